@@ -0,0 +1,269 @@
+#pragma once
+#ifndef DATABUNDLE_H
+#define DATABUNDLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../engine/coreUtils/mappedFile.h"
+#include "paletteLoader.h"
+#include "glyphLoader.h"
+#include "wordlistLoader.h"
+
+//=============================================================================
+//==== Baked Data Resource Bundle =============================================
+//=============================================================================
+
+// the palettes, font glyphs and wordlists, already decoded, in one flat binary file - so startup maps it and copies
+	// the records out, instead of decoding four PNGs and walking the glyph sheet pixel by pixel. The PNGs stay the
+	// source of truth: the bundle gets baked from them the first time they're parsed ( or on demand, from the terminal ),
+	// and it's ignored if it doesn't match the version, the checksum, or the size and timestamp of any source that's there
+
+// a source that's missing doesn't invalidate the bundle, so a build can ship with just the bundle and no PNGs
+
+constexpr uint32_t dataBundleVersion = 2;
+const std::string dataBundlePath = "../src/data/dataBundle.bin";
+
+// in the order they get stamped in the header
+const std::string dataBundleSources[ 4 ] = {
+	"../src/data/palettes.png",
+	"../src/data/bitfontCore2.png",
+	"../src/data/wordlistBad.png",
+	"../src/data/wordlistColor.png"
+};
+
+struct dataBundleHeader {
+	char magic[ 8 ] = { 'J', 'B', 'D', 'A', 'T', 'A', 0, 0 };
+	uint32_t version = dataBundleVersion;
+	uint32_t headerSize = sizeof( dataBundleHeader );
+	struct {
+		uint64_t size = 0;			// both zero when the source was missing at bake time
+		int64_t time = 0;
+	} sources[ 4 ];
+	uint64_t paletteCount = 0;
+	uint64_t glyphCount = 0;
+	uint64_t badWordCount = 0;
+	uint64_t colorWordCount = 0;
+	uint64_t payloadSize = 0;
+	uint64_t checksum = 0;			// FNV-1a over everything before this field, then the payload
+};
+
+// payload, all packed with no padding:
+	// palettes - uint32 label length, label chars, uint32 color count, then r, g, b bytes per color
+	// glyphs - int32 index, uint32 width, uint32 height, then width * height bytes, row major, 0 or 1
+	// bad words, then color words - uint32 length, then the chars
+
+static uint64_t DataBundleChecksum ( const uint8_t *data, const size_t size, uint64_t hash = 14695981039346656037ull ) {
+	for ( size_t i = 0; i < size; i++ ) {
+		hash = ( hash ^ data[ i ] ) * 1099511628211ull;
+	}
+	return hash;
+}
+
+// the header is covered too, so a damaged count or size gets caught here rather than sizing an allocation
+static uint64_t DataBundleChecksum ( const dataBundleHeader &header, const uint8_t *payload ) {
+	const uint64_t headerHash = DataBundleChecksum( reinterpret_cast< const uint8_t * >( &header ), offsetof( dataBundleHeader, checksum ) );
+	return DataBundleChecksum( payload, header.payloadSize, headerHash );
+}
+
+// false if the source is missing
+static bool DataBundleSourceStamp ( const std::string &path, uint64_t &size, int64_t &time ) {
+	std::error_code ec;
+	size = std::filesystem::file_size( path, ec );
+	if ( ec ) {
+		size = 0;
+		return false;
+	}
+	time = int64_t( std::filesystem::last_write_time( path, ec ).time_since_epoch().count() );
+	return !ec;
+}
+
+// fills out the lists from the bundle, false if it's missing, stale, or damaged - the lists are only touched on success
+static bool LoadDataBundle ( std::vector< paletteEntry > &paletteList, std::vector< glyph > &glyphList,
+	std::vector< std::string > &badWords, std::vector< std::string > &colorWords, const std::string &path = dataBundlePath ) {
+
+	mappedFile bundle( path );
+	const dataBundleHeader *header = bundle.At< dataBundleHeader >( 0 );
+	const dataBundleHeader expected;
+	if ( header == nullptr || std::memcmp( header->magic, expected.magic, sizeof( expected.magic ) ) != 0 ||
+		header->version != expected.version || header->headerSize != expected.headerSize ) {
+		return false;
+	}
+	for ( int i = 0; i < 4; i++ ) {
+		uint64_t size;
+		int64_t time;
+		if ( DataBundleSourceStamp( dataBundleSources[ i ], size, time ) &&
+			( size != header->sources[ i ].size || time != header->sources[ i ].time ) ) {
+			return false;
+		}
+	}
+	const uint8_t *payload = bundle.At< uint8_t >( sizeof( dataBundleHeader ), header->payloadSize );
+	if ( payload == nullptr || DataBundleChecksum( *header, payload ) != header->checksum ) {
+		return false;
+	}
+
+	// every record takes at least 4 bytes, so no count can be larger than this - checked again before anything is sized
+	const uint64_t maxRecords = header->payloadSize / 4;
+	if ( header->paletteCount > maxRecords || header->glyphCount > maxRecords ||
+		header->badWordCount > maxRecords || header->colorWordCount > maxRecords ) {
+		return false;
+	}
+
+	// reads are bounds checked against the payload, and go through memcpy since nothing in there is aligned
+	const uint8_t *cursor = payload;
+	const uint8_t *end = payload + header->payloadSize;
+	bool good = true;
+	auto readBytes = [ & ] ( void *out, const size_t count ) {
+		if ( !good || size_t( end - cursor ) < count ) {
+			good = false;
+			return;
+		}
+		std::memcpy( out, cursor, count );
+		cursor += count;
+	};
+	auto readU32 = [ & ] () {
+		uint32_t value = 0;
+		readBytes( &value, sizeof( value ) );
+		return value;
+	};
+	// lengths are checked against what's left before anything gets allocated for them
+	auto remaining = [ & ] () { return uint64_t( end - cursor ); };
+	auto readString = [ & ] () {
+		const uint32_t length = readU32();
+		if ( !good || length > remaining() ) {
+			good = false;
+			return std::string();
+		}
+		std::string value( length, ' ' );
+		readBytes( value.data(), value.size() );
+		return value;
+	};
+
+	std::vector< paletteEntry > palettes( header->paletteCount );
+	for ( auto &p : palettes ) {
+		p.label = readString();
+		const uint64_t colorBytes = uint64_t( readU32() ) * 3;
+		if ( !good || colorBytes > remaining() ) {
+			return false;
+		}
+		std::vector< uint8_t > rgb( colorBytes );
+		readBytes( rgb.data(), rgb.size() );
+		p.colors.resize( rgb.size() / 3 );
+		for ( size_t c = 0; c < p.colors.size(); c++ ) {
+			p.colors[ c ] = glm::ivec3( rgb[ 3 * c ], rgb[ 3 * c + 1 ], rgb[ 3 * c + 2 ] );
+		}
+		if ( !good ) {
+			return false;
+		}
+	}
+
+	std::vector< glyph > glyphs( header->glyphCount );
+	for ( auto &g : glyphs ) {
+		int32_t index = 0;
+		readBytes( &index, sizeof( index ) );
+		g.index = index;
+		const uint32_t width = readU32();
+		const uint32_t height = readU32();
+		if ( !good || height > remaining() || uint64_t( width ) * height > remaining() ) {
+			return false;
+		}
+		g.glyphData.resize( height );
+		for ( auto &row : g.glyphData ) {
+			row.resize( width );
+			readBytes( row.data(), width );
+		}
+	}
+
+	std::vector< std::string > bad( header->badWordCount );
+	for ( auto &word : bad ) {
+		word = readString();
+	}
+	std::vector< std::string > color( header->colorWordCount );
+	for ( auto &word : color ) {
+		word = readString();
+	}
+	if ( !good || cursor != end ) {
+		return false;
+	}
+
+	paletteList.insert( paletteList.end(), std::make_move_iterator( palettes.begin() ), std::make_move_iterator( palettes.end() ) );
+	glyphList.insert( glyphList.end(), std::make_move_iterator( glyphs.begin() ), std::make_move_iterator( glyphs.end() ) );
+	badWords.insert( badWords.end(), std::make_move_iterator( bad.begin() ), std::make_move_iterator( bad.end() ) );
+	colorWords.insert( colorWords.end(), std::make_move_iterator( color.begin() ), std::make_move_iterator( color.end() ) );
+	return true;
+}
+
+// writes out lists that were loaded from the PNGs, stamped with the current sources - written to a temp file and renamed
+	// into place, so a partial write never gets picked up as a bundle
+static bool BakeDataBundle ( const std::vector< paletteEntry > &paletteList, const std::vector< glyph > &glyphList,
+	const std::vector< std::string > &badWords, const std::vector< std::string > &colorWords, const std::string &path = dataBundlePath ) {
+
+	dataBundleHeader header;
+	for ( int i = 0; i < 4; i++ ) {
+		DataBundleSourceStamp( dataBundleSources[ i ], header.sources[ i ].size, header.sources[ i ].time );
+	}
+	header.paletteCount = paletteList.size();
+	header.glyphCount = glyphList.size();
+	header.badWordCount = badWords.size();
+	header.colorWordCount = colorWords.size();
+
+	std::vector< uint8_t > payload;
+	auto writeBytes = [ & ] ( const void *data, const size_t count ) {
+		const uint8_t *bytes = static_cast< const uint8_t * >( data );
+		payload.insert( payload.end(), bytes, bytes + count );
+	};
+	auto writeU32 = [ & ] ( const uint32_t value ) {
+		writeBytes( &value, sizeof( value ) );
+	};
+	auto writeString = [ & ] ( const std::string &value ) {
+		writeU32( uint32_t( value.size() ) );
+		writeBytes( value.data(), value.size() );
+	};
+
+	for ( auto &p : paletteList ) {
+		writeString( p.label );
+		writeU32( uint32_t( p.colors.size() ) );
+		for ( auto &c : p.colors ) {
+			const uint8_t rgb[ 3 ] = { uint8_t( c.r ), uint8_t( c.g ), uint8_t( c.b ) };
+			writeBytes( rgb, 3 );
+		}
+	}
+	for ( auto &g : glyphList ) {
+		const int32_t index = g.index;
+		writeBytes( &index, sizeof( index ) );
+		writeU32( g.glyphData.empty() ? 0 : uint32_t( g.glyphData[ 0 ].size() ) );
+		writeU32( uint32_t( g.glyphData.size() ) );
+		for ( auto &row : g.glyphData ) {
+			writeBytes( row.data(), row.size() );
+		}
+	}
+	for ( auto &word : badWords ) {
+		writeString( word );
+	}
+	for ( auto &word : colorWords ) {
+		writeString( word );
+	}
+	header.payloadSize = payload.size();
+	header.checksum = DataBundleChecksum( header, payload.data() );
+
+	const std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file( tempPath, std::ios::binary | std::ios::trunc );
+		file.write( reinterpret_cast< const char * >( &header ), sizeof( header ) );
+		file.write( reinterpret_cast< const char * >( payload.data() ), payload.size() );
+		if ( !file ) {
+			cout << "failed to write data bundle " << path << newline;
+			return false;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename( tempPath, path, ec );
+	return !ec;
+}
+
+#endif // DATABUNDLE_H
@@ -20,12 +20,24 @@
 
 //===== STL ===========================================================================================================
 #include <array>
+#include <bit>
+#include <deque>
 #include <vector>
 #include <random>
 #include <string>
 #include <iostream>
 #include <type_traits> // for std::is_same - https://en.cppreference.com/w/cpp/types/is_same
 
+// std::execution parallel algorithms - MSVC ships its own backend, libstdc++ wants TBB linked in, so it's opt-in there
+#if defined( _MSC_VER ) || defined( IMAGE2_USE_STD_EXECUTION )
+	#include <execution>
+	#define IMAGE2_HAS_STD_EXECUTION
+#endif
+
+//===== Span Kernels ==================================================================================================
+// SSE2/AVX2/scalar kernels over contiguous runs of pixel data, used by the bulk operations below
+#include "image2Kernels.h"
+
 //===== Image2 ========================================================================================================
 
 // TODO:
@@ -44,93 +56,117 @@ enum channel {
 	alpha = 3
 };
 
-template < typename imageType, int numChannels > class Image2 {
-public:
-
-	struct color {
-		color () {}
-		color ( std::array< imageType, numChannels > init ) : data( init ) {}
+// pixel value, one entry per channel
+template < typename imageType, int numChannels >
+struct image2Color {
+	image2Color () {}
+	image2Color ( std::array< imageType, numChannels > init ) : data( init ) {}
 
-		std::array< imageType, numChannels > data { 0 };
+	std::array< imageType, numChannels > data { 0 };
 
-		imageType operator [] ( int c ) const { return data[ c ]; }	// for val = color[ c ]
-		imageType & operator [] ( int c ) { return data[ c ]; }		// for color[ c ] = val
+	imageType operator [] ( int c ) const { return data[ c ]; }	// for val = color[ c ]
+	imageType & operator [] ( int c ) { return data[ c ]; }		// for color[ c ] = val
 
-		friend bool operator == ( const color& l, const color& r ) {
-			for ( int i = 0; i < numChannels; i++ ) {
-				if ( l.data[ i ] != r.data[ i ] ) {
-					return false;
-				}
+	friend bool operator == ( const image2Color& l, const image2Color& r ) {
+		for ( int i = 0; i < numChannels; i++ ) {
+			if ( l.data[ i ] != r.data[ i ] ) {
+				return false;
 			}
-			return true;
 		}
+		return true;
+	}
 
-		// operators needed for blending - sum + division by float normalization factor
-			// adding some others, just in case I need them at some point
-		color operator + ( const color &other ) const {
-			color temp;
-			for ( int c { 0 }; c < numChannels; c++ ) {
-				temp.data[ c ] = this->data[ c ] + other.data[ c ];
-			}
-			return temp;
+	// operators needed for blending - sum + division by float normalization factor
+		// adding some others, just in case I need them at some point
+	image2Color operator + ( const image2Color &other ) const {
+		image2Color temp;
+		for ( int c { 0 }; c < numChannels; c++ ) {
+			temp.data[ c ] = this->data[ c ] + other.data[ c ];
 		}
+		return temp;
+	}
 
-		color operator - ( const color &other ) const {
-			color temp;
-			for ( int c { 0 }; c < numChannels; c++ ) {
-				temp.data[ c ] = this->data[ c ] - other.data[ c ];
-			}
-			return temp;
+	image2Color operator - ( const image2Color &other ) const {
+		image2Color temp;
+		for ( int c { 0 }; c < numChannels; c++ ) {
+			temp.data[ c ] = this->data[ c ] - other.data[ c ];
 		}
+		return temp;
+	}
 
-		color operator / ( const float divisor ) const {
-			color temp;
-			for ( int c { 0 }; c < numChannels; c++ ) {
-				temp.data[ c ] = this->data[ c ] / divisor;
-			}
-			return temp;
+	image2Color operator / ( const float divisor ) const {
+		image2Color temp;
+		for ( int c { 0 }; c < numChannels; c++ ) {
+			temp.data[ c ] = this->data[ c ] / divisor;
 		}
+		return temp;
+	}
 
-		color operator * ( const float scalar ) const {
-			color temp;
-			for ( int c { 0 }; c < numChannels; c++ ) {
-				temp.data[ c ] = this->data[ c ] * scalar;
-			}
-			return temp;
+	image2Color operator * ( const float scalar ) const {
+		image2Color temp;
+		for ( int c { 0 }; c < numChannels; c++ ) {
+			temp.data[ c ] = this->data[ c ] * scalar;
 		}
+		return temp;
+	}
 
-		color operator / ( const color &divisor ) const {
-			color temp;
-			for ( int c { 0 }; c < numChannels; c++ ) {
-				temp.data[ c ] = this->data[ c ] / divisor.data[ c ];
-			}
-			return temp;
+	image2Color operator / ( const image2Color &divisor ) const {
+		image2Color temp;
+		for ( int c { 0 }; c < numChannels; c++ ) {
+			temp.data[ c ] = this->data[ c ] / divisor.data[ c ];
 		}
+		return temp;
+	}
 
-		color operator * ( const color &scalar ) const {
-			color temp;
-			for ( int c { 0 }; c < numChannels; c++ ) {
-				temp.data[ c ] = this->data[ c ] * scalar.data[ c ];
-			}
-			return temp;
-		}
-
-		float GetLuma () const {
-		// we're going to basically bake in the assumption that it has 3 color channels
-			// because this luma calculation is basically just valid for the RGB color situation
-			const bool isUint = std::is_same< uint8_t, imageType >::value;
-			// NTSC saturation weights
-			const float scaleFactors[] = { 0.299f, 0.587f, 0.114f };
-			float sum = 0.0f;
-			for ( int c { 0 }; c < numChannels && c < 3; c++ ) {
-				sum += ( isUint ? data[ c ] / 255.0f : data[ c ] ) * ( isUint ? data[ c ] / 255.0f : data[ c ] ) * scaleFactors[ c ];
-			}
-			return sqrt( sum );
+	image2Color operator * ( const image2Color &scalar ) const {
+		image2Color temp;
+		for ( int c { 0 }; c < numChannels; c++ ) {
+			temp.data[ c ] = this->data[ c ] * scalar.data[ c ];
 		}
+		return temp;
+	}
 
-		// add swizzle? or is that too redundant? would probably make more sense on the color than on the image
+	float GetLuma () const {
+	// we're going to basically bake in the assumption that it has 3 color channels
+		// because this luma calculation is basically just valid for the RGB color situation
+		const bool isUint = std::is_same< uint8_t, imageType >::value;
+		// NTSC saturation weights
+		const float scaleFactors[] = { 0.299f, 0.587f, 0.114f };
+		float sum = 0.0f;
+		for ( int c { 0 }; c < numChannels && c < 3; c++ ) {
+			sum += ( isUint ? data[ c ] / 255.0f : data[ c ] ) * ( isUint ? data[ c ] / 255.0f : data[ c ] ) * scaleFactors[ c ];
+		}
+		return sqrt( sum );
+	}
 
-	};
+	// add swizzle? or is that too redundant? would probably make more sense on the color than on the image
+
+};
+
+// how the pixels are ordered in memory - row-major is what the file formats and the GPU expect, the other two keep
+	// 2D neighborhoods together in cache lines for the scattered reads ( lens distortion, sampling, texturing )
+enum class imageLayout_t {
+	ROW_MAJOR,	// scanlines, one after another
+	TILED_8x8,	// 8x8 tiles, row-major inside each tile and across the grid of tiles - sizes pad up to a multiple of 8
+	MORTON		// Z-order curve, bits of x and y interleaved - each axis pads up to a power of two
+};
+
+// how the whole-image operations get split up - every policy hands out the same row bands, and rows
+	// are independent of one another, so the output is identical to the serial path in every case
+enum class image2ExecutionPolicy_t {
+	SERIAL,			// one thread, top to bottom
+	THREAD_POOL,	// row bands submitted to the shared jbDE::GetThreadPool()
+	STD_EXECUTION	// row bands through std::for_each( std::execution::par ), falls back to the pool if unavailable
+};
+
+// file loading/saving libraries
+enum class image2Backend_t { STB_IMG, LODEPNG, TINYEXR };
+
+template < typename imageType, int numChannels, imageLayout_t layout = imageLayout_t::ROW_MAJOR > class Image2 {
+public:
+
+	// shared by all the layouts, so pixels move freely between e.g. a row-major and a tiled image
+	using color = image2Color< imageType, numChannels >;
 
 //===== Constructors ==================================================================================================
 
@@ -139,41 +175,313 @@ public:
 
 	// init emtpy image with given dimensions
 	Image2 ( uint32_t x, uint32_t y ) : width( x ), height( y ) {
-		data.resize( width * height * numChannels, 0 );
+		data.resize( StorageSize(), 0 );
 	}
 
 	// load image from path
-	enum class backend { STB_IMG, LODEPNG, TINYEXR };
+	using backend = image2Backend_t;
 	Image2 ( string path, backend loader = backend::LODEPNG ) {
 		if ( !Load( path, loader ) ) {
 			cout << "image load failed with path " << path << newline << flush;
 		}
 	}
 
-	// load from e.g. GPU memory, also used for copying from another image with GetImageDataBasePtr()
+	// load from e.g. GPU memory, also used for copying from another image with GetImageDataBasePtr() - contents are row-major
 	Image2 ( uint32_t x, uint32_t y, const imageType* contents ) : width( x ), height( y ) {
-		const size_t numBers = width * height * numChannels;
-		data.reserve( numBers );
-		for ( size_t idx = 0; idx < numBers; idx++ ) {
-			data.push_back( contents[ idx ] );
+		CopyFromRowMajor( contents );
+	}
+
+	// convert from another layout, e.g. a row-major image that was just loaded
+	template < imageLayout_t sourceLayout > requires ( sourceLayout != layout )
+	explicit Image2 ( const Image2< imageType, numChannels, sourceLayout > &source ) :
+		executionPolicy( source.executionPolicy ), width( source.Width() ), height( source.Height() ) {
+		if constexpr ( sourceLayout == imageLayout_t::ROW_MAJOR ) {
+			CopyFromRowMajor( source.GetImageDataBasePtr() );
+		} else {
+			CopyFromRowMajor( source.ToRowMajor().GetImageDataBasePtr() );
 		}
 	}
 
 	// construct from another image of the same type
-	Image2< imageType, numChannels > ( const Image2< imageType, numChannels > &source ) {
+	Image2 ( const Image2 &source ) :
+		executionPolicy( source.executionPolicy ), width( source.width ), height( source.height ), data( source.data ),
+		mipLevels( source.mipLevels ), mipData( source.mipData ) {}
+
+	// take over another image's buffer, leaving it empty - e.g. pushing a freshly loaded image into a container
+	Image2 ( Image2 &&source ) noexcept :
+		executionPolicy( source.executionPolicy ), width( source.width ), height( source.height ), data( std::move( source.data ) ),
+		mipLevels( std::move( source.mipLevels ) ), mipData( std::move( source.mipData ) ) {
+		source.width = source.height = 0;
+		source.data.clear();
+		source.ClearMipChain();
+	}
+
+	// copy assignment reuses the existing buffer when it's already big enough
+	Image2& operator = ( const Image2 &source ) {
+		if ( this != &source ) {
+			executionPolicy = source.executionPolicy;
+			width = source.width;
+			height = source.height;
+			data.assign( source.data.begin(), source.data.end() );
+			mipLevels = source.mipLevels;
+			mipData.assign( source.mipData.begin(), source.mipData.end() );
+		}
+		return *this;
+	}
+
+	Image2& operator = ( Image2 &&source ) noexcept {
+		if ( this != &source ) {
+			executionPolicy = source.executionPolicy;
+			width = source.width;
+			height = source.height;
+			data = std::move( source.data );
+			mipLevels = std::move( source.mipLevels );
+			mipData = std::move( source.mipData );
+			source.width = source.height = 0;
+			source.data.clear();
+			source.ClearMipChain();
+		}
+		return *this;
+	}
+
+//===== Storage Layout ================================================================================================
+
+	using rowMajorImage_t = Image2< imageType, numChannels, imageLayout_t::ROW_MAJOR >;
+
+	// size of the storage grid, the padded layouts round the image dimensions up
+	static uint32_t StorageDimension ( const uint32_t dimension ) {
+		uint32_t storage = dimension;
+		if constexpr ( layout == imageLayout_t::TILED_8x8 ) {
+			storage = ( dimension + 7u ) & ~7u;
+		} else if constexpr ( layout == imageLayout_t::MORTON ) {
+			storage = std::bit_ceil( dimension );
+		}
+		return storage;
+	}
+	uint32_t StorageWidth () const { return StorageDimension( width ); }
+	uint32_t StorageHeight () const { return StorageDimension( height ); }
+	size_t StorageSize () const { return size_t( StorageWidth() ) * StorageHeight() * numChannels; }
+
+	// spreads the low 16 bits out to the even bit positions
+	static uint32_t SpreadBits ( uint32_t v ) {
+		v &= 0x0000FFFFu;
+		v = ( v | ( v << 8 ) ) & 0x00FF00FFu;
+		v = ( v | ( v << 4 ) ) & 0x0F0F0F0Fu;
+		v = ( v | ( v << 2 ) ) & 0x33333333u;
+		v = ( v | ( v << 1 ) ) & 0x55555555u;
+		return v;
+	}
+
+	// where pixel ( x, y ) lives, in pixels from the start of data
+	size_t PixelIndex ( const uint32_t x, const uint32_t y ) const {
+		if constexpr ( layout == imageLayout_t::TILED_8x8 ) {
+			const size_t tile = size_t( y >> 3 ) * ( StorageWidth() >> 3 ) + ( x >> 3 );
+			return tile * 64 + ( ( y & 7u ) << 3 ) + ( x & 7u );
+		} else if constexpr ( layout == imageLayout_t::MORTON ) {
+			// interleave as many bits as both axes have, the longer axis' leftover high bits go on top
+			const uint32_t bitsX = std::countr_zero( StorageWidth() );
+			const uint32_t bitsY = std::countr_zero( StorageHeight() );
+			const uint32_t shared = std::min( bitsX, bitsY );
+			const uint32_t mask = ( 1u << shared ) - 1u;
+			const size_t interleaved = SpreadBits( x & mask ) | ( SpreadBits( y & mask ) << 1 );
+			const size_t leftover = ( bitsX > bitsY ) ? ( x >> shared ) : ( y >> shared );
+			return interleaved | ( leftover << ( 2 * shared ) );
+		} else {
+			return size_t( y ) * width + x;
+		}
+	}
+
+	// row-major copy, for the save paths, uploads, and anything else that wants scanlines
+	rowMajorImage_t ToRowMajor () const {
+		if constexpr ( layout == imageLayout_t::ROW_MAJOR ) {
+			return PixelCopy();
+		} else {
+			rowMajorImage_t result( width, height );
+			result.SetExecutionPolicy( executionPolicy );
+			imageType *rows = result.GetImageDataBasePtr();
+			ForEachRow( [ & ] ( const uint32_t y ) {
+				for ( uint32_t x = 0; x < width; x++ ) {
+					const imageType *src = data.data() + PixelIndex( x, y ) * numChannels;
+					std::copy( src, src + numChannels, rows + ( size_t( y ) * width + x ) * numChannels );
+				}
+			} );
+			return result;
+		}
+	}
+
+	// take on the size and contents of a row-major image
+	void AssignFromRowMajor ( const rowMajorImage_t &source ) {
+		ClearMipChain();
 		width = source.Width();
 		height = source.Height();
-		const size_t numBers = width * height * numChannels;
-		data.reserve( numBers );
-		for ( size_t idx = 0; idx < numBers; idx++ ) {
-			data.push_back( source.GetImageDataBasePtr()[ idx ] );
+		CopyFromRowMajor( source.GetImageDataBasePtr() );
+	}
+
+	// the operations that only make sense on scanlines ( resampling, convolution, flips ) go through a row-major
+		// copy when the layout is something else
+	template < typename op_t >
+	void ViaRowMajor ( op_t &&op ) {
+		rowMajorImage_t rowMajor = ToRowMajor();
+		op( rowMajor );
+		AssignFromRowMajor( rowMajor );
+	}
+
+	// contents of this image without the mip chain, for the operations that sample a snapshot of the image while overwriting it
+	Image2 PixelCopy () const {
+		Image2 copy;
+		copy.executionPolicy = executionPolicy;
+		copy.width = width;
+		copy.height = height;
+		copy.data = data;
+		return copy;
+	}
+
+	void CopyFromRowMajor ( const imageType *rows ) {
+		if constexpr ( layout == imageLayout_t::ROW_MAJOR ) {
+			data.assign( rows, rows + size_t( width ) * height * numChannels );
+		} else {
+			data.assign( StorageSize(), imageType( 0 ) );
+			ForEachRow( [ & ] ( const uint32_t y ) {
+				for ( uint32_t x = 0; x < width; x++ ) {
+					const imageType *src = rows + ( size_t( y ) * width + x ) * numChannels;
+					std::copy( src, src + numChannels, data.data() + PixelIndex( x, y ) * numChannels );
+				}
+			} );
 		}
 	}
 
+//===== Execution Policy ==============================================================================================
+
+	// see image2ExecutionPolicy_t, shared across the image types so settings carry over between them
+	using executionPolicy_t = image2ExecutionPolicy_t;
+
+	// new images pick this up, individual images can override with SetExecutionPolicy()
+	static inline executionPolicy_t defaultExecutionPolicy = executionPolicy_t::THREAD_POOL;
+	executionPolicy_t executionPolicy = defaultExecutionPolicy;
+	void SetExecutionPolicy ( executionPolicy_t policy ) { executionPolicy = policy; }
+
+	// below this many pixels per band, dispatch costs more than it saves
+	static constexpr uint32_t minPixelsPerBand = 16384;
+
+	// calls bandFunc( yMin, yMax ) over row bands covering [ 0, numRows ), rowWidth is used to size the bands
+	template < typename bandFunc_t >
+	void ForEachRowBand ( const uint32_t numRows, const uint32_t rowWidth, bandFunc_t &&bandFunc ) const {
+		if ( numRows == 0 ) return;
+
+		threadPool &pool = jbDE::GetThreadPool();
+		const uint32_t rowsPerBandMin = std::max( 1u, minPixelsPerBand / std::max( 1u, rowWidth ) );
+		const uint32_t rowsPerBandSplit = ( numRows + pool.NumThreads() * 4 - 1 ) / ( pool.NumThreads() * 4 );
+		const uint32_t rowsPerBand = std::max( rowsPerBandMin, rowsPerBandSplit );
+
+		if ( executionPolicy == executionPolicy_t::SERIAL || rowsPerBand >= numRows ) {
+			bandFunc( 0u, numRows );
+			return;
+		}
+
+	#ifdef IMAGE2_HAS_STD_EXECUTION
+		if ( executionPolicy == executionPolicy_t::STD_EXECUTION ) {
+			std::vector< uint32_t > bandStarts;
+			for ( uint32_t y = 0; y < numRows; y += rowsPerBand ) {
+				bandStarts.push_back( y );
+			}
+			std::for_each( std::execution::par, bandStarts.begin(), bandStarts.end(), [ & ] ( const uint32_t yMin ) {
+				bandFunc( yMin, std::min( yMin + rowsPerBand, numRows ) );
+			} );
+			return;
+		}
+	#endif
+
+		pool.ParallelFor( 0, numRows, rowsPerBand, [ & ] ( const int64_t yMin, const int64_t yMax ) {
+			bandFunc( uint32_t( yMin ), uint32_t( yMax ) );
+		} );
+	}
+
+	// start of a scanline - only meaningful for the row-major layout
+	imageType* RowPointer ( const uint32_t y ) { return data.data() + size_t( y ) * width * numChannels; }
+
+	// calls spanFunc( span, count ) over bands of the storage, for the bulk operations that treat every pixel the same -
+		// the order doesn't matter to them, so they run straight through any layout ( padding included, it's never read )
+	template < typename spanFunc_t >
+	void ForEachSpan ( spanFunc_t &&spanFunc ) {
+		const size_t rowLength = size_t( StorageWidth() ) * numChannels;
+		ForEachRowBand( StorageHeight(), StorageWidth(), [ & ] ( const uint32_t yMin, const uint32_t yMax ) {
+			spanFunc( data.data() + yMin * rowLength, ( yMax - yMin ) * rowLength );
+		} );
+	}
+
+	// uint8 images run per-channel 256 entry tables, built from the same scalar expression the operation would use
+	typedef uint8_t channelTable_t[ numChannels ][ 256 ];
+	void ApplyChannelTables ( const channelTable_t &tables ) {
+		ForEachSpan( [ & ] ( imageType *span, const size_t count ) {
+			image2Kernels::LUTSpan< numChannels >( span, count, tables );
+		} );
+	}
+
+	// calls rowFunc( y ) once for every row of the image
+	template < typename rowFunc_t >
+	void ForEachRow ( rowFunc_t &&rowFunc ) const {
+		ForEachRowBand( height, width, [ & ] ( const uint32_t yMin, const uint32_t yMax ) {
+			for ( uint32_t y = yMin; y < yMax; y++ ) {
+				rowFunc( y );
+			}
+		} );
+	}
+
+//===== Scratch Arena =================================================================================================
+
+	// operations that really do need a second buffer borrow it from here instead of allocating their own on every call,
+		// there's one arena per thread and element type. It is a stack of slots: while an operation holds its slot it
+		// may wait on the pool, and the pool can run another image operation on this same thread in the meantime - that
+		// one takes the next slot up instead of clobbering ours. Slots only ever grow, ReleaseScratch() frees the idle ones
+	template < typename element_t >
+	struct scratchArena_t {
+		std::deque< std::vector< element_t > > slots; // deque, so taking a new slot never moves the ones in use
+		size_t depth = 0;
+	};
+
+	template < typename element_t >
+	static scratchArena_t< element_t >& ScratchArena () {
+		static thread_local scratchArena_t< element_t > arena;
+		return arena;
+	}
+
+	// takes the next free slot for the lifetime of the object, released in reverse order by scope
+	template < typename element_t >
+	class scratchBuffer_t {
+	public:
+		scratchBuffer_t () : arena( ScratchArena< element_t >() ) {
+			if ( arena.depth == arena.slots.size() ) {
+				arena.slots.emplace_back();
+			}
+			buffer = &arena.slots[ arena.depth++ ];
+		}
+		~scratchBuffer_t () { arena.depth--; }
+		scratchBuffer_t ( const scratchBuffer_t & ) = delete;
+		scratchBuffer_t& operator = ( const scratchBuffer_t & ) = delete;
+
+		std::vector< element_t >& operator * () { return *buffer; }
+
+	private:
+		scratchArena_t< element_t > &arena;
+		std::vector< element_t > *buffer;
+	};
+
+	static void ReleaseScratch () {
+		ScratchArena< imageType >().slots.resize( ScratchArena< imageType >().depth );
+		ScratchArena< float >().slots.resize( ScratchArena< float >().depth );
+	}
+
 //===== Functions =====================================================================================================
 //======= Basic =======================================================================================================
 
 	bool Load ( string path, backend loader = backend::LODEPNG ) {
+		ClearMipChain();
+		if constexpr ( layout != imageLayout_t::ROW_MAJOR ) { // files are scanlines, load those and rearrange
+			rowMajorImage_t loaded;
+			const bool success = loaded.Load( path, loader );
+			AssignFromRowMajor( loaded );
+			return success;
+		}
 		switch ( loader ) {
 			case backend::STB_IMG: return LoadSTB_img( path ); break;
 			case backend::LODEPNG: return LoadLodePNG( path ); break;
@@ -183,6 +491,9 @@ public:
 	}
 
 	bool Save ( string path, backend loader = backend::LODEPNG ) const {
+		if constexpr ( layout != imageLayout_t::ROW_MAJOR ) {
+			return ToRowMajor().Save( path, loader );
+		}
 		switch ( loader ) {
 			case backend::STB_IMG: return SaveSTB_img( path ); break;
 			case backend::LODEPNG: return SaveLodePNG( path ); break;
@@ -192,35 +503,34 @@ public:
 	}
 
 	void FlipHorizontal () {
-		// back up the existing state of the image
-		std::vector< imageType > oldData;
-		oldData.reserve( width * height * numChannels );
-		for ( auto c : data ) oldData.push_back( c );
-		data.resize( 0 );
-		data.reserve( width * height * 4 );
-		for ( uint32_t y = 0; y < height; y++ ) {
-			for ( uint32_t x = 0; x < width; x++ ) {
-				for ( uint8_t c = 0; c < numChannels; c++ ) {
-					data.push_back( oldData[ ( ( width - x - 1 ) + y * width ) * numChannels + c ] );
-				}
-			}
+		if constexpr ( layout != imageLayout_t::ROW_MAJOR ) {
+			ViaRowMajor( [ & ] ( rowMajorImage_t &image ) { image.FlipHorizontal(); } );
+			return;
 		}
+
+		// in place, swap pixels from the two ends of each row toward the middle
+		ClearMipChain();
+		ForEachRow( [&] ( const uint32_t y ) {
+			imageType *row = RowPointer( y );
+			for ( uint32_t x = 0; x < width / 2; x++ ) {
+				std::swap_ranges( row + x * numChannels, row + ( x + 1 ) * numChannels, row + ( width - x - 1 ) * numChannels );
+			}
+		} );
 	}
 
 	void FlipVertical () {
-		// back up the existing state of the image
-		std::vector< imageType > oldData;
-		oldData.reserve( width * height * numChannels );
-		for ( auto c : data ) oldData.push_back( c );
-		data.resize( 0 );
-		data.reserve( width * height * numChannels );
-		for ( uint32_t y = 0; y < height; y++ ) {
-			for ( uint32_t x = 0; x < width; x++ ) {
-				for ( uint8_t c = 0; c < numChannels; c++ ) {
-					data.push_back( oldData[ ( x + ( height - y - 1 ) * width ) * numChannels + c ] );
-				}
-			}
+		if constexpr ( layout != imageLayout_t::ROW_MAJOR ) {
+			ViaRowMajor( [ & ] ( rowMajorImage_t &image ) { image.FlipVertical(); } );
+			return;
 		}
+
+		// in place, swap rows from the top and bottom toward the middle - the middle row of an odd height stays put
+		ClearMipChain();
+		ForEachRowBand( height / 2, width * 2, [ & ] ( const uint32_t yMin, const uint32_t yMax ) {
+			for ( uint32_t y = yMin; y < yMax; y++ ) {
+				std::swap_ranges( RowPointer( y ), RowPointer( y + 1 ), RowPointer( height - y - 1 ) );
+			}
+		} );
 	}
 
 	void Resize ( float factor ) {
@@ -229,49 +539,64 @@ public:
 	}
 
 	void Resize ( float XFactor, float YFactor ) {
+		if constexpr ( layout != imageLayout_t::ROW_MAJOR ) {
+			ViaRowMajor( [ & ] ( rowMajorImage_t &image ) { image.Resize( XFactor, YFactor ); } );
+			return;
+		}
+
 		// scale factor does not need to be the same on x and y
 		int newX = std::floor( XFactor * float( width ) );
 		int newY = std::floor( YFactor * float( height ) );
+		ClearMipChain();
 
-		// create a copy of the existing data
-		const uint32_t oldSize = width * height * numChannels;
-		imageType* oldData = ( imageType* ) malloc( oldSize * sizeof( imageType ) );
-		for ( uint32_t i = 0; i < oldSize; i++ ) {
-			oldData[ i ] = data[ i ];
-		}
-
-		// buffer needs to be allocated before the resize function runs
-		imageType* newData = ( imageType* ) malloc( newX * newY * numChannels * sizeof( imageType ) );
+		// the source is a plain local copy rather than an arena slot - resizes are mostly one-offs at load time ( e.g.
+			// SoftRast's textures, loaded in parallel ), where a slot would keep a full size copy alive on every pool thread.
+			// The result is written straight into data, which only reallocates when the image gets bigger than it's ever been
+		const std::vector< imageType > source( data.begin(), data.end() );
+		data.resize( size_t( newX ) * newY * numChannels );
+		const imageType* oldData = source.data();
+		imageType* newData = data.data();
 
 		// compiler is complaining without the casts, I have no idea why that would be neccesary - it has the correct type from imageType
 			// I guess the is_same<> does not evaluate during template instantiation? hard to say, I don't really have any insight here
-		if ( std::is_same< uint8_t, imageType >::value ) { // uint type
-			stbir_resize_uint8( ( const uint8_t* ) oldData, width, height, width * numChannels * sizeof( imageType ),
-				( uint8_t* ) newData, newX, newY, newX * numChannels * sizeof( imageType ), numChannels );
-		} else { // float type
-			stbir_resize_float( ( const float* ) oldData, width, height, width * numChannels * sizeof( imageType ),
-				( float* ) newData, newX, newY, newX * numChannels * sizeof( imageType ), numChannels );
+		const bool isUint = std::is_same< uint8_t, imageType >::value;
+		const stbir_datatype type = isUint ? STBIR_TYPE_UINT8 : STBIR_TYPE_FLOAT;
+		const float xScale = float( newX ) / float( width );
+		const float yScale = float( newY ) / float( height );
+
+		// when magnifying vertically, stb computes each output row's filter from ( row + 0.5 + shift ) / scale, so resizing
+			// bands of output rows with the band start as the shift gives exactly the same result as the one big resize. The
+			// minifying path accumulates whole input rows into the output and would not match, so that stays in one piece
+		const uint32_t bandRows = ( yScale > 1.0f ) ? newY : 0;
+		const size_t outputStride = newX * numChannels * sizeof( imageType );
+		ForEachRowBand( bandRows, newX, [ & ] ( const uint32_t yMin, const uint32_t yMax ) {
+			stbir_resize_subpixel( oldData, width, height, width * numChannels * sizeof( imageType ),
+				( uint8_t * ) newData + yMin * outputStride, newX, yMax - yMin, outputStride,
+				type, numChannels, -1, 0, STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT, STBIR_FILTER_DEFAULT,
+				STBIR_COLORSPACE_LINEAR, NULL, xScale, yScale, 0.0f, float( yMin ) );
+		} );
+
+		if ( bandRows == 0 ) {
+			if ( isUint ) { // uint type
+				stbir_resize_uint8( ( const uint8_t* ) oldData, width, height, width * numChannels * sizeof( imageType ),
+					( uint8_t* ) newData, newX, newY, newX * numChannels * sizeof( imageType ), numChannels );
+			} else { // float type
+				stbir_resize_float( ( const float* ) oldData, width, height, width * numChannels * sizeof( imageType ),
+					( float* ) newData, newX, newY, newX * numChannels * sizeof( imageType ), numChannels );
+			}
 		}
 
 		// image dimensions are now scaled up by the input scale factor
 		width = newX;
 		height = newY;
-
-		// copy new data back to the data vector
-		data.resize( 0 );
-		const uint32_t newSize = width * height * numChannels;
-		data.reserve( newSize );
-		for ( uint32_t i = 0; i < newSize; i++ ) {
-			data.push_back( newData[ i ] );
-		}
 	}
 
 	void ClearTo ( color c ) {
-		for ( uint32_t y { 0 }; y < height; y++ ){
+		ForEachRow( [&] ( const uint32_t y ) {
 			for ( uint32_t x { 0 }; x < width; x++ ) {
 				SetAtXY( x, y, c );
 			}
-		}
+		} );
 	}
 
 	void ClearEveryOtherColumnTo ( color c ) {
@@ -291,15 +616,18 @@ public:
 	}
 
 	void GammaCorrect ( const float gamma, bool touchAlpha = false ) {
-		for ( uint32_t y { 0 }; y < height; y++ ){
-			for ( uint32_t x { 0 }; x < width; x++ ) {
-				color src = GetAtXY( x, y );
-				for ( uint8_t c { 0 }; c < numChannels; c++ ) {
-					if ( !touchAlpha && c == 3 ) break;
-					src[ c ] = std::pow( src[ c ], 1.0f / gamma );
+		if constexpr ( std::is_same< float, imageType >::value ) {
+			ForEachSpan( [ & ] ( imageType *span, const size_t count ) {
+				image2Kernels::GammaSpan< numChannels >( span, count, 1.0f / gamma, touchAlpha );
+			} );
+		} else {
+			channelTable_t tables;
+			for ( uint8_t c { 0 }; c < numChannels; c++ ) {
+				for ( int v { 0 }; v < 256; v++ ) {
+					tables[ c ][ v ] = ( !touchAlpha && c == 3 ) ? v : imageType( std::pow( imageType( v ), 1.0f / gamma ) );
 				}
-				SetAtXY( x, y, src );
 			}
+			ApplyChannelTables( tables );
 		}
 	}
 
@@ -322,7 +650,7 @@ public:
 		const bool isUint = std::is_same< uint8_t, imageType >::value;
 		const imageType min = isUint ?   0 : 0.0f;
 		const imageType max = isUint ? 255 : 1.0f;
-		for ( uint32_t y { 0 }; y < height; y++ ) {
+		ForEachRow( [&] ( const uint32_t y ) {
 			for ( uint32_t x { 0 }; x < width; x++ ) {
 				const color sourceData = GetAtXY( x, y );
 				const float sourceLuma = sourceData.GetLuma();
@@ -345,46 +673,63 @@ public:
 				}
 				SetAtXY( x, y, setData );
 			}
-		}
+		} );
 	}
 
 	void SaturateAlpha () {
-		Swizzle( "rgb1" );
+		// same as Swizzle( "rgb1" ), only the alpha channel changes
+		if constexpr ( numChannels == 4 ) {
+			const imageType max = std::is_same< uint8_t, imageType >::value ? 255 : 1.0f;
+			ForEachSpan( [ & ] ( imageType *span, const size_t count ) {
+				image2Kernels::FillChannelSpan< numChannels >( span, count, alpha, max );
+			} );
+		}
 	}
 
 	// show only a subset of the image, or make it larger, and fill with all zeroes
 	void Crop ( uint32_t newWidth, uint32_t newHeight, uint32_t offsetX = 0, uint32_t offsetY = 0 ) {
-		// out of bounds reads are all zeroes, we will keep that convention for simplicity
-		std::vector< imageType > newData;
-		newData.reserve( newWidth * newHeight * numChannels );
-		for ( uint32_t y { 0 }; y < newHeight; y++ ) {
-			for ( uint32_t x { 0 }; x < newWidth; x++ ) {
-				color oldVal = GetAtXY( x + offsetX, y + offsetY );
-				for ( uint8_t i { 0 }; i < numChannels; i++ ) {
-					newData.push_back( oldVal[ i ] );
-				}
-			}
+		if constexpr ( layout != imageLayout_t::ROW_MAJOR ) {
+			ViaRowMajor( [ & ] ( rowMajorImage_t &image ) { image.Crop( newWidth, newHeight, offsetX, offsetY ); } );
+			return;
 		}
-		data.resize( 0 );
-		data.reserve( newWidth * newHeight * numChannels );
-		data.assign( newData.begin(), newData.end() );
-		newData.clear();
+
+		// out of bounds reads are all zeroes, we will keep that convention for simplicity
+		ClearMipChain();
+		scratchBuffer_t< imageType > scratch;
+		std::vector< imageType > &source = *scratch;
+		source.assign( data.begin(), data.end() );
+		const uint32_t oldWidth = width;
+		const uint32_t oldHeight = height;
+		data.assign( size_t( newWidth ) * newHeight * numChannels, imageType( 0 ) );
 		width = newWidth;
 		height = newHeight;
+
+		// copy the part of each row that overlaps the old image, everything else stays zero
+		const uint32_t copyWidth = ( offsetX < oldWidth ) ? std::min( newWidth, oldWidth - offsetX ) : 0;
+		const uint32_t copyHeight = ( offsetY < oldHeight ) ? std::min( newHeight, oldHeight - offsetY ) : 0;
+		ForEachRowBand( copyHeight, copyWidth, [ & ] ( const uint32_t yMin, const uint32_t yMax ) {
+			for ( uint32_t y = yMin; y < yMax; y++ ) {
+				const imageType *sourceRow = source.data() + ( size_t( y + offsetY ) * oldWidth + offsetX ) * numChannels;
+				std::copy( sourceRow, sourceRow + size_t( copyWidth ) * numChannels, RowPointer( y ) );
+			}
+		} );
 	}
 
 	// scale each channel of the image, using some input color
 	void ColorCast ( color cast ) {
-		const bool isUint = std::is_same< uint8_t, imageType >::value;
-		for ( uint32_t y { 0 }; y < height; y++ ) {
-			for ( uint32_t x { 0 }; x < width; x++ ) {
-				color existingColor = GetAtXY( x, y );
-				for ( uint8_t c { 0 }; c < numChannels; c++ ) {
-					float scalar = isUint ? ( cast[ c ] / 255.0f ) : cast[ c ];
-					existingColor[ c ] *= scalar;
+		if constexpr ( std::is_same< float, imageType >::value ) {
+			ForEachSpan( [ & ] ( imageType *span, const size_t count ) {
+				image2Kernels::ScaleSpan< numChannels >( span, count, cast.data.data() );
+			} );
+		} else {
+			channelTable_t tables;
+			for ( uint8_t c { 0 }; c < numChannels; c++ ) {
+				const float scalar = cast[ c ] / 255.0f;
+				for ( int v { 0 }; v < 256; v++ ) {
+					tables[ c ][ v ] = imageType( imageType( v ) * scalar );
 				}
-				SetAtXY( x, y, existingColor );
 			}
+			ApplyChannelTables( tables );
 		}
 	}
 
@@ -419,44 +764,38 @@ public:
 	// srgb conversions <-> linear light https://www.shadertoy.com/view/4tXcWr
 		// these really only apply to float images
 	void SRGBtoRGB( bool preserveAlpha = true ) {
-		for ( uint32_t y { 0 }; y < height; y++ ) {
-			for ( uint32_t x { 0 }; x < width; x++ ) {
-				color col = GetAtXY( x, y );
-				vec4 sRGB = vec4( col[ 0 ], col[ 1 ], col[ 2 ], col[ 3 ] );
-				bvec4 cutoff = lessThan( sRGB, vec4( 0.04045f ) );
-				vec4 higher = pow( ( sRGB + vec4( 0.055f ) ) / vec4( 1.055f ), vec4( 2.4f ) );
-				vec4 lower = sRGB / vec4( 12.92f );
-				vec4 result =  mix( higher, lower, cutoff );
-				if ( preserveAlpha == true ) {
-					result = vec4( result.rgb(), sRGB.a );
+		if constexpr ( std::is_same< float, imageType >::value ) {
+			ForEachSpan( [ & ] ( imageType *span, const size_t count ) {
+				image2Kernels::SRGBToLinearSpan< numChannels >( span, count, preserveAlpha );
+			} );
+		} else {
+			channelTable_t tables;
+			for ( uint8_t c { 0 }; c < numChannels; c++ ) {
+				for ( int v { 0 }; v < 256; v++ ) {
+					const float sRGB = float( v );
+					const float linear = ( sRGB < 0.04045f ) ? sRGB / 12.92f : std::pow( ( sRGB + 0.055f ) / 1.055f, 2.4f );
+					tables[ c ][ v ] = ( preserveAlpha && c == 3 ) ? v : imageType( linear );
 				}
-				col[ 0 ] = result.r;
-				col[ 1 ] = result.g;
-				col[ 2 ] = result.b;
-				col[ 3 ] = result.a;
-				SetAtXY( x, y, col );
 			}
+			ApplyChannelTables( tables );
 		}
 	}
 
 	void RGBtoSRGB( bool preserveAlpha = true ) {
-		for ( uint32_t y { 0 }; y < height; y++ ) {
-			for ( uint32_t x { 0 }; x < width; x++ ) {
-				color col = GetAtXY( x, y );
-				vec4 linearRGB = vec4( col[ 0 ], col[ 1 ], col[ 2 ], col[ 3 ] );
-				bvec4 cutoff = lessThan( linearRGB, vec4( 0.0031308f ) );
-				vec4 higher = vec4( 1.055f ) * pow( linearRGB, vec4( 1.0f / 2.4f ) ) - vec4( 0.055f );
-				vec4 lower = linearRGB * vec4( 12.92f );
-				vec4 result = mix( higher, lower, cutoff );
-				if ( preserveAlpha == true ) {
-					result = vec4( result.rgb(), linearRGB.a );
+		if constexpr ( std::is_same< float, imageType >::value ) {
+			ForEachSpan( [ & ] ( imageType *span, const size_t count ) {
+				image2Kernels::LinearToSRGBSpan< numChannels >( span, count, preserveAlpha );
+			} );
+		} else {
+			channelTable_t tables;
+			for ( uint8_t c { 0 }; c < numChannels; c++ ) {
+				for ( int v { 0 }; v < 256; v++ ) {
+					const float linearRGB = float( v );
+					const float sRGB = ( linearRGB < 0.0031308f ) ? linearRGB * 12.92f : 1.055f * std::pow( linearRGB, 1.0f / 2.4f ) - 0.055f;
+					tables[ c ][ v ] = ( preserveAlpha && c == 3 ) ? v : imageType( sRGB );
 				}
-				col[ 0 ] = result.r;
-				col[ 1 ] = result.g;
-				col[ 2 ] = result.b;
-				col[ 3 ] = result.a;
-				SetAtXY( x, y, col );
 			}
+			ApplyChannelTables( tables );
 		}
 	}
 
@@ -511,55 +850,29 @@ public:
 
 	void RangeRemap ( rangeRemapInputs_t in [ numChannels ] ) {
 		// now everything should have a valid config - do the range remapping for each channel
-		for ( uint32_t y { 0 }; y < height; y++ ) {
-			for ( uint32_t x { 0 }; x < width; x++ ) {
-				color colorRead = GetAtXY( x, y );
-
-				// do the remapping for the channel
-				for ( uint8_t c { 0 }; c < numChannels; c++ ) {
-					switch ( in[ c ].rangeType ) {
-
-						case NOOP:
-							break;
-
-						case HARDCLIP: {
-
-							imageType temp = colorRead[ c ];
-							colorRead[ c ] = RangeRemapValue(
-												colorRead[ c ],
-												in[ c ].rangeStartLow,
-												in[ c ].rangeStartHigh,
-												in[ c ].rangeEndLow,
-												in[ c ].rangeEndHigh
-											);
-
-							// for autonormalize, this should not be possible... why is it happening?
-							// if ( colorRead[ c ] != std::clamp( colorRead[ c ], in[ c ].rangeEndLow, in[ c ].rangeEndHigh ) ) {
-								// cout << "Remapping " << temp << " from " << in[ c ].rangeStartLow << " : " << in[ c ].rangeStartHigh << " to " << in[ c ].rangeEndLow << " : " << in[ c ].rangeEndHigh << " gives " << colorRead[ c ] << endl;
-								// cout << "We clipped at " << x << " " << y << " with a value of " << temp << endl;
-							//}
-
-							// if ( temp != colorRead[ c ] ) {
-								// cout << "Remapping " << temp << " from " << in[ c ].rangeStartLow << " : " << in[ c ].rangeStartHigh << " to " << in[ c ].rangeEndLow << " : " << in[ c ].rangeEndHigh << " gives " << colorRead[ c ] << endl;
-							// }
-
-							// if ( colorRead[ c ] == in[ c ].rangeEndLow ) {
-								// cout << "Remapping " << temp << " from " << in[ c ].rangeStartLow << " : " << in[ c ].rangeStartHigh << " to 0.0 : 1.0f gives " << colorRead[ c ] << endl;
-							// }
-							break;
-						}
-
-						case SOFTCLIP:
-							// todo
-							break;
-
-						default:
-							break;
-
-					}
+			// only HARDCLIP does anything at the moment - NOOP leaves the channel alone, SOFTCLIP is still todo
+		if constexpr ( std::is_same< float, imageType >::value ) {
+			float inLow[ numChannels ], inHigh[ numChannels ], outLow[ numChannels ], outHigh[ numChannels ];
+			bool active[ numChannels ];
+			for ( uint8_t c { 0 }; c < numChannels; c++ ) {
+				active[ c ] = ( in[ c ].rangeType == HARDCLIP );
+				inLow[ c ] = in[ c ].rangeStartLow;
+				inHigh[ c ] = in[ c ].rangeStartHigh;
+				outLow[ c ] = in[ c ].rangeEndLow;
+				outHigh[ c ] = in[ c ].rangeEndHigh;
+			}
+			ForEachSpan( [ & ] ( imageType *span, const size_t count ) {
+				image2Kernels::RemapSpan< numChannels >( span, count, inLow, inHigh, outLow, outHigh, active );
+			} );
+		} else {
+			channelTable_t tables;
+			for ( uint8_t c { 0 }; c < numChannels; c++ ) {
+				for ( int v { 0 }; v < 256; v++ ) {
+					tables[ c ][ v ] = ( in[ c ].rangeType != HARDCLIP ) ? v : RangeRemapValue( v,
+						in[ c ].rangeStartLow, in[ c ].rangeStartHigh, in[ c ].rangeEndLow, in[ c ].rangeEndHigh );
 				}
-				SetAtXY( x, y, colorRead );
 			}
+			ApplyChannelTables( tables );
 		}
 	}
 
@@ -571,12 +884,12 @@ public:
 
 	void BrownConradyLensDistort ( const float k1, const float k2, const float tangentialSkew, const bool normalize = false ) {
 		// create an identical copy of the data, since we will be overwriting the entire image
-		const Image2< imageType, numChannels > cachedCopy( width, height, GetImageDataBasePtr() );
+		const Image2 cachedCopy = PixelCopy();
 
 		const float normalizeFactor = ( abs( k1 ) < 1.0f ) ? ( 1.0f - abs( k1 ) ) : ( 1.0f / ( k1 + 1.0f ) );
 
 		// iterate over every pixel in the image - calculate distorted UV's and sample the cached version
-		for ( uint32_t y { 0 }; y < height; y++ ) {
+		ForEachRow( [&] ( const uint32_t y ) {
 			for ( uint32_t x { 0 }; x < width; x++ ) {
 				// pixel coordinate in UV space
 				const vec2 normalizedPosition = vec2( ( float ) x / ( float ) width, ( float ) y / ( float ) height );
@@ -612,7 +925,7 @@ public:
 				// get the sample of the cached copy
 				SetAtXY( x, y, cachedCopy.Sample( remapped, samplerType_t::LINEAR_FILTER ) );
 			}
-		}
+		} );
 	}
 
 	// same as above, but combines multiple samples with strength increasing from 0 to the specified parameters in order to blur
@@ -630,10 +943,10 @@ public:
 		const bool normalize = false ) {
 
 		// create an identical copy of the data, since we will be overwriting the entire image
-		const Image2< imageType, numChannels > cachedCopy( width, height, GetImageDataBasePtr() );
+		const Image2 cachedCopy = PixelCopy();
 
 		// iterate over every pixel in the image - calculate distorted UV's and sample the cached version
-		for ( uint32_t y { 0 }; y < height; y++ ) {
+		ForEachRow( [&] ( const uint32_t y ) {
 			for ( uint32_t x { 0 }; x < width; x++ ) {
 
 				color accumulated; // making use of zero initialization
@@ -666,7 +979,7 @@ public:
 				accumulated = accumulated / ( float ) iterations;
 				SetAtXY( x, y, accumulated );
 			}
-		}
+		} );
 	}
 
 	void BrownConradyLensDistortMSBlurredChromatic ( const int iterations, const float k1, const float k2, const float t1 ) {
@@ -678,10 +991,10 @@ public:
 		const float k2min, const float k2max,
 		const float t1min, const float t1max ) {
 		// create an identical copy of the data, since we will be overwriting the entire image
-		const Image2< imageType, numChannels > cachedCopy( width, height, GetImageDataBasePtr() );
+		const Image2 cachedCopy = PixelCopy();
 
 		// iterate over every pixel in the image - calculate distorted UV's and sample the cached version
-		for ( uint32_t y { 0 }; y < height; y++ ) {
+		ForEachRow( [&] ( const uint32_t y ) {
 			for ( uint32_t x { 0 }; x < width; x++ ) {
 
 				color weight;
@@ -732,7 +1045,7 @@ public:
 				accumulated = accumulated / weightAccum;
 				SetAtXY( x, y, accumulated );
 			}
-		}
+		} );
 	}
 
 	void BrownConradyLensDistortMSBlurredChromaticSmooth ( const int iterations, const float k1, const float k2, const float t1 ) {
@@ -744,10 +1057,10 @@ public:
 		const float k2min, const float k2max,
 		const float t1min, const float t1max ) {
 		// create an identical copy of the data, since we will be overwriting the entire image
-		const Image2< imageType, numChannels > cachedCopy( width, height, GetImageDataBasePtr() );
+		const Image2 cachedCopy = PixelCopy();
 
 		// iterate over every pixel in the image - calculate distorted UV's and sample the cached version
-		for ( uint32_t y { 0 }; y < height; y++ ) {
+		ForEachRow( [&] ( const uint32_t y ) {
 			for ( uint32_t x { 0 }; x < width; x++ ) {
 
 				color weight;
@@ -791,7 +1104,7 @@ public:
 				accumulated = accumulated / weightAccum;
 				SetAtXY( x, y, accumulated );
 			}
-		}
+		} );
 	}
 
 	void BrownConradyLensDistortMSBlurredChromaticNormalized ( const int iterations, const float k1, const float k2, const float t1 ) {
@@ -804,10 +1117,10 @@ public:
 		const float t1min, const float t1max ) {
 
 		// create an identical copy of the data, since we will be overwriting the entire image
-		const Image2< imageType, numChannels > cachedCopy( width, height, GetImageDataBasePtr() );
+		const Image2 cachedCopy = PixelCopy();
 
 		// iterate over every pixel in the image - calculate distorted UV's and sample the cached version
-		for ( uint32_t y { 0 }; y < height; y++ ) {
+		ForEachRow( [&] ( const uint32_t y ) {
 			for ( uint32_t x { 0 }; x < width; x++ ) {
 
 				color weight;
@@ -864,7 +1177,7 @@ public:
 				accumulated = accumulated / weightAccum;
 				SetAtXY( x, y, accumulated );
 			}
-		}
+		} );
 	}
 
 	// DeCarpienter Barrel Distortion from https://www.decarpentier.nl/lens-distortion
@@ -878,10 +1191,10 @@ public:
 		const float diagSq = scaledHeight * scaledHeight * aspectDiagSq;
 
 		// cached copy of the original image data
-		const Image2< imageType, numChannels > cachedCopy( width, height, GetImageDataBasePtr() );
+		const Image2 cachedCopy = PixelCopy();
 
 		// iterate through all the pixels
-		for ( uint32_t y { 0 }; y < height; y++ ) {
+		ForEachRow( [&] ( const uint32_t y ) {
 			for ( uint32_t x { 0 }; x < width; x++ ) {
 
 				// calculate the normalized pixel coordinates
@@ -901,12 +1214,219 @@ public:
 				// sample from the cached copy and write to the current data
 				SetAtXY( x, y, cachedCopy.Sample( sampleLocation, samplerType_t::LINEAR_FILTER ) );
 			}
-		}
+		} );
 	}
 
 	void BlendOverConstantColor ( color background ) {
 		// use the alpha channel in the existing image, alpha blend every pixel in the image over this background color value
+			// color = src * a + background * ( 1 - a ), alpha = a + background alpha * ( 1 - a ) - no alpha, nothing to do
+		if constexpr ( numChannels == 4 ) {
+			ForEachSpan( [ & ] ( imageType *span, const size_t count ) {
+				image2Kernels::BlendOverSpan4( span, count, background.data.data() );
+			} );
+		}
+	}
+
+//======= Convolution =================================================================================================
 
+	// edges are clamped, and every channel ( alpha included ) is filtered. uint8 images accumulate in float and
+		// round once at the end. Kernels are centered, so they need an odd number of taps
+
+	// kernelX runs along the rows, kernelY down the columns
+	void SeparableConvolve ( const std::vector< float > &kernelX, const std::vector< float > &kernelY ) {
+		if ( kernelX.size() % 2 == 0 || kernelY.size() % 2 == 0 ) {
+			cout << "separable kernels need an odd number of taps" << newline;
+			return;
+		}
+		const image2Kernels::weightedRowFilter_t filterX { kernelX.data(), uint32_t( kernelX.size() / 2 ) };
+		const image2Kernels::weightedRowFilter_t filterY { kernelY.data(), uint32_t( kernelY.size() / 2 ) };
+		SeparablePasses( filterX, filterY );
+	}
+
+	void GaussianBlur ( const float sigma, const uint32_t radius = 0 ) { // radius 0 picks 3 sigma
+		const std::vector< float > weights = image2Kernels::GaussianWeights( sigma, radius );
+		SeparableConvolve( weights, weights );
+	}
+
+	// sliding window box filter, constant cost per pixel for any radius - a few iterations approaches a gaussian
+	void BoxBlur ( const uint32_t radius, const uint32_t iterations = 1 ) {
+		const image2Kernels::boxRowFilter_t filter { radius };
+		for ( uint32_t i = 0; i < iterations; i++ ) {
+			SeparablePasses( filter, filter );
+		}
+	}
+
+	// general size x size kernel, row-major - for anything that doesn't separate ( sharpen, edge detect, etc )
+	void Convolve ( const std::vector< float > &kernel ) {
+		if constexpr ( layout != imageLayout_t::ROW_MAJOR ) {
+			ViaRowMajor( [ & ] ( rowMajorImage_t &image ) { image.Convolve( kernel ); } );
+			return;
+		}
+
+		const uint32_t size = uint32_t( std::sqrt( float( kernel.size() ) ) + 0.5f );
+		if ( size * size != kernel.size() || size % 2 == 0 ) {
+			cout << "convolution kernel needs to be square, with an odd size" << newline;
+			return;
+		}
+		scratchBuffer_t< imageType > scratch;
+		std::vector< imageType > &source = *scratch;
+		source.assign( data.begin(), data.end() );
+		ForEachRowBand( height, width, [ & ] ( const uint32_t yMin, const uint32_t yMax ) {
+			image2Kernels::KernelRowsPass< numChannels >( source.data(), data.data(), width, height, yMin, yMax, kernel.data(), size );
+		} );
+	}
+
+	// rows of the image go to columns of a transposed float intermediate, then the same pass brings them back
+	template < typename filterX_t, typename filterY_t >
+	void SeparablePasses ( const filterX_t &filterX, const filterY_t &filterY ) {
+		if constexpr ( layout != imageLayout_t::ROW_MAJOR ) {
+			ViaRowMajor( [ & ] ( rowMajorImage_t &image ) { image.SeparablePasses( filterX, filterY ); } );
+			return;
+		}
+
+		scratchBuffer_t< float > scratch;
+		std::vector< float > &transposed = *scratch;
+		transposed.resize( data.size() );
+		ForEachRowBand( height, width, [ & ] ( const uint32_t yMin, const uint32_t yMax ) {
+			image2Kernels::TransposedRowPass< numChannels >( data.data(), transposed.data(), width, height, yMin, yMax, filterX );
+		} );
+		ForEachRowBand( width, height, [ & ] ( const uint32_t xMin, const uint32_t xMax ) {
+			image2Kernels::TransposedRowPass< numChannels >( transposed.data(), data.data(), height, width, xMin, xMax, filterY );
+		} );
+	}
+
+//======= Mip Chain ===================================================================================================
+
+	enum class mipFilter_t {
+		BOX,	// 2x2 average
+		KAISER	// 8 tap kaiser windowed sinc, sharper
+	};
+
+	// halves each level down to 1x1, everything past the base image goes into a single allocation. Each level is built
+		// from the one above it, with the rows of a level done in parallel. The chain is a snapshot, so after editing the
+		// image contents it needs to be rebuilt - operations that change the size or layout drop it automatically
+	void BuildMipChain ( const mipFilter_t filter = mipFilter_t::BOX ) {
+		ClearMipChain();
+		if ( width == 0 || height == 0 ) return;
+
+		mipLevels.push_back( { 0, width, height } );
+		size_t total = 0;
+		while ( mipLevels.back().width > 1 || mipLevels.back().height > 1 ) {
+			const mipLevel_t level = { total, std::max( 1u, mipLevels.back().width / 2 ), std::max( 1u, mipLevels.back().height / 2 ) };
+			mipLevels.push_back( level );
+			total += size_t( level.width ) * level.height * numChannels;
+		}
+		mipData.resize( total );
+
+		// the levels past the base are always row-major, so the first one is built from a row-major copy if need be
+		rowMajorImage_t rowMajorBase;
+		const imageType *base = data.data();
+		if constexpr ( layout != imageLayout_t::ROW_MAJOR ) {
+			rowMajorBase = ToRowMajor();
+			base = rowMajorBase.GetImageDataBasePtr();
+		}
+
+		const std::vector< float > weights = ( filter == mipFilter_t::BOX ) ? std::vector< float > { 0.5f, 0.5f } : image2Kernels::KaiserDownsampleWeights();
+		for ( uint32_t l = 1; l < mipLevels.size(); l++ ) {
+			const mipLevel_t &src = mipLevels[ l - 1 ];
+			const mipLevel_t &dst = mipLevels[ l ];
+			const imageType *srcTexels = ( l == 1 ) ? base : MipLevelPointer( l - 1 );
+			ForEachRowBand( dst.height, src.width * int( weights.size() ), [ & ] ( const uint32_t yMin, const uint32_t yMax ) {
+				image2Kernels::Downsample2x< numChannels >( srcTexels, src.width, src.height, MipLevelPointer( l ), dst.width, yMin, yMax, weights.data(), int( weights.size() ) );
+			} );
+		}
+	}
+
+	void ClearMipChain () {
+		mipLevels.clear();
+		std::vector< imageType >().swap( mipData );
+	}
+
+	uint32_t NumMipLevels () const { return std::max( 1u, uint32_t( mipLevels.size() ) ); }
+
+	// trilinear, lod is log2 of the footprint in base level texels - without a mip chain this is a bilinear base level read
+	color Sample ( vec2 uv, float lod ) const {
+		return ToColor( SampleTrilinear( uv, lod ) );
+	}
+
+	// anisotropic, from the screen space derivatives of uv - up to maxAnisotropy trilinear taps spread along the long
+		// axis of the footprint, each one at the lod of the short axis
+	color Sample ( vec2 uv, vec2 dUVdx, vec2 dUVdy, uint32_t maxAnisotropy = 8 ) const {
+		const vec2 size = vec2( width, height );
+		const float lengthX = glm::length( dUVdx * size );
+		const float lengthY = glm::length( dUVdy * size );
+		const float major = std::max( lengthX, lengthY );
+		const float minor = std::max( std::min( lengthX, lengthY ), 1e-6f );
+		const uint32_t numTaps = std::clamp( uint32_t( std::ceil( major / minor ) ), 1u, std::max( 1u, maxAnisotropy ) );
+		const float lod = std::log2( std::max( major / float( numTaps ), 1e-6f ) );
+		const vec2 axis = ( lengthX > lengthY ) ? dUVdx : dUVdy;
+
+		vec4 sum = vec4( 0.0f );
+		for ( uint32_t i = 0; i < numTaps; i++ ) {
+			const float offset = ( float( i ) + 0.5f ) / float( numTaps ) - 0.5f;
+			sum += SampleTrilinear( uv + axis * offset, lod );
+		}
+		return ToColor( sum / float( numTaps ) );
+	}
+
+	const imageType* MipLevelPointer ( const uint32_t level ) const {
+		return ( level == 0 ) ? data.data() : mipData.data() + mipLevels[ level ].offset;
+	}
+
+	imageType* MipLevelPointer ( const uint32_t level ) {
+		return ( level == 0 ) ? data.data() : mipData.data() + mipLevels[ level ].offset;
+	}
+
+	// unlike Sample( x, y ), these put texel centers at ( i + 0.5 ) / size, the same as the GPU - edges clamp
+	vec4 SampleBilinearLevel ( const uint32_t level, const vec2 uv ) const {
+		const uint32_t levelWidth = ( level == 0 ) ? width : mipLevels[ level ].width;
+		const uint32_t levelHeight = ( level == 0 ) ? height : mipLevels[ level ].height;
+		const imageType *texels = MipLevelPointer( level );
+
+		const vec2 position = uv * vec2( levelWidth, levelHeight ) - vec2( 0.5f );
+		const vec2 floorPosition = glm::floor( position );
+		const vec2 fractPosition = position - floorPosition;
+		const int32_t x0 = std::clamp( int32_t( floorPosition.x ), 0, int32_t( levelWidth ) - 1 );
+		const int32_t y0 = std::clamp( int32_t( floorPosition.y ), 0, int32_t( levelHeight ) - 1 );
+		const int32_t x1 = std::clamp( int32_t( floorPosition.x ) + 1, 0, int32_t( levelWidth ) - 1 );
+		const int32_t y1 = std::clamp( int32_t( floorPosition.y ) + 1, 0, int32_t( levelHeight ) - 1 );
+
+		auto texel = [ & ] ( const int32_t x, const int32_t y ) { // the base level goes through the storage layout
+			vec4 value = vec4( 0.0f );
+			const imageType *p = texels + ( ( level == 0 ) ? PixelIndex( x, y ) : ( size_t( y ) * levelWidth + x ) ) * numChannels;
+			for ( uint8_t c = 0; c < numChannels; c++ ) {
+				value[ c ] = float( p[ c ] );
+			}
+			return value;
+		};
+		return glm::mix(
+			glm::mix( texel( x0, y0 ), texel( x1, y0 ), fractPosition.x ),
+			glm::mix( texel( x0, y1 ), texel( x1, y1 ), fractPosition.x ),
+			fractPosition.y );
+	}
+
+	vec4 SampleTrilinear ( const vec2 uv, const float lod ) const {
+		const float maxLevel = float( NumMipLevels() - 1 );
+		const float clampedLod = std::clamp( std::isnan( lod ) ? 0.0f : lod, 0.0f, maxLevel );
+		const uint32_t level = uint32_t( clampedLod );
+		const float blend = clampedLod - float( level );
+		if ( blend == 0.0f || level == NumMipLevels() - 1 ) {
+			return SampleBilinearLevel( level, uv );
+		}
+		return glm::mix( SampleBilinearLevel( level, uv ), SampleBilinearLevel( level + 1, uv ), blend );
+	}
+
+	// back to the storage type, uint8 rounds and clamps
+	color ToColor ( const vec4 value ) const {
+		color c;
+		for ( uint8_t i = 0; i < numChannels; i++ ) {
+			if constexpr ( std::is_same< uint8_t, imageType >::value ) {
+				c[ i ] = imageType( std::clamp( value[ i ], 0.0f, 255.0f ) + 0.5f );
+			} else {
+				c[ i ] = value[ i ];
+			}
+		}
+		return c;
 	}
 
 //======= Access to Internal Data =====================================================================================
@@ -919,7 +1439,7 @@ public:
 	color GetAtXY ( uint32_t x, uint32_t y ) const {
 		color col;
 		if ( BoundsCheck( x, y ) ) {
-			const size_t baseIndex = ( x + y * width ) * numChannels;
+			const size_t baseIndex = PixelIndex( x, y ) * numChannels;
 			for ( uint8_t c { 0 }; c < numChannels; c++ ) // populate values
 				col[ c ] = data[ baseIndex + c ];
 		}
@@ -928,7 +1448,7 @@ public:
 
 	void SetAtXY ( uint32_t x, uint32_t y, color col ) {
 		if ( BoundsCheck( x, y ) ) {
-			const size_t baseIndex = ( x + y * width ) * numChannels;
+			const size_t baseIndex = PixelIndex( x, y ) * numChannels;
 			for ( uint8_t c { 0 }; c < numChannels; c++ ) // populate values
 				data[ baseIndex + c ] = col[ c ];
 		} // else { cout << "Out of Bounds Write :(\n"; }
@@ -1101,7 +1621,7 @@ public:
 	uint32_t Width () const { return width; }
 	uint32_t Height () const { return height; }
 
-	// tbd, need to make sure this works for passing texture data to GPU
+	// raw storage, in layout order - for anything other than ROW_MAJOR, go through ToRowMajor() before handing it to the GPU
 	const imageType* GetImageDataBasePtr () const	{ return data.data(); }
 		imageType* GetImageDataBasePtr () 			{ return data.data(); }
 
@@ -1120,6 +1640,15 @@ private:
 	// image data
 	std::vector< imageType > data;
 
+	// optional mip pyramid, see BuildMipChain() - level 0 is the image itself, the rest sit back to back in mipData, row-major
+	struct mipLevel_t {
+		size_t offset;
+		uint32_t width;
+		uint32_t height;
+	};
+	std::vector< mipLevel_t > mipLevels;
+	std::vector< imageType > mipData;
+
 //===== Loader Functions == ( Accessed via Load() ) ===================================================================
 
 	// this will handle a number of different file extensions ( png, jpg, etc )
@@ -1163,9 +1692,9 @@ private:
 
 	// high bit depth images, .exr format
 	bool LoadTinyEXR ( string path ) {
-		float* out; // width * height * RGBA
+		float* out = NULL; // width * height * RGBA
 		const char* errorCode = NULL;
-		int w, h;
+		int w = 0, h = 0;
 		int ret = LoadEXR( &out, &w, &h, path.c_str(), &errorCode );
 		if ( ret != TINYEXR_SUCCESS ) {
 			if ( errorCode ) {
@@ -1317,5 +1846,11 @@ typedef Image2< float, 1 >::color color_1F;
 typedef Image2< float, 4 > Image_4F;
 typedef Image2< float, 4 >::color color_4F;
 
+// same, in the cache friendlier layouts - mostly for textures and other heavily sampled images
+typedef Image2< uint8_t, 4, imageLayout_t::TILED_8x8 > Image_4U_Tiled;
+typedef Image2< uint8_t, 4, imageLayout_t::MORTON > Image_4U_Morton;
+typedef Image2< float, 4, imageLayout_t::TILED_8x8 > Image_4F_Tiled;
+typedef Image2< float, 4, imageLayout_t::MORTON > Image_4F_Morton;
+
 
 #endif // IMAGE2_H
\ No newline at end of file
@@ -0,0 +1,735 @@
+#pragma once
+#ifndef IMAGE2KERNELS_H
+#define IMAGE2KERNELS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#if defined( __x86_64__ ) || defined( _M_X64 ) || defined( __i386__ ) || defined( _M_IX86 )
+	#define IMAGE2_KERNELS_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+	// MSVC will emit AVX2 intrinsics in any function, GCC/Clang need the AVX2 code inside a target region ( see below ),
+		// that way the tier exists without building the whole translation unit with -mavx2
+	#define IMAGE2_KERNELS_AVX2
+#endif
+
+//===== Image2 Span Kernels ===========================================================================================
+
+// These operate on contiguous runs of interleaved pixel data ( e.g. a band of rows out of Image2::data ), so the
+	// per-pixel GetAtXY/SetAtXY and the std::array color copies drop out of the hot loops entirely. Float data goes
+	// through SSE2 or AVX2, picked at runtime - uint8 data mostly goes through 256 entry tables, which is both exact
+	// and faster than anything we'd do with the vector units for byte sized values. The gamma and sRGB curves stay on
+	// std::pow unless ApproximatePow() is turned on
+
+namespace image2Kernels {
+
+//===== Runtime Dispatch ==============================================================================================
+
+enum class simdTier_t {
+	SCALAR,
+	SSE2,
+	AVX2
+};
+
+inline simdTier_t DetectSIMDTier () {
+#ifdef IMAGE2_KERNELS_X86
+	#ifdef IMAGE2_KERNELS_AVX2
+		#ifdef _MSC_VER
+			int info[ 4 ];
+			__cpuid( info, 0 );
+			if ( info[ 0 ] >= 7 ) {
+				__cpuid( info, 1 );
+				const bool osxsave = ( info[ 2 ] & ( 1 << 27 ) ) != 0;
+				const bool avx = ( info[ 2 ] & ( 1 << 28 ) ) != 0;
+				__cpuidex( info, 7, 0 );
+				const bool avx2 = ( info[ 1 ] & ( 1 << 5 ) ) != 0;
+				// the OS also has to be saving the ymm registers on context switch
+				if ( osxsave && avx && avx2 && ( _xgetbv( 0 ) & 6 ) == 6 ) {
+					return simdTier_t::AVX2;
+				}
+			}
+		#else
+			if ( __builtin_cpu_supports( "avx2" ) ) {
+				return simdTier_t::AVX2;
+			}
+		#endif
+	#endif
+	return simdTier_t::SSE2; // baseline on x86-64
+#else
+	return simdTier_t::SCALAR;
+#endif
+}
+
+// picked once on first use - can be forced down for comparison or debugging, but not above what was detected
+inline simdTier_t &ActiveTier () {
+	static simdTier_t tier = DetectSIMDTier();
+	return tier;
+}
+
+//===== Scalar Math ===================================================================================================
+
+// pow( x, p ) as exp2( p * log2( x ) ). This is not exact: the error grows with | p * log2( x ) |, measured against a
+	// double precision pow it stays under 3.1e-6 relative ( ~50 ulp ) for x in [ 1e-6, 1e6 ] and p in [ 1/4, 4 ], and
+	// the sRGB curves built on it stay within 2.4e-7 absolute over [ 0, 1 ]. The vector versions below follow exactly the
+	// same sequence of operations, so every tier writes identical bits ( so long as the compiler isn't allowed to contract
+	// the scalar code into FMAs, e.g. GCC with -mfma needs -ffp-contract=off for that ). Anything that isn't a positive, normal, finite
+	// float ( zero, negatives, denormals, inf, nan ) goes to std::pow instead, to keep its edge case behavior
+inline float Log2Approx ( const float x ) {
+	uint32_t bits;
+	memcpy( &bits, &x, sizeof( float ) );
+	float e = float( int32_t( bits >> 23 ) - 127 );
+	bits = ( bits & 0x007FFFFFu ) | 0x3F800000u; // mantissa, in [ 1, 2 )
+	float m;
+	memcpy( &m, &bits, sizeof( float ) );
+	if ( m > 1.41421356f ) { // recenter on 1, for the series below
+		m = m * 0.5f;
+		e = e + 1.0f;
+	}
+	// ln( m ) = 2 * ( f + f^3 / 3 + f^5 / 5 + ... ), with f = ( m - 1 ) / ( m + 1 )
+	const float f = ( m - 1.0f ) / ( m + 1.0f );
+	const float f2 = f * f;
+	float p = 1.0f / 9.0f;
+	p = p * f2 + 1.0f / 7.0f;
+	p = p * f2 + 1.0f / 5.0f;
+	p = p * f2 + 1.0f / 3.0f;
+	p = p * f2 + 1.0f;
+	return e + ( ( 2.0f * f ) * p ) * 1.44269504f;
+}
+
+inline float Exp2Approx ( float y ) {
+	y = std::min( std::max( y, -126.0f ), 127.0f );
+	const float n = std::nearbyint( y ); // round to nearest even, same as cvtps
+	const float t = ( y - n ) * 0.69314718f;
+	// e^t, t in [ -ln2 / 2, ln2 / 2 ]
+	float p = 1.0f / 5040.0f;
+	p = p * t + 1.0f / 720.0f;
+	p = p * t + 1.0f / 120.0f;
+	p = p * t + 1.0f / 24.0f;
+	p = p * t + 1.0f / 6.0f;
+	p = p * t + 0.5f;
+	p = p * t + 1.0f;
+	p = p * t + 1.0f;
+	const uint32_t bits = uint32_t( int32_t( n ) + 127 ) << 23;
+	float scale;
+	memcpy( &scale, &bits, sizeof( float ) );
+	return p * scale;
+}
+
+inline bool PowFastPathOK ( const float x ) {
+	return x >= std::numeric_limits< float >::min() && x <= std::numeric_limits< float >::max();
+}
+
+inline float PowApprox ( const float x, const float exponent ) {
+	return PowFastPathOK( x ) ? Exp2Approx( exponent * Log2Approx( x ) ) : std::pow( x, exponent );
+}
+
+// the gamma and sRGB curves use std::pow by default, and give the same results the per-pixel code always has. Turning
+	// this on trades that for the vectorized approximation above, within the error bounds stated there
+inline bool &ApproximatePow () {
+	static bool enabled = false;
+	return enabled;
+}
+
+inline float Pow ( const float x, const float exponent, const bool approximate ) {
+	return approximate ? PowApprox( x, exponent ) : std::pow( x, exponent );
+}
+
+inline float SRGBToLinear ( const float x, const bool approximate ) {
+	return ( x < 0.04045f ) ? ( x / 12.92f ) : Pow( ( x + 0.055f ) / 1.055f, 2.4f, approximate );
+}
+
+inline float LinearToSRGB ( const float x, const bool approximate ) {
+	return ( x < 0.0031308f ) ? ( x * 12.92f ) : ( 1.055f * Pow( x, 1.0f / 2.4f, approximate ) - 0.055f );
+}
+
+//===== Float Kernels =================================================================================================
+
+// every kernel walks count floats ( not pixels ), starting on a pixel boundary. The scalar loop picks up
+	// the tail, and everything when the lane count doesn't line up with the channel count ( 3 channels )
+
+// the operations - the scalar side is here, the vector side is in image2KernelsVector.h. The pow based ops only take
+	// the vector path with approximate set, exact std::pow has no vector form
+struct opPow {
+	float exponent;
+	float mask[ 4 ]; // 1.0 where the channel is touched
+	bool approximate;
+	float Scalar ( float x, int c ) const { return mask[ c ] != 0.0f ? Pow( x, exponent, approximate ) : x; }
+};
+
+struct opSRGBToLinear {
+	float mask[ 4 ];
+	bool approximate;
+	float Scalar ( float x, int c ) const { return mask[ c ] != 0.0f ? SRGBToLinear( x, approximate ) : x; }
+};
+
+struct opLinearToSRGB {
+	float mask[ 4 ];
+	bool approximate;
+	float Scalar ( float x, int c ) const { return mask[ c ] != 0.0f ? LinearToSRGB( x, approximate ) : x; }
+};
+
+struct opScale {
+	float scale[ 4 ];
+	float Scalar ( float x, int c ) const { return x * scale[ c ]; }
+};
+
+// outLow + ( outHigh - outLow ) * ( ( x - inLow ) / ( inHigh - inLow ) ), same operation order as Image2::RangeRemapValue
+struct opRemap {
+	float inLow[ 4 ], inRange[ 4 ], outLow[ 4 ], outRange[ 4 ];
+	float mask[ 4 ];
+	float Scalar ( float x, int c ) const { return mask[ c ] != 0.0f ? outLow[ c ] + outRange[ c ] * ( ( x - inLow[ c ] ) / inRange[ c ] ) : x; }
+};
+
+struct opFill {
+	float value[ 4 ];
+	float mask[ 4 ];
+	float Scalar ( float x, int c ) const { return mask[ c ] != 0.0f ? value[ c ] : x; }
+};
+
+// src over a constant background: rgb = src * a + bg * ( 1 - a ), alpha = a + bgAlpha * ( 1 - a ), 4 channel only
+struct opBlendOver {
+	float background[ 4 ];
+	void Scalar4 ( float *p ) const {
+		const float a = p[ 3 ];
+		const float oneMinus = 1.0f - a;
+		for ( int c = 0; c < 4; c++ ) {
+			p[ c ] = p[ c ] * ( c == 3 ? 1.0f : a ) + background[ c ] * oneMinus;
+		}
+	}
+};
+
+template < int numChannels, typename op_t >
+inline void RunScalarSpan ( float *data, const size_t count, const op_t &op, size_t i = 0 ) {
+	if constexpr ( std::is_same< op_t, opBlendOver >::value ) {
+		for ( ; i + 4 <= count; i += 4 ) {
+			op.Scalar4( data + i );
+		}
+	} else {
+		for ( ; i < count; i++ ) {
+			data[ i ] = op.Scalar( data[ i ], int( i % numChannels ) );
+		}
+	}
+}
+
+//===== Vector Wrappers ===============================================================================================
+
+// thin layer over the intrinsics, so each kernel is written once and instantiated per instruction set
+
+#ifdef IMAGE2_KERNELS_X86
+struct vSSE2 {
+	using f = __m128;
+	using i = __m128i;
+	static constexpr int width = 4;
+	static f Load ( const float *p ) { return _mm_loadu_ps( p ); }
+	static void Store ( float *p, f v ) { _mm_storeu_ps( p, v ); }
+	static f Set1 ( float v ) { return _mm_set1_ps( v ); }
+	static f Add ( f a, f b ) { return _mm_add_ps( a, b ); }
+	static f Sub ( f a, f b ) { return _mm_sub_ps( a, b ); }
+	static f Mul ( f a, f b ) { return _mm_mul_ps( a, b ); }
+	static f Div ( f a, f b ) { return _mm_div_ps( a, b ); }
+	static f Min ( f a, f b ) { return _mm_min_ps( a, b ); }
+	static f Max ( f a, f b ) { return _mm_max_ps( a, b ); }
+	static f Less ( f a, f b ) { return _mm_cmplt_ps( a, b ); }
+	static f Greater ( f a, f b ) { return _mm_cmpgt_ps( a, b ); }
+	static f InRange ( f x, f lo, f hi ) { return _mm_and_ps( _mm_cmpge_ps( x, lo ), _mm_cmple_ps( x, hi ) ); }
+	static f Select ( f mask, f a, f b ) { return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) ); }
+	static bool AllSet ( f mask ) { return _mm_movemask_ps( mask ) == 0xF; }
+	static f RoundNearest ( f v ) { return _mm_cvtepi32_ps( _mm_cvtps_epi32( v ) ); }
+	static f AsFloat ( i v ) { return _mm_castsi128_ps( v ); }
+	static i AsInt ( f v ) { return _mm_castps_si128( v ); }
+	static i ToInt ( f v ) { return _mm_cvtps_epi32( v ); }
+	static f ToFloat ( i v ) { return _mm_cvtepi32_ps( v ); }
+	static i And ( i a, i b ) { return _mm_and_si128( a, b ); }
+	static i Or ( i a, i b ) { return _mm_or_si128( a, b ); }
+	static i Set1i ( int32_t v ) { return _mm_set1_epi32( v ); }
+	static i AddInt ( i a, i b ) { return _mm_add_epi32( a, b ); }
+	static i SubInt ( i a, i b ) { return _mm_sub_epi32( a, b ); }
+	static i ShiftLeft23 ( i v ) { return _mm_slli_epi32( v, 23 ); }
+	static i ShiftRight23 ( i v ) { return _mm_srli_epi32( v, 23 ); }
+	static f BroadcastAlpha4 ( f v ) { return _mm_shuffle_ps( v, v, _MM_SHUFFLE( 3, 3, 3, 3 ) ); }
+};
+
+namespace sse2 {
+	using V = vSSE2;
+	#include "image2KernelsVector.h"
+}
+#endif
+
+#ifdef IMAGE2_KERNELS_AVX2
+#if defined( __clang__ )
+	#pragma clang attribute push ( __attribute__(( target( "avx2" ) )), apply_to = function )
+#elif defined( __GNUC__ )
+	#pragma GCC push_options
+	#pragma GCC target( "avx2" )
+#endif
+
+struct vAVX2 {
+	using f = __m256;
+	using i = __m256i;
+	static constexpr int width = 8;
+	static f Load ( const float *p ) { return _mm256_loadu_ps( p ); }
+	static void Store ( float *p, f v ) { _mm256_storeu_ps( p, v ); }
+	static f Set1 ( float v ) { return _mm256_set1_ps( v ); }
+	static f Add ( f a, f b ) { return _mm256_add_ps( a, b ); }
+	static f Sub ( f a, f b ) { return _mm256_sub_ps( a, b ); }
+	static f Mul ( f a, f b ) { return _mm256_mul_ps( a, b ); }
+	static f Div ( f a, f b ) { return _mm256_div_ps( a, b ); }
+	static f Min ( f a, f b ) { return _mm256_min_ps( a, b ); }
+	static f Max ( f a, f b ) { return _mm256_max_ps( a, b ); }
+	static f Less ( f a, f b ) { return _mm256_cmp_ps( a, b, _CMP_LT_OQ ); }
+	static f Greater ( f a, f b ) { return _mm256_cmp_ps( a, b, _CMP_GT_OQ ); }
+	static f InRange ( f x, f lo, f hi ) { return _mm256_and_ps( _mm256_cmp_ps( x, lo, _CMP_GE_OQ ), _mm256_cmp_ps( x, hi, _CMP_LE_OQ ) ); }
+	static f Select ( f mask, f a, f b ) { return _mm256_blendv_ps( b, a, mask ); }
+	static bool AllSet ( f mask ) { return _mm256_movemask_ps( mask ) == 0xFF; }
+	static f RoundNearest ( f v ) { return _mm256_round_ps( v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC ); }
+	static f AsFloat ( i v ) { return _mm256_castsi256_ps( v ); }
+	static i AsInt ( f v ) { return _mm256_castps_si256( v ); }
+	static i ToInt ( f v ) { return _mm256_cvtps_epi32( v ); }
+	static f ToFloat ( i v ) { return _mm256_cvtepi32_ps( v ); }
+	static i And ( i a, i b ) { return _mm256_and_si256( a, b ); }
+	static i Or ( i a, i b ) { return _mm256_or_si256( a, b ); }
+	static i Set1i ( int32_t v ) { return _mm256_set1_epi32( v ); }
+	static i AddInt ( i a, i b ) { return _mm256_add_epi32( a, b ); }
+	static i SubInt ( i a, i b ) { return _mm256_sub_epi32( a, b ); }
+	static i ShiftLeft23 ( i v ) { return _mm256_slli_epi32( v, 23 ); }
+	static i ShiftRight23 ( i v ) { return _mm256_srli_epi32( v, 23 ); }
+	static f BroadcastAlpha4 ( f v ) { return _mm256_permute_ps( v, _MM_SHUFFLE( 3, 3, 3, 3 ) ); } // per 128-bit half, so per pixel
+};
+
+namespace avx2 {
+	using V = vAVX2;
+	#include "image2KernelsVector.h"
+}
+
+#if defined( __clang__ )
+	#pragma clang attribute pop
+#elif defined( __GNUC__ )
+	#pragma GCC pop_options
+#endif
+#endif
+
+template < int numChannels, typename op_t >
+inline void DispatchFloatSpan ( float *data, const size_t count, const op_t &op ) {
+	switch ( ActiveTier() ) {
+	#ifdef IMAGE2_KERNELS_AVX2
+		case simdTier_t::AVX2: avx2::RunVectorSpan< numChannels >( data, count, op ); break;
+	#endif
+	#ifdef IMAGE2_KERNELS_X86
+		case simdTier_t::SSE2: sse2::RunVectorSpan< numChannels >( data, count, op ); break;
+	#endif
+		default: RunScalarSpan< numChannels >( data, count, op ); break;
+	}
+}
+
+// channel masks - alpha is channel 3, so it only exists for 4 channel data
+inline void ChannelMask ( float mask[ 4 ], const bool includeAlpha ) {
+	for ( int c = 0; c < 4; c++ ) {
+		mask[ c ] = ( c == 3 && !includeAlpha ) ? 0.0f : 1.0f;
+	}
+}
+
+template < int numChannels >
+inline void GammaSpan ( float *data, const size_t count, const float exponent, const bool touchAlpha ) {
+	opPow op;
+	op.exponent = exponent;
+	op.approximate = ApproximatePow();
+	ChannelMask( op.mask, touchAlpha );
+	if ( op.approximate ) {
+		DispatchFloatSpan< numChannels >( data, count, op );
+	} else {
+		RunScalarSpan< numChannels >( data, count, op );
+	}
+}
+
+template < int numChannels >
+inline void SRGBToLinearSpan ( float *data, const size_t count, const bool preserveAlpha ) {
+	opSRGBToLinear op;
+	op.approximate = ApproximatePow();
+	ChannelMask( op.mask, !preserveAlpha );
+	if ( op.approximate ) {
+		DispatchFloatSpan< numChannels >( data, count, op );
+	} else {
+		RunScalarSpan< numChannels >( data, count, op );
+	}
+}
+
+template < int numChannels >
+inline void LinearToSRGBSpan ( float *data, const size_t count, const bool preserveAlpha ) {
+	opLinearToSRGB op;
+	op.approximate = ApproximatePow();
+	ChannelMask( op.mask, !preserveAlpha );
+	if ( op.approximate ) {
+		DispatchFloatSpan< numChannels >( data, count, op );
+	} else {
+		RunScalarSpan< numChannels >( data, count, op );
+	}
+}
+
+template < int numChannels >
+inline void ScaleSpan ( float *data, const size_t count, const float scale[ numChannels ] ) {
+	opScale op;
+	for ( int c = 0; c < 4; c++ ) op.scale[ c ] = ( c < numChannels ) ? scale[ c ] : 1.0f;
+	DispatchFloatSpan< numChannels >( data, count, op );
+}
+
+// active[ c ] == false leaves channel c as-is
+template < int numChannels >
+inline void RemapSpan ( float *data, const size_t count, const float inLow[], const float inHigh[], const float outLow[], const float outHigh[], const bool active[] ) {
+	opRemap op;
+	for ( int c = 0; c < 4; c++ ) {
+		const bool used = c < numChannels && active[ c ];
+		op.inLow[ c ] = used ? inLow[ c ] : 0.0f;
+		op.inRange[ c ] = used ? ( inHigh[ c ] - inLow[ c ] ) : 1.0f;
+		op.outLow[ c ] = used ? outLow[ c ] : 0.0f;
+		op.outRange[ c ] = used ? ( outHigh[ c ] - outLow[ c ] ) : 1.0f;
+		op.mask[ c ] = used ? 1.0f : 0.0f;
+	}
+	DispatchFloatSpan< numChannels >( data, count, op );
+}
+
+template < int numChannels >
+inline void FillChannelSpan ( float *data, const size_t count, const int channel, const float value ) {
+	opFill op;
+	for ( int c = 0; c < 4; c++ ) {
+		op.value[ c ] = value;
+		op.mask[ c ] = ( c == channel ) ? 1.0f : 0.0f;
+	}
+	DispatchFloatSpan< numChannels >( data, count, op );
+}
+
+inline void BlendOverSpan4 ( float *data, const size_t count, const float background[ 4 ] ) {
+	opBlendOver op;
+	for ( int c = 0; c < 4; c++ ) op.background[ c ] = background[ c ];
+	DispatchFloatSpan< 4 >( data, count, op );
+}
+
+//===== uint8 Kernels =================================================================================================
+
+// per channel lookup - the tables get built by the caller with the exact scalar expression they replace
+template < int numChannels >
+inline void LUTSpan ( uint8_t *data, const size_t count, const uint8_t table[ numChannels ][ 256 ] ) {
+	size_t i = 0;
+	for ( ; i + numChannels <= count; i += numChannels ) {
+		for ( int c = 0; c < numChannels; c++ ) {
+			data[ i + c ] = table[ c ][ data[ i + c ] ];
+		}
+	}
+}
+
+// set every pixel's value in one channel
+template < int numChannels >
+inline void FillChannelSpan ( uint8_t *data, const size_t count, const int channel, const uint8_t value ) {
+	size_t i = 0;
+#ifdef IMAGE2_KERNELS_X86
+	if constexpr ( numChannels == 4 ) {
+		if ( ActiveTier() != simdTier_t::SCALAR && channel == 3 && value == 255 ) {
+			const __m128i alphaBits = _mm_set1_epi32( int32_t( 0xFF000000u ) );
+			for ( ; i + 16 <= count; i += 16 ) {
+				__m128i *p = ( __m128i * ) ( data + i );
+				_mm_storeu_si128( p, _mm_or_si128( _mm_loadu_si128( p ), alphaBits ) );
+			}
+		}
+	}
+#endif
+	for ( ; i + numChannels <= count; i += numChannels ) {
+		data[ i + channel ] = value;
+	}
+}
+
+// same blend as the float version, in 16 bit fixed point. Rounds x / 255 to the nearest integer without a divide: add
+	// 128, fold the high byte back in, shift down by 8 - matches round( x / 255 ) exactly for every x up to 255 * 255,
+	// which covers any src * w + bg * ( 255 - a ). The SSE path below does the same thing in 16 bit lanes
+inline uint8_t Div255Round ( const uint32_t x ) {
+	const uint32_t t = x + 128;
+	return uint8_t( ( t + ( t >> 8 ) ) >> 8 );
+}
+
+inline void BlendOverSpan4 ( uint8_t *data, const size_t count, const uint8_t background[ 4 ] ) {
+	size_t i = 0;
+#ifdef IMAGE2_KERNELS_X86
+	if ( ActiveTier() != simdTier_t::SCALAR ) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i full = _mm_set1_epi16( 255 );
+		const __m128i bias = _mm_set1_epi16( 128 );
+		const __m128i bg = _mm_setr_epi16( background[ 0 ], background[ 1 ], background[ 2 ], background[ 3 ],
+			background[ 0 ], background[ 1 ], background[ 2 ], background[ 3 ] );
+		const __m128i alphaLane = _mm_setr_epi16( 0, 0, 0, -1, 0, 0, 0, -1 );
+		auto blendTwo = [ & ] ( __m128i px ) { // two pixels, 16 bits per channel
+			__m128i a = _mm_shufflelo_epi16( px, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+			a = _mm_shufflehi_epi16( a, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+			const __m128i srcWeight = _mm_or_si128( _mm_and_si128( alphaLane, full ), _mm_andnot_si128( alphaLane, a ) );
+			__m128i t = _mm_add_epi16( _mm_mullo_epi16( px, srcWeight ), _mm_mullo_epi16( bg, _mm_sub_epi16( full, a ) ) );
+			t = _mm_add_epi16( t, bias );
+			return _mm_srli_epi16( _mm_add_epi16( t, _mm_srli_epi16( t, 8 ) ), 8 );
+		};
+		for ( ; i + 16 <= count; i += 16 ) {
+			__m128i *p = ( __m128i * ) ( data + i );
+			const __m128i px = _mm_loadu_si128( p );
+			const __m128i lo = blendTwo( _mm_unpacklo_epi8( px, zero ) );
+			const __m128i hi = blendTwo( _mm_unpackhi_epi8( px, zero ) );
+			_mm_storeu_si128( p, _mm_packus_epi16( lo, hi ) );
+		}
+	}
+#endif
+	for ( ; i + 4 <= count; i += 4 ) {
+		const uint32_t a = data[ i + 3 ];
+		for ( int c = 0; c < 4; c++ ) {
+			const uint32_t srcWeight = ( c == 3 ) ? 255 : a;
+			data[ i + c ] = Div255Round( data[ i + c ] * srcWeight + background[ c ] * ( 255 - a ) );
+		}
+	}
+}
+
+//===== Convolution Passes ============================================================================================
+
+// Filtering works on tiles of blockRows x tileColumns pixels, small enough that the padded source segment and the
+	// filtered block stay in L1/L2. The separable passes write their output transposed, so the second ( vertical )
+	// pass is the exact same row pass run over the intermediate - it reads contiguous memory instead of striding
+	// down columns, and the transpose itself happens a cache-sized block at a time. All math is in float, uint8 data
+	// is converted on the way in and rounded once on the way out
+constexpr uint32_t blockRows = 16;
+constexpr uint32_t tileColumns = 64;
+
+inline float ToFloat ( const float v ) { return v; }
+inline float ToFloat ( const uint8_t v ) { return float( v ); }
+inline void FromFloat ( const float v, float &out ) { out = v; }
+inline void FromFloat ( const float v, uint8_t &out ) { out = uint8_t( std::min( std::max( v, 0.0f ), 255.0f ) + 0.5f ); }
+
+// per-thread scratch, grown as needed and kept around between calls
+inline float* ConvolveScratch ( const int slot, const size_t count ) {
+	static thread_local std::vector< float > buffers[ 2 ];
+	if ( buffers[ slot ].size() < count ) {
+		buffers[ slot ].resize( count );
+	}
+	return buffers[ slot ].data();
+}
+
+// count pixels starting at x0 ( which may be negative, or run off the end ) out of one row, edges clamped
+template < int numChannels, typename src_t >
+inline void LoadClampedSegment ( const src_t *row, const int32_t width, const int32_t x0, const int32_t count, float *out ) {
+	const int32_t innerStart = std::min( std::max( x0, 0 ), width );
+	const int32_t innerEnd = std::max( std::min( x0 + count, width ), innerStart );
+	int32_t i = 0;
+	for ( ; i < innerStart - x0 && i < count; i++ ) { // left edge
+		for ( int c = 0; c < numChannels; c++ ) {
+			out[ i * numChannels + c ] = ToFloat( row[ c ] );
+		}
+	}
+	const src_t *inner = row + size_t( innerStart ) * numChannels;
+	float *innerOut = out + size_t( i ) * numChannels;
+	const size_t innerCount = size_t( innerEnd - innerStart ) * numChannels;
+	for ( size_t j = 0; j < innerCount; j++ ) {
+		innerOut[ j ] = ToFloat( inner[ j ] );
+	}
+	i += innerEnd - innerStart;
+	const src_t *last = row + size_t( width - 1 ) * numChannels;
+	for ( ; i < count; i++ ) { // right edge
+		for ( int c = 0; c < numChannels; c++ ) {
+			out[ i * numChannels + c ] = ToFloat( last[ c ] );
+		}
+	}
+}
+
+// out[ x ] = sum over k of weights[ k ] * padded[ x + k ], for a 2 * radius + 1 tap kernel
+struct weightedRowFilter_t {
+	const float *weights;
+	uint32_t radius;
+
+	template < int numChannels >
+	void Run ( const float *padded, float *out, const uint32_t count ) const {
+		const size_t length = size_t( count ) * numChannels;
+		for ( size_t i = 0; i < length; i++ ) {
+			out[ i ] = weights[ 0 ] * padded[ i ];
+		}
+		for ( uint32_t k = 1; k <= 2 * radius; k++ ) { // tap-major, so the inner loop is a straight multiply-add over the segment
+			const float w = weights[ k ];
+			const float *src = padded + size_t( k ) * numChannels;
+			for ( size_t i = 0; i < length; i++ ) {
+				out[ i ] += w * src[ i ];
+			}
+		}
+	}
+};
+
+// box filter as a sliding window - add the sample entering on the right, drop the one leaving on the left, so the
+	// cost per pixel doesn't depend on the radius. The window restarts every tile, which keeps float drift bounded
+struct boxRowFilter_t {
+	uint32_t radius;
+
+	template < int numChannels >
+	void Run ( const float *padded, float *out, const uint32_t count ) const {
+		const uint32_t taps = 2 * radius + 1;
+		const float scale = 1.0f / float( taps );
+		float sum[ numChannels ] = {};
+		for ( uint32_t k = 0; k < taps; k++ ) {
+			for ( int c = 0; c < numChannels; c++ ) {
+				sum[ c ] += padded[ k * numChannels + c ];
+			}
+		}
+		for ( uint32_t x = 0; x < count; x++ ) {
+			for ( int c = 0; c < numChannels; c++ ) {
+				out[ x * numChannels + c ] = sum[ c ] * scale;
+				sum[ c ] += padded[ ( x + taps ) * numChannels + c ] - padded[ x * numChannels + c ];
+			}
+		}
+	}
+};
+
+// filters rows [ yMin, yMax ) of a width x height source along x, and writes them transposed - the pixel at ( x, y )
+	// lands at dst[ ( x * height + y ) * numChannels ], so dst is a height x width image. The padded segment reads
+	// one pixel past the end of the window for the box filter's last update, hence the extra + 1
+template < int numChannels, typename src_t, typename dst_t, typename filter_t >
+inline void TransposedRowPass ( const src_t *src, dst_t *dst, const uint32_t width, const uint32_t height, const uint32_t yMin, const uint32_t yMax, const filter_t &filter ) {
+	const uint32_t radius = filter.radius;
+	const uint32_t columns = std::max( tileColumns, 4 * radius );
+	float *padded = ConvolveScratch( 0, size_t( columns + 2 * radius + 1 ) * numChannels );
+	float *block = ConvolveScratch( 1, size_t( blockRows ) * columns * numChannels );
+
+	for ( uint32_t y0 = yMin; y0 < yMax; y0 += blockRows ) {
+		const uint32_t y1 = std::min( y0 + blockRows, yMax );
+		for ( uint32_t x0 = 0; x0 < width; x0 += columns ) {
+			const uint32_t count = std::min( columns, width - x0 );
+
+			// filter this tile's rows into the block
+			for ( uint32_t y = y0; y < y1; y++ ) {
+				LoadClampedSegment< numChannels >( src + size_t( y ) * width * numChannels, int32_t( width ), int32_t( x0 ) - int32_t( radius ), int32_t( count + 2 * radius + 1 ), padded );
+				filter.template Run< numChannels >( padded, block + size_t( y - y0 ) * columns * numChannels, count );
+			}
+
+			// and write it out transposed, each tile column becomes a short contiguous run in dst
+			for ( uint32_t x = 0; x < count; x++ ) {
+				dst_t *out = dst + ( size_t( x0 + x ) * height + y0 ) * numChannels;
+				for ( uint32_t y = 0; y < y1 - y0; y++ ) {
+					const float *in = block + ( size_t( y ) * columns + x ) * numChannels;
+					for ( int c = 0; c < numChannels; c++ ) {
+						FromFloat( in[ c ], out[ y * numChannels + c ] );
+					}
+				}
+			}
+		}
+	}
+}
+
+// general size x size kernel ( row-major, odd size ) over rows [ yMin, yMax ) - not separable, so there's no transpose
+	// trick here, every output row reads size clamped source rows. src has to be a separate copy of the image
+template < int numChannels, typename src_t, typename dst_t >
+inline void KernelRowsPass ( const src_t *src, dst_t *dst, const uint32_t width, const uint32_t height, const uint32_t yMin, const uint32_t yMax, const float *kernel, const uint32_t size ) {
+	const uint32_t radius = size / 2;
+	const uint32_t columns = tileColumns;
+	float *padded = ConvolveScratch( 0, size_t( columns + 2 * radius ) * numChannels );
+	float *accumulator = ConvolveScratch( 1, size_t( columns ) * numChannels );
+
+	for ( uint32_t y = yMin; y < yMax; y++ ) {
+		for ( uint32_t x0 = 0; x0 < width; x0 += columns ) {
+			const uint32_t count = std::min( columns, width - x0 );
+			const size_t length = size_t( count ) * numChannels;
+			std::fill( accumulator, accumulator + length, 0.0f );
+			for ( uint32_t ky = 0; ky < size; ky++ ) {
+				const int32_t sy = std::min( std::max( int32_t( y + ky ) - int32_t( radius ), 0 ), int32_t( height ) - 1 );
+				LoadClampedSegment< numChannels >( src + size_t( sy ) * width * numChannels, int32_t( width ), int32_t( x0 ) - int32_t( radius ), int32_t( count + 2 * radius ), padded );
+				const float *weights = kernel + size_t( ky ) * size;
+				for ( uint32_t kx = 0; kx < size; kx++ ) {
+					const float w = weights[ kx ];
+					const float *in = padded + size_t( kx ) * numChannels;
+					for ( size_t i = 0; i < length; i++ ) {
+						accumulator[ i ] += w * in[ i ];
+					}
+				}
+			}
+			dst_t *out = dst + ( size_t( y ) * width + x0 ) * numChannels;
+			for ( size_t i = 0; i < length; i++ ) {
+				FromFloat( accumulator[ i ], out[ i ] );
+			}
+		}
+	}
+}
+
+// normalized gaussian taps, radius defaults to 3 sigma
+inline std::vector< float > GaussianWeights ( const float sigma, uint32_t radius = 0 ) {
+	if ( radius == 0 ) {
+		radius = std::max( 1u, uint32_t( std::ceil( 3.0f * sigma ) ) );
+	}
+	std::vector< float > weights( 2 * radius + 1 );
+	float total = 0.0f;
+	for ( uint32_t i = 0; i < weights.size(); i++ ) {
+		const float x = float( int32_t( i ) - int32_t( radius ) );
+		weights[ i ] = std::exp( -( x * x ) / ( 2.0f * sigma * sigma ) );
+		total += weights[ i ];
+	}
+	for ( auto &w : weights ) {
+		w /= total;
+	}
+	return weights;
+}
+
+//===== Mip Downsampling ==============================================================================================
+
+// 2:1 reduction on both axes with a symmetric, even tap count filter - destination texel x is centered between source
+	// texels 2x and 2x + 1, so the taps run from 2x - ( taps / 2 - 1 ) to 2x + taps / 2, clamped at the edges. Every
+	// output row is independent: the source rows are filtered vertically into one float row, then that row horizontally
+template < int numChannels, typename texel_t >
+inline void Downsample2x ( const texel_t *src, const uint32_t srcWidth, const uint32_t srcHeight, texel_t *dst, const uint32_t dstWidth, const uint32_t yMin, const uint32_t yMax, const float *weights, const int taps ) {
+	const int firstTap = -( taps / 2 - 1 );
+	float *column = ConvolveScratch( 0, size_t( srcWidth ) * numChannels );
+	for ( uint32_t y = yMin; y < yMax; y++ ) {
+		const size_t rowLength = size_t( srcWidth ) * numChannels;
+		std::fill( column, column + rowLength, 0.0f );
+		for ( int k = 0; k < taps; k++ ) {
+			const int32_t sy = std::min( std::max( int32_t( 2 * y ) + firstTap + k, 0 ), int32_t( srcHeight ) - 1 );
+			const texel_t *row = src + size_t( sy ) * rowLength;
+			const float w = weights[ k ];
+			for ( size_t i = 0; i < rowLength; i++ ) {
+				column[ i ] += w * ToFloat( row[ i ] );
+			}
+		}
+		texel_t *out = dst + size_t( y ) * dstWidth * numChannels;
+		for ( uint32_t x = 0; x < dstWidth; x++ ) {
+			float sum[ numChannels ] = {};
+			for ( int k = 0; k < taps; k++ ) {
+				const int32_t sx = std::min( std::max( int32_t( 2 * x ) + firstTap + k, 0 ), int32_t( srcWidth ) - 1 );
+				for ( int c = 0; c < numChannels; c++ ) {
+					sum[ c ] += weights[ k ] * column[ sx * numChannels + c ];
+				}
+			}
+			for ( int c = 0; c < numChannels; c++ ) {
+				FromFloat( sum[ c ], out[ x * numChannels + c ] );
+			}
+		}
+	}
+}
+
+// 8 tap kaiser windowed sinc, cut off at the new nyquist - sharper than the box, at the cost of a little ringing
+inline std::vector< float > KaiserDownsampleWeights ( const float beta = 4.0f ) {
+	auto besselI0 = [] ( const float x ) { // power series, converges quickly over the range we need
+		float sum = 1.0f, term = 1.0f;
+		for ( int k = 1; k < 16; k++ ) {
+			term *= ( x / ( 2.0f * k ) ) * ( x / ( 2.0f * k ) );
+			sum += term;
+		}
+		return sum;
+	};
+	std::vector< float > weights( 8 );
+	float total = 0.0f;
+	for ( int k = 0; k < 8; k++ ) {
+		const float t = float( k ) - 3.5f; // offset from the destination texel center, in source texels
+		const float sinc = std::sin( 3.14159265f * t * 0.5f ) / ( 3.14159265f * t * 0.5f );
+		const float window = besselI0( beta * std::sqrt( std::max( 0.0f, 1.0f - ( t / 4.0f ) * ( t / 4.0f ) ) ) ) / besselI0( beta );
+		weights[ k ] = sinc * window;
+		total += weights[ k ];
+	}
+	for ( auto &w : weights ) {
+		w /= total;
+	}
+	return weights;
+}
+
+} // namespace image2Kernels
+
+#endif // IMAGE2KERNELS_H
@@ -0,0 +1,129 @@
+// no include guard - image2Kernels.h includes this once per instruction set, each time inside that set's namespace
+	// and with V naming its wrapper struct ( vSSE2, vAVX2 ). Everything here is defined right there, so it all gets
+	// compiled for the instruction set it is used with - the AVX2 copy sits inside a target( "avx2" ) region, which
+	// GCC and Clang need before they'll emit those instructions from a translation unit built without -mavx2
+
+//===== Vector Math ===================================================================================================
+
+inline V::f Log2Approx ( V::f x ) {
+	V::i bits = V::AsInt( x );
+	V::f e = V::ToFloat( V::SubInt( V::ShiftRight23( bits ), V::Set1i( 127 ) ) );
+	V::f m = V::AsFloat( V::Or( V::And( bits, V::Set1i( 0x007FFFFF ) ), V::Set1i( 0x3F800000 ) ) );
+	const V::f recenter = V::Greater( m, V::Set1( 1.41421356f ) );
+	m = V::Select( recenter, V::Mul( m, V::Set1( 0.5f ) ), m );
+	e = V::Select( recenter, V::Add( e, V::Set1( 1.0f ) ), e );
+	const V::f one = V::Set1( 1.0f );
+	const V::f f = V::Div( V::Sub( m, one ), V::Add( m, one ) );
+	const V::f f2 = V::Mul( f, f );
+	V::f p = V::Set1( 1.0f / 9.0f );
+	p = V::Add( V::Mul( p, f2 ), V::Set1( 1.0f / 7.0f ) );
+	p = V::Add( V::Mul( p, f2 ), V::Set1( 1.0f / 5.0f ) );
+	p = V::Add( V::Mul( p, f2 ), V::Set1( 1.0f / 3.0f ) );
+	p = V::Add( V::Mul( p, f2 ), one );
+	return V::Add( e, V::Mul( V::Mul( V::Mul( V::Set1( 2.0f ), f ), p ), V::Set1( 1.44269504f ) ) );
+}
+
+inline V::f Exp2Approx ( V::f y ) {
+	y = V::Min( V::Max( y, V::Set1( -126.0f ) ), V::Set1( 127.0f ) );
+	const V::f n = V::RoundNearest( y );
+	const V::f t = V::Mul( V::Sub( y, n ), V::Set1( 0.69314718f ) );
+	V::f p = V::Set1( 1.0f / 5040.0f );
+	p = V::Add( V::Mul( p, t ), V::Set1( 1.0f / 720.0f ) );
+	p = V::Add( V::Mul( p, t ), V::Set1( 1.0f / 120.0f ) );
+	p = V::Add( V::Mul( p, t ), V::Set1( 1.0f / 24.0f ) );
+	p = V::Add( V::Mul( p, t ), V::Set1( 1.0f / 6.0f ) );
+	p = V::Add( V::Mul( p, t ), V::Set1( 0.5f ) );
+	p = V::Add( V::Mul( p, t ), V::Set1( 1.0f ) );
+	p = V::Add( V::Mul( p, t ), V::Set1( 1.0f ) );
+	const V::f scale = V::AsFloat( V::ShiftLeft23( V::AddInt( V::ToInt( n ), V::Set1i( 127 ) ) ) );
+	return V::Mul( p, scale );
+}
+
+// lanes off the fast path are patched up with the scalar version
+inline V::f PowApprox ( V::f x, const float exponent ) {
+	V::f result = Exp2Approx( V::Mul( V::Set1( exponent ), Log2Approx( x ) ) );
+	const V::f fastPath = V::InRange( x, V::Set1( std::numeric_limits< float >::min() ), V::Set1( std::numeric_limits< float >::max() ) );
+	if ( !V::AllSet( fastPath ) ) {
+		alignas( 32 ) float xs[ V::width ], rs[ V::width ];
+		V::Store( xs, x );
+		V::Store( rs, result );
+		for ( int l = 0; l < V::width; l++ ) {
+			if ( !PowFastPathOK( xs[ l ] ) ) {
+				rs[ l ] = std::pow( xs[ l ], exponent );
+			}
+		}
+		result = V::Load( rs );
+	}
+	return result;
+}
+
+// a vector's worth of per-channel constants, repeating every numChannels lanes
+template < int numChannels >
+inline V::f ChannelPattern ( const float perChannel[] ) {
+	alignas( 32 ) float lanes[ V::width ];
+	for ( int l = 0; l < V::width; l++ ) {
+		lanes[ l ] = perChannel[ l % numChannels ];
+	}
+	return V::Load( lanes );
+}
+
+//===== Float Kernels =================================================================================================
+
+// the vector side of each op in image2Kernels.h, picked by overload on the op type
+template < int nc >
+inline V::f Vector ( const opPow &op, V::f x ) {
+	return V::Select( V::Greater( ChannelPattern< nc >( op.mask ), V::Set1( 0.0f ) ), PowApprox( x, op.exponent ), x );
+}
+
+template < int nc >
+inline V::f Vector ( const opSRGBToLinear &op, V::f x ) {
+	const V::f higher = PowApprox( V::Div( V::Add( x, V::Set1( 0.055f ) ), V::Set1( 1.055f ) ), 2.4f );
+	const V::f lower = V::Div( x, V::Set1( 12.92f ) );
+	const V::f converted = V::Select( V::Less( x, V::Set1( 0.04045f ) ), lower, higher );
+	return V::Select( V::Greater( ChannelPattern< nc >( op.mask ), V::Set1( 0.0f ) ), converted, x );
+}
+
+template < int nc >
+inline V::f Vector ( const opLinearToSRGB &op, V::f x ) {
+	const V::f higher = V::Sub( V::Mul( V::Set1( 1.055f ), PowApprox( x, 1.0f / 2.4f ) ), V::Set1( 0.055f ) );
+	const V::f lower = V::Mul( x, V::Set1( 12.92f ) );
+	const V::f converted = V::Select( V::Less( x, V::Set1( 0.0031308f ) ), lower, higher );
+	return V::Select( V::Greater( ChannelPattern< nc >( op.mask ), V::Set1( 0.0f ) ), converted, x );
+}
+
+template < int nc >
+inline V::f Vector ( const opScale &op, V::f x ) {
+	return V::Mul( x, ChannelPattern< nc >( op.scale ) );
+}
+
+template < int nc >
+inline V::f Vector ( const opRemap &op, V::f x ) {
+	const V::f remapped = V::Add( ChannelPattern< nc >( op.outLow ), V::Mul( ChannelPattern< nc >( op.outRange ),
+		V::Div( V::Sub( x, ChannelPattern< nc >( op.inLow ) ), ChannelPattern< nc >( op.inRange ) ) ) );
+	return V::Select( V::Greater( ChannelPattern< nc >( op.mask ), V::Set1( 0.0f ) ), remapped, x );
+}
+
+template < int nc >
+inline V::f Vector ( const opFill &op, V::f x ) {
+	return V::Select( V::Greater( ChannelPattern< nc >( op.mask ), V::Set1( 0.0f ) ), ChannelPattern< nc >( op.value ), x );
+}
+
+template < int nc >
+inline V::f Vector ( const opBlendOver &op, V::f x ) {
+	const float srcWeights[ 4 ] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const V::f a = V::BroadcastAlpha4( x );
+	const V::f isAlpha = V::Greater( ChannelPattern< 4 >( srcWeights ), V::Set1( 0.0f ) );
+	const V::f srcWeight = V::Select( isAlpha, V::Set1( 1.0f ), a );
+	return V::Add( V::Mul( x, srcWeight ), V::Mul( ChannelPattern< 4 >( op.background ), V::Sub( V::Set1( 1.0f ), a ) ) );
+}
+
+template < int numChannels, typename op_t >
+inline void RunVectorSpan ( float *data, const size_t count, const op_t &op ) {
+	size_t i = 0;
+	if constexpr ( V::width % numChannels == 0 ) {
+		for ( ; i + V::width <= count; i += V::width ) {
+			V::Store( data + i, Vector< numChannels >( op, V::Load( data + i ) ) );
+		}
+	}
+	RunScalarSpan< numChannels >( data, count, op, i );
+}
@@ -0,0 +1,140 @@
+#pragma once
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+//=============================================================================
+//==== Read Only Memory Mapped File ===========================================
+//=============================================================================
+
+// the whole file is mapped into the address space, and pages come in from the OS file cache as they get touched - so
+	// binary caches can be used in place, without reading or parsing anything up front. Unmapped on destruction
+
+class mappedFile {
+public:
+	mappedFile () = default;
+	explicit mappedFile ( const std::string &path ) { Open( path ); }
+	~mappedFile () { Close(); }
+
+	mappedFile ( const mappedFile & ) = delete;
+	mappedFile& operator = ( const mappedFile & ) = delete;
+	mappedFile ( mappedFile &&other ) noexcept { *this = std::move( other ); }
+	mappedFile& operator = ( mappedFile &&other ) noexcept {
+		if ( this != &other ) {
+			Close();
+			std::swap( data, other.data );
+			std::swap( size, other.size );
+		#ifdef _WIN32
+			std::swap( fileHandle, other.fileHandle );
+			std::swap( mappingHandle, other.mappingHandle );
+		#endif
+		}
+		return *this;
+	}
+
+	// false if the file is missing, empty, or can't be mapped
+	bool Open ( const std::string &path ) {
+		Close();
+	#ifdef _WIN32
+		fileHandle = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+		if ( fileHandle == INVALID_HANDLE_VALUE ) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if ( !GetFileSizeEx( fileHandle, &fileSize ) || fileSize.QuadPart == 0 ) {
+			Close();
+			return false;
+		}
+		mappingHandle = CreateFileMappingA( fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr );
+		if ( mappingHandle == nullptr ) {
+			Close();
+			return false;
+		}
+		data = static_cast< const uint8_t * >( MapViewOfFile( mappingHandle, FILE_MAP_READ, 0, 0, 0 ) );
+		size = size_t( fileSize.QuadPart );
+	#else
+		const int fd = open( path.c_str(), O_RDONLY );
+		if ( fd < 0 ) {
+			return false;
+		}
+		struct stat info;
+		if ( fstat( fd, &info ) == 0 && info.st_size > 0 ) {
+			void *mapping = mmap( nullptr, size_t( info.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+			if ( mapping != MAP_FAILED ) {
+				data = static_cast< const uint8_t * >( mapping );
+				size = size_t( info.st_size );
+			}
+		}
+		close( fd ); // the mapping holds its own reference to the file
+	#endif
+		if ( data == nullptr ) {
+			Close();
+			size = 0;
+		}
+		return data != nullptr;
+	}
+
+	void Close () {
+	#ifdef _WIN32
+		if ( data != nullptr ) {
+			UnmapViewOfFile( data );
+		}
+		if ( mappingHandle != nullptr ) {
+			CloseHandle( mappingHandle );
+			mappingHandle = nullptr;
+		}
+		if ( fileHandle != INVALID_HANDLE_VALUE ) {
+			CloseHandle( fileHandle );
+			fileHandle = INVALID_HANDLE_VALUE;
+		}
+	#else
+		if ( data != nullptr ) {
+			munmap( const_cast< uint8_t * >( data ), size );
+		}
+	#endif
+		data = nullptr;
+		size = 0;
+	}
+
+	bool IsOpen () const { return data != nullptr; }
+	const uint8_t* Data () const { return data; }
+	size_t Size () const { return size; }
+
+	// count elements of T at a byte offset, or nullptr when they'd run past the end of the file
+	template < typename T >
+	const T* At ( const size_t offset, const size_t count = 1 ) const {
+		if ( data == nullptr || offset > size || count > ( size - offset ) / sizeof( T ) ) {
+			return nullptr;
+		}
+		return reinterpret_cast< const T * >( data + offset );
+	}
+
+private:
+	const uint8_t *data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	HANDLE mappingHandle = nullptr;
+#endif
+};
+
+#endif // MAPPEDFILE_H
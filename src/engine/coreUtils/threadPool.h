@@ -0,0 +1,213 @@
+#pragma once
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//=============================================================================
+//==== Work Stealing Thread Pool ==============================================
+//=============================================================================
+
+// each worker owns a deque - it pushes and pops its own work LIFO from the back, and when that runs
+	// dry it steals FIFO from the front of the other workers' deques. Waiting on a taskGroup helps
+	// execute queued work first, so tasks are free to spawn and wait on subtasks ( e.g. recursive
+	// tree builds ) without deadlocking the pool - it only sleeps once there is nothing left to steal
+
+class threadPool {
+public:
+	// counter for a set of related tasks, so you can wait on just the ones you submitted
+	struct taskGroup {
+		std::atomic< int > pending { 0 };
+		bool Done () const { return pending.load( std::memory_order_acquire ) == 0; }
+
+		// signalled under the pool's sleepLock when pending hits zero, or when new work shows up
+		std::condition_variable finished;
+	};
+
+	threadPool ( uint32_t numThreads = std::max( 1u, std::thread::hardware_concurrency() ) ) : queues( numThreads ) {
+		workers.reserve( numThreads );
+		for ( uint32_t id = 0; id < numThreads; id++ ) {
+			workers.emplace_back( [ this, id ] () { WorkerLoop( id ); } );
+		}
+	}
+
+	~threadPool () {
+		{
+			std::lock_guard< std::mutex > lock( sleepLock );
+			shutdown = true;
+		}
+		wake.notify_all();
+		for ( auto& w : workers ) {
+			w.join();
+		}
+	}
+
+	uint32_t NumThreads () const { return uint32_t( workers.size() ); }
+
+	// index of the calling thread in this pool, or -1 when called from outside of it
+	int WorkerIndex () const { return ( currentPool == this ) ? currentWorker : -1; }
+
+	void Submit ( std::function< void() > func, taskGroup *group = nullptr ) {
+		if ( group != nullptr ) {
+			group->pending.fetch_add( 1, std::memory_order_relaxed );
+		}
+
+		// workers push to their own queue, outside threads spread the work round robin
+		const int self = WorkerIndex();
+		const uint32_t target = ( self >= 0 ) ? uint32_t( self ) : ( submitCounter.fetch_add( 1, std::memory_order_relaxed ) % NumThreads() );
+		queuedTasks.fetch_add( 1, std::memory_order_release );
+		{
+			std::lock_guard< std::mutex > lock( queues[ target ].lock );
+			queues[ target ].tasks.push_back( { std::move( func ), group } );
+		}
+
+		{ // the lock makes sure we can't slip in between a worker's ( or waiter's ) check and its wait
+			std::lock_guard< std::mutex > lock( sleepLock );
+			for ( taskGroup *waiting : waitingGroups ) {
+				waiting->finished.notify_all();
+			}
+		}
+		wake.notify_one();
+	}
+
+	// help out with queued work until everything in the group has finished - when there is nothing
+		// to steal, sleep on the group until it finishes or more work is submitted ( e.g. a subtask )
+	void Wait ( taskGroup &group ) {
+		const int self = WorkerIndex();
+		while ( true ) {
+			if ( TryRunOne( self ) ) {
+				continue;
+			}
+
+			// completions decrement under this lock, so once we see Done() here nobody touches the group again
+			std::unique_lock< std::mutex > lock( sleepLock );
+			if ( group.Done() ) {
+				return;
+			}
+			waitingGroups.push_back( &group );
+			group.finished.wait( lock, [ this, &group ] () { return group.Done() || queuedTasks.load( std::memory_order_acquire ) > 0; } );
+			waitingGroups.erase( std::find( waitingGroups.begin(), waitingGroups.end(), &group ) );
+			if ( group.Done() ) {
+				return;
+			}
+		}
+	}
+
+	// calls rangeFunc( lo, hi ) over [ begin, end ) in chunks of at most grainSize, the calling thread takes part
+	template < typename rangeFunc_t >
+	void ParallelFor ( int64_t begin, int64_t end, int64_t grainSize, rangeFunc_t &&rangeFunc ) {
+		grainSize = std::max< int64_t >( grainSize, 1 );
+		if ( end - begin <= grainSize || NumThreads() == 1 ) {
+			if ( end > begin ) {
+				rangeFunc( begin, end );
+			}
+			return;
+		}
+
+		taskGroup group;
+		for ( int64_t lo = begin + grainSize; lo < end; lo += grainSize ) {
+			const int64_t hi = std::min( lo + grainSize, end );
+			Submit( [ &rangeFunc, lo, hi ] () { rangeFunc( lo, hi ); }, &group );
+		}
+		rangeFunc( begin, std::min( begin + grainSize, end ) );
+		Wait( group );
+	}
+
+private:
+	struct task_t {
+		std::function< void() > func;
+		taskGroup *group = nullptr;
+	};
+
+	struct workerQueue_t {
+		std::mutex lock;
+		std::deque< task_t > tasks;
+	};
+
+	std::vector< workerQueue_t > queues;
+	std::vector< std::thread > workers;
+
+	std::atomic< int > queuedTasks { 0 };
+	std::atomic< uint32_t > submitCounter { 0 };
+
+	std::mutex sleepLock;
+	std::condition_variable wake;
+	std::vector< taskGroup * > waitingGroups; // groups with a thread blocked in Wait, guarded by sleepLock
+	bool shutdown = false;
+
+	// identifies pool threads, so Submit and Wait know which queue is "ours"
+	static inline thread_local const threadPool *currentPool = nullptr;
+	static inline thread_local int currentWorker = -1;
+
+	bool TryPop ( uint32_t queue, bool fromBack, task_t &out ) {
+		std::lock_guard< std::mutex > lock( queues[ queue ].lock );
+		auto &tasks = queues[ queue ].tasks;
+		if ( tasks.empty() ) {
+			return false;
+		}
+		if ( fromBack ) {
+			out = std::move( tasks.back() );
+			tasks.pop_back();
+		} else {
+			out = std::move( tasks.front() );
+			tasks.pop_front();
+		}
+		return true;
+	}
+
+	bool TryRunOne ( int self ) {
+		if ( queuedTasks.load( std::memory_order_acquire ) <= 0 ) {
+			return false;
+		}
+
+		task_t task;
+		bool found = ( self >= 0 ) && TryPop( uint32_t( self ), true, task );
+		const uint32_t start = ( self >= 0 ) ? uint32_t( self ) + 1 : 0;
+		for ( uint32_t i = 0; i < NumThreads() && !found; i++ ) {
+			found = TryPop( ( start + i ) % NumThreads(), false, task );
+		}
+
+		if ( found ) {
+			queuedTasks.fetch_sub( 1, std::memory_order_relaxed );
+			task.func();
+			if ( task.group != nullptr ) {
+				std::lock_guard< std::mutex > lock( sleepLock );
+				if ( task.group->pending.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) {
+					task.group->finished.notify_all();
+				}
+			}
+		}
+		return found;
+	}
+
+	void WorkerLoop ( int id ) {
+		currentPool = this;
+		currentWorker = id;
+		while ( true ) {
+			if ( !TryRunOne( id ) ) {
+				std::unique_lock< std::mutex > lock( sleepLock );
+				wake.wait( lock, [ this ] () { return shutdown || queuedTasks.load( std::memory_order_acquire ) > 0; } );
+				if ( shutdown ) {
+					return;
+				}
+			}
+		}
+	}
+};
+
+namespace jbDE {
+	// shared pool, sized to the machine - created on first use
+	inline threadPool& GetThreadPool () {
+		static threadPool pool;
+		return pool;
+	}
+}
+
+#endif // THREADPOOL_H
@@ -0,0 +1,252 @@
+#pragma once
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "threadPool.h"
+
+//=============================================================================
+//==== Progressive Tile Scheduler for CPU Rendering ===========================
+//=============================================================================
+
+// the image is cut into tiles, which are visited along a Hilbert curve so that consecutive tiles are neighbors on
+	// screen and share cache contents ( BVH nodes, textures ). Each pass deals contiguous runs of that order out to
+	// per lane deques - a lane works through its own run from the front, and when it's done it steals from the back
+	// of someone else's, which is the part furthest from where that lane is working. The lanes are tasks on the
+	// shared thread pool, the calling thread runs the first one, so nothing gets spawned per pass and the tile
+	// threads don't compete with the pool for the cores
+
+// rendering is progressive - the first pass takes initialSamples, and every pass after that doubles the total, with a
+	// callback in between passes so a partial image can be shown early. The tile function reports an error estimate for
+	// the tile, and tiles that come in under errorThreshold are retired and skipped by the later passes
+
+class tileScheduler {
+public:
+	struct tile_t {
+		uint32_t x, y;				// top left pixel
+		uint32_t width, height;		// clipped to the image
+		uint32_t index;				// position in the row major tile grid, stable across passes
+	};
+
+	// one tile's share of one pass - render samples [ firstSample, firstSample + sampleCount )
+	struct work_t {
+		tile_t tile;
+		uint32_t pass;
+		uint32_t firstSample;
+		uint32_t sampleCount;
+	};
+
+	struct result_t {
+		uint64_t rays = 0;
+		float error = 1e30f;		// noise estimate after this pass, for the adaptive sampling
+	};
+
+	struct settings_t {
+		uint32_t tileSize = 16;
+		uint32_t initialSamples = 1;
+		uint32_t maxSamples = 64;
+		float errorThreshold = 0.0f;	// zero turns the adaptive sampling off
+		uint32_t numThreads = 0;		// lanes, zero uses one per pool thread - capped at the pool size
+	};
+
+	struct stats_t {
+		uint32_t passes = 0;
+		uint32_t samplesPerPixel = 0;	// for the tiles that ran every pass
+		uint64_t tilesRendered = 0;		// summed over all passes
+		uint64_t tilesRetired = 0;		// converged before maxSamples
+		uint64_t steals = 0;
+		uint64_t rays = 0;
+		float seconds = 0.0f;
+		float meanTileMs = 0.0f;
+		float maxTileMs = 0.0f;
+		std::vector< float > utilization;	// per lane, time spent in the tile function over the wall time of the run
+
+		float MRaysPerSecond () const { return ( seconds > 0.0f ) ? float( rays ) / ( seconds * 1e6f ) : 0.0f; }
+	};
+
+	// lane is in [ 0, numThreads ), and no two calls with the same lane run at the same time
+	using tileFunc_t = std::function< result_t( const work_t &work, uint32_t lane ) >;
+	using passFunc_t = std::function< void( uint32_t pass, uint32_t samplesSoFar ) >;
+
+	// blocks until the last pass is finished, or Cancel() is called
+	stats_t Run ( uint32_t width, uint32_t height, const settings_t &settings, tileFunc_t renderTile, passFunc_t passDone = nullptr ) {
+		cancelled = false;
+		BuildTiles( width, height, std::max( settings.tileSize, 1u ) );
+		threadPool &pool = jbDE::GetThreadPool();
+		const uint32_t numThreads = ( settings.numThreads > 0 ) ? std::min( settings.numThreads, pool.NumThreads() ) : pool.NumThreads();
+
+		stats_t stats;
+		std::vector< threadStats_t > threadStats( numThreads );
+		std::vector< float > tileError( tiles.size(), 1e30f );
+		std::vector< uint32_t > active( tiles.size() );
+		for ( uint32_t i = 0; i < active.size(); i++ ) {
+			active[ i ] = i; // the hilbert order
+		}
+
+		const auto tStart = std::chrono::steady_clock::now();
+		uint32_t samplesDone = 0;
+		for ( uint32_t pass = 0; samplesDone < settings.maxSamples && !active.empty() && !cancelled; pass++ ) {
+			const uint32_t sampleCount = ( pass == 0 ) ? std::clamp( settings.initialSamples, 1u, settings.maxSamples ) : std::min( samplesDone, settings.maxSamples - samplesDone );
+
+			queues = std::vector< tileQueue_t >( numThreads );
+			for ( uint32_t t = 0; t < numThreads; t++ ) {
+				const size_t lo = active.size() * t / numThreads;
+				const size_t hi = active.size() * ( t + 1 ) / numThreads;
+				queues[ t ].tiles.assign( active.begin() + lo, active.begin() + hi );
+			}
+
+			auto runLane = [ & ] ( const uint32_t t ) {
+				threadStats_t &s = threadStats[ t ];
+				uint32_t tileIndex;
+				while ( NextTile( t, tileIndex, s.steals ) ) {
+					const auto tileStart = std::chrono::steady_clock::now();
+					const result_t result = renderTile( { tiles[ tileIndex ], pass, samplesDone, sampleCount }, t );
+					const float ms = std::chrono::duration< float, std::milli >( std::chrono::steady_clock::now() - tileStart ).count();
+					tileError[ tileIndex ] = result.error;
+					s.rays += result.rays;
+					s.tiles++;
+					s.busyMs += ms;
+					s.maxTileMs = std::max( s.maxTileMs, ms );
+				}
+			};
+			threadPool::taskGroup group;
+			for ( uint32_t t = 1; t < numThreads; t++ ) {
+				pool.Submit( [ &runLane, t ] () { runLane( t ); }, &group );
+			}
+			runLane( 0 );
+			pool.Wait( group );
+
+			stats.tilesRendered += active.size();
+			samplesDone += sampleCount;
+			stats.passes++;
+
+			// retire the tiles that have converged, the rest go on to the next pass
+			if ( settings.errorThreshold > 0.0f && samplesDone < settings.maxSamples ) {
+				const size_t before = active.size();
+				std::erase_if( active, [ & ] ( uint32_t i ) { return tileError[ i ] < settings.errorThreshold; } );
+				stats.tilesRetired += before - active.size();
+			}
+
+			if ( passDone ) {
+				passDone( pass, samplesDone );
+			}
+		}
+
+		stats.samplesPerPixel = samplesDone;
+		stats.seconds = std::chrono::duration< float >( std::chrono::steady_clock::now() - tStart ).count();
+		uint64_t tileCount = 0;
+		float busyMs = 0.0f;
+		for ( auto &s : threadStats ) {
+			stats.rays += s.rays;
+			stats.steals += s.steals;
+			stats.maxTileMs = std::max( stats.maxTileMs, s.maxTileMs );
+			stats.utilization.push_back( ( stats.seconds > 0.0f ) ? s.busyMs / ( stats.seconds * 1000.0f ) : 0.0f );
+			tileCount += s.tiles;
+			busyMs += s.busyMs;
+		}
+		stats.meanTileMs = ( tileCount > 0 ) ? busyMs / float( tileCount ) : 0.0f;
+		return stats;
+	}
+
+	// lanes finish the tile they're on, the pass loop stops after that
+	void Cancel () { cancelled = true; }
+
+private:
+	struct tileQueue_t {
+		std::mutex lock;
+		std::deque< uint32_t > tiles;
+	};
+
+	struct alignas( 64 ) threadStats_t {
+		uint64_t rays = 0;
+		uint64_t tiles = 0;
+		uint64_t steals = 0;
+		float busyMs = 0.0f;
+		float maxTileMs = 0.0f;
+	};
+
+	std::vector< tile_t > tiles; // in hilbert order
+	std::vector< tileQueue_t > queues;
+	std::atomic< bool > cancelled { false };
+
+	bool NextTile ( uint32_t self, uint32_t &tileIndex, uint64_t &steals ) {
+		if ( cancelled ) {
+			return false;
+		}
+		{ // own run, front to back
+			std::lock_guard< std::mutex > lock( queues[ self ].lock );
+			if ( !queues[ self ].tiles.empty() ) {
+				tileIndex = queues[ self ].tiles.front();
+				queues[ self ].tiles.pop_front();
+				return true;
+			}
+		}
+		// steal from the far end of someone else's
+		const uint32_t numQueues = uint32_t( queues.size() );
+		for ( uint32_t i = 1; i < numQueues; i++ ) {
+			tileQueue_t &victim = queues[ ( self + i ) % numQueues ];
+			std::lock_guard< std::mutex > lock( victim.lock );
+			if ( !victim.tiles.empty() ) {
+				tileIndex = victim.tiles.back();
+				victim.tiles.pop_back();
+				steals++;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// distance along the curve to x,y on an n by n grid, n a power of two
+	static void HilbertToXY ( const uint32_t n, uint32_t d, uint32_t &x, uint32_t &y ) {
+		x = y = 0;
+		for ( uint32_t s = 1; s < n; s *= 2 ) {
+			const uint32_t rx = 1 & ( d / 2 );
+			const uint32_t ry = 1 & ( d ^ rx );
+			if ( ry == 0 ) { // rotate the quadrant
+				if ( rx == 1 ) {
+					x = s - 1 - x;
+					y = s - 1 - y;
+				}
+				std::swap( x, y );
+			}
+			x += s * rx;
+			y += s * ry;
+			d /= 4;
+		}
+	}
+
+	void BuildTiles ( const uint32_t width, const uint32_t height, const uint32_t tileSize ) {
+		const uint32_t tilesX = ( width + tileSize - 1 ) / tileSize;
+		const uint32_t tilesY = ( height + tileSize - 1 ) / tileSize;
+		uint32_t n = 1;
+		while ( n < std::max( tilesX, tilesY ) ) {
+			n *= 2;
+		}
+
+		// walk the curve over the enclosing power of two square, keeping the points that land on the grid
+		tiles.clear();
+		for ( uint32_t d = 0; d < n * n; d++ ) {
+			uint32_t x, y;
+			HilbertToXY( n, d, x, y );
+			if ( x < tilesX && y < tilesY ) {
+				tile_t tile;
+				tile.x = x * tileSize;
+				tile.y = y * tileSize;
+				tile.width = std::min( tileSize, width - tile.x );
+				tile.height = std::min( tileSize, height - tile.y );
+				tile.index = x + y * tilesX;
+				tiles.push_back( tile );
+			}
+		}
+	}
+};
+
+#endif // TILESCHEDULER_H
@@ -302,31 +302,50 @@ void engineBase::LoadData () {
 	ZoneScoped;
 
 	if ( config.loadDataResources ) { // toggle loading of palettes, font glyphs, and bad/color wordlists
+		bool loadedBundle = false;
 		{
-			Block Start( "Loading Palettes" );
+			Block Start( "Loading Data Bundle" );
 
-			LoadPalettes( paletteList );
-			palette::PopulateLocalList( paletteList );
-			// cout << "loaded " << paletteList.size() << " palettes" << newline;
+			// already decoded, if there's a current bundle - otherwise it's the PNGs, below
+			loadedBundle = LoadDataBundle( paletteList, glyphList, badWords, colorWords );
 		}
 
-		{
-			Block Start( "Loading Font Glyphs" );
+		if ( loadedBundle ) {
+			palette::PopulateLocalList( paletteList );
+		} else {
+			{
+				Block Start( "Loading Palettes" );
 
-			LoadGlyphs( glyphList );
-			// cout << "loaded " << glyphList.size() << " glyphs" << newline;
-		}
+				LoadPalettes( paletteList );
+				palette::PopulateLocalList( paletteList );
+				// cout << "loaded " << paletteList.size() << " palettes" << newline;
+			}
 
-		{
-			Block Start( "Load Wordlists" );
+			{
+				Block Start( "Loading Font Glyphs" );
+
+				LoadGlyphs( glyphList );
+				// cout << "loaded " << glyphList.size() << " glyphs" << newline;
+			}
+
+			{
+				Block Start( "Load Wordlists" );
 
-			LoadBadWords( badWords );
-			// cout << "loaded " << badWords.size() << " bad words" << newline;
+				LoadBadWords( badWords );
+				// cout << "loaded " << badWords.size() << " bad words" << newline;
 
-			LoadColorWords( colorWords );
-			// cout << "loaded " << colorWords.size() << " color words" << newline;
+				LoadColorWords( colorWords );
+				// cout << "loaded " << colorWords.size() << " color words" << newline;
 
-			/* plantWords, animalWords, toolWords, etc? tbd */
+				/* plantWords, animalWords, toolWords, etc? tbd */
+			}
+
+			{
+				Block Start( "Baking Data Bundle" );
+
+				// so the next startup can skip all of the above
+				BakeDataBundle( paletteList, glyphList, badWords, colorWords );
+			}
 		}
 	} else {
 		cout << endl << T_RED << " User Has Elected to Skip Loading of Data Resources ( Palettes, WordLists ) " << RESET << endl;
@@ -347,6 +366,60 @@ void engineBase::TerminalSetup () {
 			}, "Quit the engine." );
 
 
+		// droplets per second for the particle eroder, serial and parallel, on a fresh perlin map
+		terminal.addCommand( { "benchmarkErosion" },
+			{ { "dim", INT, "heightmap size, in pixels on a side" }, { "droplets", INT, "how many droplets to run through each path" } },
+			[=] ( args_t args ) {
+				particleEroder p;
+				p.InitWithPerlin( std::max( 16, int( args[ "dim" ].data.x ) ) );
+				const particleEroder::benchmarkResult_t result = p.Benchmark( std::max( 1, int( args[ "droplets" ].data.x ) ) );
+				terminal.addHistoryLine( terminal.csb.append( "Serial:   " + to_string( int( result.serialDropletsPerSecond ) ) + " droplets/s" ).flush() );
+				terminal.addHistoryLine( terminal.csb.append( "Parallel: " + to_string( int( result.parallelDropletsPerSecond ) ) + " droplets/s on " + to_string( jbDE::GetThreadPool().NumThreads() ) + " threads, " +
+					( result.repeatable ? "repeatable" : "NOT repeatable" ) ).flush() );
+			}, "Time serial and parallel particle erosion." );
+
+		// the grid eroder against the particle eroder, on the same perlin map - speed of each, and how alike the results are
+		terminal.addCommand( { "benchmarkGridErosion" },
+			{ { "dim", INT, "heightmap size, in pixels on a side" }, { "iterations", INT, "timesteps for the grid eroder" }, { "droplets", INT, "droplets for the particle eroder" } },
+			[=] ( args_t args ) {
+				particleEroder p;
+				p.InitWithPerlin( std::max( 16, int( args[ "dim" ].data.x ) ) );
+				const Image_1F before = p.model;
+				gridEroder g;
+				g.model = before;
+				g.Reset();
+
+				const uint32_t iterations = std::max( 1, int( args[ "iterations" ].data.x ) );
+				const uint32_t droplets = std::max( 1, int( args[ "droplets" ].data.x ) );
+				const gridEroder::benchmarkResult_t gridResult = g.Benchmark( iterations );
+				const particleEroder::benchmarkResult_t particleResult = p.Benchmark( droplets );
+
+				// and once more for the maps to compare, Benchmark leaves the models as they were
+				g.Erode( iterations );
+				p.ErodeParallel( droplets );
+				const erosionComparison_t comparison = CompareErosion( before, g.model, p.model );
+
+				terminal.addHistoryLine( terminal.csb.append( "Grid:     " + to_string( int( gridResult.cellsPerSecond ) ) + " cells/s on " + to_string( jbDE::GetThreadPool().NumThreads() ) + " threads, " +
+					( gridResult.repeatable ? "repeatable" : "NOT repeatable" ) ).flush() );
+				terminal.addHistoryLine( terminal.csb.append( "Particle: " + to_string( int( particleResult.parallelDropletsPerSecond ) ) + " droplets/s" ).flush() );
+				terminal.addHistoryLine( terminal.csb.append( "Mean height change " + to_string( comparison.meanChangeA ) + " grid, " + to_string( comparison.meanChangeB ) + " particle, correlation " + to_string( comparison.correlation ) ).flush() );
+			}, "Time the grid eroder, and compare its output with the particle eroder's on the same map." );
+
+		// reparse the data resource PNGs and rewrite the bundle, e.g. after editing them while the engine is running
+		terminal.addCommand( { "bakeDataBundle" }, {},
+			[=] ( args_t args ) {
+				std::vector< paletteEntry > palettes;
+				std::vector< glyph > glyphs;
+				std::vector< string > bad, color;
+				LoadPalettes( palettes );
+				LoadGlyphs( glyphs );
+				LoadBadWords( bad );
+				LoadColorWords( color );
+				const bool baked = BakeDataBundle( palettes, glyphs, bad, color );
+				terminal.addHistoryLine( terminal.csb.append( baked ? "Baked " + to_string( palettes.size() ) + " palettes, " + to_string( glyphs.size() ) + " glyphs, " +
+					to_string( bad.size() + color.size() ) + " words to " + dataBundlePath : "Failed to write " + dataBundlePath ).flush() );
+			}, "Rebuild the baked data bundle from the PNGs." );
+
 		// texture usage report, with some extras that I wanted anyways
 		terminal.addCommand( { "textureManagerReport" }, {},
 		[=] ( args_t args ) {
@@ -128,6 +128,15 @@ namespace std {
 // some useful math functions
 #include "./coreUtils/math.h"
 
+// work stealing thread pool, shared by the CPU side bulk operations
+#include "./coreUtils/threadPool.h"
+
+// hilbert ordered, work stealing, progressive tile scheduling for the CPU renderers
+#include "./coreUtils/tileScheduler.h"
+
+// read only memory mapped files, for the binary caches
+#include "./coreUtils/mappedFile.h"
+
 // image load/save/resize/access/manipulation wrapper
 #include "./coreUtils/image2.h"
 
@@ -176,15 +185,27 @@ namespace std {
 // wordlist decoders
 #include "../data/wordlistLoader.h"
 
+// the above, already decoded into one memory mapped file, with the PNG path as the fallback
+#include "../data/dataBundle.h"
+
 // templated diamond square heightmap generation
 #include "../utils/noise/diamondSquare/diamond_square.h"
 
+// parallel diamond square over an infinite lattice, for any size window and seamless chunks
+#include "../utils/noise/diamondSquare/diamondSquareGenerator.h"
+
 // bringing the old perlin implementation back
 #include "../utils/noise/perlin.h"
 
 // particle based erosion
 #include "../utils/erosion/particleBased.h"
 
+// grid based hydraulic + thermal erosion
+#include "../utils/erosion/gridBased.h"
+
+// short time fourier transform on single precision fftw plans, streaming or offline
+#include "../utils/stft/stft.h"
+
 // Brent Werness' Voxel Automata Terrain, ported to C++
 #include "../utils/noise/VAT/VAT.h"
 
@@ -75,6 +75,149 @@ public:
 		return ( float( stopTime - startTime ) / 1000000.0f ) / 500.0f;
 	}
 
+	// filters a 2k image a handful of times with each of the convolution paths, reports megapixels/sec
+	template < typename imageType >
+	void ConvolutionBenchmark ( const string label ) {
+		const uint32_t dim = 2048;
+		const uint32_t numConvolutionRuns = 10;
+		imageType source( dim, dim );
+		rngi noise = rngi( 0, 255, 69420 );
+		for ( uint32_t y = 0; y < dim; y++ ) {
+			for ( uint32_t x = 0; x < dim; x++ ) {
+				auto col = source.GetAtXY( x, y );
+				for ( uint8_t c = 0; c < 4; c++ ) {
+					col[ c ] = std::is_same< imageType, Image_4F >::value ? ( noise() / 255.0f ) : noise();
+				}
+				source.SetAtXY( x, y, col );
+			}
+		}
+
+		const std::vector< float > sharpen = { 0.0f, -1.0f, 0.0f, -1.0f, 5.0f, -1.0f, 0.0f, -1.0f, 0.0f };
+		const std::vector< std::pair< string, std::function< void( imageType& ) > > > filters = {
+			{ "Gaussian, sigma 4 ( 25 taps, separable )", [] ( imageType &image ) { image.GaussianBlur( 4.0f ); } },
+			{ "Box, radius 16 ( sliding window )", [] ( imageType &image ) { image.BoxBlur( 16 ); } },
+			{ "Box, radius 16, 3 iterations", [] ( imageType &image ) { image.BoxBlur( 16, 3 ); } },
+			{ "3x3 sharpen ( general kernel )", [ & ] ( imageType &image ) { image.Convolve( sharpen ); } }
+		};
+
+		for ( auto &filter : filters ) {
+			imageType image = source;
+			filter.second( image ); // warmup, also faults in the scratch buffers
+			const auto tStart = std::chrono::steady_clock::now();
+			for ( uint32_t i = 0; i < numConvolutionRuns; i++ ) {
+				filter.second( image );
+			}
+			const float seconds = std::chrono::duration< float >( std::chrono::steady_clock::now() - tStart ).count();
+			const float megapixels = float( dim * dim ) * numConvolutionRuns / 1e6f;
+			cout << " " << label << " " << filter.first << ": " << megapixels / seconds << " MPix/s" << endl;
+		}
+	}
+
+	// the scattered read workloads, lens distortion and rotated texture sampling, on the same image in each storage layout
+	template < typename imageType >
+	void LayoutBenchmark ( const string label ) {
+		const uint32_t dim = 2048;
+		const uint32_t numLayoutRuns = 5;
+		Image_4U noise( dim, dim );
+		rngi noiseGen = rngi( 0, 255, 69420 );
+		for ( auto &v : *noise.GetData() ) {
+			v = noiseGen();
+		}
+		imageType source( noise );
+		const float megapixels = float( dim * dim ) * numLayoutRuns / 1e6f;
+
+		{ // lens distortion, every pixel takes a bilinear read from somewhere else in the image
+			imageType image = source;
+			const auto tStart = std::chrono::steady_clock::now();
+			for ( uint32_t i = 0; i < numLayoutRuns; i++ ) {
+				image.BrownConradyLensDistort( 0.5f, 0.4f, -0.2f );
+			}
+			const float seconds = std::chrono::duration< float >( std::chrono::steady_clock::now() - tStart ).count();
+			cout << " " << label << " Brown-Conrady lens distort: " << megapixels / seconds << " MPix/s" << endl;
+		}
+
+		{ // rotated lookups walk diagonally across the rows, which is where the row-major layout hurts the most
+			const float angle = glm::radians( 75.0f );
+			const mat2 rotate = mat2( cos( angle ), sin( angle ), -sin( angle ), cos( angle ) );
+			std::atomic< uint32_t > checksum = 0;
+			const auto tStart = std::chrono::steady_clock::now();
+			for ( uint32_t i = 0; i < numLayoutRuns; i++ ) {
+				jbDE::GetThreadPool().ParallelFor( 0, dim, 16, [ & ] ( const int64_t yMin, const int64_t yMax ) {
+					uint32_t sum = 0;
+					for ( int64_t y = yMin; y < yMax; y++ ) {
+						for ( uint32_t x = 0; x < dim; x++ ) {
+							const vec2 uv = rotate * ( vec2( x, y ) / float( dim ) - vec2( 0.5f ) ) + vec2( 0.5f );
+							sum += source.Sample( uv, 0.0f )[ red ];
+						}
+					}
+					checksum += sum;
+				} );
+			}
+			const float seconds = std::chrono::duration< float >( std::chrono::steady_clock::now() - tStart ).count();
+			cout << " " << label << " rotated bilinear sampling: " << megapixels / seconds << " MPix/s ( checksum " << checksum << " )" << endl;
+		}
+	}
+
+	// full frames of a Sponza sized model through the binned rasterizer, reports triangles/sec and fill rate
+	void SoftRastBenchmark () {
+		const uint32_t numFrames = 20;
+		SoftRast s( 1920, 1080 );
+		s.LoadModel( "../../SponzaRepack/sponza.obj", "../../SponzaRepack/" );
+
+		if ( s.triangles.empty() ) { // no model on disk, stand in a torus with the same triangle count ( ~262k )
+			cout << " sponza.obj not found, using a 512x256 segment torus" << endl;
+			Image_4U checker( 256, 256 );
+			for ( uint32_t y = 0; y < 256; y++ ) {
+				for ( uint32_t x = 0; x < 256; x++ ) {
+					const uint8_t value = ( ( x / 32 + y / 32 ) % 2 ) ? 255 : 64;
+					checker.SetAtXY( x, y, color_4U( { value, value, value, 255 } ) );
+				}
+			}
+			s.texSet.emplace_back( checker );
+			s.texSet.back().BuildMipChain();
+
+			const int segmentsU = 512, segmentsV = 256;
+			auto torusPoint = [ & ] ( int i, int j ) {
+				const float u = float( jbDE::tau ) * i / segmentsU, v = float( jbDE::tau ) * j / segmentsV;
+				return vec3( ( 1.0f + 0.4f * cos( v ) ) * cos( u ), 0.4f * sin( v ), ( 1.0f + 0.4f * cos( v ) ) * sin( u ) );
+			};
+			for ( int i = 0; i < segmentsU; i++ ) {
+				for ( int j = 0; j < segmentsV; j++ ) {
+					triangle a, b;
+					const vec3 uv0 = vec3( float( i ) / segmentsU * 8.0f, float( j ) / segmentsV * 4.0f, 0.0f );
+					const vec3 uv1 = uv0 + vec3( 8.0f / segmentsU, 4.0f / segmentsV, 0.0f );
+					a.p0 = torusPoint( i, j );		a.t0 = uv0;
+					a.p1 = torusPoint( i + 1, j );	a.t1 = vec3( uv1.x, uv0.y, 0.0f );
+					a.p2 = torusPoint( i + 1, j + 1 );	a.t2 = uv1;
+					b.p0 = a.p0;						b.t0 = uv0;
+					b.p1 = a.p2;						b.t1 = uv1;
+					b.p2 = torusPoint( i, j + 1 );	b.t2 = vec3( uv0.x, uv1.y, 0.0f );
+					s.triangles.push_back( a );
+					s.triangles.push_back( b );
+				}
+			}
+		}
+		s.UnitCubeRefit();
+
+		SoftRast::rasterStats_t totals;
+		float seconds = 0.0f;
+		for ( uint32_t i = 0; i < numFrames + 1; i++ ) { // first frame is warmup
+			s.Color.ClearTo( color_4U( { 0, 0, 0, 0 } ) );
+			s.Depth.ClearTo( color_1F( { std::numeric_limits< float >::max() } ) );
+			const mat3 transform = rotation( vec3( 0.3f, 1.0f, 0.1f ), 0.1f * i ) * 0.9f;
+			const auto tStart = std::chrono::steady_clock::now();
+			s.DrawModel( transform );
+			if ( i != 0 ) {
+				seconds += std::chrono::duration< float >( std::chrono::steady_clock::now() - tStart ).count();
+				totals += s.stats;
+			}
+		}
+		cout << " " << s.triangles.size() << " triangles at 1920x1080: " << ( seconds * 1000.0f / numFrames ) << "ms/frame" << endl;
+		cout << " " << ( s.triangles.size() * numFrames / seconds ) / 1e6f << " MTris/s, " << ( totals.pixelsShaded / seconds ) / 1e6f << " MPix/s fill rate" << endl;
+		cout << " per frame: " << totals.trianglesClipped / numFrames << " triangles clipped, " << totals.trianglesOccluded / numFrames << " occluded by Hi-Z ( "
+			<< totals.blocksOccluded / numFrames << " blocks ), " << totals.pixelsShaded / numFrames << " pixels shaded, overdraw " << totals.Overdraw() << endl;
+	}
+
 	void OnInit () {
 		ZoneScoped;
 		{
@@ -191,6 +334,30 @@ public:
 			{
 
 			}
+
+			// Test 6: CPU Image2 Convolution
+			{	// result in megapixels/sec
+				cout << "Test 6: CPU Image2 Convolution ( " << jbDE::GetThreadPool().NumThreads() << " threads )" << endl;
+				ConvolutionBenchmark< Image_4F >( "Image_4F" );
+				ConvolutionBenchmark< Image_4U >( "Image_4U" );
+				cout << endl;
+			}
+
+			// Test 7: CPU Image2 Storage Layouts
+			{	// result in megapixels/sec
+				cout << "Test 7: CPU Image2 Storage Layouts ( " << jbDE::GetThreadPool().NumThreads() << " threads )" << endl;
+				LayoutBenchmark< Image_4U >( "Row-Major" );
+				LayoutBenchmark< Image_4U_Tiled >( "Tiled 8x8" );
+				LayoutBenchmark< Image_4U_Morton >( "Morton" );
+				cout << endl;
+			}
+
+			// Test 8: CPU SoftRast Rasterization
+			{	// result in triangles/sec and megapixels/sec
+				cout << "Test 8: CPU SoftRast Binned Rasterization ( " << jbDE::GetThreadPool().NumThreads() << " threads )" << endl;
+				SoftRastBenchmark();
+				cout << endl;
+			}
 		}
 	}
 
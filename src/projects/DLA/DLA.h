@@ -1,162 +1,406 @@
 #include "../../engine/includes.h"
+#include <bit>
+
+// anchored particles on a sparse grid of 8x8x8 cell blocks - an open addressed table maps block coordinates to blocks,
+	// each block has a bitmask of which cells are occupied, so an empty neighbor cell is one bit test instead of a map
+	// lookup. The particles themselves live in one flat pool, chained per cell, since most cells only ever hold one
+class sparseParticleGrid {
+public:
+	static constexpr int blockBits = 3;
+	static constexpr int blockSize = 1 << blockBits;
+	static constexpr int blockCells = blockSize * blockSize * blockSize;
+	static constexpr uint32_t none = ~0u;
+
+	struct block_t {
+		uint64_t occupancy[ blockCells / 64 ] = {};
+		uint64_t changed[ blockCells / 64 ] = {};	// cells added to since the last ForEachChangedCell()
+		uint32_t head[ blockCells ];	// first particle in the cell, chained through next
+		uint16_t count[ blockCells ] = {};
+		ivec3 base;						// cell coordinate of the block's corner
+		block_t () { std::fill( std::begin( head ), std::end( head ), none ); }
+	};
+
+	std::vector< block_t > blocks;
+	std::vector< vec3 > positions;
+	std::vector< uint32_t > next;
+
+	// running totals, kept up to date by Add() instead of scanning
+	uint32_t uniqueCells = 0;
+	uint32_t maxCellCount = 0;
+	ivec3 minTouched = ivec3( 0 );
+	ivec3 maxTouched = ivec3( 0 );
+
+	static ivec3 Cell ( const vec3 &p ) { return ivec3( glm::floor( p ) ); }
+
+	void Clear () {
+		blocks.clear();
+		positions.clear();
+		next.clear();
+		keys.assign( 1024, emptyKey );
+		values.assign( 1024, none );
+		uniqueCells = maxCellCount = 0;
+		minTouched = maxTouched = ivec3( 0 );
+	}
+
+	uint32_t Count () const { return uint32_t( positions.size() ); }
+
+	// returns the new particle count in the cell
+	uint32_t Add ( const vec3 &p ) {
+		const ivec3 cell = Cell( p );
+		block_t &b = blocks[ FindOrAddBlock( cell >> blockBits ) ];
+		const uint32_t c = LocalIndex( cell );
+		if ( b.count[ c ] == 0 ) {
+			b.occupancy[ c >> 6 ] |= ( 1ull << ( c & 63 ) );
+			minTouched = ( uniqueCells == 0 ) ? cell : glm::min( minTouched, cell );
+			maxTouched = ( uniqueCells == 0 ) ? cell : glm::max( maxTouched, cell );
+			uniqueCells++;
+		}
+		b.changed[ c >> 6 ] |= ( 1ull << ( c & 63 ) );
+		positions.push_back( p );
+		next.push_back( b.head[ c ] );
+		b.head[ c ] = uint32_t( positions.size() - 1 );
+		if ( b.count[ c ] < 0xFFFF ) {
+			b.count[ c ]++;
+		}
+		maxCellCount = std::max< uint32_t >( maxCellCount, b.count[ c ] );
+		return b.count[ c ];
+	}
+
+	uint32_t CellCount ( const ivec3 &cell ) const {
+		const uint32_t b = FindBlock( cell >> blockBits );
+		return ( b == none ) ? 0 : blocks[ b ].count[ LocalIndex( cell ) ];
+	}
+
+	// squared distance to the closest particle in the 3x3x3 cells around p, or maxDistance2 if there's nothing closer.
+		// The 27 cells touch at most 2x2x2 blocks, so that's the most table lookups it takes
+	float ClosestDistance2 ( const vec3 &p, const float maxDistance2 ) const {
+		const ivec3 cell = Cell( p );
+		const ivec3 blockMin = ( cell - 1 ) >> blockBits;
+		const ivec3 blockMax = ( cell + 1 ) >> blockBits;
+		float closest = maxDistance2;
+		for ( int bz = blockMin.z; bz <= blockMax.z; bz++ ) {
+			for ( int by = blockMin.y; by <= blockMax.y; by++ ) {
+				for ( int bx = blockMin.x; bx <= blockMax.x; bx++ ) {
+					const uint32_t index = FindBlock( ivec3( bx, by, bz ) );
+					if ( index != none ) {
+						closest = std::min( closest, ClosestInBlock( blocks[ index ], p, cell ) );
+					}
+				}
+			}
+		}
+		return closest;
+	}
+
+	// func( ivec3 cell, uint32_t count ) for every occupied cell
+	template < typename cellFunc_t >
+	void ForEachCell ( cellFunc_t &&func ) const {
+		for ( const block_t &b : blocks ) {
+			for ( uint32_t word = 0; word < blockCells / 64; word++ ) {
+				for ( uint64_t bits = b.occupancy[ word ]; bits != 0; bits &= bits - 1 ) {
+					const uint32_t c = word * 64 + std::countr_zero( bits );
+					func( b.base + ivec3( c % blockSize, ( c / blockSize ) % blockSize, c / ( blockSize * blockSize ) ), uint32_t( b.count[ c ] ) );
+				}
+			}
+		}
+	}
+
+	// same as ForEachCell, but only the cells that have changed since the last call - for writing snapshots as deltas
+	template < typename cellFunc_t >
+	void ForEachChangedCell ( cellFunc_t &&func ) {
+		for ( block_t &b : blocks ) {
+			for ( uint32_t word = 0; word < blockCells / 64; word++ ) {
+				for ( uint64_t bits = b.changed[ word ]; bits != 0; bits &= bits - 1 ) {
+					const uint32_t c = word * 64 + std::countr_zero( bits );
+					func( b.base + ivec3( c % blockSize, ( c / blockSize ) % blockSize, c / ( blockSize * blockSize ) ), uint32_t( b.count[ c ] ) );
+				}
+				b.changed[ word ] = 0;
+			}
+		}
+	}
+
+	sparseParticleGrid () { Clear(); }
+
+private:
+	static constexpr uint64_t emptyKey = ~0ull;
+	std::vector< uint64_t > keys;	// packed block coordinates, linear probing
+	std::vector< uint32_t > values;	// index into blocks
+
+	// the part of the 3x3x3 neighborhood of cell that's inside block b
+	float ClosestInBlock ( const block_t &b, const vec3 &p, const ivec3 &cell ) const {
+		const ivec3 lo = glm::max( cell - 1, b.base ) - b.base;
+		const ivec3 hi = glm::min( cell + 1, b.base + ( blockSize - 1 ) ) - b.base;
+		float closest = std::numeric_limits< float >::max();
+		for ( int z = lo.z; z <= hi.z; z++ ) {
+			for ( int y = lo.y; y <= hi.y; y++ ) {
+				for ( int x = lo.x; x <= hi.x; x++ ) {
+					const uint32_t c = x + blockSize * ( y + blockSize * z );
+					if ( ( ( b.occupancy[ c >> 6 ] >> ( c & 63 ) ) & 1 ) == 0 ) {
+						continue;
+					}
+					for ( uint32_t i = b.head[ c ]; i != none; i = next[ i ] ) {
+						const vec3 d = positions[ i ] - p;
+						closest = std::min( closest, glm::dot( d, d ) );
+					}
+				}
+			}
+		}
+		return closest;
+	}
+
+	static uint32_t LocalIndex ( const ivec3 &cell ) {
+		const ivec3 l = cell & ( blockSize - 1 );
+		return uint32_t( l.x + blockSize * ( l.y + blockSize * l.z ) );
+	}
+
+	// 21 bits per axis is plenty, the walkers don't leave +/-150
+	static uint64_t Key ( const ivec3 &block ) {
+		const uint64_t mask = ( 1ull << 21 ) - 1;
+		return ( uint64_t( block.x ) & mask ) | ( ( uint64_t( block.y ) & mask ) << 21 ) | ( ( uint64_t( block.z ) & mask ) << 42 );
+	}
+
+	static uint64_t Mix ( uint64_t x ) {
+		x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+		x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebull;
+		return x ^ ( x >> 31 );
+	}
+
+	uint32_t FindBlock ( const ivec3 &block ) const {
+		const uint64_t key = Key( block );
+		const size_t mask = keys.size() - 1;
+		for ( size_t slot = Mix( key ) & mask; keys[ slot ] != emptyKey; slot = ( slot + 1 ) & mask ) {
+			if ( keys[ slot ] == key ) {
+				return values[ slot ];
+			}
+		}
+		return none;
+	}
+
+	uint32_t FindOrAddBlock ( const ivec3 &block ) {
+		const uint32_t found = FindBlock( block );
+		if ( found != none ) {
+			return found;
+		}
+		// keep the table under half full, so probe runs stay short
+		if ( ( blocks.size() + 1 ) * 2 > keys.size() ) {
+			Grow();
+		}
+		blocks.emplace_back();
+		blocks.back().base = block << blockBits;
+		Insert( Key( block ), uint32_t( blocks.size() - 1 ) );
+		return uint32_t( blocks.size() - 1 );
+	}
+
+	void Insert ( const uint64_t key, const uint32_t value ) {
+		const size_t mask = keys.size() - 1;
+		size_t slot = Mix( key ) & mask;
+		while ( keys[ slot ] != emptyKey ) {
+			slot = ( slot + 1 ) & mask;
+		}
+		keys[ slot ] = key;
+		values[ slot ] = value;
+	}
+
+	void Grow () {
+		keys.assign( keys.size() * 2, emptyKey );
+		values.assign( keys.size(), none );
+		for ( uint32_t i = 0; i < blocks.size(); i++ ) {
+			Insert( Key( blocks[ i ].base >> blockBits ), i );
+		}
+	}
+};
 
 class DLAModelCPU {
 public:
 	std::vector< vec3 > unanchoredParticles;
-	std::unordered_map< ivec3, std::vector< vec3 > > anchoredParticles; // on a quantized grid
+	sparseParticleGrid anchoredParticles; // on a quantized grid
 
 	float anchorDistance = 0.8f;
-	int threadIDX;
+	float jitter = 5.0f;		// walkers take a uniform random step in [ -jitter, jitter ] on each axis
+	float wind = 1.0f;			// plus this much in +y
+	uint32_t numWalkers = 50000;
+	int threadIDX = 0;
+
+	// progress lines to cout every reportInterval iterations, and a snapshot every snapshotInterval - zero turns either off
+	int reportInterval = 10;
+	int snapshotInterval = 500;
+	string snapshotPath;		// empty picks "Run<threadIDX>_<anchorDistance>.dla"
+
+	// walkers step in parallel, in fixed size chunks that each get their own random stream from ( seed, iteration,
+		// chunk ) - the grid is only read while they move, and the ones that bond are queued up and added after, in
+		// chunk order, so a given seed gives the same aggregate for any thread count
+	uint64_t seed = std::random_device()();
+	uint64_t iteration = 0;
+	static constexpr uint32_t chunkSize = 1024;
+
+	// false steps the chunks inline on the calling thread, for when something else already has the pool busy ( batch
+		// mode runs one model per task ) - waiting on the chunks would let a run pick up a whole other run nested on its
+		// stack. Same chunks and random streams either way, so the aggregate doesn't change
+	bool parallel = true;
+
+	// splitmix64, one per chunk
+	struct walkerRng_t {
+		uint64_t state;
+		uint64_t Next () {
+			uint64_t x = ( state += 0x9e3779b97f4a7c15ull );
+			x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+			x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebull;
+			return x ^ ( x >> 31 );
+		}
+		// uniform in [ lo, hi )
+		float operator () ( const float lo, const float hi ) {
+			return lo + ( hi - lo ) * float( Next() >> 40 ) * ( 1.0f / float( 1ull << 24 ) );
+		}
+	};
 
-	void Respawn ( vec3 &particle ) {
-		static rng placement( -100.0f, 100.0f );
-		particle.x = placement();
-		particle.y = placement();
-		particle.z = placement();
+	void Respawn ( vec3 &particle, walkerRng_t &r ) {
+		particle.x = r( -100.0f, 100.0f );
+		particle.y = r( -100.0f, 100.0f );
+		particle.z = r( -100.0f, 100.0f );
 	}
 
 	void Update () {
-		rng jitter( -5.0f, 5.0f );
-		for ( auto& particle : unanchoredParticles ) {
-			// jitter the particle in a random direction
-			particle.x += jitter();
-			particle.y += jitter();
-			particle.z += jitter();
-
-			// "wind"
-			particle.y += 1.0f;
-
-			// look at the nearby cells to see if there's anyone you might bond to
-			ivec3 quantizedPosition = ivec3( particle );
-
-			float closestDistance = 1000.0f;
-			vec3 closestParticle = vec3( 0.0f );
-
-			for ( int x = -1; x <= 1; x++ ) {
-				for ( int y = -1; y <= 1; y++ ) {
-					for ( int z = -1; z <= 1; z++ ) {
-						for ( auto& otherParticle : anchoredParticles[ quantizedPosition + ivec3( x, y, z ) ] ) {
-							float dCantidate = distance( particle, otherParticle );
-							if ( dCantidate < closestDistance ) {
-								closestDistance = dCantidate;
-								closestParticle = otherParticle;
-							}
-						}
+		const uint32_t numChunks = uint32_t( ( unanchoredParticles.size() + chunkSize - 1 ) / chunkSize );
+		bonded.resize( numChunks );
+		const float anchorDistance2 = anchorDistance * anchorDistance;
+
+		auto stepChunks = [ & ] ( int64_t lo, int64_t hi ) {
+			for ( int64_t chunk = lo; chunk < hi; chunk++ ) {
+				walkerRng_t r { seed ^ ( iteration * 0xd1b54a32d192ed03ull ) ^ ( uint64_t( chunk ) << 40 ) };
+				std::vector< vec3 > &bondedHere = bonded[ chunk ];
+				bondedHere.clear();
+				const size_t end = std::min( unanchoredParticles.size(), size_t( chunk + 1 ) * chunkSize );
+				for ( size_t i = size_t( chunk ) * chunkSize; i < end; i++ ) {
+					vec3 &particle = unanchoredParticles[ i ];
+
+					// jitter the particle in a random direction
+					particle.x += r( -jitter, jitter );
+					particle.y += r( -jitter, jitter );
+					particle.z += r( -jitter, jitter );
+
+					// "wind"
+					particle.y += wind;
+
+					// if there's an anchored particle nearby in bonding distance
+					if ( anchoredParticles.ClosestDistance2( particle, anchorDistance2 ) < anchorDistance2 ) {
+						bondedHere.push_back( particle );
+						Respawn( particle, r );
 					}
-				}
-			}
 
-			// if we found an anchored particle in bonding distance
-			if ( closestDistance < anchorDistance ) {
-				anchoredParticles[ quantizedPosition ].push_back( particle );
-				Respawn( particle );
+					// bounds check and respawn if outside of reasonable volume
+					if ( abs( particle.x ) > 150.0f || abs( particle.y ) > 150.0f || abs( particle.z ) > 150.0f ) {
+						Respawn( particle, r );
+					}
+				}
 			}
+		};
+		if ( parallel ) {
+			jbDE::GetThreadPool().ParallelFor( 0, numChunks, 1, stepChunks );
+		} else {
+			stepChunks( 0, numChunks );
+		}
 
-			// bounds check and respawn if outside of reasonable volume
-			if ( abs( particle.x ) > 150.0f || abs( particle.y ) > 150.0f || abs( particle.y ) > 150.0f ) {
-				Respawn( particle );
+		// commit the new anchors
+		for ( auto &chunk : bonded ) {
+			for ( auto &p : chunk ) {
+				anchoredParticles.Add( p );
 			}
 		}
+		iteration++;
 	}
 
 	void Init () {
+		walkerRng_t r { ~seed };
+		anchoredParticles.Clear();
+		iteration = 0;
+
 		// initialize the list of unanchored particles
-		unanchoredParticles.resize( 50000 );
+		unanchoredParticles.resize( numWalkers );
 		for ( auto& particle : unanchoredParticles ) {
-			Respawn( particle );
+			Respawn( particle, r );
 		}
 
-		// initial anchored particles
-		rng loc( 0.0f, tau );
-		rng jitter( -8, 8 );
+		// initial anchored particles, a maximum of a single particle per cell
 		for ( int i = 0; i < 20000; i++ ) {
-			float locS = loc();
-			vec3 point = vec3( 10.0f * cos( locS ) + jitter() * loc(), 10.0f * sin( locS ) + jitter() * loc(), loc() + jitter() );
-			anchoredParticles[ ivec3( point ) ].push_back( point );
-		}
-
-		// prune to a maximum of a single particle per cell
-		for ( auto& [p, m] : anchoredParticles ) {
-			if ( m.size() != 0 ) {
-				m.resize( 1 );
+			float locS = r( 0.0f, jbDE::tau );
+			vec3 point = vec3( 10.0f * cos( locS ) + r( -8.0f, 8.0f ) * r( 0.0f, jbDE::tau ), 10.0f * sin( locS ) + r( -8.0f, 8.0f ) * r( 0.0f, jbDE::tau ), r( 0.0f, jbDE::tau ) + r( -8.0f, 8.0f ) );
+			if ( anchoredParticles.CellCount( sparseParticleGrid::Cell( point ) ) == 0 ) {
+				anchoredParticles.Add( point );
 			}
 		}
 
-		rng anchorD = rng( 1.0f, 1.9f );
-		anchorDistance = anchorD();
+		anchorDistance = r( 1.0f, 1.9f );
 	}
 
 	int i = 0;
 	void RunBatch ( int iterations ) {
 
 		// run it for some number of iterations
-		ivec3 lastMinTouched = ivec3( 0 );
-		ivec3 lastMaxTouched = ivec3( 0 );
-		int lastMaxCellCount = 0;
-		int n = 0;
+		std::ofstream snapshots;
+		if ( snapshotInterval > 0 ) {
+			OpenSnapshotStream( snapshots );
+		}
 		for ( i = 0; i < iterations; i++ ) {
 
 			// running the sim...
 			Update();
 
-			if ( i % 10 == 0 ) {
-				int totalAnchored = 0;
-				int uniqueCells = 0;
-				int maxCellCount = 0;
-				ivec3 minTouched = ivec3( 0 );
-				ivec3 maxTouched = ivec3( 0 );
-				for ( auto& [p, m] : anchoredParticles ) {
-					if ( m.size() != 0 ) {
-						totalAnchored += m.size();
-						maxCellCount = max( int( m.size() ), maxCellCount );
-						uniqueCells++;
-						minTouched = min( p, minTouched );
-						maxTouched = max( p, maxTouched );
-					}
-				}
-				cout << 100.0f * float( i ) / iterations << "%... Anchored: " << totalAnchored << " Unique: " << uniqueCells << endl;
+			if ( reportInterval > 0 && i % reportInterval == 0 ) {
+				const ivec3 minTouched = anchoredParticles.minTouched;
+				const ivec3 maxTouched = anchoredParticles.maxTouched;
+				cout << 100.0f * float( i ) / iterations << "%... Anchored: " << anchoredParticles.Count() << " Unique: " << anchoredParticles.uniqueCells << endl;
 				cout << "Min " << minTouched.x << " " << minTouched.y << " " << minTouched.z << endl;
 				cout << "Max " << maxTouched.x << " " << maxTouched.y << " " << maxTouched.z << endl;
-				lastMinTouched = minTouched;
-				lastMaxTouched = maxTouched;
-				lastMaxCellCount = maxCellCount;
 			}
 
-
-			if ( i % 500 == 0 ) {
-				// dump 256^3 block model for Voraldo
-				Image_4F blockSave( 256, 256 * 256 );
-				ivec3 centerPoint = ivec3( ( lastMinTouched + lastMaxTouched ) / 2 );
-
-				for ( auto& [p, m] : anchoredParticles ) {
-					if ( m.size() != 0 ) {
-						ivec3 pA = p - centerPoint + ivec3( 127 );
-						blockSave.SetAtXY( pA.x, pA.y + pA.z * 256, color_4F( { 0.618f, 0.618f, 0.618f, std::pow( float( m.size() ) / lastMaxCellCount, 0.3f ) } ) );
-					}
-				}
-
-				blockSave.Save( "Run" + to_string( threadIDX ) + "_DLAStage" + to_string( n++ ) + "_" + to_string( anchorDistance ) + ".png" );
+			// the last iteration always gets one, so the stream ends on the final state
+			if ( snapshotInterval > 0 && ( i % snapshotInterval == 0 || i == iterations - 1 ) ) {
+				WriteSnapshot( snapshots );
 			}
 		}
+	}
 
-		/*
-		// dump 256^3 block model for Voraldo
-		Image_4F blockSave ( 256, 256 * 256 );
-		ivec3 centerPoint = ivec3( ( lastMinTouched + lastMaxTouched ) / 2 );
-
-		for ( auto& [ p, m ] : anchoredParticles ) {
-			if ( m.size() != 0 ) {
-				ivec3 pA = p - centerPoint + ivec3( 127 );
-				blockSave.SetAtXY( pA.x, pA.y + pA.z * 256, color_4F( { 1.0f, 1.0f, 1.0f, 2.0f * float( m.size() ) / lastMaxCellCount } ) );
-			}
-		}
+	// snapshots are a stream of sparse voxel deltas, instead of a dense 256x65536 image per snapshot. All little endian:
+		// header	"DLADELTA", uint32 version, float anchorDistance, float jitter, float wind, uint32 numWalkers, uint64 seed
+		// frames	uint32 iteration, uint32 n, then n records of int16 x, y, z, uint16 count
+		// a record is the new particle count of a cell that changed since the frame before, the first frame has every
+		// occupied cell, so replaying the frames in order with "cell = count" rebuilds the aggregate at any snapshot
+	static constexpr uint32_t snapshotVersion = 1;
+
+	struct snapshotRecord_t {
+		int16_t x, y, z;
+		uint16_t count;
+	};
+
+	void OpenSnapshotStream ( std::ofstream &out ) {
+		const string path = snapshotPath.empty() ? "Run" + to_string( threadIDX ) + "_" + to_string( anchorDistance ) + ".dla" : snapshotPath;
+		out.open( path, std::ios::binary | std::ios::trunc );
+		out.write( "DLADELTA", 8 );
+		out.write( ( const char * ) &snapshotVersion, sizeof( snapshotVersion ) );
+		out.write( ( const char * ) &anchorDistance, sizeof( anchorDistance ) );
+		out.write( ( const char * ) &jitter, sizeof( jitter ) );
+		out.write( ( const char * ) &wind, sizeof( wind ) );
+		out.write( ( const char * ) &numWalkers, sizeof( numWalkers ) );
+		out.write( ( const char * ) &seed, sizeof( seed ) );
+		out.flush();
+	}
 
-		blockSave.Save( "Test.png" );
-		*/
+	void WriteSnapshot ( std::ofstream &out ) {
+		std::vector< snapshotRecord_t > records;
+		anchoredParticles.ForEachChangedCell( [ & ] ( ivec3 p, uint32_t count ) {
+			// walkers respawn past +/-150, so the aggregate stays well inside int16
+			records.push_back( { int16_t( p.x ), int16_t( p.y ), int16_t( p.z ), uint16_t( count ) } );
+		} );
+		const uint32_t header[ 2 ] = { uint32_t( iteration ), uint32_t( records.size() ) };
+		out.write( ( const char * ) header, sizeof( header ) );
+		out.write( ( const char * ) records.data(), records.size() * sizeof( snapshotRecord_t ) );
+		out.flush(); // overnight runs - whatever made it to disk is usable if one dies partway
 	}
 
 	~DLAModelCPU() {};
 	DLAModelCPU () {};
+
+private:
+	std::vector< std::vector< vec3 > > bonded; // per chunk, waiting to be added to the grid
 };
 
 class DLAModelGPU {
@@ -190,7 +434,7 @@ public:
 	void ResetField () {
 		// 3D uint texture for DLA deposition
 		Image_4U DLABuffer( blockDim, blockDim * blockDim );
-		rng pick( 0, tau );
+		rng pick( 0, jbDE::tau );
 		for ( int i = 0; i < 500; i++ ) {
 			// make sure that there's at least a couple seed texels
 			// DLABuffer.SetAtXY( texelPick(), texelPick() + texelPick() * blockDim, color_4U( { 1, 0, 0, 0 } ) );
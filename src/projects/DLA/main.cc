@@ -18,28 +18,6 @@ public:
 		{
 			Block Start( "Additional User Init" );
 
-			// something to put some basic data in the accumulator texture
-
-			/*
-			const int numThreads = 4;
-			std::thread threads[ numThreads ]; // create thread pool
-			for ( int id = 0; id < numThreads; id++ ) { // do work
-				threads[ id ] = std::thread(
-					[ this, id ]() {
-
-						DLAModelCPU d;
-						d.Init();
-						d.threadIDX = id;
-						d.RunBatch( 10000 );
-
-					}
-				);
-			}
-
-			for ( int id = 0; id <= numThreads; id++ )
-				threads[ id ].join();
-			*/
-
 			d.textureManager = &textureManager;
 			d.Init();
 			d.Run( 100 );
@@ -207,7 +185,104 @@ public:
 	}
 };
 
+// headless batch mode - independent DLAModelCPU runs on the thread pool, with parameters swept across the runs. Each
+	// parameter is either a single value, or lo:hi to spread it evenly from lo on the first run to hi on the last, e.g.
+	//   DLA --batch runs=16 iterations=20000 anchorDistance=1.0:1.9 wind=0:2 out=sweep
+	// every run streams its snapshots to <out>/Run<n>.dla, see DLAModelCPU::WriteSnapshot for the format
+int DLABatch ( int argc, char *argv[] ) {
+	struct param_t { float lo, hi; };
+	unordered_map< string, param_t > params = {
+		{ "runs", { 8, 8 } },
+		{ "iterations", { 10000, 10000 } },
+		{ "anchorDistance", { 1.0f, 1.9f } },
+		{ "jitter", { 5.0f, 5.0f } },
+		{ "wind", { 1.0f, 1.0f } },
+		{ "walkers", { 50000, 50000 } },
+		{ "snapshot", { 500, 500 } }
+	};
+	string outputDir = "DLABatch";
+	bool seeded = false;
+	uint64_t baseSeed = 0;
+
+	auto Usage = [] ( const string &arg ) {
+		cerr << "DLA batch: didn't understand \"" << arg << "\"" << endl;
+		cerr << "  usage: DLA --batch [runs=N] [iterations=N] [anchorDistance=v|lo:hi] [jitter=v|lo:hi] [wind=v|lo:hi] [walkers=v|lo:hi] [snapshot=N] [seed=N] [out=dir]" << endl;
+		return 1;
+	};
+	for ( int a = 0; a < argc; a++ ) {
+		const string arg = argv[ a ];
+		const size_t equals = arg.find( '=' );
+		const string key = arg.substr( 0, equals );
+		const string value = ( equals == string::npos ) ? "" : arg.substr( equals + 1 );
+		try { // stoull / stof throw on values that aren't numbers, or are out of range
+			if ( key == "out" ) {
+				outputDir = value;
+			} else if ( key == "seed" ) {
+				seeded = true;
+				baseSeed = std::stoull( value );
+			} else if ( params.count( key ) != 0 && !value.empty() ) {
+				const size_t colon = value.find( ':' );
+				params[ key ].lo = std::stof( value.substr( 0, colon ) );
+				params[ key ].hi = ( colon == string::npos ) ? params[ key ].lo : std::stof( value.substr( colon + 1 ) );
+			} else {
+				return Usage( arg );
+			}
+		} catch ( const std::exception & ) {
+			return Usage( arg );
+		}
+	}
+
+	const int runs = std::max( 1, int( params[ "runs" ].lo ) );
+	const int iterations = std::max( 1, int( params[ "iterations" ].lo ) );
+	// value of a parameter for a given run
+	auto Sweep = [ & ] ( const string &key, const int run ) {
+		const param_t &p = params[ key ];
+		return ( runs == 1 ) ? p.lo : p.lo + ( p.hi - p.lo ) * float( run ) / float( runs - 1 );
+	};
+
+	std::filesystem::create_directories( outputDir );
+	std::mutex coutLock;
+	const auto tStart = std::chrono::steady_clock::now();
+
+	// each run is a task - once there are enough of them to keep every pool thread busy, the runs step their walkers
+		// inline rather than splitting them up on the pool again, see DLAModelCPU::parallel
+	threadPool &pool = jbDE::GetThreadPool();
+	const bool parallelRuns = uint32_t( runs ) < pool.NumThreads();
+	threadPool::taskGroup group;
+	for ( int run = 0; run < runs; run++ ) {
+		pool.Submit( [ &, run ] () {
+			DLAModelCPU d;
+			if ( seeded ) {
+				d.seed = baseSeed + run;
+			}
+			d.numWalkers = uint32_t( std::max( 1.0f, std::round( Sweep( "walkers", run ) ) ) );
+			d.Init();
+			d.anchorDistance = Sweep( "anchorDistance", run );
+			d.jitter = Sweep( "jitter", run );
+			d.wind = Sweep( "wind", run );
+			d.threadIDX = run;
+			d.parallel = parallelRuns;
+			d.reportInterval = 0; // runs would interleave their lines
+			d.snapshotInterval = int( params[ "snapshot" ].lo );
+			d.snapshotPath = outputDir + "/Run" + to_string( run ) + ".dla";
+			d.RunBatch( iterations );
+
+			std::lock_guard< std::mutex > lock( coutLock );
+			cout << "Run " << run << " finished - anchorDistance " << d.anchorDistance << " jitter " << d.jitter << " wind " << d.wind << " walkers " << d.numWalkers
+				<< " seed " << d.seed << " anchored " << d.anchoredParticles.Count() << " unique cells " << d.anchoredParticles.uniqueCells << endl;
+		}, &group );
+	}
+	pool.Wait( group );
+
+	cout << runs << " runs of " << iterations << " iterations in " << std::chrono::duration< float >( std::chrono::steady_clock::now() - tStart ).count() << "s" << endl;
+	return 0;
+}
+
 int main ( int argc, char *argv[] ) {
+	if ( argc > 1 && string( argv[ 1 ] ) == "--batch" ) {
+		return DLABatch( argc - 2, argv + 2 );
+	}
+
 	DLA engineInstance;
 	while( !engineInstance.MainLoop() );
 	return 0;
@@ -410,8 +410,9 @@ void APIGeometryContainer::Initialize () {
 			// linearize the data - all textures are 2048 by 2048
 			std::vector< uint8_t > arrayTextureData;
 			for ( uint32_t i = 0; i < s.texSet.size(); i++ ) {
-				for ( uint32_t o = 0; o < s.texSet[ i ].Height() * s.texSet[ i ].Width() * 4; o++ ) {
-					arrayTextureData.push_back( s.texSet[ i ].GetImageDataBasePtr()[ o ] );
+				const Image_4U rowMajor = s.texSet[ i ].ToRowMajor(); // SoftRast keeps them tiled
+				for ( uint32_t o = 0; o < rowMajor.Height() * rowMajor.Width() * 4; o++ ) {
+					arrayTextureData.push_back( rowMajor.GetImageDataBasePtr()[ o ] );
 				}
 			}
 
@@ -1,4 +1,11 @@
 #include "../../../engine/includes.h"
+#include <bit>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+	// wide node and triangle tests go four lanes at a time through SSE2
+	#define BVH_SSE2
+	#include <emmintrin.h>
+#endif
 
 // drawing heavily from:
 // https://jacco.ompf2.com/2022/04/13/how-to-build-a-bvh-part-1-basics/
@@ -13,6 +20,7 @@ struct ray_t {
 	float distance = MAX_DISTANCE;
 	vec2 uv = vec2( -1.0f );
 	uint32_t triangleIdx;
+	uint32_t instanceIdx = 0; // which instance was hit, when tracing against a tlas_t
 };
 
 // triangle data class
@@ -71,6 +79,16 @@ struct aabb_t {
 		maxs.z = std::max( maxs.z, p.z );
 	}
 
+	// union with another box - an empty box ( still at the initial values ) doesn't change anything
+	void growToInclude ( const aabb_t &other ) {
+		mins.x = std::min( mins.x, other.mins.x );
+		mins.y = std::min( mins.y, other.mins.y );
+		mins.z = std::min( mins.z, other.mins.z );
+		maxs.x = std::max( maxs.x, other.maxs.x );
+		maxs.y = std::max( maxs.y, other.maxs.y );
+		maxs.z = std::max( maxs.z, other.maxs.z );
+	}
+
 	// get the surface area ( is this half the surface area? seems like maybe... )
 	float area () {
 		vec3 e = maxs - mins; // box extent
@@ -133,6 +151,382 @@ struct bin_t {
 	int primitiveCount = 0;
 };
 
+// a bundle of coherent rays, traced together - 16 is one 4x4 tile of primary rays
+struct rayPacket_t {
+	static constexpr int SIZE = 16;
+	ray_t rays[ SIZE ];
+};
+
+// compact intersection-only triangle data, SoA, in the order of the bvh's triangleIndices so that every leaf is a
+	// contiguous range - vertex0 and the two edges are all Moller-Trumbore needs, plus the index back into triangleList
+struct compactTriangles_t {
+	std::vector< float > v0x, v0y, v0z;
+	std::vector< float > e1x, e1y, e1z;
+	std::vector< float > e2x, e2y, e2z;
+	std::vector< uint32_t > idx;
+
+	// the float arrays, in the order they get written to the bvh cache
+	std::array< std::vector< float > *, 9 > FloatArrays () {
+		return { &v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z };
+	}
+
+	void Build ( const std::vector< triangle_t > &triangleList, const std::vector< uint32_t > &triangleIndices ) {
+		const size_t count = triangleIndices.size();
+		for ( auto *v : FloatArrays() ) {
+			v->resize( count );
+		}
+		idx.resize( count );
+		for ( size_t i = 0; i < count; i++ ) {
+			const triangle_t &triangle = triangleList[ triangleIndices[ i ] ];
+			const vec3 edge1 = triangle.vertex1 - triangle.vertex0;
+			const vec3 edge2 = triangle.vertex2 - triangle.vertex0;
+			v0x[ i ] = triangle.vertex0.x; v0y[ i ] = triangle.vertex0.y; v0z[ i ] = triangle.vertex0.z;
+			e1x[ i ] = edge1.x; e1y[ i ] = edge1.y; e1z[ i ] = edge1.z;
+			e2x[ i ] = edge2.x; e2y[ i ] = edge2.y; e2z[ i ] = edge2.z;
+			idx[ i ] = triangle.idx;
+		}
+	}
+
+	// single ray against triangles [ first, first + count ), same math and epsilons as triangle_t::intersect
+	void Intersect ( ray_t &ray, const uint32_t first, const uint32_t count ) const {
+	#ifdef BVH_SSE2
+		const __m128 dx = _mm_set1_ps( ray.direction.x ), dy = _mm_set1_ps( ray.direction.y ), dz = _mm_set1_ps( ray.direction.z );
+		const __m128 ox = _mm_set1_ps( ray.origin.x ), oy = _mm_set1_ps( ray.origin.y ), oz = _mm_set1_ps( ray.origin.z );
+		for ( uint32_t base = first; base < first + count; base += 4 ) {
+			// lanes past the end of the leaf are masked off, and the loads for them are kept inside the arrays
+			const uint32_t lanes = std::min( 4u, first + count - base );
+			auto load = [ base, lanes ] ( const std::vector< float > &source ) {
+				if ( lanes == 4 ) {
+					return _mm_loadu_ps( source.data() + base );
+				}
+				alignas( 16 ) float partial[ 4 ] = {};
+				for ( uint32_t l = 0; l < lanes; l++ ) {
+					partial[ l ] = source[ base + l ];
+				}
+				return _mm_load_ps( partial );
+			};
+			const __m128 laneValid = _mm_cmplt_ps( _mm_setr_ps( 0.0f, 1.0f, 2.0f, 3.0f ), _mm_set1_ps( float( lanes ) ) );
+			__m128 t, u, v;
+			const __m128 hit = _mm_and_ps( laneValid, IntersectLanes( ox, oy, oz, dx, dy, dz, _mm_set1_ps( ray.distance ),
+				load( v0x ), load( v0y ), load( v0z ), load( e1x ), load( e1y ), load( e1z ), load( e2x ), load( e2y ), load( e2z ), t, u, v ) );
+
+			const int mask = _mm_movemask_ps( hit );
+			if ( mask != 0 ) {
+				// nearest lane wins, and the later lane on a tie, same as testing them one after another
+				alignas( 16 ) float tLanes[ 4 ], uLanes[ 4 ], vLanes[ 4 ];
+				_mm_store_ps( tLanes, t ); _mm_store_ps( uLanes, u ); _mm_store_ps( vLanes, v );
+				for ( int l = 0; l < 4; l++ ) {
+					if ( ( mask & ( 1 << l ) ) && tLanes[ l ] <= ray.distance ) {
+						ray.distance = tLanes[ l ];
+						ray.uv = vec2( uLanes[ l ], vLanes[ l ] );
+						ray.triangleIdx = idx[ base + l ];
+					}
+				}
+			}
+		}
+	#else
+		for ( uint32_t i = first; i < first + count; i++ ) {
+			float t, u, v;
+			if ( IntersectOne( ray.origin, ray.direction, ray.distance, i, t, u, v ) ) {
+				ray.distance = t;
+				ray.uv = vec2( u, v );
+				ray.triangleIdx = idx[ i ];
+			}
+		}
+	#endif
+	}
+
+	// scalar reference for one triangle, true on a hit that's no further than tMax
+	bool IntersectOne ( const vec3 origin, const vec3 direction, const float tMax, const uint32_t i, float &t, float &u, float &v ) const {
+		const vec3 edge1 = vec3( e1x[ i ], e1y[ i ], e1z[ i ] );
+		const vec3 edge2 = vec3( e2x[ i ], e2y[ i ], e2z[ i ] );
+		const vec3 h = cross( direction, edge2 );
+		const float a = dot( edge1, h );
+		if ( a > -0.0001f && a < 0.0001f ) return false; // ray parallel to triangle
+		const float f = 1.0f / a;
+		const vec3 s = origin - vec3( v0x[ i ], v0y[ i ], v0z[ i ] );
+		u = f * dot( s, h );
+		if ( u < 0.0f || u > 1.0f ) return false;
+		const vec3 q = cross( s, edge1 );
+		v = f * dot( direction, q );
+		if ( v < 0.0f || u + v > 1.0f ) return false;
+		t = f * dot( edge2, q );
+		return t > 0.0001f && t <= tMax;
+	}
+
+#ifdef BVH_SSE2
+	// four Moller-Trumbore tests at once - either four triangles against one ray, or one triangle against four rays,
+		// depending on what gets broadcast. Operation order follows glm's cross and dot, so it matches the scalar version
+	static inline __m128 IntersectLanes ( const __m128 ox, const __m128 oy, const __m128 oz, const __m128 dx, const __m128 dy, const __m128 dz, const __m128 tMax,
+		const __m128 v0x, const __m128 v0y, const __m128 v0z, const __m128 e1x, const __m128 e1y, const __m128 e1z,
+		const __m128 e2x, const __m128 e2y, const __m128 e2z, __m128 &t, __m128 &u, __m128 &v ) {
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps( 1.0f ), epsilon = _mm_set1_ps( 0.0001f );
+		const __m128 hx = _mm_sub_ps( _mm_mul_ps( dy, e2z ), _mm_mul_ps( e2y, dz ) );
+		const __m128 hy = _mm_sub_ps( _mm_mul_ps( dz, e2x ), _mm_mul_ps( e2z, dx ) );
+		const __m128 hz = _mm_sub_ps( _mm_mul_ps( dx, e2y ), _mm_mul_ps( e2x, dy ) );
+		const __m128 a = _mm_add_ps( _mm_add_ps( _mm_mul_ps( e1x, hx ), _mm_mul_ps( e1y, hy ) ), _mm_mul_ps( e1z, hz ) );
+		__m128 valid = _mm_andnot_ps( _mm_and_ps( _mm_cmpgt_ps( a, _mm_sub_ps( zero, epsilon ) ), _mm_cmplt_ps( a, epsilon ) ), _mm_castsi128_ps( _mm_set1_epi32( -1 ) ) );
+		const __m128 f = _mm_div_ps( one, a );
+		const __m128 sx = _mm_sub_ps( ox, v0x ), sy = _mm_sub_ps( oy, v0y ), sz = _mm_sub_ps( oz, v0z );
+		u = _mm_mul_ps( f, _mm_add_ps( _mm_add_ps( _mm_mul_ps( sx, hx ), _mm_mul_ps( sy, hy ) ), _mm_mul_ps( sz, hz ) ) );
+		valid = _mm_andnot_ps( _mm_or_ps( _mm_cmplt_ps( u, zero ), _mm_cmpgt_ps( u, one ) ), valid );
+		const __m128 qx = _mm_sub_ps( _mm_mul_ps( sy, e1z ), _mm_mul_ps( e1y, sz ) );
+		const __m128 qy = _mm_sub_ps( _mm_mul_ps( sz, e1x ), _mm_mul_ps( e1z, sx ) );
+		const __m128 qz = _mm_sub_ps( _mm_mul_ps( sx, e1y ), _mm_mul_ps( e1x, sy ) );
+		v = _mm_mul_ps( f, _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, qx ), _mm_mul_ps( dy, qy ) ), _mm_mul_ps( dz, qz ) ) );
+		valid = _mm_andnot_ps( _mm_or_ps( _mm_cmplt_ps( v, zero ), _mm_cmpgt_ps( _mm_add_ps( u, v ), one ) ), valid );
+		t = _mm_mul_ps( f, _mm_add_ps( _mm_add_ps( _mm_mul_ps( e2x, qx ), _mm_mul_ps( e2y, qy ) ), _mm_mul_ps( e2z, qz ) ) );
+		return _mm_and_ps( valid, _mm_and_ps( _mm_cmpgt_ps( t, epsilon ), _mm_cmple_ps( t, tMax ) ) );
+	}
+#endif
+};
+
+// wide bvh node - the bounds of all the children are stored SoA, so one node tests every child at once
+template < int WIDTH >
+struct alignas( 16 ) wideNode_t {
+	static constexpr uint32_t EMPTY = 0xFFFFFFFFu;
+
+	float minX[ WIDTH ], minY[ WIDTH ], minZ[ WIDTH ];
+	float maxX[ WIDTH ], maxY[ WIDTH ], maxZ[ WIDTH ];
+	uint32_t child[ WIDTH ];	// interior children: wide node index, leaves: first triangle in the compact triangle list
+	uint32_t count[ WIDTH ];	// leaves: triangle count, interior children: 0, unused slots: EMPTY
+};
+
+// 4 or 8 wide bvh, collapsed from the binary tree
+template < int WIDTH >
+struct wideBVH_t {
+	static_assert( WIDTH == 4 || WIDTH == 8, "wide bvh is 4 or 8 wide" );
+	using node_t = wideNode_t< WIDTH >;
+	std::vector< node_t > nodes;
+
+	// repeatedly open up the largest interior child until the node is full, so the big boxes get tested together
+	void Collapse ( std::vector< bvhNode_t > &binaryNodes, const uint32_t rootNodeIdx ) {
+		nodes.resize( 0 );
+		CollapseNode( binaryNodes, rootNodeIdx );
+	}
+
+	uint32_t CollapseNode ( std::vector< bvhNode_t > &binaryNodes, const uint32_t binaryIdx ) {
+		const uint32_t wideIdx = nodes.size();
+		nodes.emplace_back();
+
+		uint32_t candidates[ WIDTH ];
+		int numCandidates = 0;
+		if ( binaryNodes[ binaryIdx ].isLeaf() ) {
+			candidates[ numCandidates++ ] = binaryIdx; // only happens at the root, for tiny models
+		} else {
+			candidates[ numCandidates++ ] = binaryNodes[ binaryIdx ].leftChild;
+			candidates[ numCandidates++ ] = binaryNodes[ binaryIdx ].leftChild + 1;
+		}
+
+		while ( numCandidates < WIDTH ) {
+			int largest = -1;
+			float largestArea = -1.0f;
+			for ( int i = 0; i < numCandidates; i++ ) {
+				bvhNode_t &candidate = binaryNodes[ candidates[ i ] ];
+				if ( !candidate.isLeaf() ) {
+					const vec3 e = candidate.aabbMax - candidate.aabbMin;
+					const float area = e.x * e.y + e.y * e.z + e.z * e.x;
+					if ( area > largestArea ) {
+						largest = i;
+						largestArea = area;
+					}
+				}
+			}
+			if ( largest == -1 ) break; // nothing left to open up
+			const uint32_t opened = candidates[ largest ];
+			candidates[ largest ] = binaryNodes[ opened ].leftChild;
+			candidates[ numCandidates++ ] = binaryNodes[ opened ].leftChild + 1;
+		}
+
+		for ( int i = 0; i < WIDTH; i++ ) {
+			// recursion grows the node list, so no holding references into it across this
+			uint32_t child = 0, count = node_t::EMPTY;
+			vec3 mins = vec3( 1e30f ), maxs = vec3( -1e30f );
+			if ( i < numCandidates ) {
+				bvhNode_t &candidate = binaryNodes[ candidates[ i ] ];
+				mins = candidate.aabbMin;
+				maxs = candidate.aabbMax;
+				if ( candidate.isLeaf() ) {
+					child = candidate.leftChild;
+					count = candidate.primitiveCount;
+				} else {
+					child = CollapseNode( binaryNodes, candidates[ i ] );
+					count = 0;
+				}
+			}
+			node_t &node = nodes[ wideIdx ];
+			node.minX[ i ] = mins.x; node.minY[ i ] = mins.y; node.minZ[ i ] = mins.z;
+			node.maxX[ i ] = maxs.x; node.maxY[ i ] = maxs.y; node.maxZ[ i ] = maxs.z;
+			node.child[ i ] = child;
+			node.count[ i ] = count;
+		}
+		return wideIdx;
+	}
+
+	struct stackEntry_t {
+		float t;
+		uint32_t child;
+		uint32_t count;
+	};
+
+	// slab test of one ray against all the children of a node, entry distances out, hit mask returned
+	int IntersectChildren ( const node_t &node, const vec3 origin, const vec3 inverseDirection, const float tMax, float tEnter[ WIDTH ] ) const {
+		// near and far planes picked by the sign of the direction, so unused slots ( inverted boxes ) never hit
+		const float *nearX = ( inverseDirection.x >= 0.0f ) ? node.minX : node.maxX, *farX = ( inverseDirection.x >= 0.0f ) ? node.maxX : node.minX;
+		const float *nearY = ( inverseDirection.y >= 0.0f ) ? node.minY : node.maxY, *farY = ( inverseDirection.y >= 0.0f ) ? node.maxY : node.minY;
+		const float *nearZ = ( inverseDirection.z >= 0.0f ) ? node.minZ : node.maxZ, *farZ = ( inverseDirection.z >= 0.0f ) ? node.maxZ : node.minZ;
+		int mask = 0;
+	#ifdef BVH_SSE2
+		const __m128 ox = _mm_set1_ps( origin.x ), oy = _mm_set1_ps( origin.y ), oz = _mm_set1_ps( origin.z );
+		const __m128 ix = _mm_set1_ps( inverseDirection.x ), iy = _mm_set1_ps( inverseDirection.y ), iz = _mm_set1_ps( inverseDirection.z );
+		for ( int g = 0; g < WIDTH; g += 4 ) {
+			const __m128 tNear = _mm_max_ps( _mm_max_ps(
+				_mm_mul_ps( _mm_sub_ps( _mm_load_ps( nearX + g ), ox ), ix ),
+				_mm_mul_ps( _mm_sub_ps( _mm_load_ps( nearY + g ), oy ), iy ) ),
+				_mm_mul_ps( _mm_sub_ps( _mm_load_ps( nearZ + g ), oz ), iz ) );
+			const __m128 tFar = _mm_min_ps( _mm_min_ps(
+				_mm_mul_ps( _mm_sub_ps( _mm_load_ps( farX + g ), ox ), ix ),
+				_mm_mul_ps( _mm_sub_ps( _mm_load_ps( farY + g ), oy ), iy ) ),
+				_mm_mul_ps( _mm_sub_ps( _mm_load_ps( farZ + g ), oz ), iz ) );
+			const __m128 hit = _mm_and_ps( _mm_cmpge_ps( tFar, tNear ), _mm_and_ps( _mm_cmplt_ps( tNear, _mm_set1_ps( tMax ) ), _mm_cmpgt_ps( tFar, _mm_setzero_ps() ) ) );
+			_mm_storeu_ps( tEnter + g, tNear );
+			mask |= _mm_movemask_ps( hit ) << g;
+		}
+	#else
+		for ( int i = 0; i < WIDTH; i++ ) {
+			const float tNear = std::max( std::max( ( nearX[ i ] - origin.x ) * inverseDirection.x, ( nearY[ i ] - origin.y ) * inverseDirection.y ), ( nearZ[ i ] - origin.z ) * inverseDirection.z );
+			const float tFar = std::min( std::min( ( farX[ i ] - origin.x ) * inverseDirection.x, ( farY[ i ] - origin.y ) * inverseDirection.y ), ( farZ[ i ] - origin.z ) * inverseDirection.z );
+			tEnter[ i ] = tNear;
+			if ( tFar >= tNear && tNear < tMax && tFar > 0.0f ) {
+				mask |= 1 << i;
+			}
+		}
+	#endif
+		return mask;
+	}
+
+	// push the hit children so that the nearest one comes off the stack first
+	static inline void PushSorted ( const node_t &node, int mask, const float tEnter[ WIDTH ], stackEntry_t *stack, uint32_t &stackPtr ) {
+		stackEntry_t hits[ WIDTH ];
+		int numHits = 0;
+		for ( ; mask != 0; mask &= mask - 1 ) {
+			const int i = std::countr_zero( uint32_t( mask ) );
+			stackEntry_t entry = { tEnter[ i ], node.child[ i ], node.count[ i ] };
+			int j = numHits++;
+			for ( ; j > 0 && hits[ j - 1 ].t < entry.t; j-- ) { // descending by distance
+				hits[ j ] = hits[ j - 1 ];
+			}
+			hits[ j ] = entry;
+		}
+		for ( int i = 0; i < numHits; i++ ) {
+			stack[ stackPtr++ ] = hits[ i ];
+		}
+	}
+
+	static constexpr uint32_t STACK_SIZE = 64 * ( WIDTH - 1 ) + 1;
+	void Intersect ( ray_t &ray, const compactTriangles_t &triangles ) const {
+		const vec3 inverseDirection = 1.0f / ray.direction;
+		stackEntry_t stack[ STACK_SIZE ];
+		uint32_t stackPtr = 0;
+		stack[ stackPtr++ ] = { 0.0f, 0, 0 };
+		while ( stackPtr != 0 ) {
+			const stackEntry_t entry = stack[ --stackPtr ];
+			if ( entry.t >= ray.distance ) continue; // something nearer was already hit
+			if ( entry.count != 0 ) {
+				triangles.Intersect( ray, entry.child, entry.count );
+				continue;
+			}
+			const node_t &node = nodes[ entry.child ];
+			float tEnter[ WIDTH ];
+			const int mask = IntersectChildren( node, ray.origin, inverseDirection, ray.distance, tEnter );
+			PushSorted( node, mask, tEnter, stack, stackPtr );
+		}
+	}
+
+	// packet traversal - a node is opened if any ray in the packet hits it, and then the leaf tests run one triangle
+		// against four rays at a time. Works for any set of rays, but it only pays off when they take similar paths
+	void Intersect ( rayPacket_t &packet, const compactTriangles_t &triangles ) const {
+		constexpr int N = rayPacket_t::SIZE;
+		alignas( 16 ) float ox[ N ], oy[ N ], oz[ N ], dx[ N ], dy[ N ], dz[ N ], ix[ N ], iy[ N ], iz[ N ], tMax[ N ], u[ N ], v[ N ];
+		alignas( 16 ) uint32_t hitIdx[ N ];
+		for ( int r = 0; r < N; r++ ) {
+			const ray_t &ray = packet.rays[ r ];
+			ox[ r ] = ray.origin.x; oy[ r ] = ray.origin.y; oz[ r ] = ray.origin.z;
+			dx[ r ] = ray.direction.x; dy[ r ] = ray.direction.y; dz[ r ] = ray.direction.z;
+			ix[ r ] = 1.0f / ray.direction.x; iy[ r ] = 1.0f / ray.direction.y; iz[ r ] = 1.0f / ray.direction.z;
+			tMax[ r ] = ray.distance; u[ r ] = ray.uv.x; v[ r ] = ray.uv.y; hitIdx[ r ] = ray.triangleIdx;
+		}
+
+		stackEntry_t stack[ STACK_SIZE ];
+		uint32_t stackPtr = 0;
+		stack[ stackPtr++ ] = { 0.0f, 0, 0 };
+		while ( stackPtr != 0 ) {
+			const stackEntry_t entry = stack[ --stackPtr ];
+			float farthest = tMax[ 0 ];
+			for ( int r = 1; r < N; r++ ) {
+				farthest = std::max( farthest, tMax[ r ] );
+			}
+			if ( entry.t >= farthest ) continue; // every ray in the packet already hit something nearer
+
+			if ( entry.count != 0 ) {
+				for ( uint32_t i = entry.child; i < entry.child + entry.count; i++ ) {
+				#ifdef BVH_SSE2
+					const __m128 v0x = _mm_set1_ps( triangles.v0x[ i ] ), v0y = _mm_set1_ps( triangles.v0y[ i ] ), v0z = _mm_set1_ps( triangles.v0z[ i ] );
+					const __m128 e1x = _mm_set1_ps( triangles.e1x[ i ] ), e1y = _mm_set1_ps( triangles.e1y[ i ] ), e1z = _mm_set1_ps( triangles.e1z[ i ] );
+					const __m128 e2x = _mm_set1_ps( triangles.e2x[ i ] ), e2y = _mm_set1_ps( triangles.e2y[ i ] ), e2z = _mm_set1_ps( triangles.e2z[ i ] );
+					const __m128i idx = _mm_set1_epi32( int( triangles.idx[ i ] ) );
+					for ( int r = 0; r < N; r += 4 ) {
+						__m128 t, uHit, vHit;
+						const __m128 hit = compactTriangles_t::IntersectLanes( _mm_load_ps( ox + r ), _mm_load_ps( oy + r ), _mm_load_ps( oz + r ),
+							_mm_load_ps( dx + r ), _mm_load_ps( dy + r ), _mm_load_ps( dz + r ), _mm_load_ps( tMax + r ),
+							v0x, v0y, v0z, e1x, e1y, e1z, e2x, e2y, e2z, t, uHit, vHit );
+						if ( _mm_movemask_ps( hit ) == 0 ) continue;
+						auto select = [ &hit ] ( __m128 a, __m128 b ) { return _mm_or_ps( _mm_and_ps( hit, a ), _mm_andnot_ps( hit, b ) ); };
+						_mm_store_ps( tMax + r, select( t, _mm_load_ps( tMax + r ) ) );
+						_mm_store_ps( u + r, select( uHit, _mm_load_ps( u + r ) ) );
+						_mm_store_ps( v + r, select( vHit, _mm_load_ps( v + r ) ) );
+						_mm_store_si128( ( __m128i * ) ( hitIdx + r ), _mm_castps_si128( select( _mm_castsi128_ps( idx ), _mm_castsi128_ps( _mm_load_si128( ( const __m128i * ) ( hitIdx + r ) ) ) ) ) );
+					}
+				#else
+					for ( int r = 0; r < N; r++ ) {
+						float t, uHit, vHit;
+						if ( triangles.IntersectOne( vec3( ox[ r ], oy[ r ], oz[ r ] ), vec3( dx[ r ], dy[ r ], dz[ r ] ), tMax[ r ], i, t, uHit, vHit ) ) {
+							tMax[ r ] = t; u[ r ] = uHit; v[ r ] = vHit; hitIdx[ r ] = triangles.idx[ i ];
+						}
+					}
+				#endif
+				}
+				continue;
+			}
+
+			// open the node for the whole packet, ordered by the nearest entry of any ray
+			const node_t &node = nodes[ entry.child ];
+			int packetMask = 0;
+			float packetEnter[ WIDTH ];
+			for ( int i = 0; i < WIDTH; i++ ) {
+				packetEnter[ i ] = 1e30f;
+			}
+			for ( int r = 0; r < N; r++ ) {
+				float tEnter[ WIDTH ];
+				const int mask = IntersectChildren( node, vec3( ox[ r ], oy[ r ], oz[ r ] ), vec3( ix[ r ], iy[ r ], iz[ r ] ), tMax[ r ], tEnter );
+				for ( int m = mask; m != 0; m &= m - 1 ) {
+					const int i = std::countr_zero( uint32_t( m ) );
+					packetEnter[ i ] = std::min( packetEnter[ i ], tEnter[ i ] );
+				}
+				packetMask |= mask;
+			}
+			PushSorted( node, packetMask, packetEnter, stack, stackPtr );
+		}
+
+		for ( int r = 0; r < N; r++ ) {
+			ray_t &ray = packet.rays[ r ];
+			ray.distance = tMax[ r ];
+			ray.uv = vec2( u[ r ], v[ r ] );
+			ray.triangleIdx = hitIdx[ r ];
+		}
+	}
+};
+
 // top level bvh class
 struct bvh_t {
 	std::vector< triangle_t > triangleList;
@@ -154,8 +548,9 @@ struct bvh_t {
 
 	// load model triangles
 	SoftRast s;
+	string modelPath = "../../SponzaRepack/sponza.obj";
 	aabb_t Load () {
-		s.LoadModel( "../../SponzaRepack/sponza.obj", "../../SponzaRepack/" );
+		s.LoadModel( modelPath, "../../SponzaRepack/" );
 		// s.LoadModel( "../San_Miguel/san-miguel-low-poly.obj", "../San_Miguel/" );
 		// s.LoadModel( "../birdOfPrey/birdOfPrey.obj", "../birdOfPrey/textures/" );
 
@@ -198,65 +593,126 @@ struct bvh_t {
 		return modelbbox;
 	}
 
-	void UpdateNodeBounds ( uint32_t nodeIndex ) {
-		// calculate the bounds for a BVH node, based on contained primitives
-		bvhNode_t &node = bvhNodes[ nodeIndex ];
+	// bounds of the primitives in [ first, first + count ) of the index buffer
+	void GatherBounds ( const uint32_t first, const uint32_t count, aabb_t &bbox ) {
+		for ( uint32_t i = first; i < first + count; i++ ) {
+			triangle_t &triangle = triangleList[ triangleIndices[ i ] ];
+			bbox.growToInclude( triangle.vertex0 );
+			bbox.growToInclude( triangle.vertex1 );
+			bbox.growToInclude( triangle.vertex2 );
+		}
+	}
 
-		aabb_t bbox;
-		for ( uint32_t i = 0; i < node.primitiveCount; i++ ) {
-			triangle_t &leafTriangle = triangleList[ triangleIndices[ node.leftChild + i ] ];
+	// bounds of just the centroids, in that same range - this sets up the bins
+	void GatherCentroidBounds ( const uint32_t first, const uint32_t count, aabb_t &bbox ) {
+		for ( uint32_t i = first; i < first + count; i++ ) {
+			bbox.growToInclude( triangleList[ triangleIndices[ i ] ].centroid );
+		}
+	}
+
+	// bin the range on all three axes in a single pass over the primitives, instead of rescanning per axis
+	static constexpr int NUM_BINS = 8;
+	struct binSet_t {
+		bin_t bins[ 3 ][ NUM_BINS ];
+
+		void growToInclude ( const binSet_t &other ) {
+			for ( int a = 0; a < 3; a++ )
+			for ( int b = 0; b < NUM_BINS; b++ ) {
+				bins[ a ][ b ].primitiveCount += other.bins[ a ][ b ].primitiveCount;
+				bins[ a ][ b ].bounds.growToInclude( other.bins[ a ][ b ].bounds );
+			}
+		}
+	};
 
-			bbox.growToInclude( leafTriangle.vertex0 );
-			bbox.growToInclude( leafTriangle.vertex1 );
-			bbox.growToInclude( leafTriangle.vertex2 );
+	void GatherBins ( const uint32_t first, const uint32_t count, const aabb_t &centroidBounds, binSet_t &binSet ) {
+		// precompute a scale factor based on number of bins - degenerate axes are skipped later, so it doesn't matter what lands in them
+		vec3 scale;
+		for ( int a = 0; a < 3; a++ ) {
+			scale[ a ] = NUM_BINS / ( centroidBounds.maxs[ a ] - centroidBounds.mins[ a ] );
+		}
+
+		for ( uint32_t i = first; i < first + count; i++ ) {
+			triangle_t &triangle = triangleList[ triangleIndices[ i ] ];
+
+			// the box around the three vertices only needs computing once, and then it goes into one bin per axis
+			aabb_t triangleBounds;
+			triangleBounds.growToInclude( triangle.vertex0 );
+			triangleBounds.growToInclude( triangle.vertex1 );
+			triangleBounds.growToInclude( triangle.vertex2 );
+
+			for ( int a = 0; a < 3; a++ ) {
+				if ( centroidBounds.mins[ a ] == centroidBounds.maxs[ a ] ) {
+					continue;
+				}
+
+				// figure out what bin it falls into
+				const int bindex = std::min( NUM_BINS - 1, ( int )( ( triangle.centroid[ a ] - centroidBounds.mins[ a ] ) * scale[ a ] ) );
+				bin_t &bin = binSet.bins[ a ][ bindex ];
+
+				// increment bin count, and grow the bounds for that bin to include this primitive
+				bin.primitiveCount++;
+				bin.bounds.growToInclude( triangleBounds );
+			}
+		}
+	}
+
+	// the gathers above only use min/max and integer adds, so a range can be cut into chunks, run on the thread pool, and
+		// the chunk results merged back together in order - this comes out bit identical to the serial gather
+	static constexpr uint32_t PARALLEL_GATHER_GRAIN = 16384;
+	template < typename result_t, typename gatherFunc_t >
+	result_t ParallelGather ( const uint32_t first, const uint32_t count, gatherFunc_t &&gather ) {
+		const uint32_t numChunks = ( count + PARALLEL_GATHER_GRAIN - 1 ) / PARALLEL_GATHER_GRAIN;
+		std::vector< result_t > partials( numChunks );
+		jbDE::GetThreadPool().ParallelFor( 0, numChunks, 1, [ & ] ( int64_t lo, int64_t hi ) {
+			for ( int64_t c = lo; c < hi; c++ ) {
+				const uint32_t chunkFirst = first + uint32_t( c ) * PARALLEL_GATHER_GRAIN;
+				gather( chunkFirst, std::min( PARALLEL_GATHER_GRAIN, first + count - chunkFirst ), partials[ c ] );
+			}
+		} );
+		for ( uint32_t c = 1; c < numChunks; c++ ) {
+			partials[ 0 ].growToInclude( partials[ c ] );
+		}
+		return partials[ 0 ];
+	}
+
+	void UpdateNodeBounds ( bvhNode_t &node, const bool parallel = false ) {
+		// calculate the bounds for a BVH node, based on contained primitives
+		aabb_t bbox;
+		if ( parallel ) {
+			bbox = ParallelGather< aabb_t >( node.leftChild, node.primitiveCount, [ this ] ( uint32_t first, uint32_t count, aabb_t &b ) { GatherBounds( first, count, b ); } );
+		} else {
+			GatherBounds( node.leftChild, node.primitiveCount, bbox );
 		}
 
 		node.aabbMax = bbox.maxs;
 		node.aabbMin = bbox.mins;
 	}
 
-	float FindBestSplitPlane ( bvhNode_t& node, int& axis, float& splitPos ) {
+	float FindBestSplitPlane ( bvhNode_t& node, int& axis, float& splitPos, const bool parallel = false ) {
 		float bestCost = 1e30f;
 
+		// find the bounds for the primitive centroids of the primitives in the node, and bin them along all three axes
+		aabb_t centroidBounds;
+		binSet_t binSet;
+		if ( parallel ) {
+			centroidBounds = ParallelGather< aabb_t >( node.leftChild, node.primitiveCount, [ this ] ( uint32_t first, uint32_t count, aabb_t &b ) { GatherCentroidBounds( first, count, b ); } );
+			binSet = ParallelGather< binSet_t >( node.leftChild, node.primitiveCount, [ this, &centroidBounds ] ( uint32_t first, uint32_t count, binSet_t &b ) { GatherBins( first, count, centroidBounds, b ); } );
+		} else {
+			GatherCentroidBounds( node.leftChild, node.primitiveCount, centroidBounds );
+			GatherBins( node.leftChild, node.primitiveCount, centroidBounds, binSet );
+		}
+
 		// for the three axes, x,y,z ( optimization opportunity here, only considering the longest axis )
 		for ( int a = 0; a < 3; a++ ) {
-
-			// iterate through the list of triangles
-			float boundsMin = 1e30f, boundsMax = -1e30f;
-			for ( uint32_t i = 0; i < node.primitiveCount; i++ ) {
-				// find the bounds for the primitive centroids of the primitives in the node
-				triangle_t& triangle = triangleList[ triangleIndices[ node.leftChild + i ] ];
-				boundsMin = min( boundsMin, triangle.centroid[ a ] );
-				boundsMax = max( boundsMax, triangle.centroid[ a ] );
-			}
+			const float boundsMin = centroidBounds.mins[ a ];
+			const float boundsMax = centroidBounds.maxs[ a ];
 
 			// if the bounds are degenerate, continue
 			if ( boundsMin == boundsMax ) {
 				continue;
 			}
 
-			// otherwise, we start the binning
-			constexpr int NUM_BINS = 8;
-			bin_t bin[ NUM_BINS ];
-
-			// precompute a scale factor based on number of bins
-			float scale = NUM_BINS / ( boundsMax - boundsMin );
-
-			// iterating through the primitives again
-			for ( uint32_t i = 0; i < node.primitiveCount; i++ ) {
-				triangle_t& triangle = triangleList[ triangleIndices[ node.leftChild + i ] ];
-
-				// figure out what bin it falls into
-				int bindex = min( NUM_BINS - 1, ( int )( ( triangle.centroid[ a ] - boundsMin ) * scale ) );
-
-				// increment bin count
-				bin[ bindex ].primitiveCount++;
-
-				// grow the bounds for that bin, to include all three vertices of this primitive
-				bin[ bindex ].bounds.growToInclude( triangle.vertex0 );
-				bin[ bindex ].bounds.growToInclude( triangle.vertex1 );
-				bin[ bindex ].bounds.growToInclude( triangle.vertex2 );
-			}
+			const bin_t *bin = binSet.bins[ a ];
 
 			// left and right sweeps through the bins
 			float leftArea[ NUM_BINS - 1 ], rightArea[ NUM_BINS - 1 ];
@@ -280,7 +736,7 @@ struct bvh_t {
 			}
 
 			// calculating SAH cost for each direction
-			scale = ( boundsMax - boundsMin ) / NUM_BINS;
+			const float scale = ( boundsMax - boundsMin ) / NUM_BINS;
 			for ( int i = 0; i < NUM_BINS - 1; i++ ) {
 				float planeCost = leftCount[ i ] * leftArea[ i ] + rightCount[ i ] * rightArea[ i ];
 				// update best cost etc while iterating
@@ -323,12 +779,11 @@ struct bvh_t {
 		return ( cost > 0.0f ) ? cost : 1e30f;
 	}
 
-	void Subdivide ( uint32_t nodeIndex ) {
-		// ref current node
-		bvhNode_t &currentNode = bvhNodes[ nodeIndex ];
-
+	// decide whether to split this node, and if so partition its primitives and fill out the two children - doesn't touch
+		// the node itself, so the caller can put the children wherever it keeps its nodes
+	bool SplitNode ( bvhNode_t &currentNode, bvhNode_t &leftNode, bvhNode_t &rightNode, const bool parallel = false ) {
 		// we can go ahead and kill it if we at a leaf node
-		if ( currentNode.primitiveCount <= 2 ) return;
+		if ( currentNode.primitiveCount <= 2 ) return false;
 
 		int splitAxis = 0;
 		float splitPos = 0.0f;
@@ -336,11 +791,11 @@ struct bvh_t {
 		// surface area heuristic to pick the split axis and the position
 		int bestAxis;
 		float bestPos;
-		float bestCost = FindBestSplitPlane( currentNode, bestAxis, bestPos );
+		float bestCost = FindBestSplitPlane( currentNode, bestAxis, bestPos, parallel );
 
 		// we can early out if we aren't improving
 		float noSplitPos = CalculateNodeCost( currentNode );
-		if ( bestCost >= noSplitPos ) return;
+		if ( bestCost >= noSplitPos ) return false;
 
 		splitAxis = bestAxis;
 		splitPos = bestPos;
@@ -350,6 +805,7 @@ struct bvh_t {
 		int j = i + currentNode.primitiveCount - 1;
 
 		// iterate through, and place triangles based on centroid position relative to the dividing line
+			// ( this stays serial for the parallel build too - the order it leaves the indices in is part of the output )
 		while ( i <= j ) {
 			if ( triangleList[ triangleIndices[ i ] ].centroid[ splitAxis ] < splitPos ) {
 				i++;
@@ -365,41 +821,121 @@ struct bvh_t {
 		const uint32_t leftCount = i - currentNode.leftChild;
 
 		// abort the split if either of the sides are empty
-		if ( leftCount == 0 || leftCount == currentNode.primitiveCount ) return;
-
-		// otherwise we're creating child nodes for each half ( note use of contiguous nodes, here )
-		int leftChildIdx = nodesUsed++;
-		int rightChildIdx = nodesUsed++;
+		if ( leftCount == 0 || leftCount == currentNode.primitiveCount ) return false;
 
 		// ...so I guess you can always get the right child index back, by looking at base idx + primitive count
-		bvhNodes[ leftChildIdx ].leftChild = currentNode.leftChild;
-		bvhNodes[ leftChildIdx ].primitiveCount = leftCount;
+		leftNode.leftChild = currentNode.leftChild;
+		leftNode.primitiveCount = leftCount;
 
-		bvhNodes[ rightChildIdx ].leftChild = i;
-		bvhNodes[ rightChildIdx ].primitiveCount = currentNode.primitiveCount - leftCount;
-
-		// not tracking the isLeaf bool, means primitiveCount has to be used to id leaves vs interior nodes
-		currentNode.primitiveCount = 0; // so setting this now interior node to zero to indicate this isn't a leaf
-		currentNode.leftChild = leftChildIdx; // and the child there - note that right child can always be recovered with +1 ( contiguous )
+		rightNode.leftChild = i;
+		rightNode.primitiveCount = currentNode.primitiveCount - leftCount;
 
 		// update the bounds for the child nodes
-		UpdateNodeBounds( leftChildIdx );
-		UpdateNodeBounds( rightChildIdx );
+		UpdateNodeBounds( leftNode, parallel );
+		UpdateNodeBounds( rightNode, parallel );
+		return true;
+	}
+
+	void Subdivide ( std::vector< bvhNode_t > &nodes, uint32_t &used, uint32_t nodeIndex ) {
+		bvhNode_t leftNode, rightNode;
+		if ( !SplitNode( nodes[ nodeIndex ], leftNode, rightNode ) ) return;
+
+		// otherwise we're creating child nodes for each half ( note use of contiguous nodes, here )
+		const uint32_t leftChildIdx = used++;
+		const uint32_t rightChildIdx = used++;
+		nodes[ leftChildIdx ] = leftNode;
+		nodes[ rightChildIdx ] = rightNode;
+
+		// not tracking the isLeaf bool, means primitiveCount has to be used to id leaves vs interior nodes
+		nodes[ nodeIndex ].primitiveCount = 0; // so setting this now interior node to zero to indicate this isn't a leaf
+		nodes[ nodeIndex ].leftChild = leftChildIdx; // and the child there - note that right child can always be recovered with +1 ( contiguous )
 
 		// recurse into each of the child nodes, from this
-		Subdivide( leftChildIdx );
-		Subdivide( rightChildIdx );
+		Subdivide( nodes, used, leftChildIdx );
+		Subdivide( nodes, used, rightChildIdx );
 	}
 
-	void BuildTree () {
+	// the parallel build - nodes with at least PARALLEL_SPLIT_MIN primitives are split using the parallel gathers, and their
+		// children go on as tasks. Below that, a task runs the serial Subdivide for the whole subtree into its own node list
+	static constexpr uint32_t PARALLEL_SPLIT_MIN = 65536;
+	struct buildNode_t {
+		bvhNode_t node;
+		std::vector< buildNode_t > children;	// two, when this was split at the top of the tree
+		std::vector< bvhNode_t > subtree;		// serially built subtree, [ 0 ] is the root and then the rest in allocation order
+		uint32_t descendantCount = 0;			// how many nodes the build allocated below this one
+	};
+
+	void SubdivideParallel ( buildNode_t &b ) {
+		if ( b.node.primitiveCount < PARALLEL_SPLIT_MIN ) {
+			b.subtree.resize( b.node.primitiveCount * 2 - 1 );
+			b.subtree[ 0 ] = b.node;
+			uint32_t used = 1;
+			Subdivide( b.subtree, used, 0 );
+			b.subtree.resize( used );
+			b.descendantCount = used - 1;
+			return;
+		}
+
+		b.children.resize( 2 );
+		if ( !SplitNode( b.node, b.children[ 0 ].node, b.children[ 1 ].node, true ) ) {
+			b.children.clear();
+			return;
+		}
+
+		// the two halves touch disjoint ranges of the index buffer, so they can go at the same time
+		threadPool &pool = jbDE::GetThreadPool();
+		threadPool::taskGroup group;
+		pool.Submit( [ this, &b ] () { SubdivideParallel( b.children[ 0 ] ); }, &group );
+		SubdivideParallel( b.children[ 1 ] );
+		pool.Wait( group );
+
+		b.descendantCount = 2 + b.children[ 0 ].descendantCount + b.children[ 1 ].descendantCount;
+	}
+
+	// write the node to bvhNodes[ nodeIndex ] and its descendants from base onwards - Subdivide allocates a node's two children
+		// and then everything under the left child before the right one, so we know where every subtree lands from the counts
+	void PlaceSubtree ( buildNode_t &b, const uint32_t nodeIndex, const uint32_t base, threadPool::taskGroup &group ) {
+		if ( !b.children.empty() ) {
+			bvhNodes[ nodeIndex ] = b.node;
+			bvhNodes[ nodeIndex ].primitiveCount = 0;
+			bvhNodes[ nodeIndex ].leftChild = base;
+			PlaceSubtree( b.children[ 0 ], base, base + 2, group );
+			PlaceSubtree( b.children[ 1 ], base + 1, base + 2 + b.children[ 0 ].descendantCount, group );
+		} else if ( b.subtree.empty() ) {
+			bvhNodes[ nodeIndex ] = b.node; // leaf at the top of the tree
+		} else {
+			jbDE::GetThreadPool().Submit( [ this, &b, nodeIndex, base ] () {
+				// local index 0 is the subtree root, local k > 0 goes to base + k - 1
+				for ( uint32_t k = 0; k < b.subtree.size(); k++ ) {
+					bvhNode_t node = b.subtree[ k ];
+					if ( !node.isLeaf() ) {
+						node.leftChild = base + node.leftChild - 1;
+					}
+					bvhNodes[ ( k == 0 ) ? nodeIndex : base + k - 1 ] = node;
+				}
+			}, &group );
+		}
+	}
+
+	// the parallel build produces the exact same nodes and index buffer as the serial one, it's kept around for reference
+	void BuildTree ( const bool parallel = true ) {
+		nodesUsed = 1;
+		if ( triangleList.empty() ) {
+			bvhNodes.resize( 0 );
+			return;
+		}
+
 		// maximum possible size is 2N + 1 nodes, where N is the number of triangles
 			// ( N leaves have N/2 parents, N/4 granparents, etc... )
 		bvhNodes.resize( triangleList.size() * 2 - 1 );
 
 		// precompute the centroids of all the triangles
-		for ( auto& triangle : triangleList ) {
-			triangle.centroid = vec3( triangle.vertex0 + triangle.vertex1 + triangle.vertex2 ) / 3.0f;
-		}
+		jbDE::GetThreadPool().ParallelFor( 0, triangleList.size(), PARALLEL_GATHER_GRAIN, [ this ] ( int64_t lo, int64_t hi ) {
+			for ( int64_t i = lo; i < hi; i++ ) {
+				triangle_t &triangle = triangleList[ i ];
+				triangle.centroid = vec3( triangle.vertex0 + triangle.vertex1 + triangle.vertex2 ) / 3.0f;
+			}
+		} );
 
 		// populate the index buffer, initially just in order
 		triangleIndices.resize( triangleList.size() );
@@ -413,10 +949,260 @@ struct bvh_t {
 		root.primitiveCount = triangleList.size();
 
 		// updating node bounds, for the root node - so it's the bounding box for entire model
-		UpdateNodeBounds( rootNodeIdx );
+		UpdateNodeBounds( root, parallel );
+
+		if ( parallel ) {
+			// build the tree into the task-local lists, then lay it out in the order the serial build would have
+			buildNode_t top;
+			top.node = root;
+			SubdivideParallel( top );
+
+			threadPool::taskGroup group;
+			PlaceSubtree( top, rootNodeIdx, rootNodeIdx + 1, group );
+			jbDE::GetThreadPool().Wait( group );
+			nodesUsed = 1 + top.descendantCount;
+		} else {
+			// subdivide from the root node, recursively
+			Subdivide( bvhNodes, nodesUsed, rootNodeIdx );
+		}
+
+		// baseline for the refit quality metric
+		builtQuality.resize( bvhNodes.size() );
+		currentQuality.resize( bvhNodes.size() );
+		RefitNode( rootNodeIdx, false );
+		builtQuality = currentQuality;
+	}
+
+	// SAH cost of the finished tree, relative to the root node's area - each node visited costs 1, each triangle test costs 1.
+		// Walks from the root, since partial rebuilds can leave unreferenced nodes behind in the list
+	float SAHCost () {
+		if ( bvhNodes.empty() ) return 0.0f;
+		double cost = 0.0;
+		std::vector< uint32_t > stack = { rootNodeIdx };
+		while ( !stack.empty() ) {
+			bvhNode_t &node = bvhNodes[ stack.back() ];
+			stack.pop_back();
+			const vec3 e = node.aabbMax - node.aabbMin;
+			const double surfaceArea = e.x * e.y + e.y * e.z + e.z * e.x;
+			cost += surfaceArea * ( node.isLeaf() ? node.primitiveCount : 1 );
+			if ( !node.isLeaf() ) {
+				stack.push_back( node.leftChild );
+				stack.push_back( node.leftChild + 1 );
+			}
+		}
+		const vec3 e = bvhNodes[ rootNodeIdx ].aabbMax - bvhNodes[ rootNodeIdx ].aabbMin;
+		return float( cost / ( e.x * e.y + e.y * e.z + e.z * e.x ) );
+	}
 
-		// subdivide from the root node, recursively
-		Subdivide( rootNodeIdx );
+	// per node SAH quality - subtree cost over the node's own area, which is the expected cost of a ray that hits the
+		// node. Recorded after a build, and again after every refit, so we can see which parts of the tree got worse
+	std::vector< float > builtQuality;
+	std::vector< float > currentQuality;
+
+	// refit recursion spawns tasks for the first few levels, below that the subtrees are plenty big enough to run serial
+	static constexpr int PARALLEL_REFIT_DEPTH = 6;
+	float RefitNode ( const uint32_t nodeIndex, const bool updateBounds, const int depth = 0 ) {
+		bvhNode_t &node = bvhNodes[ nodeIndex ];
+		float cost;
+		if ( node.isLeaf() ) {
+			if ( updateBounds ) {
+				UpdateNodeBounds( node );
+			}
+			cost = CalculateNodeCost( node );
+		} else {
+			float leftCost, rightCost;
+			if ( depth < PARALLEL_REFIT_DEPTH ) {
+				threadPool &pool = jbDE::GetThreadPool();
+				threadPool::taskGroup group;
+				pool.Submit( [ this, &node, &leftCost, updateBounds, depth ] () { leftCost = RefitNode( node.leftChild, updateBounds, depth + 1 ); }, &group );
+				rightCost = RefitNode( node.leftChild + 1, updateBounds, depth + 1 );
+				pool.Wait( group );
+			} else {
+				leftCost = RefitNode( node.leftChild, updateBounds, depth + 1 );
+				rightCost = RefitNode( node.leftChild + 1, updateBounds, depth + 1 );
+			}
+
+			if ( updateBounds ) {
+				// interior bounds are just the union of the two children
+				aabb_t bbox;
+				bbox.growToInclude( aabb_t { bvhNodes[ node.leftChild ].aabbMin, bvhNodes[ node.leftChild ].aabbMax } );
+				bbox.growToInclude( aabb_t { bvhNodes[ node.leftChild + 1 ].aabbMin, bvhNodes[ node.leftChild + 1 ].aabbMax } );
+				node.aabbMin = bbox.mins;
+				node.aabbMax = bbox.maxs;
+			}
+
+			// a traversal step costs 1
+			const vec3 e = node.aabbMax - node.aabbMin;
+			cost = ( e.x * e.y + e.y * e.z + e.z * e.x ) + leftCost + rightCost;
+		}
+
+		const vec3 e = node.aabbMax - node.aabbMin;
+		currentQuality[ nodeIndex ] = cost / std::max( e.x * e.y + e.y * e.z + e.z * e.x, 1e-30f );
+		return cost;
+	}
+
+	// after the triangles have moved - keeps the topology, updates the bounds bottom up. Wide trees are re-collapsed
+		// if they're in use, since the compact triangle list holds its own copy of the vertices
+	void Refit () {
+		if ( triangleList.empty() ) return;
+		jbDE::GetThreadPool().ParallelFor( 0, triangleList.size(), PARALLEL_GATHER_GRAIN, [ this ] ( int64_t lo, int64_t hi ) {
+			for ( int64_t i = lo; i < hi; i++ ) {
+				triangle_t &triangle = triangleList[ i ];
+				triangle.centroid = vec3( triangle.vertex0 + triangle.vertex1 + triangle.vertex2 ) / 3.0f;
+			}
+		} );
+		RefitNode( rootNodeIdx, true );
+		if ( !bvh4.nodes.empty() ) {
+			Collapse();
+		}
+	}
+
+	// how much worse a subtree is than when it was built, 1.0 is unchanged
+	float Degradation ( const uint32_t nodeIndex = 0 ) const {
+		return currentQuality[ nodeIndex ] / std::max( builtQuality[ nodeIndex ], 1e-30f );
+	}
+
+	// walk a subtree for the range of triangleIndices it covers, and how many nodes sit below it - the builds allocate
+		// all of a node's descendants in one contiguous run starting at its leftChild, and rebuilds keep it that way
+	void SubtreeExtent ( const uint32_t nodeIndex, uint32_t &first, uint32_t &count, uint32_t &descendants ) {
+		first = UINT32_MAX; count = 0; descendants = 0;
+		std::vector< uint32_t > stack = { nodeIndex };
+		while ( !stack.empty() ) {
+			bvhNode_t &node = bvhNodes[ stack.back() ];
+			stack.pop_back();
+			if ( node.isLeaf() ) {
+				first = std::min( first, node.leftChild );
+				count += node.primitiveCount;
+			} else {
+				descendants += 2;
+				stack.push_back( node.leftChild );
+				stack.push_back( node.leftChild + 1 );
+			}
+		}
+	}
+
+	// rebuild one subtree in place, from the triangles it already holds. The new nodes go back where the old ones were if
+		// they fit, otherwise onto the end of the node list, and the old run is just left unreferenced
+	void RebuildSubtree ( const uint32_t nodeIndex ) {
+		uint32_t first, count, oldDescendants;
+		SubtreeExtent( nodeIndex, first, count, oldDescendants );
+
+		buildNode_t top;
+		top.node.leftChild = first;
+		top.node.primitiveCount = count;
+		UpdateNodeBounds( top.node, count >= PARALLEL_SPLIT_MIN );
+		SubdivideParallel( top );
+
+		uint32_t base = bvhNodes[ nodeIndex ].leftChild; // only used when the node was interior, and the new nodes fit
+		if ( top.descendantCount > oldDescendants ) {
+			base = nodesUsed;
+			nodesUsed += top.descendantCount;
+			if ( bvhNodes.size() < nodesUsed ) {
+				bvhNodes.resize( nodesUsed );
+			}
+		}
+		builtQuality.resize( bvhNodes.size() );
+		currentQuality.resize( bvhNodes.size() );
+
+		threadPool::taskGroup group;
+		PlaceSubtree( top, nodeIndex, base, group );
+		jbDE::GetThreadPool().Wait( group );
+
+		// new subtree, new baseline for the quality metric
+		RefitNode( nodeIndex, false );
+		std::vector< uint32_t > stack = { nodeIndex };
+		while ( !stack.empty() ) {
+			const uint32_t index = stack.back();
+			stack.pop_back();
+			builtQuality[ index ] = currentQuality[ index ];
+			if ( !bvhNodes[ index ].isLeaf() ) {
+				stack.push_back( bvhNodes[ index ].leftChild );
+				stack.push_back( bvhNodes[ index ].leftChild + 1 );
+			}
+		}
+	}
+
+	// find the subtrees to rebuild - the highest degraded nodes that hold no more than REBUILD_MAX_FRACTION of the
+		// triangles. Anything bigger than that gets split up into its children, to keep rebuilds local
+	static constexpr float REBUILD_MAX_FRACTION = 0.25f;
+	void CollectDegraded ( const uint32_t nodeIndex, const float threshold, std::vector< uint32_t > &degraded ) {
+		bvhNode_t &node = bvhNodes[ nodeIndex ];
+		if ( node.isLeaf() || Degradation( nodeIndex ) <= threshold ) return;
+		uint32_t first, count, descendants;
+		SubtreeExtent( nodeIndex, first, count, descendants );
+		if ( count <= REBUILD_MAX_FRACTION * triangleList.size() ) {
+			degraded.push_back( nodeIndex );
+		} else {
+			CollectDegraded( node.leftChild, threshold, degraded );
+			CollectDegraded( node.leftChild + 1, threshold, degraded );
+		}
+	}
+
+	// rebuilt subtrees that outgrow their old run get appended to the node list, leaving the old run dead - once the list
+		// passes this many times the 2N - 1 a full build uses, it's compacted in place, so repeated updates stay bounded
+	static constexpr float COMPACT_SLACK = 1.5f;
+	void CompactInPlace () {
+		std::vector< uint32_t > source;
+		std::vector< bvhNode_t > compacted = CompactNodes( &source );
+		std::vector< float > built( compacted.size() ), current( compacted.size() );
+		for ( uint32_t i = 0; i < compacted.size(); i++ ) {
+			built[ i ] = builtQuality[ source[ i ] ];
+			current[ i ] = currentQuality[ source[ i ] ];
+		}
+
+		// keep the room a full build would have, for the next rebuilds to reuse
+		const size_t capacity = std::max< size_t >( compacted.size(), triangleList.size() * 2 - 1 );
+		nodesUsed = compacted.size();
+		rootNodeIdx = 0;
+		bvhNodes = std::move( compacted );
+		bvhNodes.resize( capacity );
+		bvhNodes.shrink_to_fit();
+		builtQuality = std::move( built );
+		currentQuality = std::move( current );
+		builtQuality.resize( capacity );
+		currentQuality.resize( capacity );
+	}
+
+	struct updateReport_t {
+		bool fullRebuild = false;
+		bool compacted = false;
+		uint32_t subtreesRebuilt = 0;
+		float degradationBefore = 1.0f;
+		float degradationAfter = 1.0f;
+	};
+
+	// the animated geometry update - refit, and if the tree got more than threshold times worse than it was when built,
+		// rebuild the degraded subtrees. When the damage is all up at the top, where nothing is small enough, start over
+	updateReport_t RefitAndRebuild ( const float threshold = 1.5f ) {
+		updateReport_t report;
+		if ( triangleList.empty() ) return report;
+
+		Refit();
+		report.degradationBefore = report.degradationAfter = Degradation();
+		if ( report.degradationBefore <= threshold ) return report;
+
+		std::vector< uint32_t > degraded;
+		CollectDegraded( rootNodeIdx, threshold, degraded );
+		if ( degraded.empty() ) {
+			BuildTree();
+			report.fullRebuild = true;
+		} else {
+			for ( uint32_t nodeIndex : degraded ) {
+				RebuildSubtree( nodeIndex );
+			}
+			RefitNode( rootNodeIdx, false ); // ancestors of the rebuilt subtrees have new costs
+			report.subtreesRebuilt = degraded.size();
+			if ( nodesUsed > COMPACT_SLACK * ( triangleList.size() * 2 - 1 ) ) {
+				CompactInPlace();
+				report.compacted = true;
+			}
+		}
+		report.degradationAfter = Degradation();
+
+		if ( !bvh4.nodes.empty() ) {
+			Collapse();
+		}
+		return report;
 	}
 
 	// naiive traversal for comparison
@@ -483,10 +1269,387 @@ struct bvh_t {
 		}
 	}
 
+	// wide versions of the tree, collapsed from bvhNodes after a build, sharing one compact triangle list
+	compactTriangles_t compactTriangles;
+	wideBVH_t< 4 > bvh4;
+	wideBVH_t< 8 > bvh8;
+	void Collapse () {
+		compactTriangles.Build( triangleList, triangleIndices );
+		CollapseWide();
+	}
+
+	void CollapseWide () {
+		bvh4.Collapse( bvhNodes, rootNodeIdx );
+		bvh8.Collapse( bvhNodes, rootNodeIdx );
+	}
+
+	// binary bvh cache, written beside the model after a build, so a later run maps it and skips building entirely. It's
+		// keyed on a hash of the triangle positions and the build parameters, so a different mesh or a builder change just
+		// misses and rebuilds. The shading data still comes from the model load, only the acceleration structure is cached
+	static constexpr uint32_t bvhCacheVersion = 1;
+	struct bvhCacheHeader {
+		char magic[ 8 ] = { 'B', 'V', 'H', 'C', 'A', 'C', 'H', 'E' };
+		uint32_t version = bvhCacheVersion;
+		uint32_t headerSize = sizeof( bvhCacheHeader );
+		uint64_t contentHash = 0;
+		uint64_t triangleCount = 0;
+		uint64_t nodeCount = 0;			// then nodeCount bvhNodes, triangleCount indices, and the compact triangles -
+										// the nine float arrays followed by the triangle indices, triangleCount of each
+	};
+
+	string BVHCachePath () const {
+		return modelPath + ".bvhcache";
+	}
+
+	// FNV-1a over the bits of the vertex positions, in fixed size chunks so the result doesn't depend on thread count
+	uint64_t ContentHash () {
+		constexpr uint64_t basis = 0xcbf29ce484222325ull;
+		constexpr uint64_t prime = 0x100000001b3ull;
+		const uint32_t numChunks = ( triangleList.size() + PARALLEL_GATHER_GRAIN - 1 ) / PARALLEL_GATHER_GRAIN;
+		std::vector< uint64_t > chunkHashes( numChunks );
+		jbDE::GetThreadPool().ParallelFor( 0, numChunks, 1, [ & ] ( int64_t lo, int64_t hi ) {
+			for ( int64_t c = lo; c < hi; c++ ) {
+				uint64_t hash = basis;
+				const size_t end = std::min( size_t( c + 1 ) * PARALLEL_GATHER_GRAIN, triangleList.size() );
+				for ( size_t i = size_t( c ) * PARALLEL_GATHER_GRAIN; i < end; i++ ) {
+					const triangle_t &triangle = triangleList[ i ];
+					for ( const vec3 &v : { triangle.vertex0, triangle.vertex1, triangle.vertex2 } ) {
+						for ( int j = 0; j < 3; j++ ) {
+							hash = ( hash ^ std::bit_cast< uint32_t >( v[ j ] ) ) * prime;
+						}
+					}
+				}
+				chunkHashes[ c ] = hash;
+			}
+		} );
+
+		uint64_t hash = basis;
+		auto mix = [ &hash ] ( const uint64_t value ) { hash = ( hash ^ value ) * prime; };
+		mix( bvhCacheVersion );
+		mix( NUM_BINS );
+		mix( sizeof( bvhNode_t ) );
+		mix( triangleList.size() );
+		for ( uint64_t chunkHash : chunkHashes ) {
+			mix( chunkHash );
+		}
+		return hash;
+	}
+
+	// needs the triangles loaded, false if there's no cache that matches them
+	bool LoadCache () {
+		if ( triangleList.empty() ) return false;
+		const size_t count = triangleList.size();
+
+		bvhCacheHeader expected;
+		expected.contentHash = ContentHash();
+		expected.triangleCount = count;
+
+		mappedFile cache( BVHCachePath() );
+		const bvhCacheHeader *header = cache.At< bvhCacheHeader >( 0 );
+		if ( header == nullptr || std::memcmp( header->magic, expected.magic, sizeof( expected.magic ) ) != 0 ||
+			header->version != expected.version || header->headerSize != expected.headerSize ||
+			header->contentHash != expected.contentHash || header->triangleCount != expected.triangleCount ||
+			header->nodeCount == 0 || header->nodeCount > 2 * count ) {
+			return false;
+		}
+
+		size_t offset = sizeof( bvhCacheHeader );
+		const size_t nodeCount = header->nodeCount;
+		const bvhNode_t *nodes = cache.At< bvhNode_t >( offset, nodeCount );		offset += nodeCount * sizeof( bvhNode_t );
+		const uint32_t *indices = cache.At< uint32_t >( offset, count );			offset += count * sizeof( uint32_t );
+		const float *compact = cache.At< float >( offset, 9 * count );				offset += 9 * count * sizeof( float );
+		const uint32_t *compactIdx = cache.At< uint32_t >( offset, count );
+		if ( !nodes || !indices || !compact || !compactIdx ) {
+			return false; // truncated
+		}
+
+		// cheap structural check, so a damaged file can't send traversal off the end of an array - and since the cache is
+			// written compacted, children always sit after their parent, so one pointing back means it's damaged ( a cycle )
+		for ( size_t i = 0; i < nodeCount; i++ ) {
+			const bvhNode_t &node = nodes[ i ];
+			if ( ( node.primitiveCount > 0 ) ? ( uint64_t( node.leftChild ) + node.primitiveCount > count ) :
+				( node.leftChild <= i || uint64_t( node.leftChild ) + 1 >= nodeCount ) ) {
+				return false;
+			}
+		}
+		for ( size_t i = 0; i < count; i++ ) {
+			if ( indices[ i ] >= count || compactIdx[ i ] >= count ) {
+				return false;
+			}
+		}
+
+		// copy out of the mapping, keeping the spare room at the end of the node list for partial rebuilds
+		bvhNodes.assign( nodes, nodes + nodeCount );
+		bvhNodes.resize( std::max< size_t >( nodeCount, count * 2 - 1 ) );
+		nodesUsed = nodeCount;
+		triangleIndices.assign( indices, indices + count );
+		auto arrays = compactTriangles.FloatArrays();
+		for ( int a = 0; a < 9; a++ ) {
+			arrays[ a ]->assign( compact + a * count, compact + ( a + 1 ) * count );
+		}
+		compactTriangles.idx.assign( compactIdx, compactIdx + count );
+
+		// the rest is derived - centroids for later rebuilds, the refit quality baseline, and the wide trees
+		jbDE::GetThreadPool().ParallelFor( 0, count, PARALLEL_GATHER_GRAIN, [ this ] ( int64_t lo, int64_t hi ) {
+			for ( int64_t i = lo; i < hi; i++ ) {
+				triangle_t &triangle = triangleList[ i ];
+				triangle.centroid = vec3( triangle.vertex0 + triangle.vertex1 + triangle.vertex2 ) / 3.0f;
+			}
+		} );
+		builtQuality.resize( bvhNodes.size() );
+		currentQuality.resize( bvhNodes.size() );
+		RefitNode( rootNodeIdx, false );
+		builtQuality = currentQuality;
+		CollapseWide();
+		return true;
+	}
+
+	// copy of the tree with the runs that partial rebuilds left unreferenced squeezed out, root at 0. Laid out the way the
+		// builds do it, depth first with each node's descendants in one run from its leftChild, so it's at most 2 * count - 1.
+		// source, if given, gets the old index of every node in the copy, for moving anything else that's kept per node
+	std::vector< bvhNode_t > CompactNodes ( std::vector< uint32_t > *source = nullptr ) {
+		std::vector< bvhNode_t > compacted = { bvhNodes[ rootNodeIdx ] };
+		std::vector< std::pair< uint32_t, uint32_t > > stack = { { 0, rootNodeIdx } }; // index in compacted, in bvhNodes
+		if ( source != nullptr ) {
+			source->assign( 1, rootNodeIdx );
+		}
+		while ( !stack.empty() ) {
+			const auto [ to, from ] = stack.back();
+			stack.pop_back();
+			if ( bvhNodes[ from ].isLeaf() ) continue;
+			if ( source != nullptr ) {
+				source->push_back( bvhNodes[ from ].leftChild );
+				source->push_back( bvhNodes[ from ].leftChild + 1 );
+			}
+			const uint32_t base = compacted.size();
+			compacted[ to ].leftChild = base;
+			compacted.push_back( bvhNodes[ bvhNodes[ from ].leftChild ] );
+			compacted.push_back( bvhNodes[ bvhNodes[ from ].leftChild + 1 ] );
+			stack.push_back( { base + 1, bvhNodes[ from ].leftChild + 1 } ); // left comes off first, so its subtree goes in before the right's
+			stack.push_back( { base, bvhNodes[ from ].leftChild } );
+		}
+		return compacted;
+	}
+
+	// written to a temp file and renamed into place, so a partial write never gets picked up as a cache
+	void SaveCache () {
+		if ( bvhNodes.empty() ) return;
+		if ( compactTriangles.idx.size() != triangleList.size() ) {
+			Collapse();
+		}
+
+		bvhCacheHeader header;
+		header.contentHash = ContentHash();
+		header.triangleCount = triangleList.size();
+		const std::vector< bvhNode_t > nodes = CompactNodes();
+		header.nodeCount = nodes.size();
+
+		const string cachePath = BVHCachePath();
+		const string tempPath = cachePath + ".tmp";
+		{
+			std::ofstream file( tempPath, std::ios::binary | std::ios::trunc );
+			file.write( reinterpret_cast< const char * >( &header ), sizeof( header ) );
+			file.write( reinterpret_cast< const char * >( nodes.data() ), nodes.size() * sizeof( bvhNode_t ) );
+			file.write( reinterpret_cast< const char * >( triangleIndices.data() ), triangleIndices.size() * sizeof( uint32_t ) );
+			for ( auto *a : compactTriangles.FloatArrays() ) {
+				file.write( reinterpret_cast< const char * >( a->data() ), a->size() * sizeof( float ) );
+			}
+			file.write( reinterpret_cast< const char * >( compactTriangles.idx.data() ), compactTriangles.idx.size() * sizeof( uint32_t ) );
+			if ( !file ) {
+				cout << "BVH: failed to write cache " << cachePath << newline;
+				return;
+			}
+		}
+		std::error_code ec;
+		std::filesystem::rename( tempPath, cachePath, ec );
+	}
+
+	// which structure acceleratedTraversal uses
+	enum traversalMode_t { BINARY = 2, WIDE4 = 4, WIDE8 = 8 };
+	traversalMode_t traversalMode = WIDE4;
+
 	// test ray against acceleration structure
 	void acceleratedTraversal ( ray_t &ray ) {
-		// recursiveTraversal( ray, rootNodeIdx );
-		iterativeTraversal( ray );
+		switch ( traversalMode ) {
+			case WIDE4: bvh4.Intersect( ray, compactTriangles ); break;
+			case WIDE8: bvh8.Intersect( ray, compactTriangles ); break;
+			default:
+				// recursiveTraversal( ray, rootNodeIdx );
+				iterativeTraversal( ray );
+			break;
+		}
+	}
+
+	// test a packet of coherent rays against acceleration structure
+	void acceleratedTraversal ( rayPacket_t &packet ) {
+		switch ( traversalMode ) {
+			case WIDE4: bvh4.Intersect( packet, compactTriangles ); break;
+			case WIDE8: bvh8.Intersect( packet, compactTriangles ); break;
+			default:
+				for ( auto &ray : packet.rays ) {
+					iterativeTraversal( ray );
+				}
+			break;
+		}
+	}
+};
+
+// one placement of a bottom level bvh in the world
+struct blasInstance_t {
+	bvh_t *blas = nullptr;
+	mat4 transform = mat4( 1.0f );
+	mat4 inverseTransform = mat4( 1.0f );
+	aabb_t worldBounds;
+};
+
+// top level bvh, over instances of bottom level ones - moving an instance means a new transform and a rebuild of this
+	// level only, which is cheap since there are few instances. The bottom level trees get refit separately if their
+	// geometry animates ( bvh_t::RefitAndRebuild ), and then the top level needs Refit() for the new bounds
+struct tlas_t {
+	std::vector< blasInstance_t > instances;
+	std::vector< uint32_t > instanceIndices;
+	std::vector< bvhNode_t > nodes;
+	uint32_t nodesUsed = 0;
+
+	uint32_t AddInstance ( bvh_t *blas, const mat4 &transform = mat4( 1.0f ) ) {
+		instances.emplace_back();
+		instances.back().blas = blas;
+		SetTransform( instances.size() - 1, transform );
+		return instances.size() - 1;
+	}
+
+	// needs a Build() or Refit() afterwards, before tracing again
+	void SetTransform ( const uint32_t instance, const mat4 &transform ) {
+		blasInstance_t &i = instances[ instance ];
+		i.transform = transform;
+		i.inverseTransform = glm::inverse( transform );
+		UpdateInstanceBounds( i );
+	}
+
+	void UpdateInstanceBounds ( blasInstance_t &i ) {
+		// world space box around the eight transformed corners of the blas root
+		const bvhNode_t &root = i.blas->bvhNodes[ i.blas->rootNodeIdx ];
+		i.worldBounds = aabb_t();
+		for ( int c = 0; c < 8; c++ ) {
+			const vec3 corner = vec3( ( c & 1 ) ? root.aabbMax.x : root.aabbMin.x, ( c & 2 ) ? root.aabbMax.y : root.aabbMin.y, ( c & 4 ) ? root.aabbMax.z : root.aabbMin.z );
+			i.worldBounds.growToInclude( vec3( i.transform * vec4( corner, 1.0f ) ) );
+		}
+	}
+
+	// median split on the widest axis of the instance centroids, down to single instance leaves
+	void Build () {
+		nodes.resize( std::max< size_t >( 1, instances.size() * 2 - 1 ) );
+		instanceIndices.resize( instances.size() );
+		std::iota( instanceIndices.begin(), instanceIndices.end(), 0 );
+		nodesUsed = 1;
+		nodes[ 0 ].leftChild = 0;
+		nodes[ 0 ].primitiveCount = instances.size();
+		if ( instances.empty() ) {
+			nodes[ 0 ].aabbMin = vec3( 1e30f );
+			nodes[ 0 ].aabbMax = vec3( -1e30f );
+			return;
+		}
+		Subdivide( 0 );
+	}
+
+	void Subdivide ( const uint32_t nodeIndex ) {
+		bvhNode_t &node = nodes[ nodeIndex ];
+		aabb_t bounds, centroidBounds;
+		for ( uint32_t i = node.leftChild; i < node.leftChild + node.primitiveCount; i++ ) {
+			const aabb_t &b = instances[ instanceIndices[ i ] ].worldBounds;
+			bounds.growToInclude( b );
+			centroidBounds.growToInclude( ( b.mins + b.maxs ) * 0.5f );
+		}
+		node.aabbMin = bounds.mins;
+		node.aabbMax = bounds.maxs;
+		if ( node.primitiveCount == 1 ) return;
+
+		const vec3 extent = centroidBounds.maxs - centroidBounds.mins;
+		const int axis = ( extent.x > extent.y && extent.x > extent.z ) ? 0 : ( extent.y > extent.z ) ? 1 : 2;
+		const uint32_t first = node.leftChild, count = node.primitiveCount, half = count / 2;
+		std::nth_element( instanceIndices.begin() + first, instanceIndices.begin() + first + half, instanceIndices.begin() + first + count,
+			[ this, axis ] ( uint32_t a, uint32_t b ) {
+				return ( instances[ a ].worldBounds.mins[ axis ] + instances[ a ].worldBounds.maxs[ axis ] ) < ( instances[ b ].worldBounds.mins[ axis ] + instances[ b ].worldBounds.maxs[ axis ] );
+			} );
+
+		const uint32_t leftChildIdx = nodesUsed++;
+		nodesUsed++;
+		nodes[ leftChildIdx ].leftChild = first;
+		nodes[ leftChildIdx ].primitiveCount = half;
+		nodes[ leftChildIdx + 1 ].leftChild = first + half;
+		nodes[ leftChildIdx + 1 ].primitiveCount = count - half;
+		node.leftChild = leftChildIdx;
+		node.primitiveCount = 0;
+		Subdivide( leftChildIdx );
+		Subdivide( leftChildIdx + 1 );
+	}
+
+	// keep the tree, update the instance bounds and then the node bounds bottom up - children always come after their
+		// parent in the node list, so a reverse walk sees them first
+	void Refit () {
+		for ( auto &i : instances ) {
+			UpdateInstanceBounds( i );
+		}
+		for ( int n = int( nodesUsed ) - 1; n >= 0 && !instances.empty(); n-- ) {
+			bvhNode_t &node = nodes[ n ];
+			aabb_t bounds;
+			if ( node.isLeaf() ) {
+				for ( uint32_t i = node.leftChild; i < node.leftChild + node.primitiveCount; i++ ) {
+					bounds.growToInclude( instances[ instanceIndices[ i ] ].worldBounds );
+				}
+			} else {
+				bounds.growToInclude( aabb_t { nodes[ node.leftChild ].aabbMin, nodes[ node.leftChild ].aabbMax } );
+				bounds.growToInclude( aabb_t { nodes[ node.leftChild + 1 ].aabbMin, nodes[ node.leftChild + 1 ].aabbMax } );
+			}
+			node.aabbMin = bounds.mins;
+			node.aabbMax = bounds.maxs;
+		}
+	}
+
+	void IntersectInstance ( ray_t &ray, const uint32_t instance ) {
+		// into the instance's object space - the direction isn't renormalized, so distances along the ray stay the same
+		const blasInstance_t &i = instances[ instance ];
+		ray_t local;
+		local.origin = vec3( i.inverseTransform * vec4( ray.origin, 1.0f ) );
+		local.direction = mat3( i.inverseTransform ) * ray.direction;
+		local.distance = ray.distance;
+		i.blas->acceleratedTraversal( local );
+		if ( local.distance < ray.distance ) {
+			ray.distance = local.distance;
+			ray.uv = local.uv;
+			ray.triangleIdx = local.triangleIdx;
+			ray.instanceIdx = instance;
+		}
+	}
+
+	void Intersect ( ray_t &ray ) {
+		if ( instances.empty() ) return;
+		bvhNode_t* node = &nodes[ 0 ], *stack[ 64 ];
+		uint32_t stackPtr = 0;
+		if ( IntersectAABB_i( ray, node->aabbMin, node->aabbMax ) == MAX_DISTANCE ) return;
+		while ( 1 ) {
+			if ( node->isLeaf() ) {
+				for ( uint32_t i = 0; i < node->primitiveCount; i++ )
+					IntersectInstance( ray, instanceIndices[ node->leftChild + i ] );
+				if ( stackPtr == 0 ) break; else node = stack[ --stackPtr ];
+				continue;
+			}
+			bvhNode_t* child1 = &nodes[ node->leftChild ];
+			bvhNode_t* child2 = &nodes[ node->leftChild + 1 ];
+			float dist1 = IntersectAABB_i( ray, child1->aabbMin, child1->aabbMax );
+			float dist2 = IntersectAABB_i( ray, child2->aabbMin, child2->aabbMax );
+			if ( dist1 > dist2 ) { std::swap( dist1, dist2 ); std::swap( child1, child2 ); }
+			if ( dist1 == MAX_DISTANCE ) {
+				if ( stackPtr == 0 ) {
+					break;
+				} else {
+					node = stack[ --stackPtr ];
+				}
+			} else {
+				node = child1;
+				if ( dist2 != MAX_DISTANCE ) stack[ stackPtr++ ] = child2;
+			}
+		}
 	}
 };
 
@@ -496,165 +1659,217 @@ struct testRenderer_t {
 	// holding scene data
 	bvh_t accelerationStructure;
 
-	// image data, to display
+	// image data, to display - resolved from the accumulation buffers after every pass, under the lock
 	Image_4F imageBuffer;
-	bool imageBufferDirty; // does this image need to be resent to the GPU?
-
-	// setup the worker threads
-	static constexpr int NUM_THREADS = 1;
-	std::thread threads[ NUM_THREADS + 1 ];
-
-	static constexpr uint32_t REPORT_DELAY = 32; 				// reporter thread sleep duration, in ms
-	static constexpr uint32_t PROGRESS_INDICATOR_STOPS = 69; // cli spaces to take up
+	std::atomic< bool > imageBufferDirty{ false }; // does this image need to be resent to the GPU?
+	std::mutex imageLock;
 
 	static constexpr float scaleFactor = 0.618f;
 	static constexpr uint32_t X_IMAGE_DIM = 300 * scaleFactor;
 	static constexpr uint32_t Y_IMAGE_DIM = 200 * scaleFactor;
-	static constexpr uint32_t TILESIZE_XY = 4;
-	static constexpr uint32_t NUM_SAMPLES = 4;
-	// bool threadsShouldDie = false;
-
-	std::atomic< uint32_t > tileIndexCounter{ 0 };
-	std::atomic< uint32_t > tileFinishCounter{ 0 };
-	uint32_t totalTileCount = std::ceil( X_IMAGE_DIM / TILESIZE_XY ) * ( std::ceil( Y_IMAGE_DIM / TILESIZE_XY ) + 1 );
+	static constexpr uint32_t PACKET_XY = 4; // primary ray packets cover 4x4 pixels of a tile
+
+	// running sums per pixel - the luminance moments give the per tile error estimate for the adaptive sampling
+	std::vector< vec3 > colorSum;
+	std::vector< float > luminanceSum;
+	std::vector< float > luminanceSquaredSum;
+	std::vector< float > depth;
+	std::vector< uint32_t > sampleCount;
+
+	// scheduling happens on a background thread, so the passes can show up on screen as they finish
+	tileScheduler scheduler;
+	tileScheduler::settings_t renderSettings;
+	tileScheduler::stats_t lastRenderStats;
+	std::thread renderThread;
+	std::atomic< bool > rendering{ false };
+	std::atomic< bool > renderFinished{ false };
 
 	// camera parameterization could use work
 	const vec3 eyeLocation = vec3( -100.0f, 600.0f, 0.0f );
-	rng jitter = rng( 0.0f, 1.0f );
-	rng centeredJitter = rng( -1.0f, 1.0f );
 
 	testRenderer_t () {
 		// create the preview image - probably eventually use alpha channel to send traversal depth kind of stats
 		imageBuffer = Image_4F( X_IMAGE_DIM, Y_IMAGE_DIM );
 		imageBuffer.SaturateAlpha();
+
+		renderSettings.tileSize = 16;
+		renderSettings.initialSamples = 1;
+		renderSettings.maxSamples = 16;
+		renderSettings.errorThreshold = 0.02f;
+	}
+
+	~testRenderer_t () {
+		scheduler.Cancel();
+		if ( renderThread.joinable() ) {
+			renderThread.join();
+		}
+	}
+
+	// false if there's already a render going
+	bool StartRender () {
+		if ( rendering.exchange( true ) ) {
+			return false;
+		}
+		if ( renderThread.joinable() ) {
+			renderThread.join();
+		}
+		renderThread = std::thread( [ this ] () {
+			acceleratedTraversal();
+			rendering = false;
+			renderFinished = true;
+		} );
+		return true;
 	}
 
 	// accelerated traversal, for comparison
 	void acceleratedTraversal () {
+		const size_t numPixels = size_t( imageBuffer.Width() ) * imageBuffer.Height();
+		colorSum.assign( numPixels, vec3( 0.0f ) );
+		luminanceSum.assign( numPixels, 0.0f );
+		luminanceSquaredSum.assign( numPixels, 0.0f );
+		depth.assign( numPixels, MAX_DISTANCE );
+		sampleCount.assign( numPixels, 0 );
+
+		lastRenderStats = scheduler.Run( imageBuffer.Width(), imageBuffer.Height(), renderSettings,
+			[ this ] ( const tileScheduler::work_t &work, uint32_t ) { return RenderTile( work ); },
+			[ this ] ( uint32_t, uint32_t ) { Resolve(); } );
+
+		cout << lastRenderStats.seconds << " sec, " << lastRenderStats.MRaysPerSecond() << " Mrays/s" << endl;
+	}
 
-		// so we are going to want to do some more setup for the camera, maybe
-		for ( int id = 0; id <= NUM_THREADS; id++ ) {
-			threads[ id ] = ( id == NUM_THREADS ) ? std::thread( // reporter thread
-				[ this, id ] () {
-					const auto tstart = std::chrono::system_clock::now();
-					while ( true ) { // report timing
-						// show status - break on 100% completion
-						cout << "\r\033[K";
-						cout << "["; //  [=====....................] where equals shows progress
-						const float frac = float( tileFinishCounter ) / float( totalTileCount );
-						int numFill = std::floor( PROGRESS_INDICATOR_STOPS * frac ) - 1;
-						for( int i = 0; i <= numFill; i++ ) cout << "=";
-						for( uint32_t i = 0; i < PROGRESS_INDICATOR_STOPS - numFill; i++ ) cout << ".";
-						cout << "]" << std::flush;
-						cout << "[" << std::setw( 3 ) << 100.0 * frac << "% " << std::flush;
-
-						cout << std::setw( 7 ) << std::showpoint << std::chrono::duration_cast< std::chrono::milliseconds >( std::chrono::system_clock::now() - tstart ).count() / 1000.0 << " sec]" << std::flush;
-
-						if( tileFinishCounter >= totalTileCount ){
-							const float seconds = std::chrono::duration_cast< std::chrono::milliseconds >( std::chrono::system_clock::now() - tstart ).count() / 1000.0;
-							cout << "\r\033[K[" << std::string( PROGRESS_INDICATOR_STOPS + 1, '=' ) << "] " << seconds << " sec"<< endl;
-							break;
-						}
+	// average the sums into the display image
+	void Resolve () {
+		std::lock_guard< std::mutex > lock( imageLock );
+		for ( uint32_t y = 0; y < imageBuffer.Height(); y++ ) {
+			for ( uint32_t x = 0; x < imageBuffer.Width(); x++ ) {
+				const size_t i = x + size_t( y ) * imageBuffer.Width();
+				const vec3 color = ( sampleCount[ i ] > 0 ) ? colorSum[ i ] / float( sampleCount[ i ] ) : vec3( 0.0f );
+				color_4F val;
+				val[ red ] = color.r;
+				val[ green ] = color.g;
+				val[ blue ] = color.b;
+				val[ alpha ] = depth[ i ];
+				imageBuffer.SetAtXY( x, y, val );
+			}
+		}
+		imageBufferDirty = true;
+	}
 
-						// sleep for some amount of time before showing again
-						std::this_thread::sleep_for( std::chrono::milliseconds( REPORT_DELAY ) );
+	tileScheduler::result_t RenderTile ( const tileScheduler::work_t &work ) {
+		const tileScheduler::tile_t &tile = work.tile;
+		tileScheduler::result_t result;
+
+		// seeded from the tile and the pass, so the threads don't share generator state
+		rng jitter = rng( 0.0f, 1.0f, tile.index * 7919u + work.pass );
+		rng centeredJitter = rng( -1.0f, 1.0f, tile.index * 7919u + work.pass + 104729u );
+
+		// primary rays go through as packets, one per sample, with one ray for each pixel in a 4x4 block of the tile
+		static_assert( PACKET_XY * PACKET_XY == rayPacket_t::SIZE, "primary ray packets cover a 4x4 block" );
+		for ( uint32_t blockY = 0; blockY < tile.height; blockY += PACKET_XY ) {
+			for ( uint32_t blockX = 0; blockX < tile.width; blockX += PACKET_XY ) {
+				for ( uint32_t i = 0; i < work.sampleCount; i++ ) {
+					rayPacket_t packet;
+					for ( int p = 0; p < rayPacket_t::SIZE; p++ ) {
+						// lanes off the edge of the tile trace a clamped pixel, and their results are dropped
+						const uint32_t x = tile.x + std::min( blockX + p % PACKET_XY, tile.width - 1 );
+						const uint32_t y = tile.y + std::min( blockY + p / PACKET_XY, tile.height - 1 );
+						const float xRemap = RangeRemap( x + jitter(), 0, imageBuffer.Width(), 10.0f, -10.0f );
+						const float yRemap = RangeRemap( y + jitter(), 0, imageBuffer.Height(), 10.0f, -10.0f );
+
+						// test a ray against the triangles
+						ray_t &ray = packet.rays[ p ];
+						// ray.origin = 100.0f * vec3( xRemap * ( float( imageBuffer.Width() ) / float( imageBuffer.Height() ) ), yRemap, 0.0f ) + eyeLocation;
+						ray.origin = 40.0f * vec3( xRemap * ( float( imageBuffer.Width() ) / float( imageBuffer.Height() ) ), yRemap, 0.0f ) + eyeLocation;
+						// ray.direction = normalize( vec3( 1.0f, 0.0f, 0.25f ) );
+						ray.direction = normalize( vec3( 0.0f, 0.0f, 1.0f ) );
 					}
-				}
-			) : std::thread( // worker threads
-				[ this, id ] () {
-					// distribution of work is tile based
-					while ( true ) {
-						// solve for x and y from the index
-						unsigned long long index = tileIndexCounter.fetch_add( 1 );
-						if ( index >= totalTileCount ) break;
-
-						int numTilesX = int( std::ceil( float( X_IMAGE_DIM ) / float( TILESIZE_XY ) ) );
-
-						const int tile_x_index = index % numTilesX;
-						const int tile_y_index = ( index / numTilesX );
-
-						const int tile_base_x = tile_x_index * TILESIZE_XY;
-						const int tile_base_y = tile_y_index * TILESIZE_XY;
-
-						for ( uint32_t y = tile_base_y; y < tile_base_y + TILESIZE_XY; y++ )
-						for ( uint32_t x = tile_base_x; x < tile_base_x + TILESIZE_XY; x++ ) {
-
-							const float numSamples = NUM_SAMPLES;
-							accelerationStructure.RayComplexityCounterReset();
-
-							vec3 color = vec3( 0.0f );
-							float d = MAX_DISTANCE;
-
-							for ( uint32_t i = 0; i < NUM_SAMPLES; i++ ) {
-								const float xRemap = RangeRemap( x + jitter(), 0, imageBuffer.Width(), 10.0f, -10.0f );
-								const float yRemap = RangeRemap( y + jitter(), 0, imageBuffer.Height(), 10.0f, -10.0f );
-
-								// test a ray against the triangles
-								ray_t ray;
-								// ray.origin = 100.0f * vec3( xRemap * ( float( imageBuffer.Width() ) / float( imageBuffer.Height() ) ), yRemap, 0.0f ) + eyeLocation;
-								ray.origin = 40.0f * vec3( xRemap * ( float( imageBuffer.Width() ) / float( imageBuffer.Height() ) ), yRemap, 0.0f ) + eyeLocation;
-								// ray.direction = normalize( vec3( 1.0f, 0.0f, 0.25f ) );
-								ray.direction = normalize( vec3( 0.0f, 0.0f, 1.0f ) );
-
-								accelerationStructure.acceleratedTraversal( ray );
-
-								if ( ray.distance < MAX_DISTANCE ) {
-									triangle_t triangle = accelerationStructure.triangleList[ ray.triangleIdx ];
-									vec3 barycentricCoords = GetBarycentricCoords( triangle.vertex0, triangle.vertex1, triangle.vertex2, ray.origin + ray.distance * ray.direction );
-
-									// computing a lighting term
-									const vec3 lightSize = vec3( 1.0f, 1.0f, 1.0f );
-									const vec3 lightPosition = vec3( 0.0f + lightSize.x * centeredJitter(), 500.0f + lightSize.y * centeredJitter(), 0.0f + lightSize.z * centeredJitter() );
-									ray_t lightRay;
-									lightRay.origin = ray.origin + ray.distance * ray.direction + 0.01f * triangle.normal;
-									lightRay.direction = normalize( lightPosition - lightRay.origin );
-									vec3 lightTerm = vec3( 0.01f );
-
-									accelerationStructure.acceleratedTraversal( lightRay );
-									const float dLight = distance( lightRay.origin, lightPosition );
-									if ( lightRay.distance >= dLight ) {
-									// if ( lightRay.distance < 20.0f ) {
-									// if ( distance( lightRay.origin, vec3( 300.0f ) ) < 200.0f ) {
-
-										vec3 lightColor = palette::paletteRef( RemapRange( lightPosition.z, -lightSize.z, lightSize.z, 0.0f, 1.0f ) );
-										lightTerm = vec3( 100.0f / std::pow( dLight, 1.2f ) ) * lightColor;
-										// lightTerm = 1.0f;
-									}
-
-									// going to have to move this into the traversal, if I want to support alpha testing
-									vec2 interpolatedTC =
-										barycentricCoords.x * triangle.texcoord0.xy() +
-										barycentricCoords.y * triangle.texcoord1.xy() +
-										barycentricCoords.z * triangle.texcoord2.xy();
-
-									int texturePick = triangle.texcoord0.z * 2;
-
-									// color = accelerationStructure.s.TexRef( glm::mod( vec2( interpolatedTC.x, 1.0f - interpolatedTC.y ), vec2( 1.0f ) ), texturePick ).rgb();
-									color += lightTerm * accelerationStructure.s.TexRef( glm::mod( interpolatedTC, vec2( 1.0f ) ), texturePick ).rgb() / numSamples;
-									// color = triangle.normal;
-
-									d = ray.distance;
-									// d = dLight;
-
-									// color = ray.origin + ray.distance * ray.direction;
-								}
+
+					accelerationStructure.acceleratedTraversal( packet );
+					result.rays += rayPacket_t::SIZE;
+
+					for ( int p = 0; p < rayPacket_t::SIZE; p++ ) {
+						const uint32_t localX = blockX + p % PACKET_XY;
+						const uint32_t localY = blockY + p / PACKET_XY;
+						if ( localX >= tile.width || localY >= tile.height ) continue;
+						const size_t pixel = ( tile.x + localX ) + size_t( tile.y + localY ) * imageBuffer.Width();
+
+						vec3 color = vec3( 0.0f );
+						ray_t &ray = packet.rays[ p ];
+						if ( ray.distance < MAX_DISTANCE ) {
+							triangle_t triangle = accelerationStructure.triangleList[ ray.triangleIdx ];
+							vec3 barycentricCoords = GetBarycentricCoords( triangle.vertex0, triangle.vertex1, triangle.vertex2, ray.origin + ray.distance * ray.direction );
+
+							// computing a lighting term
+							const vec3 lightSize = vec3( 1.0f, 1.0f, 1.0f );
+							const vec3 lightPosition = vec3( 0.0f + lightSize.x * centeredJitter(), 500.0f + lightSize.y * centeredJitter(), 0.0f + lightSize.z * centeredJitter() );
+							ray_t lightRay;
+							lightRay.origin = ray.origin + ray.distance * ray.direction + 0.01f * triangle.normal;
+							lightRay.direction = normalize( lightPosition - lightRay.origin );
+							vec3 lightTerm = vec3( 0.01f );
+
+							accelerationStructure.acceleratedTraversal( lightRay );
+							result.rays++;
+							const float dLight = distance( lightRay.origin, lightPosition );
+							if ( lightRay.distance >= dLight ) {
+							// if ( lightRay.distance < 20.0f ) {
+							// if ( distance( lightRay.origin, vec3( 300.0f ) ) < 200.0f ) {
+
+								vec3 lightColor = palette::paletteRef( RemapRange( lightPosition.z, -lightSize.z, lightSize.z, 0.0f, 1.0f ) );
+								lightTerm = vec3( 100.0f / std::pow( dLight, 1.2f ) ) * lightColor;
+								// lightTerm = 1.0f;
 							}
 
-							color_4F val;
-							val[ red ] = color.r;
-							val[ green ] = color.g;
-							val[ blue ] = color.b;
-							// val[ alpha ] = accelerationStructure.GetRayComplexityCounter() * ( hitSamples / numSamples );
-							val[ alpha ] = d;
-							imageBuffer.SetAtXY( x, y, val );
+							// going to have to move this into the traversal, if I want to support alpha testing
+							vec2 interpolatedTC =
+								barycentricCoords.x * triangle.texcoord0.xy() +
+								barycentricCoords.y * triangle.texcoord1.xy() +
+								barycentricCoords.z * triangle.texcoord2.xy();
+
+							int texturePick = triangle.texcoord0.z * 2;
+
+							// pick a mip level from the ray footprint - the pixel spacing projected onto the surface, scaled by how
+								// much texture this triangle stretches over how much world space
+							const float pixelWorldSize = 800.0f / float( imageBuffer.Height() );
+							const float cosTheta = std::max( std::abs( dot( triangle.normal, ray.direction ) ), 0.01f );
+							const float uvArea = std::abs( glm::determinant( mat2( triangle.texcoord1.xy() - triangle.texcoord0.xy(), triangle.texcoord2.xy() - triangle.texcoord0.xy() ) ) );
+							const float worldArea = glm::length( cross( triangle.vertex1 - triangle.vertex0, triangle.vertex2 - triangle.vertex0 ) );
+							const float texelFootprint = ( pixelWorldSize / std::sqrt( cosTheta ) ) * std::sqrt( uvArea / std::max( worldArea, 1e-12f ) ) * float( accelerationStructure.s.texSet[ texturePick ].Width() );
+							const float lod = std::log2( std::max( texelFootprint, 1e-6f ) );
+
+							// color = accelerationStructure.s.TexRef( glm::mod( vec2( interpolatedTC.x, 1.0f - interpolatedTC.y ), vec2( 1.0f ) ), texturePick ).rgb();
+							color = lightTerm * accelerationStructure.s.TexRef( glm::mod( interpolatedTC, vec2( 1.0f ) ), texturePick, lod ).rgb();
+							// color = triangle.normal;
+
+							depth[ pixel ] = ray.distance;
+							// d = dLight;
+
+							// color = ray.origin + ray.distance * ray.direction;
 						}
-						tileFinishCounter.fetch_add( 1 );
+
+						colorSum[ pixel ] += color;
+						const float luminance = dot( color, vec3( 0.2126f, 0.7152f, 0.0722f ) );
+						luminanceSum[ pixel ] += luminance;
+						luminanceSquaredSum[ pixel ] += luminance * luminance;
+						sampleCount[ pixel ]++;
 					}
 				}
-			);
+			}
 		}
-		for ( int id = 0; id <= NUM_THREADS; id++ ) {
-			threads[ id ].join();
+
+		// tile error is the worst pixel's standard error of the mean luminance, relative to that mean - a single
+			// sample has no variance estimate, so those stay at the default and can't retire
+		if ( work.firstSample + work.sampleCount > 1 ) {
+			result.error = 0.0f;
+			for ( uint32_t y = tile.y; y < tile.y + tile.height; y++ ) {
+				for ( uint32_t x = tile.x; x < tile.x + tile.width; x++ ) {
+					const size_t i = x + size_t( y ) * imageBuffer.Width();
+					const float n = float( sampleCount[ i ] );
+					const float mean = luminanceSum[ i ] / n;
+					const float variance = std::max( 0.0f, ( luminanceSquaredSum[ i ] - n * mean * mean ) / ( n - 1.0f ) );
+					result.error = std::max( result.error, std::sqrt( variance / n ) / ( mean + 0.01f ) );
+				}
+			}
 		}
+		return result;
 	}
 };
\ No newline at end of file
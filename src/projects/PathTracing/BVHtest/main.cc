@@ -8,6 +8,15 @@ public:
 
 	testRenderer_t renderer;
 
+	// the render runs in the background, and reads the model and the BVH while it does
+	bool RenderInProgress () {
+		if ( renderer.rendering ) {
+			terminal.addHistoryLine( terminal.csb.append( "Render in progress, wait for it to finish" ).flush() );
+			return true;
+		}
+		return false;
+	}
+
 	void OnInit () {
 		ZoneScoped;
 		{
@@ -32,6 +41,7 @@ public:
 			// == Load the Model =====================================================================
 			terminal.addCommand( { "LoadModel" }, {},
 				[=] ( args_t args ) {
+					if ( RenderInProgress() ) return;
 					auto tStart = std::chrono::system_clock::now();
 
 					// load the model
@@ -52,8 +62,18 @@ public:
 			// == Build the BVH ======================================================================
 			terminal.addCommand( { "BuildBVH" }, {},
 				[=] ( args_t args ) {
+					if ( RenderInProgress() ) return;
 					auto tStart = std::chrono::system_clock::now();
 
+					// a cache from an earlier run on the same mesh skips the build entirely
+					if ( renderer.accelerationStructure.LoadCache() ) {
+						auto tStop = std::chrono::system_clock::now();
+						float timeTaken = std::chrono::duration_cast< std::chrono::microseconds >( tStop - tStart ).count() / 1000.0f;
+						terminal.addHistoryLine( terminal.csb.append( "BVH loaded from cache in " + to_string( timeTaken ) + "ms" ).flush() );
+						terminal.addHistoryLine( terminal.csb.append( "BVH contains " + to_string( renderer.accelerationStructure.nodesUsed ) + " nodes, SAH cost " + to_string( renderer.accelerationStructure.SAHCost() ) ).flush() );
+						return;
+					}
+
 					// use the loaded model to build a bvh
 					renderer.accelerationStructure.BuildTree();
 
@@ -61,33 +81,140 @@ public:
 					auto tStop = std::chrono::system_clock::now();
 					float timeTaken = std::chrono::duration_cast< std::chrono::microseconds >( tStop - tStart ).count() / 1000.0f;
 					terminal.addHistoryLine( terminal.csb.append( "BVH Build finished in " + to_string( timeTaken ) + "ms" ).flush() );
+					terminal.addHistoryLine( terminal.csb.append( "BVH contains " + to_string( renderer.accelerationStructure.nodesUsed ) + " nodes, SAH cost " + to_string( renderer.accelerationStructure.SAHCost() ) ).flush() );
 
-				}, "Build the BVH from the currently loaded model." );
+					// collapse to the wide trees, for the SIMD traversal
+					tStart = std::chrono::system_clock::now();
+					renderer.accelerationStructure.Collapse();
+					tStop = std::chrono::system_clock::now();
+					timeTaken = std::chrono::duration_cast< std::chrono::microseconds >( tStop - tStart ).count() / 1000.0f;
+					terminal.addHistoryLine( terminal.csb.append( "Collapse to BVH4 ( " + to_string( renderer.accelerationStructure.bvh4.nodes.size() ) + " nodes ) and BVH8 ( " +
+						to_string( renderer.accelerationStructure.bvh8.nodes.size() ) + " nodes ) finished in " + to_string( timeTaken ) + "ms" ).flush() );
 
-			// == Render an Image ====================================================================
-			terminal.addCommand( { "RenderImage" }, {},
+					// and keep it for next time
+					renderer.accelerationStructure.SaveCache();
+
+				}, "Build the BVH from the currently loaded model, or load it from the cache if there's a matching one." );
+
+			// == Benchmark the BVH Build ============================================================
+			terminal.addCommand( { "BenchmarkBVH" }, {},
+				[=] ( args_t args ) {
+					if ( RenderInProgress() ) return;
+					bvh_t &bvh = renderer.accelerationStructure;
+					if ( bvh.triangleList.empty() ) {
+						terminal.addHistoryLine( terminal.csb.append( "No model loaded, run LoadModel first" ).flush() );
+						return;
+					}
+
+					// builds over growing prefixes of the model's triangle list, serial then parallel
+					const std::vector< triangle_t > fullList = bvh.triangleList;
+					std::vector< size_t > counts;
+					for ( size_t count = 1024; count < fullList.size(); count *= 4 ) {
+						counts.push_back( count );
+					}
+					counts.push_back( fullList.size() );
+
+					auto TimeBuild = [ &bvh ] ( const bool parallel ) {
+						auto tStart = std::chrono::system_clock::now();
+						bvh.BuildTree( parallel );
+						auto tStop = std::chrono::system_clock::now();
+						return std::chrono::duration_cast< std::chrono::microseconds >( tStop - tStart ).count() / 1000.0f;
+					};
+
+					terminal.addHistoryLine( terminal.csb.append( "BVH build benchmark, " + to_string( jbDE::GetThreadPool().NumThreads() ) + " threads" ).flush() );
+					for ( size_t count : counts ) {
+						bvh.triangleList.assign( fullList.begin(), fullList.begin() + count );
+
+						// serial build first, keep its output to check the parallel one against
+						const float serialTime = TimeBuild( false );
+						const std::vector< bvhNode_t > serialNodes( bvh.bvhNodes.begin(), bvh.bvhNodes.begin() + bvh.nodesUsed );
+						const std::vector< uint32_t > serialIndices = bvh.triangleIndices;
+						const float serialCost = bvh.SAHCost();
+
+						const float parallelTime = TimeBuild( true );
+						const bool identical = bvh.nodesUsed == serialNodes.size() && bvh.triangleIndices == serialIndices && bvh.SAHCost() == serialCost &&
+							memcmp( bvh.bvhNodes.data(), serialNodes.data(), serialNodes.size() * sizeof( bvhNode_t ) ) == 0;
+
+						terminal.addHistoryLine( terminal.csb.append( " " + to_string( count ) + " triangles: serial " + to_string( serialTime ) + "ms, parallel " + to_string( parallelTime ) + "ms, " +
+							to_string( bvh.nodesUsed ) + " nodes, SAH cost " + to_string( serialCost ) + ( identical ? "" : " ( MISMATCH )" ) ).flush() );
+					}
+
+					// leave the full model built
+					bvh.triangleList = fullList;
+					bvh.BuildTree();
+					bvh.Collapse();
+				}, "Time serial and parallel BVH builds over increasing triangle counts." );
+
+			// == Animate + Refit the BVH ============================================================
+			terminal.addCommand( { "RefitBVH" },
+				{ { "amount", FLOAT, "how far to jitter each triangle, in world units" } },
 				[=] ( args_t args ) {
+					if ( RenderInProgress() ) return;
+					bvh_t &bvh = renderer.accelerationStructure;
+					if ( bvh.bvhNodes.empty() ) {
+						terminal.addHistoryLine( terminal.csb.append( "No BVH built, run BuildBVH first" ).flush() );
+						return;
+					}
+
+					// stand-in for animated geometry, every triangle gets moved rigidly by a random offset
+					const float amount = args[ "amount" ].data.x;
+					rng offset = rng( -amount, amount );
+					for ( auto &triangle : bvh.triangleList ) {
+						const vec3 d = vec3( offset(), offset(), offset() );
+						triangle.vertex0 += d;
+						triangle.vertex1 += d;
+						triangle.vertex2 += d;
+					}
+
 					auto tStart = std::chrono::system_clock::now();
+					bvh_t::updateReport_t report = bvh.RefitAndRebuild();
+					auto tStop = std::chrono::system_clock::now();
+					float timeTaken = std::chrono::duration_cast< std::chrono::microseconds >( tStop - tStart ).count() / 1000.0f;
+
+					const string action = report.fullRebuild ? "full rebuild" : ( report.subtreesRebuilt > 0 ? to_string( report.subtreesRebuilt ) + " subtrees rebuilt" + ( report.compacted ? ", node list compacted" : "" ) : "refit only" );
+					terminal.addHistoryLine( terminal.csb.append( "BVH update finished in " + to_string( timeTaken ) + "ms, " + action ).flush() );
+					terminal.addHistoryLine( terminal.csb.append( " degradation " + to_string( report.degradationBefore ) + " -> " + to_string( report.degradationAfter ) + ", SAH cost " + to_string( bvh.SAHCost() ) ).flush() );
+				}, "Jitter the model's triangles, then refit the BVH, rebuilding degraded subtrees." );
 
+			// == Render an Image ====================================================================
+			terminal.addCommand( { "RenderImage" }, {},
+				[=] ( args_t args ) {
 					// add some cvars (with defaults) for setting the following:
 						// viewer position
 						// viewer direction
 						// ...
 
-					// run the accelerated traversal
-					renderer.acceleratedTraversal();
+					// run the accelerated traversal in the background - OnUpdate picks up the passes as they finish
+					if ( renderer.StartRender() ) {
+						terminal.addHistoryLine( terminal.csb.append( "Render started" ).flush() );
+					} else {
+						terminal.addHistoryLine( terminal.csb.append( "Render already in progress" ).flush() );
+					}
 
-					// then put the result in the "Image Buffer" texture, to look at it
-					glBindTexture( GL_TEXTURE_2D, textureManager.Get( "Image Buffer" ) );
-					glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA32F, renderer.imageBuffer.Width(), renderer.imageBuffer.Height(), 0, GL_RGBA, GL_FLOAT, ( void * ) renderer.imageBuffer.GetImageDataBasePtr() );
-
-					// maybe also save to disk, tbd
-
-					auto tStop = std::chrono::system_clock::now();
-					float timeTaken = std::chrono::duration_cast< std::chrono::microseconds >( tStop - tStart ).count() / 1000.0f;
-					terminal.addHistoryLine( terminal.csb.append( "Render Image finished in " + to_string( timeTaken ) + "ms" ).flush() );
+				}, "Render an image from the built BVH, progressively." );
 
-				}, "Render an image from the built BVH." );
+			terminal.addCommand( { "RenderSettings" },
+				{ { "tileSize", INT, "tile width and height in pixels" }, { "maxSamples", INT, "samples per pixel for tiles that don't converge early" }, { "threshold", FLOAT, "relative error a tile has to get under to stop sampling, zero to always take maxSamples" } },
+				[=] ( args_t args ) {
+					if ( RenderInProgress() ) return;
+					renderer.renderSettings.tileSize = std::max( 1, int( args[ "tileSize" ].data.x ) );
+					renderer.renderSettings.maxSamples = std::max( 1, int( args[ "maxSamples" ].data.x ) );
+					renderer.renderSettings.errorThreshold = std::max( 0.0f, float( args[ "threshold" ].data.x ) );
+					terminal.addHistoryLine( terminal.csb.append( "Render settings updated" ).flush() );
+				}, "Set the tile size, sample count and adaptive sampling threshold used by RenderImage." );
+
+			terminal.addCommand( { "TraversalMode" },
+				{ { "width", INT, "tree width to traverse - 2 for the binary tree, 4 or 8 for the collapsed wide trees" } },
+				[=] ( args_t args ) {
+					if ( RenderInProgress() ) return;
+					const int width = args[ "width" ].data.x;
+					if ( width == 2 || width == 4 || width == 8 ) {
+						renderer.accelerationStructure.traversalMode = bvh_t::traversalMode_t( width );
+						terminal.addHistoryLine( terminal.csb.append( "Traversal now uses the " + ( width == 2 ? string( "binary" ) : "BVH" + to_string( width ) ) + " tree" ).flush() );
+					} else {
+						terminal.addHistoryLine( terminal.csb.append( "Width must be 2, 4 or 8" ).flush() );
+					}
+				}, "Pick the BVH width used for traversal." );
 		}
 	}
 
@@ -166,6 +293,25 @@ public:
 		ZoneScoped; scopedTimer Start( "Update" );
 		// application-specific update code
 
+		// put the latest pass of the render in the "Image Buffer" texture, to look at it
+		if ( renderer.imageBufferDirty.exchange( false ) ) {
+			std::lock_guard< std::mutex > lock( renderer.imageLock );
+			glBindTexture( GL_TEXTURE_2D, textureManager.Get( "Image Buffer" ) );
+			glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA32F, renderer.imageBuffer.Width(), renderer.imageBuffer.Height(), 0, GL_RGBA, GL_FLOAT, ( void * ) renderer.imageBuffer.GetImageDataBasePtr() );
+		}
+
+		// report once the last pass is done
+		if ( renderer.renderFinished.exchange( false ) ) {
+			const tileScheduler::stats_t &stats = renderer.lastRenderStats;
+			terminal.addHistoryLine( terminal.csb.append( "Render Image finished in " + to_string( stats.seconds * 1000.0f ) + "ms, " + to_string( stats.passes ) + " passes, up to " + to_string( stats.samplesPerPixel ) + " samples per pixel" ).flush() );
+			terminal.addHistoryLine( terminal.csb.append( to_string( stats.rays ) + " rays traced, " + to_string( stats.MRaysPerSecond() ) + " Mrays/s" ).flush() );
+			terminal.addHistoryLine( terminal.csb.append( to_string( stats.tilesRendered ) + " tiles rendered ( " + to_string( stats.tilesRetired ) + " retired early ), " + to_string( stats.meanTileMs ) + "ms mean / " + to_string( stats.maxTileMs ) + "ms max per tile, " + to_string( stats.steals ) + " steals" ).flush() );
+			string utilization = "Thread utilization:";
+			for ( float u : stats.utilization ) {
+				utilization += " " + to_string( int( 100.0f * u ) ) + "%";
+			}
+			terminal.addHistoryLine( terminal.csb.append( utilization ).flush() );
+		}
 	}
 
 	void OnRender () {
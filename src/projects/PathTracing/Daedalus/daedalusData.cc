@@ -769,29 +769,17 @@ void Daedalus::DDAVATTex() {
 	#define BLOCKDIM 512
 	voxelAutomataTerrain vR( 9, flip, string( "r" ), initMode, lambda, beta, mag, glm::bvec3( minusX, minusY, minusZ ), glm::bvec3( plusX, plusY, plusZ ) );
 	strcpy( inputString, vR.getShortRule().c_str() );
-	std::vector< uint8_t > loaded;
-	loaded.reserve( BLOCKDIM * BLOCKDIM * BLOCKDIM * 4 );
-	for ( int x = 0; x < BLOCKDIM; x++ ) {
-		for ( int y = 0; y < BLOCKDIM; y++ ) {
-			for ( int z = 0; z < BLOCKDIM; z++ ) {
-				glm::vec4 color;
-				switch ( vR.state[ x ][ y ][ z ] ) {
-					// case 0: color = color0; break;
-					// case 1: color = color1; break;
-					// case 2: color = color2; break;
-					// default: color = color0; break;
-					case 0: color = glm::vec4( palette::paletteRef( 0.2f + jitter() ), 0.0f ); break;
-					case 1: color = glm::vec4( palette::paletteRef( 0.5f + jitter() ), 0.1f ); break;
-					case 2: color = glm::vec4( palette::paletteRef( 0.8f + jitter() ), 0.2f + alphaOffset() ); break;
-					// default: color = color0; break;
-				}
-				loaded.push_back( static_cast<uint8_t>( color.x * 255.0 ) );
-				loaded.push_back( static_cast<uint8_t>( color.y * 255.0 ) );
-				loaded.push_back( static_cast<uint8_t>( color.z * 255.0 ) );
-				loaded.push_back( static_cast<uint8_t>( color.w * 255.0 ) );
-			}
+	std::vector< uint8_t > loaded( size_t( BLOCKDIM ) * BLOCKDIM * BLOCKDIM * 4 );
+	vR.ExportRGBA( loaded.data(), glm::ivec3( BLOCKDIM ), [ & ] ( uint8_t state ) {
+		switch ( state ) {
+			// case 0: return color0;
+			// case 1: return color1;
+			// case 2: return color2;
+			case 0: return glm::vec4( palette::paletteRef( 0.2f + jitter() ), 0.0f );
+			case 1: return glm::vec4( palette::paletteRef( 0.5f + jitter() ), 0.1f );
+			default: return glm::vec4( palette::paletteRef( 0.8f + jitter() ), 0.2f + alphaOffset() );
 		}
-	}
+	} );
 	static bool firstRun = true;
 	if ( !firstRun ) {
 		textureManager.Remove( "DDATex" );
@@ -821,7 +809,7 @@ void Daedalus::HeightmapTex() {
 	int numSteps = 100;
 	for ( int i = 0; i <= numSteps; i++ ) {
 		cout << "\rRunning eroder: " << i << " / " << numSteps << std::flush;
-		p.Erode( 1000 );
+		p.ErodeParallel( 1000 );
 	}
 
 	cout << endl;
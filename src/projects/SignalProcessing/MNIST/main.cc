@@ -226,7 +226,7 @@ struct NeuralNet {
 		outputGradient.resize( 10, 0.0f );
 	}
 
-	void Forward ( NNLayer layer, vector< float > &inputData, vector< float > &outputData ) {
+	void Forward ( const NNLayer &layer, vector< float > &inputData, vector< float > &outputData ) {
 		// initialize outputs with the bias values
 		for ( uint32_t i = 0; i < layer.outputSize; i++ ) {
 			outputData[ i ] = layer.biases[ i ];
@@ -246,7 +246,7 @@ struct NeuralNet {
 		}
 	}
 
-	void Backward ( NNLayer layer, vector< float > &inputData, vector< float > &outputGradient, vector< float > &inputGradient ) {
+	void Backward ( NNLayer &layer, vector< float > &inputData, vector< float > &outputGradient, vector< float > &inputGradient ) {
 	// calculating gradients, proceeds backwards
 
 		// updating gradients
@@ -284,7 +284,7 @@ struct NeuralNet {
 
 	float Train ( uint32_t i ) {
 		// load image i (from training set)
-		MNISTImage currentImage = trainImages[ i ];
+		const MNISTImage &currentImage = trainImages[ i ];
 
 		// put it in the first layer
 		uint32_t index = 0;
@@ -295,10 +295,6 @@ struct NeuralNet {
 			}
 		}
 
-		for ( uint32_t i = 0; i < 28 * 28; i++ ) {
-			cout << std::fixed <<std::setprecision( 4 ) << inputData[ i ] << ", ";
-		}
-
 		// forward propagation
 		Forward( hiddenLayer, inputData, hiddenData );
 		Forward( outputLayer, hiddenData, outputData );
@@ -307,7 +303,6 @@ struct NeuralNet {
 		// calculate output gradients (compared to known label)
 		for ( uint32_t i = 0; i < outputLayer.outputSize; i++ ) {
 			outputGradient[ i ] = outputData[ i ] - ( i == currentImage.label ? 1.0f : 0.0f );
-			cout << std::fixed <<std::setprecision( 4 ) << outputData[ i ] << " ( " << std::fixed <<std::setprecision( 4 ) << outputGradient[ i ] << " ), ";
 		}
 
 		// backwards propagation
@@ -326,7 +321,7 @@ struct NeuralNet {
 
 	uint8_t Predict ( uint32_t i ) {
 		// load in image i (from testing set)
-		MNISTImage currentImage = testImages[ i ];
+		const MNISTImage &currentImage = testImages[ i ];
 
 		// put it in the first layer
 		uint32_t index = 0;
@@ -352,6 +347,280 @@ struct NeuralNet {
 
 		return maxOutput;
 	}
+
+//=============================================================================
+// mini-batch path - same network, same layers, but a batch of samples goes through each layer as one matrix product,
+	// instead of a matrix-vector product per sample. The batch is cut into fixed size slices that run on the thread
+	// pool, each slice accumulates its own weight gradients, and those get summed into the real layers in slice order,
+	// so the result doesn't depend on the thread count. Gradients are summed over the batch rather than averaged, so
+	// learningRate and momentum mean about the same thing they do for the per-sample path
+	uint32_t batchSize = 64;
+	static constexpr uint32_t sliceSize = 16;
+
+	// images unpacked to floats once, one row of 784 per image, in the same order Train() reads them
+	vector< float > trainInputs, testInputs;
+	vector< uint8_t > trainLabels, testLabels;
+
+	void PackImages ( const vector< MNISTImage > &images, vector< float > &inputs, vector< uint8_t > &labels ) {
+		inputs.resize( images.size() * 28 * 28 );
+		labels.resize( images.size() );
+		for ( size_t n = 0; n < images.size(); n++ ) {
+			float *row = &inputs[ n * 28 * 28 ];
+			for ( uint32_t y = 0; y < 28; y++ ) {
+				for ( uint32_t x = 0; x < 28; x++ ) {
+					row[ x + y * 28 ] = images[ n ].data[ x ][ y ] / 255.0f;
+				}
+			}
+			labels[ n ] = images[ n ].label;
+		}
+	}
+
+	// C( M x N ) += A( M x K ) * B( K x N ), all row major. K is walked in blocks so the block of B stays in cache
+		// across all the rows of A, and the inner loop is a contiguous multiply-add over a row of C, which the compiler
+		// vectorizes. Zero inputs are skipped, which is most of an MNIST image
+	static void GEMM ( const float *A, const float *B, float *C, const uint32_t M, const uint32_t K, const uint32_t N ) {
+		constexpr uint32_t kBlock = 32;
+		for ( uint32_t k0 = 0; k0 < K; k0 += kBlock ) {
+			const uint32_t k1 = std::min( k0 + kBlock, K );
+			for ( uint32_t m = 0; m < M; m++ ) {
+				float *c = C + size_t( m ) * N;
+				for ( uint32_t k = k0; k < k1; k++ ) {
+					const float a = A[ size_t( m ) * K + k ];
+					if ( a == 0.0f ) {
+						continue;
+					}
+					const float *b = B + size_t( k ) * N;
+					for ( uint32_t n = 0; n < N; n++ ) {
+						c[ n ] += a * b[ n ];
+					}
+				}
+			}
+		}
+	}
+
+	// C( K x N ) += transpose( A( M x K ) ) * D( M x N ) - the weight gradient, input activations times output deltas
+	static void GEMM_TransposeA ( const float *A, const float *D, float *C, const uint32_t M, const uint32_t K, const uint32_t N ) {
+		constexpr uint32_t kBlock = 64;
+		for ( uint32_t k0 = 0; k0 < K; k0 += kBlock ) {
+			const uint32_t k1 = std::min( k0 + kBlock, K );
+			for ( uint32_t m = 0; m < M; m++ ) {
+				const float *d = D + size_t( m ) * N;
+				for ( uint32_t k = k0; k < k1; k++ ) {
+					const float a = A[ size_t( m ) * K + k ];
+					if ( a == 0.0f ) {
+						continue;
+					}
+					float *c = C + size_t( k ) * N;
+					for ( uint32_t n = 0; n < N; n++ ) {
+						c[ n ] += a * d[ n ];
+					}
+				}
+			}
+		}
+	}
+
+	// C( M x K ) = D( M x N ) * transpose( W( K x N ) ) - the input gradient. Done with W transposed ahead of time,
+		// so it's the same contiguous multiply-add as the others instead of a dot product per element
+	static void GEMM_TransposeB ( const float *D, const float *WT, float *C, const uint32_t M, const uint32_t K, const uint32_t N ) {
+		std::fill( C, C + size_t( M ) * K, 0.0f );
+		GEMM( D, WT, C, M, N, K );
+	}
+
+	// per slice scratch, plus its share of the gradients
+	struct batchSlice_t {
+		vector< float > hidden, output;					// activations
+		vector< float > hiddenDelta, outputDelta;		// gradients with respect to the pre-activation values
+		vector< float > hiddenWeightGradient, hiddenBiasGradient;
+		vector< float > outputWeightGradient, outputBiasGradient;
+		float loss = 0.0f;
+		uint32_t correct = 0;
+	};
+	vector< batchSlice_t > slices;
+	vector< float > outputWeightsTransposed;
+
+	// forward pass for count samples starting at inputs, leaves the softmax outputs in s.output
+	void ForwardSlice ( batchSlice_t &s, const float *inputs, const uint32_t count ) {
+		const uint32_t H = hiddenLayer.outputSize, O = outputLayer.outputSize;
+		s.hidden.resize( sliceSize * H );
+		s.output.resize( sliceSize * O );
+		for ( uint32_t m = 0; m < count; m++ ) {
+			std::copy( hiddenLayer.biases.begin(), hiddenLayer.biases.end(), s.hidden.begin() + m * H );
+			std::copy( outputLayer.biases.begin(), outputLayer.biases.end(), s.output.begin() + m * O );
+		}
+		GEMM( inputs, hiddenLayer.weights.data(), s.hidden.data(), count, hiddenLayer.inputSize, H );
+		for ( uint32_t i = 0; i < count * H; i++ ) {
+			s.hidden[ i ] = std::max( s.hidden[ i ], 0.0f );
+		}
+		GEMM( s.hidden.data(), outputLayer.weights.data(), s.output.data(), count, H, O );
+		vector< float > row( O );
+		for ( uint32_t m = 0; m < count; m++ ) {
+			// ReLU then softmax, same as the per-sample path
+			for ( uint32_t i = 0; i < O; i++ ) {
+				row[ i ] = std::max( s.output[ m * O + i ], 0.0f );
+			}
+			SoftMax( row );
+			std::copy( row.begin(), row.end(), s.output.begin() + m * O );
+		}
+	}
+
+	uint8_t ArgMax ( const float *output ) const {
+		uint8_t best = 0;
+		for ( uint32_t i = 1; i < outputLayer.outputSize; i++ ) {
+			if ( output[ i ] > output[ best ] ) {
+				best = i;
+			}
+		}
+		return best;
+	}
+
+	// one training step over the samples listed in order[ first, first + count )
+	void TrainBatch ( const vector< uint32_t > &order, const uint32_t first, const uint32_t count ) {
+		const uint32_t I = hiddenLayer.inputSize, H = hiddenLayer.outputSize, O = outputLayer.outputSize;
+		const uint32_t numSlices = ( count + sliceSize - 1 ) / sliceSize;
+		if ( slices.size() < numSlices ) {
+			slices.resize( numSlices );
+		}
+
+		// the input gradient of the output layer needs its weights transposed, H x O -> O x H
+		outputWeightsTransposed.resize( size_t( O ) * H );
+		for ( uint32_t j = 0; j < H; j++ ) {
+			for ( uint32_t i = 0; i < O; i++ ) {
+				outputWeightsTransposed[ i * H + j ] = outputLayer.weights[ j * O + i ];
+			}
+		}
+
+		jbDE::GetThreadPool().ParallelFor( 0, numSlices, 1, [ & ] ( int64_t lo, int64_t hi ) {
+			vector< float > inputs( sliceSize * I );
+			for ( int64_t si = lo; si < hi; si++ ) {
+				batchSlice_t &s = slices[ si ];
+				const uint32_t sliceFirst = first + uint32_t( si ) * sliceSize;
+				const uint32_t sliceCount = std::min( sliceSize, first + count - sliceFirst );
+
+				// gather the shuffled samples into a contiguous block
+				for ( uint32_t m = 0; m < sliceCount; m++ ) {
+					const float *src = &trainInputs[ size_t( order[ sliceFirst + m ] ) * I ];
+					std::copy( src, src + I, inputs.begin() + m * I );
+				}
+				ForwardSlice( s, inputs.data(), sliceCount );
+
+				// output deltas, softmax + cross entropy
+				s.outputDelta.resize( sliceSize * O );
+				s.loss = 0.0f;
+				s.correct = 0;
+				for ( uint32_t m = 0; m < sliceCount; m++ ) {
+					const uint8_t label = trainLabels[ order[ sliceFirst + m ] ];
+					for ( uint32_t i = 0; i < O; i++ ) {
+						s.outputDelta[ m * O + i ] = s.output[ m * O + i ] - ( i == label ? 1.0f : 0.0f );
+					}
+					s.loss += -logf( s.output[ m * O + label ] + 1e-10f );
+					s.correct += ( ArgMax( &s.output[ m * O ] ) == label ) ? 1 : 0;
+				}
+
+				// back through the output layer, then the hidden ReLU
+				s.hiddenDelta.resize( sliceSize * H );
+				GEMM_TransposeB( s.outputDelta.data(), outputWeightsTransposed.data(), s.hiddenDelta.data(), sliceCount, H, O );
+				for ( uint32_t i = 0; i < sliceCount * H; i++ ) {
+					s.hiddenDelta[ i ] *= ( s.hidden[ i ] > 0.0f ) ? 1.0f : 0.0f;
+				}
+
+				// weight and bias gradients for this slice
+				s.outputWeightGradient.assign( size_t( H ) * O, 0.0f );
+				s.outputBiasGradient.assign( O, 0.0f );
+				s.hiddenWeightGradient.assign( size_t( I ) * H, 0.0f );
+				s.hiddenBiasGradient.assign( H, 0.0f );
+				GEMM_TransposeA( s.hidden.data(), s.outputDelta.data(), s.outputWeightGradient.data(), sliceCount, H, O );
+				GEMM_TransposeA( inputs.data(), s.hiddenDelta.data(), s.hiddenWeightGradient.data(), sliceCount, I, H );
+				for ( uint32_t m = 0; m < sliceCount; m++ ) {
+					for ( uint32_t i = 0; i < O; i++ ) {
+						s.outputBiasGradient[ i ] += s.outputDelta[ m * O + i ];
+					}
+					for ( uint32_t i = 0; i < H; i++ ) {
+						s.hiddenBiasGradient[ i ] += s.hiddenDelta[ m * H + i ];
+					}
+				}
+			}
+		} );
+
+		// sum the slices in order and apply the momentum update to the real layers
+		ApplyGradients( hiddenLayer, numSlices, &batchSlice_t::hiddenWeightGradient, &batchSlice_t::hiddenBiasGradient );
+		ApplyGradients( outputLayer, numSlices, &batchSlice_t::outputWeightGradient, &batchSlice_t::outputBiasGradient );
+	}
+
+	void ApplyGradients ( NNLayer &layer, const uint32_t numSlices, vector< float > batchSlice_t::*weightGradient, vector< float > batchSlice_t::*biasGradient ) {
+		auto Update = [ & ] ( vector< float > &values, vector< float > &valueMomentum, vector< float > batchSlice_t::*gradient, int64_t lo, int64_t hi ) {
+			for ( int64_t idx = lo; idx < hi; idx++ ) {
+				float grad = 0.0f;
+				for ( uint32_t si = 0; si < numSlices; si++ ) {
+					grad += ( slices[ si ].*gradient )[ idx ];
+				}
+				valueMomentum[ idx ] = momentum * valueMomentum[ idx ] + learningRate * grad;
+				values[ idx ] -= valueMomentum[ idx ];
+			}
+		};
+		jbDE::GetThreadPool().ParallelFor( 0, layer.weights.size(), 16384, [ & ] ( int64_t lo, int64_t hi ) {
+			Update( layer.weights, layer.weightMomentum, weightGradient, lo, hi );
+		} );
+		Update( layer.biases, layer.biasMomentum, biasGradient, 0, layer.biases.size() );
+	}
+
+	// fraction of the test set classified correctly, batched the same way
+	float Evaluate () {
+		const uint32_t I = hiddenLayer.inputSize, O = outputLayer.outputSize;
+		const uint32_t numSlices = uint32_t( ( testLabels.size() + sliceSize - 1 ) / sliceSize );
+		std::atomic< uint32_t > correct { 0 };
+		jbDE::GetThreadPool().ParallelFor( 0, numSlices, 16, [ & ] ( int64_t lo, int64_t hi ) {
+			batchSlice_t s;
+			for ( int64_t si = lo; si < hi; si++ ) {
+				const uint32_t first = uint32_t( si ) * sliceSize;
+				const uint32_t count = std::min( sliceSize, uint32_t( testLabels.size() ) - first );
+				ForwardSlice( s, &testInputs[ size_t( first ) * I ], count );
+				for ( uint32_t m = 0; m < count; m++ ) {
+					correct += ( ArgMax( &s.output[ m * O ] ) == testLabels[ first + m ] ) ? 1 : 0;
+				}
+			}
+		} );
+		return testLabels.empty() ? 0.0f : float( correct ) / float( testLabels.size() );
+	}
+
+	struct epochStats_t {
+		float seconds = 0.0f;
+		float samplesPerSecond = 0.0f;
+		float averageLoss = 0.0f;
+		float trainAccuracy = 0.0f;		// on the batches as they were trained, so slightly behind the final weights
+		float testAccuracy = 0.0f;
+	};
+
+	// one pass over the training set in a shuffled order, then the test set
+	epochStats_t TrainEpoch ( const uint32_t epoch ) {
+		if ( trainInputs.empty() ) {
+			PackImages( trainImages, trainInputs, trainLabels );
+			PackImages( testImages, testInputs, testLabels );
+		}
+
+		vector< uint32_t > order( trainLabels.size() );
+		std::iota( order.begin(), order.end(), 0u );
+		std::shuffle( order.begin(), order.end(), std::mt19937( 1234u + epoch ) );
+
+		epochStats_t stats;
+		const auto tStart = std::chrono::steady_clock::now();
+		double totalLoss = 0.0;
+		uint64_t totalCorrect = 0;
+		const uint32_t step = std::max( batchSize, 1u );
+		for ( uint32_t first = 0; first < order.size(); first += step ) {
+			const uint32_t count = std::min< uint32_t >( step, uint32_t( order.size() ) - first );
+			TrainBatch( order, first, count );
+			for ( uint32_t si = 0; si < ( count + sliceSize - 1 ) / sliceSize; si++ ) {
+				totalLoss += slices[ si ].loss;
+				totalCorrect += slices[ si ].correct;
+			}
+		}
+		stats.seconds = std::chrono::duration< float >( std::chrono::steady_clock::now() - tStart ).count();
+		stats.samplesPerSecond = float( order.size() ) / std::max( stats.seconds, 1e-6f );
+		stats.averageLoss = order.empty() ? 0.0f : float( totalLoss / order.size() );
+		stats.trainAccuracy = order.empty() ? 0.0f : float( totalCorrect ) / float( order.size() );
+		stats.testAccuracy = Evaluate();
+		return stats;
+	}
 };
 
 class MNIST final : public engineBase {
@@ -375,35 +644,18 @@ public:
 			MNIST_dataLoader data;
 			data.Load();
 
-			// // training + testing
-			// for ( uint epoch = 0; epoch < network.epochs; epoch++ ) {
-			// 	unscopedTimer epochTime;
-			// 	epochTime.tick();
-
-			// 	// training iterations
-			// 	float totalLoss = 0.0f;
-			// 	// for ( uint i = 0; i < trainImages.size(); i++ ) {
-			// 	for ( uint i = 0; i < 1; i++ ) {
-			// 		float loss = network.Train( i );
-			// 		totalLoss += loss;
-			// 		cout << "loss: " << totalLoss << endl;
-			// 	}
-
-			// 	// testing iterations
-			// 	int correct = 0;
-			// 	for ( uint i = 0; i < testImages.size(); i++ ) {
-			// 		uint prediction = network.Predict( i );
-			// 		// data.ShowTest( i );
-			// 		// cout << "predicted: " << prediction << endl << endl;
-			// 		if ( testImages[ i ].label == prediction ) {
-			// 			correct++;
-			// 		}
-			// 	}
-
-			// 	// report epoch results
-			// 	epochTime.tock();
-			// 	cout << "Epoch " << epoch + 1 << ", Accuracy: " << 100.0f * float( correct ) / float( testImages.size() ) << "% Avg. Loss: " << totalLoss / float( trainImages.size() ) << " Time: " << epochTime.timeCPU / 1000.0f << "s" << endl;
-			// }
+			// == Batched Training ====================================================================
+			terminal.addCommand( { "Train" },
+				{ { "epochs", INT, "passes over the training set" }, { "batchSize", INT, "samples per weight update" } },
+				[=] ( args_t args ) {
+					network.batchSize = std::max( 1, int( args[ "batchSize" ].data.x ) );
+					for ( int epoch = 0; epoch < int( args[ "epochs" ].data.x ); epoch++ ) {
+						const NeuralNet::epochStats_t stats = network.TrainEpoch( epoch );
+						const string report = "Epoch " + to_string( epoch + 1 ) + ", Accuracy: " + to_string( 100.0f * stats.testAccuracy ) + "% ( train " + to_string( 100.0f * stats.trainAccuracy ) + "% ) Avg. Loss: " + to_string( stats.averageLoss ) + " Time: " + to_string( stats.seconds ) + "s, " + to_string( int( stats.samplesPerSecond ) ) + " samples/s";
+						cout << report << endl;
+						terminal.addHistoryLine( terminal.csb.append( report ).flush() );
+					}
+				}, "Train the network with mini-batches, reporting accuracy on the test set after each epoch." );
 
 			// runNetwork();
 
@@ -1,31 +1,109 @@
 #include "../../../engine/engine.h"
 
+// decodes a wav and converts it to mono float at its own sample rate, used by both the live view and the offline path
+bool LoadMonoWAV ( const string &filename, std::vector< float > &samples, int &sampleRate ) {
+	SDL_AudioSpec wavSpec;
+	Uint32 wavLengthBytes;
+	Uint8* wavDataBuffer;
+	if ( !SDL_LoadWAV( filename.c_str(), &wavSpec, &wavDataBuffer, &wavLengthBytes ) ) {
+		cout << "\nCould not open test wav: " << SDL_GetError() << newline;
+		return false;
+	}
+
+	cout << "\nLoaded " << filename << ", " << wavLengthBytes << " bytes" << newline;
+	cout << "Details:" << newline;
+	cout << "\tSample Rate:\t\t" << wavSpec.freq << newline;
+	cout << "\tEndianness:\t\t" << ( ( SDL_AUDIO_ISBIGENDIAN( wavSpec.format ) ) ? "big" : "little" ) << newline;
+	cout << "\tSignedness:\t\t" << ( ( SDL_AUDIO_ISSIGNED( wavSpec.format ) ) ? "signed" : "unsigned" ) << newline;
+	cout << "\tData Type:\t\t" << ( ( SDL_AUDIO_ISFLOAT( wavSpec.format ) ) ? "float" : "integer" ) << newline;
+	cout << "\tBits Per Sample:\t" << ( int ) SDL_AUDIO_BITSIZE( wavSpec.format ) << newline;
+	cout << "\tChannels:\t\t" << ( int ) wavSpec.channels << newline;
+
+	// whatever the file had, we want one channel of floats
+	const SDL_AudioSpec monoSpec = { SDL_AUDIO_F32, 1, wavSpec.freq };
+	Uint8* convertedBuffer = nullptr;
+	int convertedLengthBytes = 0;
+	const bool converted = SDL_ConvertAudioSamples( &wavSpec, wavDataBuffer, int( wavLengthBytes ), &monoSpec, &convertedBuffer, &convertedLengthBytes );
+	SDL_free( wavDataBuffer );
+	if ( !converted ) {
+		cout << "Failed to convert samples: " << SDL_GetError() << newline;
+		return false;
+	}
+
+	const float *first = ( const float * ) convertedBuffer;
+	samples.assign( first, first + convertedLengthBytes / sizeof( float ) );
+	sampleRate = wavSpec.freq;
+	SDL_free( convertedBuffer );
+	return true;
+}
+
 class spectrogram final : public engineBase { // sample derived from base engine class
 public:
 	spectrogram () { Init(); OnInit(); PostInit(); }
 	~spectrogram () { DeInit(); Quit(); }
 
-	// static constexpr int N = 2048;
-	static constexpr int N = 800;
-	fftw_complex *inputData, *outputData;
-	fftw_plan p;
+	// short time fourier transform, making one waterfall row per hop
+	stftSettings_t stftSettings;
+	stft analyzer;
+	std::vector< float > magnitudes;
+
+	// the audio callback pushes each chunk it plays into this, and the update pulls hops out of it
+	sampleRing playedSamples;
 
-	// holding the audio data, pulling out 800 samples per frame
-		// ( 48000 samples per second / 60 frames per second = 800 samples per frame )
-	SDL_AudioStream * streamBufferAnalyze = NULL;
+	// the whole wav, as mono floats - the playback stream pulls from this through FeedPlayback()
+	std::vector< float > wavSamples;
+	int wavSampleRate = 48000;
+	size_t playhead = 0; // only touched on the audio thread, after init
+	SDL_AudioStream * playbackStream = NULL;
 
 	GLuint signalBuffer;
 	GLuint fftBuffer;
 
-	// load an audio file
-	SDL_AudioSpec wavSpec;
-	Uint32 wavLengthBytes;
-	Uint8* wavDataBuffer;
-
 	int paletteSelect = 10;
 	int waterfallRowUpdate = 0;
 	const int waterfallHeight = 1024;
 
+	// runs on SDL's audio thread when the device wants more data
+	static void SDLCALL FeedPlayback ( void *userdata, SDL_AudioStream *stream, int additionalAmount, int ) {
+		spectrogram &self = *( spectrogram * ) userdata;
+		const size_t count = std::min( size_t( additionalAmount ) / sizeof( float ), self.wavSamples.size() - self.playhead );
+		if ( count > 0 ) {
+			const float *chunk = &self.wavSamples[ self.playhead ];
+			SDL_PutAudioStreamData( stream, chunk, int( count * sizeof( float ) ) );
+			self.playedSamples.Push( chunk, uint32_t( count ) );
+			self.playhead += count;
+		}
+	}
+
+	// plan, window, and the buffers and waterfall texture that depend on the fft size
+	void ConfigureAnalysis () {
+		analyzer.Configure( stftSettings );
+		const uint32_t N = analyzer.Settings().fftSize;
+		magnitudes.assign( analyzer.NumBins(), 0.0f );
+
+		// declare buffers, to pass signal + fft to GPU - sized once here, updated in place after that
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, signalBuffer );
+		glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof( GLfloat ) * N, NULL, GL_DYNAMIC_DRAW );
+		glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 0, signalBuffer );
+
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, fftBuffer );
+		glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof( GLfloat ) * analyzer.NumBins(), NULL, GL_DYNAMIC_DRAW );
+		glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 1, fftBuffer );
+
+		// waterfall graph, spectrogram - update by rows, with new fft data
+		textureOptions_t opts;
+		opts.width			= N / 2;
+		opts.height			= waterfallHeight;
+		opts.dataType		= GL_R32F;
+		opts.minFilter		= GL_NEAREST;
+		opts.magFilter		= GL_NEAREST;
+		opts.textureType	= GL_TEXTURE_2D;
+		textureManager.Remove( "Waterfall" );
+		textureManager.Add( "Waterfall", opts );
+		textureManager.ZeroTexture2D( "Waterfall" );
+		waterfallRowUpdate = 0;
+	}
+
 	void OnInit () {
 		ZoneScoped;
 		{
@@ -34,77 +112,36 @@ public:
 			// something to put some basic data in the accumulator texture - specific to the demo project
 			shaders[ "Draw" ] = computeShader( "../src/projects/SignalProcessing/Spectrogram/shaders/draw.cs.glsl" ).shaderHandle;
 
-			// init fftw3 resources
-			inputData = ( fftw_complex* ) fftw_malloc( sizeof( fftw_complex ) * N );
-			outputData = ( fftw_complex* ) fftw_malloc( sizeof( fftw_complex ) * N );
-			p = fftw_plan_dft_1d( N, inputData, outputData, FFTW_FORWARD, FFTW_ESTIMATE );
-
-			// declare buffers, to pass signal + fft to GPU
 			glGenBuffers( 1, &signalBuffer );
-			glBindBuffer( GL_SHADER_STORAGE_BUFFER, signalBuffer );
-			glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof( GLfloat ) * N, NULL, GL_DYNAMIC_COPY );
-			glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 0, signalBuffer );
-
 			glGenBuffers( 1, &fftBuffer );
-			glBindBuffer( GL_SHADER_STORAGE_BUFFER, fftBuffer );
-			glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof( GLfloat ) * N, NULL, GL_DYNAMIC_COPY );
-			glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 0, fftBuffer );
-
-			// waterfall graph, spectrogram - update by rows, with new fft data
-			textureOptions_t opts;
-			opts.width			= N / 2;
-			opts.height			= waterfallHeight;
-			opts.dataType		= GL_R32F;
-			opts.minFilter		= GL_NEAREST;
-			opts.magFilter		= GL_NEAREST;
-			opts.textureType	= GL_TEXTURE_2D;
-			textureManager.Add( "Waterfall", opts );
+			ConfigureAnalysis();
 
 			// string filename = string( "../../Documents/cave14.wav" );
 			// string filename = string( "../../Documents/resultpele.wav" );
 			// string filename = string( "../../Documents/groupB.wav" );
 			string filename = string( "../../Documents/dennisMorrowMonoFloat.wav" );
 
-			if ( SDL_LoadWAV( filename.c_str(), &wavSpec, &wavDataBuffer, &wavLengthBytes ) == NULL ) {
-				cout << "\nCould not open test wav: " << SDL_GetError() << newline;
-			} else {
-				// Do stuff with the WAV data, and then...
-				cout << "\nLoaded " << filename << ", " << wavLengthBytes << " bytes" << newline;
-				cout << "Details:" << newline;
-				cout << "\tSample Rate:\t\t" << wavSpec.freq << newline;
-				cout << "\tEndianness:\t\t" << ( ( SDL_AUDIO_ISBIGENDIAN( wavSpec.format ) ) ? "big" : "little" ) << newline;
-				cout << "\tSignedness:\t\t" << ( ( SDL_AUDIO_ISSIGNED( wavSpec.format ) ) ? "signed" : "unsigned" ) << newline;
-				cout << "\tData Type:\t\t" << ( ( SDL_AUDIO_ISFLOAT( wavSpec.format ) ) ? "float" : "integer" ) << newline;
-				cout << "\tBits Per Sample:\t" << ( int ) SDL_AUDIO_BITSIZE( wavSpec.format ) << newline;
-				cout << "\tChannels:\t\t" << ( int ) wavSpec.channels << newline;
-
-				// create the audio stream, to pull data from -
-				// streamBufferAnalyze = SDL_NewAudioStream( AUDIO_F32, 1, 48000, AUDIO_F32, 1, 48000 );
-
+			if ( LoadMonoWAV( filename, wavSamples, wavSampleRate ) ) {
 				// SDL3 changes the interface a bit https://examples.libsdl.org/SDL3/audio/03-load-wav/
-				streamBufferAnalyze = SDL_OpenAudioDeviceStream( SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK , &wavSpec, NULL, NULL );
-				int rc = SDL_PutAudioStreamData( streamBufferAnalyze, wavDataBuffer, wavLengthBytes );
-				if ( rc == -1 ) {
-					cout << "Failed to put samples in stream: " << SDL_GetError() << newline;
+					// the stream asks for data through the callback, so we see exactly what gets played, as it's played
+				const SDL_AudioSpec playbackSpec = { SDL_AUDIO_F32, 1, wavSampleRate };
+				playbackStream = SDL_OpenAudioDeviceStream( SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &playbackSpec, FeedPlayback, this );
+				if ( playbackStream == NULL ) {
+					cout << "Failed to open playback stream: " << SDL_GetError() << newline;
+				} else {
+					SDL_ResumeAudioStreamDevice( playbackStream );
 				}
-
-				// // set the playback to begin
-				// SDL_AudioDeviceID dev = SDL_OpenAudioDevice( NULL, 0, &wavSpec, NULL, 0 );
-				// SDL_QueueAudio( dev, wavDataBuffer, wavLengthBytes );
-				// SDL_PauseAudioDevice( dev, 0 );
-
-				SDL_ResumeAudioStreamDevice( streamBufferAnalyze );
-
-				// free the data
-				SDL_free( wavDataBuffer );
 			}
 		}
 	}
 
 	void DeInit () {
-		fftw_destroy_plan( p );
-		fftw_free( inputData );
-		fftw_free( outputData );
+		// stops the callback, before the samples and the ring go away
+		if ( playbackStream != NULL ) {
+			SDL_DestroyAudioStream( playbackStream );
+		}
+		glDeleteBuffers( 1, &signalBuffer );
+		glDeleteBuffers( 1, &fftBuffer );
 	}
 
 	void HandleCustomEvents () {
@@ -144,6 +181,27 @@ public:
 			profilerWindow.Render(); // GPU graph is presented on top, CPU on bottom
 		}
 
+		{
+			ImGui::Begin( "Spectrogram", NULL, 0 );
+			// replanning measures new sizes, so it waits for the button rather than following the sliders
+			static int fftSize = int( stftSettings.fftSize );
+			static int hopSize = int( stftSettings.hopSize );
+			static int windowSelect = int( stftSettings.window );
+			const char * windowNames[] = { "Rectangular", "Hann", "Hamming", "Blackman" };
+			ImGui::SliderInt( "FFT Size", &fftSize, 64, 8192 );
+			ImGui::SliderInt( "Hop Size", &hopSize, 1, fftSize );
+			ImGui::Combo( "Window", &windowSelect, windowNames, IM_ARRAYSIZE( windowNames ) );
+			if ( ImGui::Button( "Apply" ) ) {
+				stftSettings.fftSize = uint32_t( fftSize );
+				stftSettings.hopSize = uint32_t( std::min( hopSize, fftSize ) );
+				stftSettings.window = stftWindow_t( windowSelect );
+				ConfigureAnalysis();
+			}
+			ImGui::Text( "%d bins, %.1f Hz apart, %.1f rows per second", int( analyzer.NumBins() ),
+				float( wavSampleRate ) / float( stftSettings.fftSize ), float( wavSampleRate ) / float( stftSettings.hopSize ) );
+			ImGui::End();
+		}
+
 		QuitConf( &quitConfirm ); // show quit confirm window, if triggered
 
 		if ( showDemoWindow ) ImGui::ShowDemoWindow( &showDemoWindow );
@@ -164,7 +222,7 @@ public:
 			const GLuint shader = shaders[ "Draw" ];
 			glUseProgram( shader );
 
-			glUniform1i( glGetUniformLocation( shader, "dataSize" ), N );
+			glUniform1i( glGetUniformLocation( shader, "dataSize" ), analyzer.Settings().fftSize );
 			glUniform1i( glGetUniformLocation( shader, "paletteSelect" ), paletteSelect );
 
 			// waterfall/spectrogram ring buffer
@@ -207,56 +265,27 @@ public:
 	void OnUpdate () {
 		ZoneScoped; scopedTimer Start( "Update" );
 
-		static float data[ N ];
-
-		/* // SDL2 Version
-		// get the data out of the audio stream
-		int gotten = SDL_GetAudioStreamData(streamBufferAnalyze, data, sizeof(data));
-		if ( gotten == -1 ) {
-			cout << "Uhoh, failed to get converted data: " << SDL_GetError() << newline;
-		}
-		*/
-
-		if ( SDL_GetAudioStreamAvailable( streamBufferAnalyze ) < ( int ) sizeof( data ) ) {
-			SDL_GetAudioStreamData( streamBufferAnalyze, ( void* ) data, ( int ) sizeof( data ) );
-			// SDL_PutAudioStreamData( streamBufferAnalyze, data, wavLengthBytes );
-		} else {
-			cout << "Uhoh, failed to get converted data: " << SDL_GetError() << newline;
-		}
-
-		for ( int i = 0; i < N; i++ ) {
-			inputData[ i ][ 0 ] = data[ i ];
-			inputData[ i ][ 1 ] = 0.0f;
-		}
-		fftw_execute( p );
-
-		// put it in the buffer for the shader to read ( note use of double precision on CPU, single on GPU )
-		static float inputDataCastToSinglePrecision[ N ] = { 0.0f };
-		static float outputDataCastToSinglePrecision[ N ] = { 0.0f };
+		// every hop that's been played since last frame gets a row in the waterfall
+		const uint32_t N = analyzer.Settings().fftSize;
+		bool updated = false;
+		while ( analyzer.Next( playedSamples, magnitudes.data() ) ) {
+			glBindTexture( GL_TEXTURE_2D, textureManager.Get( "Waterfall" ) );
+			glTexSubImage2D( GL_TEXTURE_2D, 0, 0, waterfallRowUpdate, N / 2, 1, GL_RED, GL_FLOAT, ( GLvoid * ) magnitudes.data() );
 
-		for ( int i = 0; i < N; i++ ) {
-			inputDataCastToSinglePrecision[ i ] = static_cast< float > ( inputData[ i ][ 0 ] );
-
-			// need to get magnitude from the complex numbers, here - angle is phase, not used
-			outputDataCastToSinglePrecision[ i ] = static_cast< float > (
-				sqrt( outputData[ i ][ 0 ] * outputData[ i ][ 0 ] + outputData[ i ][ 1 ] * outputData[ i ][ 1 ] ) );
+			waterfallRowUpdate--;
+			if ( waterfallRowUpdate < 0 ) {
+				waterfallRowUpdate = waterfallHeight - 1;
+			}
+			updated = true;
 		}
 
-		glBindBuffer( GL_SHADER_STORAGE_BUFFER, signalBuffer );
-		glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof( GLfloat ) * N, ( GLvoid * ) &inputDataCastToSinglePrecision, GL_DYNAMIC_COPY );
-		glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 0, signalBuffer );
-
-		glBindBuffer( GL_SHADER_STORAGE_BUFFER, fftBuffer );
-		glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof( GLfloat ) * N, ( GLvoid * ) &outputDataCastToSinglePrecision, GL_DYNAMIC_COPY );
-		glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 1, fftBuffer );
-
-		// update the next row in the spectrogram waterfall graph image, with the same data that was passed to the fftBuffer
-		glBindTexture( GL_TEXTURE_2D, textureManager.Get( "Waterfall" ) );
-		glTexSubImage2D( GL_TEXTURE_2D, 0, 0, waterfallRowUpdate, N / 2, 1, GL_RED, GL_FLOAT, ( GLvoid * ) &outputDataCastToSinglePrecision );
+		// latest window of signal and its spectrum, for the graphs
+		if ( updated ) {
+			glBindBuffer( GL_SHADER_STORAGE_BUFFER, signalBuffer );
+			glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizeof( GLfloat ) * N, ( GLvoid * ) analyzer.History() );
 
-		waterfallRowUpdate--;
-		if ( waterfallRowUpdate < 0 ) {
-			waterfallRowUpdate = waterfallHeight - 1;
+			glBindBuffer( GL_SHADER_STORAGE_BUFFER, fftBuffer );
+			glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizeof( GLfloat ) * analyzer.NumBins(), ( GLvoid * ) magnitudes.data() );
 		}
 	}
 
@@ -293,7 +322,92 @@ public:
 	}
 };
 
+// headless, for whole files - one row per hop, low frequencies on the left, same as the waterfall. A .exr output keeps
+	// the raw magnitudes, anything else gets the decibels remapped from [ peak - range, peak ] to black..white
+int SpectrogramOffline ( int argc, char *argv[] ) {
+	const auto Usage = [] () {
+		cerr << "  usage: Spectrogram --offline in.wav out.png [fft=N] [hop=N] [window=rectangular|hann|hamming|blackman] [range=dB]" << endl;
+		return 1;
+	};
+	if ( argc < 2 ) {
+		return Usage();
+	}
+	const string inputPath = argv[ 0 ];
+	const string outputPath = argv[ 1 ];
+	const bool rawOutput = std::filesystem::path( outputPath ).extension() == ".exr";
+
+	stftSettings_t settings;
+	float range = 90.0f;
+	for ( int i = 2; i < argc; i++ ) {
+		const string arg = argv[ i ];
+		const size_t equals = arg.find( '=' );
+		const string key = arg.substr( 0, equals );
+		const string value = ( equals == string::npos ) ? "" : arg.substr( equals + 1 );
+		if ( key == "fft" || key == "hop" || key == "range" ) {
+			try {
+				if ( key == "fft" ) {
+					settings.fftSize = uint32_t( std::max( 2, std::stoi( value ) ) );
+				} else if ( key == "hop" ) {
+					settings.hopSize = uint32_t( std::max( 1, std::stoi( value ) ) );
+				} else {
+					range = std::max( 1.0f, std::stof( value ) );
+				}
+			} catch ( const std::exception & ) {
+				cerr << "  bad value for " << key << ": \"" << value << "\"" << endl;
+				return Usage();
+			}
+		} else if ( key == "window" && ( value == "rectangular" || value == "hann" || value == "hamming" || value == "blackman" ) ) {
+			settings.window =	( value == "rectangular" ) ? stftWindow_t::RECTANGULAR :
+								( value == "hann" ) ? stftWindow_t::HANN :
+								( value == "hamming" ) ? stftWindow_t::HAMMING : stftWindow_t::BLACKMAN;
+		} else {
+			cerr << "  unknown argument " << arg << endl;
+			return 1;
+		}
+	}
+	settings.decibels = !rawOutput;
+
+	std::vector< float > samples;
+	int sampleRate;
+	if ( !LoadMonoWAV( inputPath, samples, sampleRate ) ) {
+		return 1;
+	}
+
+	const auto tStart = std::chrono::steady_clock::now();
+	stft analyzer( settings );
+	Image_1F result = analyzer.Analyze( samples.data(), samples.size() );
+	const float seconds = std::chrono::duration< float >( std::chrono::steady_clock::now() - tStart ).count();
+	cout << result.Height() << " frames of " << result.Width() << " bins in " << seconds << "s, "
+		<< ( float( samples.size() ) / float( sampleRate ) ) / seconds << "x realtime" << endl;
+
+	bool saved;
+	if ( rawOutput ) {
+		saved = result.Save( outputPath, Image_1F::backend::TINYEXR );
+	} else {
+		const float *dB = result.GetImageDataBasePtr();
+		const size_t count = size_t( result.Width() ) * result.Height();
+		const float peak = *std::max_element( dB, dB + count );
+		Image_4U image( result.Width(), result.Height() );
+		uint8_t *pixels = image.GetImageDataBasePtr();
+		for ( size_t i = 0; i < count; i++ ) {
+			const uint8_t v = uint8_t( 255.0f * std::clamp( 1.0f - ( peak - dB[ i ] ) / range, 0.0f, 1.0f ) );
+			pixels[ 4 * i + 0 ] = pixels[ 4 * i + 1 ] = pixels[ 4 * i + 2 ] = v;
+			pixels[ 4 * i + 3 ] = 255;
+		}
+		saved = image.Save( outputPath );
+	}
+	if ( !saved ) {
+		cerr << "  failed to write " << outputPath << endl;
+		return 1;
+	}
+	return 0;
+}
+
 int main ( int argc, char *argv[] ) {
+	if ( argc > 1 && string( argv[ 1 ] ) == "--offline" ) {
+		return SpectrogramOffline( argc - 2, argv + 2 );
+	}
+
 	spectrogram engineInstance;
 	while( !engineInstance.MainLoop() );
 	return 0;
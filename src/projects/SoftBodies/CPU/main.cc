@@ -55,6 +55,24 @@ public:
 				ImGui::Text(" ");
 				ImGui::SliderFloat( "Suspension K", &simulationModel.simParameters.suspensionKConstant, 0.0f, 15000.0f );
 				ImGui::SliderFloat( "Suspension Damping", &simulationModel.simParameters.suspensionDamping, 0.0f, 100.0f );
+				ImGui::Text(" ");
+				ImGui::Checkbox( "SoA Solver", &simulationModel.simParameters.useSoASolver );
+				ImGui::SliderInt( "Substeps Per Frame", &simulationModel.simParameters.substepsPerFrame, 1, 64 );
+				ImGui::SliderInt( "Solver Threads ( 0 = auto )", &simulationModel.simParameters.solverThreads, 0, int( std::thread::hardware_concurrency() ) );
+				ImGui::Text(" ");
+				static softbodyBenchmark benchmark;
+				static int benchmarkCopies = 1;
+				ImGui::SliderInt( "Benchmark Copies", &benchmarkCopies, 1, 1000 );
+				if ( ImGui::Button( "Benchmark" ) ) {
+					benchmark = simulationModel.Benchmark( std::max( 100, 10000 / benchmarkCopies ), benchmarkCopies ); // about the same amount of work at any size
+				}
+				if ( benchmark.ticks != 0 ) {
+					ImGui::Text( "%u ticks, %u copies", benchmark.ticks, benchmark.copies );
+					ImGui::Text( "Original:       %.2f M node updates/s", benchmark.originalNodeUpdatesPerSecond / 1e6f );
+					ImGui::Text( "Solver:         %.2f M node updates/s", benchmark.solverNodeUpdatesPerSecond / 1e6f );
+					ImGui::Text( "Solver x%-2u:     %.2f M node updates/s", benchmark.threads, benchmark.threadedNodeUpdatesPerSecond / 1e6f );
+					ImGui::Text( "Max difference: %g", benchmark.maxDifference );
+				}
 				ImGui::EndTabItem();
 			}
 			if ( ImGui::BeginTabItem( "Render" ) ) {
@@ -12,21 +12,9 @@ model::model() {
 	fnFractal->SetOctaveCount( 2 );
 
 	fnGenerator = fnFractal;
-
-	// spawn all the threads
-	// for ( int i = 0; i < numThreads; i++ ) {
-	// 	workerState[ i ] = WAITING;
-	// 	workerThreads[ i ] = std::thread( &model::MultiThreadUpdateFunc, this, i );
-	// }
 }
 
-model::~model() {
-//   // quit and join all the threads
-// 	for ( int i = 0; i < numThreads; i++ ) {
-// 		workerState[ i ] = QUIT;
-// 		workerThreads[ i ].join();
-// 	}
-}
+model::~model() {}
 
 void model::loadFramePoints() {
 	// clear out data, so this can also be used as a reset
@@ -163,6 +151,8 @@ void model::loadFramePoints() {
 	addEdge( 3, 32, SUSPENSION1 );
 	addEdge( 3, 36, SUSPENSION1 );
 	addEdge( 3, 38, SUSPENSION1 );
+
+	solver.Build( nodes );
 }
 
 void model::GPUSetup() {
@@ -363,72 +353,6 @@ void model::SingleThreadSoftbodyUpdate() {
 	}
 }
 
-void model::MultiThreadUpdateFunc ( int myThreadIndex ) {
-	// cout << "id is " << myThreadIndex << endl;
-	while ( workerState[ myThreadIndex ] != QUIT ) {
-		if ( workerState[ myThreadIndex ] == WAITING )
-			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
-		else if ( workerState[ myThreadIndex ] == WORKING ) {
-			// run the update for all the relevant nodes
-			for ( unsigned int n = myThreadIndex; n < nodes.size(); n += numThreads ) {
-				cout << "thread index " << myThreadIndex << " is updating node " << n << endl;
-				if ( !nodes[ n ].anchored ) {
-					glm::vec3 forceAccumulator = glm::vec3( 0, 0, 0 );
-					float k = 0;
-					float d = 0;
-					//get your forces from all the connections - accumulate in forceAccumulator vector
-					for ( auto& e : nodes[ n ].edges ) {
-						switch ( e.type ) {
-							case CHASSIS:
-							k = simParameters.chassisKConstant;
-							d = simParameters.chassisDamping;
-							break;
-							case SUSPENSION:
-							case SUSPENSION1:
-							k = simParameters.suspensionKConstant;
-							d = simParameters.suspensionDamping;
-							break;
-						}
-						//get positions of the two nodes involved
-						glm::vec3 myPosition = nodes[ n ].oldPosition;
-						glm::vec3 otherPosition = nodes[ e.node2 ].anchored ?
-						nodes[ e.node2 ].position :    // use new position for anchored nodes ( position is up to date )
-						nodes[ e.node2 ].oldPosition;  // use old position for unanchored nodes ( old value is what you use )
-
-						//less than 1 is shorter, greater than 1 is longer than base length
-						float springRatio = glm::distance( myPosition, otherPosition ) / e.baseLength;
-						forceAccumulator += -k * glm::normalize( myPosition - otherPosition ) * ( springRatio - 1 ); // spring force
-						forceAccumulator -= d * nodes[ n ].oldVelocity;                           //damping force
-					}
-					forceAccumulator += ( *nodes[ n ].mass ) * glm::vec3( 0.0f, -simParameters.gravity, 0.0f ); // add gravity
-					glm::vec3 acceleration = forceAccumulator / ( *nodes[ n ].mass );                           // get the resulting acceleration
-					nodes[ n ].velocity = nodes[ n ].oldVelocity + acceleration * simParameters.timeScale;    // compute the new velocity
-					nodes[ n ].position = nodes[ n ].oldPosition + nodes[ n ].velocity * simParameters.timeScale;      // get the new position
-				}
-			}
-			cout << "setting " << myThreadIndex << " to wait" << endl;
-			workerState[ myThreadIndex ] = WAITING;
-		}
-	}
-}
-
-bool model::AllThreadComplete () {
-	bool check = true;
-	for ( int i = 0; i < numThreads; i++ ) {
-		if ( workerState[ i ] == WORKING ) {
-			check = false;
-			cout << "thread " << i << " is still working" << endl;
-		}
-	}
-	return check;
-}
-
-void model::EnableAllWorkers () {
-	for( int i = 0; i < numThreads; i++ ) {
-		workerState[ i ] = WORKING;
-	}
-}
-
 void model::CachePreviousValues () {
 	for ( auto& n : nodes )
 		if ( !n.anchored ) {
@@ -447,27 +371,68 @@ void model::Update () {
 	nodes[ 2 ].position.y = getGroundPoint( nodes[ 2 ].position.x, nodes[ 2 ].position.z ) / displayParameters.scale + displayParameters.wheelDiameter;
 	nodes[ 3 ].position.y = getGroundPoint( nodes[ 3 ].position.x, nodes[ 3 ].position.z ) / displayParameters.scale + displayParameters.wheelDiameter;
 
-	// back up velocities and positions in the 'old' values
+	const uint32_t ticks = std::max( simParameters.substepsPerFrame, 1 );
+	if ( simParameters.useSoASolver ) {
+		solver.UpdateAnchors( nodes );
+		solver.Run( simParameters, ticks, std::max( simParameters.solverThreads, 0 ) );
+		solver.CopyOut( nodes );
+	} else {
+		for ( uint32_t i = 0; i < ticks; i++ ) {
+			// back up velocities and positions in the 'old' values
+			CachePreviousValues();
+			SingleThreadSoftbodyUpdate();
+		}
+		// keep the solver's copy in step, so switching back and forth doesn't jump
+		solver.Build( nodes );
+	}
 
-	// single threaded update structure
-	// auto tstart = std::chrono::high_resolution_clock::now();
-	// for ( int i = 0; i < 10; i++ ){
+	// pass the new GPU data
+	passNewGPUData();
+}
+
+softbodyBenchmark model::Benchmark( uint32_t ticks, uint32_t copies ) {
+	softbodyBenchmark result;
+	result.ticks = ticks = std::max( ticks, 1u );
+	result.copies = copies = std::max( copies, 1u );
+	const std::vector< node > saved = nodes;
+	auto Seconds = [] ( auto start ) { return std::chrono::duration< float >( std::chrono::steady_clock::now() - start ).count(); };
+
+	// original update, on the one instance
+	uint32_t unanchored = 0;
+	for ( auto& n : nodes ) {
+		unanchored += n.anchored ? 0 : 1;
+	}
+	auto tStart = std::chrono::steady_clock::now();
+	for ( uint32_t i = 0; i < ticks; i++ ) {
 		CachePreviousValues();
 		SingleThreadSoftbodyUpdate();
-	// }
-	// cout << "singlethread update (x10) " << std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now()-tstart).count() << "ns\n";
-
-	// // multithreaded update structure
-	// auto tstartm = std::chrono::high_resolution_clock::now();
-	// // for ( int i = 0; i < 10; i++ ){
-	// 	CachePreviousValues();
-	// 	EnableAllWorkers();							// set worker thread enable flag
-	// 	while( !AllThreadComplete() );	// wait for all threads to reach completion
-	// // }
-	// cout << "multithread update " << std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now()-tstartm).count() << "ns\n";
+	}
+	result.originalNodeUpdatesPerSecond = float( unanchored ) * ticks / std::max( Seconds( tStart ), 1e-9f );
+	const std::vector< node > reference = nodes;
+	nodes = saved;
+
+	// the solver, first single threaded, then with one thread per hardware thread
+	softbodySolver s;
+	s.Build( saved, copies );
+	tStart = std::chrono::steady_clock::now();
+	s.Run( simParameters, ticks, 1 );
+	result.solverNodeUpdatesPerSecond = float( s.NumUnanchored() ) * ticks / std::max( Seconds( tStart ), 1e-9f );
+
+	std::vector< node > check = saved;
+	s.CopyOut( check );
+	for ( size_t i = 0; i < check.size(); i++ ) {
+		const glm::vec3 d = glm::abs( check[ i ].position - reference[ i ].position );
+		result.maxDifference = std::max( { result.maxDifference, d.x, d.y, d.z } );
+	}
 
-	// pass the new GPU data
-	passNewGPUData();
+	softbodySolver threaded;
+	threaded.Build( saved, copies );
+	result.threads = std::max( 1u, std::thread::hardware_concurrency() );
+	tStart = std::chrono::steady_clock::now();
+	threaded.Run( simParameters, ticks, result.threads );
+	result.threadedNodeUpdatesPerSecond = float( threaded.NumUnanchored() ) * ticks / std::max( Seconds( tStart ), 1e-9f );
+
+	return result;
 }
 
 void model::Display() {
@@ -550,3 +515,245 @@ void model::addFace( int nodeIndex1, int nodeIndex2, int nodeIndex3, glm::vec3 n
 
 	faces.push_back( f );
 }
+
+//=============================================================================
+//==== softbodySolver =========================================================
+//=============================================================================
+
+softbodySolver::~softbodySolver() {
+	StopTeam();
+}
+
+void softbodySolver::Build( const std::vector< node > &nodes, uint32_t copies ) {
+	StopTeam();
+	copies = std::max( copies, 1u );
+	graphNodes = uint32_t( nodes.size() );
+	numNodes = graphNodes * copies;
+	numUnanchored = 0;
+	current = 0;
+
+	for ( int b = 0; b < 2; b++ ) {
+		px[ b ].resize( numNodes ); py[ b ].resize( numNodes ); pz[ b ].resize( numNodes );
+		vx[ b ].resize( numNodes ); vy[ b ].resize( numNodes ); vz[ b ].resize( numNodes );
+	}
+	anchored.resize( numNodes );
+	massSource.resize( numNodes );
+	mass.resize( numNodes );
+	damping.resize( numNodes );
+	edgeStart.assign( 1, 0 );
+	edgeSelf.clear(); edgeOther.clear(); type.clear(); inverseBaseLength.clear();
+
+	for ( uint32_t c = 0; c < copies; c++ ) {
+		for ( uint32_t i = 0; i < graphNodes; i++ ) {
+			const node &n = nodes[ i ];
+			const uint32_t index = c * graphNodes + i;
+			for ( int b = 0; b < 2; b++ ) {
+				px[ b ][ index ] = n.position.x; py[ b ][ index ] = n.position.y; pz[ b ][ index ] = n.position.z;
+				vx[ b ][ index ] = n.velocity.x; vy[ b ][ index ] = n.velocity.y; vz[ b ][ index ] = n.velocity.z;
+			}
+			anchored[ index ] = n.anchored;
+			massSource[ index ] = n.mass;
+			numUnanchored += n.anchored ? 0 : 1;
+
+			// anchored nodes don't get a force, so they don't need their edges
+			if ( !n.anchored ) {
+				for ( auto& e : n.edges ) {
+					edgeSelf.push_back( index );
+					edgeOther.push_back( c * graphNodes + e.node2 );
+					type.push_back( e.type );
+					inverseBaseLength.push_back( 1.0f / e.baseLength );
+				}
+			}
+			edgeStart.push_back( uint32_t( edgeSelf.size() ) );
+		}
+	}
+	k.resize( edgeSelf.size() );
+	fx.resize( edgeSelf.size() ); fy.resize( edgeSelf.size() ); fz.resize( edgeSelf.size() );
+}
+
+void softbodySolver::UpdateAnchors( const std::vector< node > &nodes ) {
+	for ( uint32_t index = 0; index < numNodes; index++ ) {
+		if ( anchored[ index ] ) {
+			const glm::vec3 p = nodes[ index % graphNodes ].position;
+			for ( int b = 0; b < 2; b++ ) {
+				px[ b ][ index ] = p.x; py[ b ][ index ] = p.y; pz[ b ][ index ] = p.z;
+			}
+		}
+	}
+}
+
+void softbodySolver::CopyOut( std::vector< node > &nodes ) const {
+	const uint32_t previous = current ^ 1;
+	for ( uint32_t i = 0; i < graphNodes && i < nodes.size(); i++ ) {
+		if ( !anchored[ i ] ) {
+			nodes[ i ].position = glm::vec3( px[ current ][ i ], py[ current ][ i ], pz[ current ][ i ] );
+			nodes[ i ].velocity = glm::vec3( vx[ current ][ i ], vy[ current ][ i ], vz[ current ][ i ] );
+			nodes[ i ].oldPosition = glm::vec3( px[ previous ][ i ], py[ previous ][ i ], pz[ previous ][ i ] );
+			nodes[ i ].oldVelocity = glm::vec3( vx[ previous ][ i ], vy[ previous ][ i ], vz[ previous ][ i ] );
+		}
+	}
+}
+
+void softbodySolver::Run( const simParameterPack &parameters, uint32_t ticks, uint32_t numThreads ) {
+	if ( numNodes == 0 || ticks == 0 ) {
+		return;
+	}
+
+	// per type constants, once for the whole run
+	float typeK[ 3 ], typeD[ 3 ];
+	typeK[ CHASSIS ] = parameters.chassisKConstant;
+	typeD[ CHASSIS ] = parameters.chassisDamping;
+	typeK[ SUSPENSION ] = typeK[ SUSPENSION1 ] = parameters.suspensionKConstant;
+	typeD[ SUSPENSION ] = typeD[ SUSPENSION1 ] = parameters.suspensionDamping;
+	for ( uint32_t n = 0; n < numNodes; n++ ) {
+		mass[ n ] = *massSource[ n ];
+		damping[ n ] = 0.0f;
+		for ( uint32_t h = edgeStart[ n ]; h < edgeStart[ n + 1 ]; h++ ) {
+			k[ h ] = typeK[ type[ h ] ];
+			damping[ n ] += typeD[ type[ h ] ];
+		}
+	}
+
+	if ( numThreads == 0 ) {
+		numThreads = std::clamp( numNodes / 2048u, 1u, std::max( 1u, std::thread::hardware_concurrency() ) );
+	}
+	numThreads = std::min( numThreads, numNodes );
+	if ( numThreads != teamSize ) {
+		StartTeam( numThreads );
+	}
+
+	jobTicks = ticks;
+	jobTimeScale = parameters.timeScale;
+	jobGravity = parameters.gravity;
+	if ( teamSize > 1 ) {
+		startBarrier->arrive_and_wait();
+	}
+	RunTicks( 0 );
+	current ^= ( ticks & 1 );
+}
+
+void softbodySolver::RunTicks( uint32_t thread ) {
+	for ( uint32_t t = 0; t < jobTicks; t++ ) {
+		Tick( thread, current ^ ( t & 1 ), jobTimeScale, jobGravity );
+		if ( teamSize > 1 ) {
+			tickBarrier->arrive_and_wait();
+		}
+	}
+}
+
+void softbodySolver::Tick( uint32_t thread, uint32_t buffer, float timeScale, float gravity ) {
+	const uint32_t nodeLo = nodeSplit[ thread ], nodeHi = nodeSplit[ thread + 1 ];
+	const uint32_t edgeLo = edgeStart[ nodeLo ], edgeHi = edgeStart[ nodeHi ];
+
+	const float *oldX = px[ buffer ].data(), *oldY = py[ buffer ].data(), *oldZ = pz[ buffer ].data();
+	const float *oldVX = vx[ buffer ].data(), *oldVY = vy[ buffer ].data(), *oldVZ = vz[ buffer ].data();
+	float *newX = px[ buffer ^ 1 ].data(), *newY = py[ buffer ^ 1 ].data(), *newZ = pz[ buffer ^ 1 ].data();
+	float *newVX = vx[ buffer ^ 1 ].data(), *newVY = vy[ buffer ^ 1 ].data(), *newVZ = vz[ buffer ^ 1 ].data();
+	const uint32_t *self = edgeSelf.data(), *other = edgeOther.data();
+	const float *edgeK = k.data(), *invBase = inverseBaseLength.data();
+	float *forceX = fx.data(), *forceY = fy.data(), *forceZ = fz.data();
+
+	// spring force for every half edge of this thread's nodes. Anchored nodes keep their current position in both
+		// buffers, so reading the old buffer is right for them too. The positions come through edgeSelf / edgeOther,
+		// which keeps the compiler from vectorizing this, so the SSE2 loop gathers four half edges into lanes by hand -
+		// same operations in the same order as the scalar loop, which picks up the tail, so the results match exactly
+	uint32_t h = edgeLo;
+#ifdef SOFTBODY_SSE2
+	const __m128 one = _mm_set1_ps( 1.0f ), minLength = _mm_set1_ps( 1e-20f ), signBit = _mm_set1_ps( -0.0f );
+	for ( ; h + 4 <= edgeHi; h += 4 ) {
+		const uint32_t s0 = self[ h ], s1 = self[ h + 1 ], s2 = self[ h + 2 ], s3 = self[ h + 3 ];
+		const uint32_t o0 = other[ h ], o1 = other[ h + 1 ], o2 = other[ h + 2 ], o3 = other[ h + 3 ];
+		const __m128 dx = _mm_sub_ps( _mm_setr_ps( oldX[ s0 ], oldX[ s1 ], oldX[ s2 ], oldX[ s3 ] ), _mm_setr_ps( oldX[ o0 ], oldX[ o1 ], oldX[ o2 ], oldX[ o3 ] ) );
+		const __m128 dy = _mm_sub_ps( _mm_setr_ps( oldY[ s0 ], oldY[ s1 ], oldY[ s2 ], oldY[ s3 ] ), _mm_setr_ps( oldY[ o0 ], oldY[ o1 ], oldY[ o2 ], oldY[ o3 ] ) );
+		const __m128 dz = _mm_sub_ps( _mm_setr_ps( oldZ[ s0 ], oldZ[ s1 ], oldZ[ s2 ], oldZ[ s3 ] ), _mm_setr_ps( oldZ[ o0 ], oldZ[ o1 ], oldZ[ o2 ], oldZ[ o3 ] ) );
+		const __m128 length = _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) ) );
+		const __m128 negK = _mm_xor_ps( _mm_loadu_ps( edgeK + h ), signBit );
+		const __m128 scale = _mm_div_ps( _mm_mul_ps( negK, _mm_sub_ps( _mm_mul_ps( length, _mm_loadu_ps( invBase + h ) ), one ) ), _mm_max_ps( minLength, length ) );
+		_mm_storeu_ps( forceX + h, _mm_mul_ps( scale, dx ) );
+		_mm_storeu_ps( forceY + h, _mm_mul_ps( scale, dy ) );
+		_mm_storeu_ps( forceZ + h, _mm_mul_ps( scale, dz ) );
+	}
+#endif
+	for ( ; h < edgeHi; h++ ) {
+		const float dx = oldX[ self[ h ] ] - oldX[ other[ h ] ];
+		const float dy = oldY[ self[ h ] ] - oldY[ other[ h ] ];
+		const float dz = oldZ[ self[ h ] ] - oldZ[ other[ h ] ];
+		const float length = std::sqrt( dx * dx + dy * dy + dz * dz );
+		// -k * normalize( d ) * ( length / baseLength - 1 )
+		const float scale = -edgeK[ h ] * ( length * invBase[ h ] - 1.0f ) / std::max( length, 1e-20f );
+		forceX[ h ] = scale * dx;
+		forceY[ h ] = scale * dy;
+		forceZ[ h ] = scale * dz;
+	}
+
+	// sum them up per node, and integrate
+	for ( uint32_t n = nodeLo; n < nodeHi; n++ ) {
+		if ( anchored[ n ] ) {
+			newX[ n ] = oldX[ n ]; newY[ n ] = oldY[ n ]; newZ[ n ] = oldZ[ n ];
+			newVX[ n ] = oldVX[ n ]; newVY[ n ] = oldVY[ n ]; newVZ[ n ] = oldVZ[ n ];
+			continue;
+		}
+		float x = 0.0f, y = 0.0f, z = 0.0f;
+		for ( uint32_t e = edgeStart[ n ]; e < edgeStart[ n + 1 ]; e++ ) {
+			x += forceX[ e ];
+			y += forceY[ e ];
+			z += forceZ[ e ];
+		}
+		x -= damping[ n ] * oldVX[ n ];
+		y -= damping[ n ] * oldVY[ n ];
+		z -= damping[ n ] * oldVZ[ n ];
+		y += mass[ n ] * -gravity;
+
+		newVX[ n ] = oldVX[ n ] + ( x / mass[ n ] ) * timeScale;
+		newVY[ n ] = oldVY[ n ] + ( y / mass[ n ] ) * timeScale;
+		newVZ[ n ] = oldVZ[ n ] + ( z / mass[ n ] ) * timeScale;
+		newX[ n ] = oldX[ n ] + newVX[ n ] * timeScale;
+		newY[ n ] = oldY[ n ] + newVY[ n ] * timeScale;
+		newZ[ n ] = oldZ[ n ] + newVZ[ n ] * timeScale;
+	}
+}
+
+void softbodySolver::StartTeam( uint32_t size ) {
+	StopTeam();
+	teamSize = size;
+
+	// split the nodes so each thread gets about the same number of edges
+	nodeSplit.assign( 1, 0 );
+	const uint32_t totalEdges = edgeStart[ numNodes ];
+	for ( uint32_t t = 1; t < teamSize; t++ ) {
+		const uint32_t target = uint32_t( uint64_t( totalEdges ) * t / teamSize );
+		const uint32_t split = uint32_t( std::lower_bound( edgeStart.begin(), edgeStart.end(), target ) - edgeStart.begin() );
+		nodeSplit.push_back( std::clamp( split, nodeSplit.back(), numNodes ) );
+	}
+	nodeSplit.push_back( numNodes );
+
+	if ( teamSize > 1 ) {
+		// the calling thread is member zero, the rest wait on startBarrier in between runs
+		quit = false;
+		startBarrier = std::make_unique< std::barrier<> >( teamSize );
+		tickBarrier = std::make_unique< std::barrier<> >( teamSize );
+		for ( uint32_t t = 1; t < teamSize; t++ ) {
+			team.emplace_back( [ this, t ] () {
+				while ( true ) {
+					startBarrier->arrive_and_wait();
+					if ( quit ) {
+						break;
+					}
+					RunTicks( t );
+				}
+			} );
+		}
+	}
+}
+
+void softbodySolver::StopTeam() {
+	if ( !team.empty() ) {
+		quit = true;
+		startBarrier->arrive_and_wait();
+		for ( auto& t : team ) {
+			t.join();
+		}
+		team.clear();
+	}
+	teamSize = 0;
+}
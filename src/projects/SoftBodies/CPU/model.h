@@ -4,6 +4,14 @@
 #pragma once
 
 #include "../../../engine/includes.h"
+#include <barrier>
+#include <memory>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+	// softbodySolver evaluates the springs four half edges at a time through SSE2
+	#define SOFTBODY_SSE2
+	#include <emmintrin.h>
+#endif
 
 // default colors to use
 namespace softbodyColors {
@@ -20,13 +28,6 @@ namespace softbodyColors {
 	const glm::vec4 BG =     glm::vec4( 0.40f, 0.30f, 0.10f, 1.00f );
 };
 
-constexpr int numThreads = 12;          // worker threads for the update
-enum threadState {
-	WORKING,                              // thread is engaged in computation
-	WAITING,                              // thread has finished the work
-	QUIT
-};
-
 enum edgeType {
 	CHASSIS,                              // chassis member
 	SUSPENSION,                           // suspension member
@@ -68,6 +69,86 @@ struct simParameterPack {
 
 	float suspensionKConstant = 9000.0f;  // hooke's law spring constant for suspension edges
 	float suspensionDamping   = 32.4f;    // damping factor for suspension edges
+
+	bool  useSoASolver        = true;     // softbodySolver, instead of the original per node update
+	int   substepsPerFrame    = 1;        // sim ticks per call to Update()
+	int   solverThreads       = 0;        // for softbodySolver, zero picks based on the node count
+};
+
+// structure of arrays copy of the node graph, for running a lot of ticks quickly. Edges are in CSR form - node n's
+	// half edges are [ edgeStart[ n ], edgeStart[ n + 1 ] ), each edge shows up once from either end. Spring constants,
+	// damping and masses are looked up once per Run() instead of per edge, so the inner loops are straight arithmetic
+	// over flat arrays. Positions and velocities are double buffered, ticks read one and write the other, which is the
+	// same old / new split the original update does with CachePreviousValues(). With more than one thread, each one
+	// owns a fixed range of nodes for the whole Run(), and the ticks are separated by a barrier
+class softbodySolver {
+public:
+	~softbodySolver();
+
+	// copies > 1 lays out that many independent instances of the graph, for benchmarking at larger sizes
+	void Build( const std::vector< node > &nodes, uint32_t copies = 1 );
+
+	// anchored nodes are driven from outside, pick up their current positions
+	void UpdateAnchors( const std::vector< node > &nodes );
+
+	// numThreads of zero picks one thread per couple thousand nodes, small graphs don't win anything from threading
+	void Run( const simParameterPack &parameters, uint32_t ticks, uint32_t numThreads = 0 );
+
+	// write the first instance back out to the nodes, for drawing
+	void CopyOut( std::vector< node > &nodes ) const;
+
+	uint32_t NumNodes() const { return numNodes; }
+	uint32_t NumUnanchored() const { return numUnanchored; }
+	uint32_t ThreadsUsed() const { return teamSize; }
+
+private:
+	uint32_t numNodes = 0;
+	uint32_t graphNodes = 0;              // nodes per instance
+	uint32_t numUnanchored = 0;
+	uint32_t current = 0;                 // which buffer holds the latest state
+
+	// per node
+	std::vector< float > px[ 2 ], py[ 2 ], pz[ 2 ];
+	std::vector< float > vx[ 2 ], vy[ 2 ], vz[ 2 ];
+	std::vector< uint8_t > anchored;
+	std::vector< const float * > massSource;
+	std::vector< float > mass;
+	std::vector< float > damping;         // summed over the node's edges, the original applies it once per edge
+	std::vector< uint32_t > edgeStart;
+
+	// per half edge
+	std::vector< uint32_t > edgeSelf, edgeOther;
+	std::vector< edgeType > type;
+	std::vector< float > inverseBaseLength;
+	std::vector< float > k;
+	std::vector< float > fx, fy, fz;      // spring force on edgeSelf
+
+	void Tick( uint32_t thread, uint32_t buffer, float timeScale, float gravity );
+
+	// thread team - each member gets a node range, balanced by edge count
+	uint32_t teamSize = 0;
+	std::vector< uint32_t > nodeSplit;
+	std::vector< std::thread > team;
+	std::unique_ptr< std::barrier<> > startBarrier;
+	std::unique_ptr< std::barrier<> > tickBarrier;
+	bool quit = false;
+	uint32_t jobTicks = 0;
+	float jobTimeScale = 0.0f, jobGravity = 0.0f;
+	void StartTeam( uint32_t size );
+	void StopTeam();
+	void RunTicks( uint32_t thread );
+};
+
+// node updates per second for the original update and for softbodySolver on one thread and on several - maxDifference
+	// is the largest position difference between the original and the solver after the same number of ticks
+struct softbodyBenchmark {
+	uint32_t ticks = 0;
+	uint32_t copies = 0;
+	uint32_t threads = 0;
+	float originalNodeUpdatesPerSecond = 0.0f;
+	float solverNodeUpdatesPerSecond = 0.0f;
+	float threadedNodeUpdatesPerSecond = 0.0f;
+	float maxDifference = 0.0f;
 };
 
 // consolidate display parameters
@@ -138,7 +219,10 @@ public:
 	void updateUniforms();                // update uniform variables
 
 	// update functions for model
-	void Update( /* threadID */ );        // single threaded update - add threadID for threaded update
+	void Update();                        // simParameters.substepsPerFrame ticks
+
+	// runs on copies of the current state, which is left as it was
+	softbodyBenchmark Benchmark( uint32_t ticks, uint32_t copies );
 
 	// show the model
 	void Display();                       // render the latest vertex data with the simGeometryShader
@@ -174,29 +258,8 @@ private:
 	// back up current values to previous values
 	void CachePreviousValues();
 
-	// keeping the state of each thread
-	threadState workerState[ numThreads ];
-	std::thread workerThreads[ numThreads ];
-	void EnableAllWorkers();
-	void MultiThreadUpdateFunc( int index );
-	// std::function< void( int ) > MultiThreadUpdateFunc = []() ;
-
-
-	// std::atomic<unsigned int> indexcrement{ 0 }; // used to get new thread ids
-	// std::thread updateThreads[ numThreads ] {[=](){
-	// 	// while ( workerState[ myThreadIndex ] != QUIT ) {
-	// 	// 	if ( workerState[ myThreadIndex ] == WAITING )
-	// 	// 		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
-	// 	// 	else {
-	// 	// 		// run the update for all the relevant nodes
-	// 	// 	}
-	// 	// }
-	// 	int index = indexcrement.fetch_add( 1 );
-	// 	cout << "myindex is " << index << endl;
-	// }};
-
-
-	bool AllThreadComplete();
+	// data oriented version of the update
+	softbodySolver solver;
 
 	// update all nodes with a single thread
 	void SingleThreadSoftbodyUpdate();
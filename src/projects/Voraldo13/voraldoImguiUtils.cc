@@ -1063,25 +1063,9 @@ void Voraldo13::MenuVAT () {
 		if ( ImGui::Button( " Compute From String " ) ) {
 			voxelAutomataTerrain vS( blockLevelsDeep, flip, string( inputString ), initMode, lambda, beta, mag, glm::bvec3( minusX, minusY, minusZ ), glm::bvec3( plusX, plusY, plusZ ) );
 			strcpy( inputString, vS.getShortRule().c_str() );
-			std::vector<uint8_t> loaded;
-			loaded.reserve( blockDim.x * blockDim.y * blockDim.z * 4 );
-			for ( int x = 0; x < blockDim.x; x++ ) {
-				for ( int y = 0; y < blockDim.y; y++ ) {
-					for ( int z = 0; z < blockDim.z; z++ ) {
-						glm::vec4 color;
-						switch ( vS.state[ x ][ y ][ z ] ) {
-							case 0: color = color0; break;
-							case 1: color = color1; break;
-							case 2: color = color2; break;
-							default: color = color0; break;
-						}
-						loaded.push_back( static_cast<uint8_t>( color.x * 255.0 ) );
-						loaded.push_back( static_cast<uint8_t>( color.y * 255.0 ) );
-						loaded.push_back( static_cast<uint8_t>( color.z * 255.0 ) );
-						loaded.push_back( static_cast<uint8_t>( color.w * 255.0 ) );
-					}
-				}
-			}
+			const glm::vec4 colors[ 3 ] = { color0, color1, color2 };
+			std::vector<uint8_t> loaded( size_t( blockDim.x ) * blockDim.y * blockDim.z * 4 );
+			vS.ExportRGBA( loaded.data(), glm::ivec3( blockDim ), colors );
 			glBindTexture( GL_TEXTURE_3D, textureManager.Get( "LoadBuffer" ) );
 			glTexImage3D( GL_TEXTURE_3D, 0, GL_RGBA8, blockDim.x, blockDim.y, blockDim.z, 0, GL_RGBA, GL_UNSIGNED_BYTE, &loaded[ 0 ] );
 			SwapBlocks();
@@ -1099,25 +1083,9 @@ void Voraldo13::MenuVAT () {
 		if ( ImGui::Button( " Compute Random " ) ) {
 			voxelAutomataTerrain vR( blockLevelsDeep, flip, string( "r" ), initMode, lambda, beta, mag, glm::bvec3( minusX, minusY, minusZ ), glm::bvec3( plusX, plusY, plusZ ) );
 			strcpy( inputString, vR.getShortRule().c_str() );
-			std::vector<uint8_t> loaded;
-			loaded.reserve( blockDim.x * blockDim.y * blockDim.z * 4 );
-			for ( int x = 0; x < blockDim.x; x++ ) {
-				for ( int y = 0; y < blockDim.y; y++ ) {
-					for ( int z = 0; z < blockDim.z; z++ ) {
-						glm::vec4 color;
-						switch ( vR.state[ x ][ y ][ z ] ) {
-							case 0: color = color0; break;
-							case 1: color = color1; break;
-							case 2: color = color2; break;
-							default: color = color0; break;
-						}
-						loaded.push_back( static_cast<uint8_t>( color.x * 255.0 ) );
-						loaded.push_back( static_cast<uint8_t>( color.y * 255.0 ) );
-						loaded.push_back( static_cast<uint8_t>( color.z * 255.0 ) );
-						loaded.push_back( static_cast<uint8_t>( color.w * 255.0 ) );
-					}
-				}
-			}
+			const glm::vec4 colors[ 3 ] = { color0, color1, color2 };
+			std::vector<uint8_t> loaded( size_t( blockDim.x ) * blockDim.y * blockDim.z * 4 );
+			vR.ExportRGBA( loaded.data(), glm::ivec3( blockDim ), colors );
 			glBindTexture( GL_TEXTURE_3D, textureManager.Get( "LoadBuffer" ) );
 			glTexImage3D( GL_TEXTURE_3D, 0, GL_RGBA8, blockDim.x, blockDim.y, blockDim.z, 0, GL_RGBA, GL_UNSIGNED_BYTE, &loaded[ 0 ] );
 			SwapBlocks();
@@ -1135,25 +1103,9 @@ void Voraldo13::MenuVAT () {
 		if ( ImGui::Button( " Compute IRandom " ) ) {
 			voxelAutomataTerrain vI( blockLevelsDeep, flip, string( "i" ), initMode, lambda, beta, mag, glm::bvec3( minusX, minusY, minusZ ), glm::bvec3( plusX, plusY, plusZ ) );
 			strcpy( inputString, vI.getShortRule().c_str() );
-			std::vector<uint8_t> loaded;
-			loaded.reserve( blockDim.x * blockDim.y * blockDim.z * 4 );
-			for ( int x = 0; x < blockDim.x; x++ ) {
-				for ( int y = 0; y < blockDim.y; y++ ) {
-					for ( int z = 0; z < blockDim.z; z++ ) {
-						glm::vec4 color;
-						switch ( vI.state[ x ][ y ][ z ] ) {
-							case 0: color = color0; break;
-							case 1: color = color1; break;
-							case 2: color = color2; break;
-							default: color = color0; break;
-						}
-						loaded.push_back( static_cast<uint8_t>( color.x * 255.0 ) );
-						loaded.push_back( static_cast<uint8_t>( color.y * 255.0 ) );
-						loaded.push_back( static_cast<uint8_t>( color.z * 255.0 ) );
-						loaded.push_back( static_cast<uint8_t>( color.w * 255.0 ) );
-					}
-				}
-			}
+			const glm::vec4 colors[ 3 ] = { color0, color1, color2 };
+			std::vector<uint8_t> loaded( size_t( blockDim.x ) * blockDim.y * blockDim.z * 4 );
+			vI.ExportRGBA( loaded.data(), glm::ivec3( blockDim ), colors );
 			glBindTexture( GL_TEXTURE_3D, textureManager.Get( "LoadBuffer" ) );
 			glTexImage3D( GL_TEXTURE_3D, 0, GL_RGBA8, blockDim.x, blockDim.y, blockDim.z, 0, GL_RGBA, GL_UNSIGNED_BYTE, &loaded[ 0 ] );
 			SwapBlocks();
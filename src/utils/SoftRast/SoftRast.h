@@ -4,6 +4,13 @@
 #include "../ModelLoading/TinyOBJLoader/tiny_obj_loader.h"
 #include "../../engine/includes.h"
 
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+	// the 2x2 quads go through SSE2, bit-identical to the scalar path so long as the compiler isn't contracting the
+		// scalar plane evaluation into FMAs ( -mfma needs -ffp-contract=off, same as the image2 kernels )
+	#define SOFTRAST_SSE2
+	#include <emmintrin.h>
+#endif
+
 struct triangle {
 	vec3 p0, p1, p2; // per vertex position
 	vec3 t0, t1, t2; // per vertex texcoord xy, texture index
@@ -28,19 +35,6 @@ static const color_4U ColorFromVec4( vec4 color ) {
 	return temp;
 }
 
-static const vec3 BarycentricCoords ( vec3 p0, vec3 p1, vec3 p2, vec3 P ) {
-	vec3 s[ 2 ];
-	for ( int i = 2; i--; ) {
-		s[ i ][ 0 ] = p2[ i ] - p0[ i ];
-		s[ i ][ 1 ] = p1[ i ] - p0[ i ];
-		s[ i ][ 2 ] = p0[ i ] - P[ i ];
-	}
-	vec3 u = glm::cross( s[ 0 ], s[ 1 ] );
-	if ( std::abs( u[ 2 ] ) > 1e-2f )	 	// If u[ 2 ] is zero then triangle ABC is degenerate
-		return vec3( 1.0f - ( u.x + u.y ) / u.z, u.y / u.z, u.x / u.z );
-	return vec3( -1.0f, 1.0f, 1.0f );	// in this case generate negative coordinates, it will be thrown away by the rasterizer
-}
-
 static const mat3 rotation( vec3 a, float angle ) {
 	a = glm::normalize( a ); //a is the axis
 	float s = sin( angle );
@@ -93,8 +87,9 @@ public:
 		return vec4( value[ red ] / 255.0f, value[ green ] / 255.0f, value[ blue ] / 255.0f, value[ alpha ] / 255.0f ) - vec4( 0.5f );
 	}
 
-	std::vector< Image_4U > texSet;
-	void LoadTex ( string texPath ) {
+	// textures are stored in 8x8 tiles, so the filtered reads mostly stay inside a cache line or two
+	std::vector< Image_4U_Tiled > texSet;
+	Image_4U_Tiled PrepareTex ( string texPath ) {
 		if ( !texPath.empty() ) {
 			Image_4U temp( texPath );
 			temp.FlipVertical();
@@ -114,9 +109,13 @@ public:
 				cout << "    done" << endl << endl;
 			}
 
-			texSet.push_back( temp );
+			// rearrange into tiles, minified reads go through the mip chain
+			Image_4U_Tiled tiled( temp );
+			tiled.BuildMipChain();
+			return tiled;
 		} else {
-			Image_4U temp( 2048, 2048 );
+			Image_4U_Tiled temp( 2048, 2048 );
+			temp.BuildMipChain();
 
 			if ( verboseLoad ) {
 				cout << "    image defaulting";
@@ -124,9 +123,12 @@ public:
 				cout << "    done" << endl << endl;
 			}
 
-			texSet.push_back( temp );
+			return temp;
 		}
 	}
+	void LoadTex ( string texPath ) {
+		texSet.push_back( PrepareTex( texPath ) );
+	}
 	vec4 TexRef ( vec2 texCoord, int id ) {
 		uint32_t x = uint32_t( texCoord.x * float( texSet[ id ].Width() ) );
 		uint32_t y = uint32_t( texCoord.y * float( texSet[ id ].Height() ) );
@@ -136,6 +138,17 @@ public:
 		return returnVal;
 	}
 
+	// filtered reads - anisotropic from the screen space texcoord derivatives, or trilinear at a given lod
+	vec4 TexRef ( vec2 texCoord, int id, vec2 dUVdx, vec2 dUVdy ) {
+		color_4U val = texSet[ id ].Sample( texCoord, dUVdx, dUVdy );
+		return vec4( val[ red ] / 255.0f, val[ green ] / 255.0f, val[ blue ] / 255.0f, val[ alpha ] / 255.0f );
+	}
+
+	vec4 TexRef ( vec2 texCoord, int id, float lod ) {
+		color_4U val = texSet[ id ].Sample( texCoord, lod );
+		return vec4( val[ red ] / 255.0f, val[ green ] / 255.0f, val[ blue ] / 255.0f, val[ alpha ] / 255.0f );
+	}
+
 	const vec3 NDCToPixelCoords ( vec3 NDCCoord ) {
 		return vec3(
 			RemapRange( NDCCoord.x, -1.0f, 1.0f, 0.0f, float( width - 1.0f ) ),
@@ -202,8 +215,104 @@ public:
 		}
 	}
 
-	// draw triangle
-	void DrawTriangle ( triangle t, const mat3 transform, const vec3 offset  ) {
+	// a value that varies linearly in screen space - at pixel P it is c + a * ( P.x - origin.x ) + b * ( P.y - origin.y )
+	struct rasterPlane {
+		float a = 0.0f, b = 0.0f, c = 0.0f;
+
+		// every path evaluates a pixel the same way - a base for its 8x8 block plus a step inside of the block - so a
+			// pixel gets identical bits whether it's reached by the scalar scan, the SIMD quads, or from any tile
+		float BlockBase ( const ivec2 blockOffset ) const { return c + ( a * float( blockOffset.x ) + b * float( blockOffset.y ) ); }
+		float At ( const float base, const int i, const int j ) const { return base + ( a * float( i ) + b * float( j ) ); }
+
+		// bounds on the step across a block, rounding is monotonic so no pixel in the block can land outside of these
+		float MaxStep () const { return std::max( a * 7.0f, 0.0f ) + std::max( b * 7.0f, 0.0f ); }
+		float MinStep () const { return std::min( a * 7.0f, 0.0f ) + std::min( b * 7.0f, 0.0f ); }
+	};
+
+	// triangle after transform and projection, reduced to the planes the pixel loop needs
+	struct rasterTriangle {
+		rasterPlane edge[ 3 ];	// edge functions, scaled so they're all non-negative inside and sum to twice the area
+		rasterPlane depth;
+		rasterPlane u, v;		// texcoords
+		float textureID;		// single material per tri
+		ivec2 origin;			// plane origin, same as bboxMin
+		ivec2 bboxMin;			// inclusive pixel bounds, already clipped to the screen
+		ivec2 bboxMax;
+		vec2 dUVdx, dUVdy;		// constant texcoord derivatives, for the anisotropic lookup
+		ivec2 cutoff;			// the depth < 0 clip stops an x-major scan here, see SetupTriangle
+	};
+
+	// where a triangle gets rasterized to - either the full Color/Depth buffers, or a tile cache
+	struct rasterTarget {
+		uint8_t *color;			// 4 channel, row-major
+		float *depth;
+		ivec2 origin;			// pixel coords of element 0, a multiple of 8
+		ivec2 extent;			// pixels outside of origin .. origin + extent - 1 are not touched
+		int stride;				// elements per row
+		float *hiZ = nullptr;	// optional, farthest depth in each 8x8 block of the target, row-major from the origin
+	};
+
+	rasterTarget FullscreenTarget () {
+		return { Color.GetImageDataBasePtr(), Depth.GetImageDataBasePtr(), ivec2( 0 ), ivec2( width, height ), int( width ) };
+	}
+
+	// counters for the last DrawModel / DrawModelSerial
+	struct rasterStats_t {
+		uint64_t trianglesSubmitted = 0;
+		uint64_t trianglesClipped = 0;		// dropped in setup - off screen, degenerate, or behind the near plane
+		uint64_t trianglesOccluded = 0;		// every block they touched was behind the Hi-Z
+		uint64_t blocksOccluded = 0;		// 8x8 blocks rejected by the Hi-Z, summed over triangles
+		uint64_t pixelsShaded = 0;			// passed the depth test and took a texture read
+		uint64_t pixelsWritten = 0;			// shaded, and not rejected for zero alpha
+		uint64_t pixelsTouched = 0;			// distinct pixels that ended the frame with a new depth
+
+		float Overdraw () const { return pixelsTouched ? float( pixelsShaded ) / float( pixelsTouched ) : 0.0f; }
+
+		rasterStats_t& operator += ( const rasterStats_t &other ) {
+			trianglesSubmitted += other.trianglesSubmitted;
+			trianglesClipped += other.trianglesClipped;
+			trianglesOccluded += other.trianglesOccluded;
+			blocksOccluded += other.blocksOccluded;
+			pixelsShaded += other.pixelsShaded;
+			pixelsWritten += other.pixelsWritten;
+			pixelsTouched += other.pixelsTouched;
+			return *this;
+		}
+	};
+	rasterStats_t stats;
+
+	// hierarchical Z - one value per 8x8 block, never closer than the farthest depth actually stored in it. A block of a
+		// triangle whose nearest possible depth is at or behind that can't pass a single depth test, so it's skipped
+		// before any per pixel work, and the image is exactly what it would have been without it
+	static int HiZBlocksWide ( const rasterTarget &target ) {
+		return ( target.extent.x + 7 ) / 8;
+	}
+
+	static void UpdateHiZBlock ( const rasterTarget &target, const ivec2 block ) {
+		const ivec2 pixelMin = block * 8;
+		const ivec2 pixelMax = glm::min( pixelMin + ivec2( 8 ), target.extent );
+		float farthest = -std::numeric_limits< float >::infinity();
+		for ( int y = pixelMin.y; y < pixelMax.y; y++ ) {
+			const float *row = target.depth + size_t( y ) * target.stride;
+			for ( int x = pixelMin.x; x < pixelMax.x; x++ ) {
+				// a NaN never passes a depth test, so it doesn't need to hold the block open
+				farthest = ( row[ x ] > farthest ) ? row[ x ] : farthest;
+			}
+		}
+		target.hiZ[ block.x + block.y * HiZBlocksWide( target ) ] = farthest;
+	}
+
+	static void BuildHiZ ( const rasterTarget &target ) {
+		const ivec2 blocks = ( target.extent + ivec2( 7 ) ) / 8;
+		for ( int y = 0; y < blocks.y; y++ ) {
+			for ( int x = 0; x < blocks.x; x++ ) {
+				UpdateHiZBlock( target, ivec2( x, y ) );
+			}
+		}
+	}
+
+	// transform + project, clip the bounding box to the screen, returns false if nothing will be drawn
+	bool SetupTriangle ( triangle t, const mat3 transform, const vec3 offset, rasterTriangle &rt ) {
 
 		// apply transform
 		t.p0 = transform * ( t.p0 + offset );
@@ -241,7 +350,7 @@ public:
 			bboxmax[ j ] = std::min( clamp[ j ], std::max( bboxmax[ j ], t.p2[ j ] ) );
 		}
 
-		if ( verboseDraw ) {
+		if ( verboseDraw ) { // note that this gets called from the binning threads in DrawModel
 			cout << "Drawing triangle, with:" << newline;
 			cout << "[vertex 0]" << newline;
 			cout << "  Position: " << t.p0.x << " " << t.p0.y << " " << t.p0.z << newline;
@@ -260,79 +369,560 @@ public:
 			cout << "  Color:    " << t.c2.x << " " << t.c2.y << " " << t.c2.z << newline << newline;
 		}
 
-		constexpr bool allowPrimitiveJitter = false;
-		ivec2 eval;
-		for ( eval.x = bboxmin.x; eval.x <= bboxmax.x; eval.x++ ) {
-			for ( eval.y = bboxmin.y; eval.y <= bboxmax.y; eval.y++ ) {
-
-				// for( n ) jittered samples? tbd, will need to do something to get an alpha value from the n samples
-				vec4 jitter = allowPrimitiveJitter ? BlueNoiseRef( eval ) : vec4( 0.0f );
-				vec3 bc = BarycentricCoords( t.p0, t.p1, t.p2, vec3( float( eval.x ) + jitter.x, float( eval.y ) + jitter.y, 0.0f ) );
+		// same bounds the int loop counters always got from the float box, kept in int range for far off screen verts
+		rt.bboxMin = ivec2( int( std::min( bboxmin.x, float( width ) ) ), int( std::min( bboxmin.y, float( height ) ) ) );
+		rt.bboxMax = ivec2( int( std::floor( std::max( bboxmax.x, -1.0f ) ) ), int( std::floor( std::max( bboxmax.y, -1.0f ) ) ) );
+		if ( rt.bboxMin.x > rt.bboxMax.x || rt.bboxMin.y > rt.bboxMax.y ) {
+			return false; // entirely off screen
+		}
 
-				// any barycentric coord being negative means degenerate triangle or sample point outside triangle
-				if ( bc.x < 0 || bc.y < 0 || bc.z < 0 ) continue;
+		// twice the signed area, which is also the sum of the three edge functions at any point
+		const float area = ( t.p1.x - t.p0.x ) * ( t.p2.y - t.p0.y ) - ( t.p1.y - t.p0.y ) * ( t.p2.x - t.p0.x );
+		if ( !( std::abs( area ) > 1e-2f ) ) {
+			return false; // degenerate
+		}
 
-				// if ( // interesting experiment, reject samples with certain ranges of the barycentric coords
-				// 	( std::fmod( bc.x, 0.5f ) > 0.1618 && std::fmod( bc.y, 0.5f ) > 0.1618 ) ||
-				// 	( std::fmod( bc.x, 0.5f ) > 0.1618 && std::fmod( bc.z, 0.5f ) > 0.1618 ) ||
-				// 	( std::fmod( bc.z, 0.5f ) > 0.1618 && std::fmod( bc.y, 0.5f ) > 0.1618 )
-				// ) continue;
+		// edge functions, relative to the bbox corner to keep the magnitudes small where we actually evaluate them -
+			// flipped for clockwise triangles, so the inside test is the same for either winding
+		rt.origin = rt.bboxMin;
+		const vec2 o = vec2( rt.origin );
+		const float windingSign = ( area < 0.0f ) ? -1.0f : 1.0f;
+		auto edgePlane = [ & ] ( const vec3 va, const vec3 vb ) {
+			rasterPlane p;
+			p.a = windingSign * ( va.y - vb.y );
+			p.b = windingSign * ( vb.x - va.x );
+			p.c = windingSign * ( ( vb.x - va.x ) * ( o.y - va.y ) - ( vb.y - va.y ) * ( o.x - va.x ) );
+			return p;
+		};
+		rt.edge[ 0 ] = edgePlane( t.p1, t.p2 ); // weight for p0
+		rt.edge[ 1 ] = edgePlane( t.p2, t.p0 ); // weight for p1
+		rt.edge[ 2 ] = edgePlane( t.p0, t.p1 ); // weight for p2
+
+		// per vertex attributes become planes, the barycentric weights are the edge functions over the area
+		const float inverseArea = 1.0f / std::abs( area );
+		auto attributePlane = [ & ] ( const float f0, const float f1, const float f2 ) {
+			rasterPlane p;
+			p.a = ( f0 * rt.edge[ 0 ].a + f1 * rt.edge[ 1 ].a + f2 * rt.edge[ 2 ].a ) * inverseArea;
+			p.b = ( f0 * rt.edge[ 0 ].b + f1 * rt.edge[ 1 ].b + f2 * rt.edge[ 2 ].b ) * inverseArea;
+			p.c = ( f0 * rt.edge[ 0 ].c + f1 * rt.edge[ 1 ].c + f2 * rt.edge[ 2 ].c ) * inverseArea;
+			return p;
+		};
+		rt.depth = attributePlane( t.p0.z, t.p1.z, t.p2.z );
+		rt.u = attributePlane( t.t0.x, t.t1.x, t.t2.x );
+		rt.v = attributePlane( t.t0.y, t.t1.y, t.t2.y );
+		rt.textureID = t.t0.z;
+
+		// the plane slopes are the texcoord derivatives ( y is flipped, same as the lookup )
+		rt.dUVdx = vec2( rt.u.a, -rt.v.a );
+		rt.dUVdy = vec2( rt.u.b, -rt.v.b );
+
+		// the cheapo clipping plane - the first covered sample with depth < 0 abandons the rest of the triangle, in the
+			// x-major order the rasterizer has always scanned in. Find that point up front, so the triangle can be drawn in
+			// any order ( row by row, tile by tile ) and still cover exactly the same pixels. Nothing to find when all three
+			// depths are non-negative
+		rt.cutoff = ivec2( rt.bboxMax.x + 1, 0 );
+		if ( std::min( std::min( t.p0.z, t.p1.z ), t.p2.z ) < 0.0f ) {
+			ivec2 eval;
+			for ( eval.x = rt.bboxMin.x; eval.x <= rt.bboxMax.x; eval.x++ ) {
+				for ( eval.y = rt.bboxMin.y; eval.y <= rt.bboxMax.y; eval.y++ ) {
+					const ivec2 blockOffset = ( eval & ivec2( ~7 ) ) - rt.origin;
+					const ivec2 step = eval & ivec2( 7 );
+					bool covered = true;
+					for ( int k = 0; k < 3; k++ ) {
+						covered = covered && rt.edge[ k ].At( rt.edge[ k ].BlockBase( blockOffset ), step.x, step.y ) >= 0.0f;
+					}
+					if ( covered && rt.depth.At( rt.depth.BlockBase( blockOffset ), step.x, step.y ) < 0.0f ) {
+						rt.cutoff = eval;
+						eval = rt.bboxMax + ivec2( 1 ); // break out of both loops
+					}
+				}
+			}
+		}
 
-				float depth = 0.0f; // barycentric interpolation of depth
-				depth += bc.x * t.p0.z;
-				depth += bc.y * t.p1.z;
-				depth += bc.z * t.p2.z;
+		return !( rt.cutoff.x == rt.bboxMin.x && rt.cutoff.y == rt.bboxMin.y );
+	}
 
-				vec3 texCoord = vec3( 0.0f );
-				texCoord += bc.x * vec3( t.t0.x, t.t0.y, 0.0f );
-				texCoord += bc.y * vec3( t.t1.x, t.t1.y, 0.0f );
-				texCoord += bc.z * vec3( t.t2.x, t.t2.y, 0.0f );
-				texCoord.z = t.t0.z; // single material per tri
+	// coverage bits and interpolated values for the 2x2 quad at ( qx, qy ) inside of a block, lanes are in row order -
+		// texcoords are only filled out by EvaluateQuadTexcoords, once some lane has passed the depth test
+	struct rasterQuad {
+		int covered;
+		float depth[ 4 ];
+		float u[ 4 ];
+		float v[ 4 ];
+	};
+
+	static void EvaluateQuad ( const rasterTriangle &rt, const float base[ 6 ], const int qx, const int qy, const bool fullyCovered, rasterQuad &q ) {
+	#ifdef SOFTRAST_SSE2
+		const __m128 i = _mm_add_ps( _mm_set1_ps( float( qx ) ), _mm_setr_ps( 0.0f, 1.0f, 0.0f, 1.0f ) );
+		const __m128 j = _mm_add_ps( _mm_set1_ps( float( qy ) ), _mm_setr_ps( 0.0f, 0.0f, 1.0f, 1.0f ) );
+		auto evaluate = [ & ] ( const rasterPlane &p, const float planeBase ) { // same operation order as rasterPlane::At
+			return _mm_add_ps( _mm_set1_ps( planeBase ), _mm_add_ps( _mm_mul_ps( _mm_set1_ps( p.a ), i ), _mm_mul_ps( _mm_set1_ps( p.b ), j ) ) );
+		};
+		if ( fullyCovered ) {
+			q.covered = 0xF;
+		} else {
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 inside = _mm_and_ps( _mm_and_ps(
+				_mm_cmpge_ps( evaluate( rt.edge[ 0 ], base[ 0 ] ), zero ),
+				_mm_cmpge_ps( evaluate( rt.edge[ 1 ], base[ 1 ] ), zero ) ),
+				_mm_cmpge_ps( evaluate( rt.edge[ 2 ], base[ 2 ] ), zero ) );
+			q.covered = _mm_movemask_ps( inside );
+		}
+		if ( q.covered ) {
+			_mm_storeu_ps( q.depth, evaluate( rt.depth, base[ 3 ] ) );
+		}
+	#else
+		q.covered = 0;
+		for ( int lane = 0; lane < 4; lane++ ) {
+			const int i = qx + ( lane & 1 );
+			const int j = qy + ( lane >> 1 );
+			if ( fullyCovered || ( rt.edge[ 0 ].At( base[ 0 ], i, j ) >= 0.0f && rt.edge[ 1 ].At( base[ 1 ], i, j ) >= 0.0f && rt.edge[ 2 ].At( base[ 2 ], i, j ) >= 0.0f ) ) {
+				q.covered |= 1 << lane;
+			}
+			q.depth[ lane ] = rt.depth.At( base[ 3 ], i, j );
+		}
+	#endif
+	}
 
-				vec3 normal = vec3( 0.0f );
-				normal += bc.x * vec3( t.n0.x, t.n0.y, t.n0.z );
-				normal += bc.y * vec3( t.n1.x, t.n1.y, t.n1.z );
-				normal += bc.z * vec3( t.n2.x, t.n2.y, t.n2.z );
+	static void EvaluateQuadTexcoords ( const rasterTriangle &rt, const float base[ 6 ], const int qx, const int qy, rasterQuad &q ) {
+	#ifdef SOFTRAST_SSE2
+		const __m128 i = _mm_add_ps( _mm_set1_ps( float( qx ) ), _mm_setr_ps( 0.0f, 1.0f, 0.0f, 1.0f ) );
+		const __m128 j = _mm_add_ps( _mm_set1_ps( float( qy ) ), _mm_setr_ps( 0.0f, 0.0f, 1.0f, 1.0f ) );
+		_mm_storeu_ps( q.u, _mm_add_ps( _mm_set1_ps( base[ 4 ] ), _mm_add_ps( _mm_mul_ps( _mm_set1_ps( rt.u.a ), i ), _mm_mul_ps( _mm_set1_ps( rt.u.b ), j ) ) ) );
+		_mm_storeu_ps( q.v, _mm_add_ps( _mm_set1_ps( base[ 5 ] ), _mm_add_ps( _mm_mul_ps( _mm_set1_ps( rt.v.a ), i ), _mm_mul_ps( _mm_set1_ps( rt.v.b ), j ) ) ) );
+	#else
+		for ( int lane = 0; lane < 4; lane++ ) {
+			q.u[ lane ] = rt.u.At( base[ 4 ], qx + ( lane & 1 ), qy + ( lane >> 1 ) );
+			q.v[ lane ] = rt.v.At( base[ 5 ], qx + ( lane & 1 ), qy + ( lane >> 1 ) );
+		}
+	#endif
+	}
 
-				if ( depth < 0.0f ) {
-					return; // cheapo clipping plane
+	// scans the part of the triangle's bounding box that falls inside the target, in 8x8 blocks of 2x2 quads - blocks
+		// that fall entirely outside one of the edges, or entirely behind the Hi-Z, are skipped without touching the
+		// pixels. Returns false if the Hi-Z rejected everything that the edges didn't
+	bool RasterizeTriangle ( const rasterTriangle &rt, const rasterTarget &target, rasterStats_t &counters ) {
+		const ivec2 lo = glm::max( rt.bboxMin, target.origin );
+		const ivec2 hi = glm::min( rt.bboxMax, target.origin + target.extent - ivec2( 1 ) );
+		const int hiZWidth = HiZBlocksWide( target );
+
+		// whole triangle first - the nearest the depth plane gets over these blocks is in the corner block its slopes
+			// point away from ( rounding is monotonic, so this bounds every pixel ), against the farthest block under it
+		if ( target.hiZ != nullptr ) {
+			const ivec2 blockMin = ( lo - target.origin ) / 8;
+			const ivec2 blockMax = ( hi - target.origin ) / 8;
+			float farthest = -std::numeric_limits< float >::infinity();
+			for ( int y = blockMin.y; y <= blockMax.y; y++ ) {
+				for ( int x = blockMin.x; x <= blockMax.x; x++ ) {
+					farthest = std::max( farthest, target.hiZ[ x + y * hiZWidth ] );
 				}
+			}
+			const ivec2 nearestBlock = target.origin + 8 * ivec2( ( rt.depth.a >= 0.0f ) ? blockMin.x : blockMax.x, ( rt.depth.b >= 0.0f ) ? blockMin.y : blockMax.y );
+			if ( rt.depth.BlockBase( nearestBlock - rt.origin ) + rt.depth.MinStep() >= farthest ) {
+				return false;
+			}
+		}
 
-				if ( Depth.GetAtXY( eval.x, eval.y )[ red ] > depth ) { // compute the color to write, texturing, etc, etc
+		// columns at or past the cutoff were never reached by the x-major scan
+		auto rowEnd = [ & ] ( const int y ) {
+			return std::min( hi.x, ( y >= rt.cutoff.y ) ? rt.cutoff.x - 1 : rt.cutoff.x );
+		};
+
+		bool reachedAnyBlock = false;
+		bool occludedAnyBlock = false;
+		for ( int by = lo.y & ~7; by <= hi.y; by += 8 ) {
+			for ( int bx = lo.x & ~7; bx <= hi.x; bx += 8 ) {
+				const ivec2 blockOffset = ivec2( bx, by ) - rt.origin;
+				float base[ 6 ];
+				bool rejected = false;
+				bool fullyCovered = true;
+				for ( int k = 0; k < 3; k++ ) {
+					base[ k ] = rt.edge[ k ].BlockBase( blockOffset );
+					rejected = rejected || ( base[ k ] + rt.edge[ k ].MaxStep() ) < 0.0f;
+					fullyCovered = fullyCovered && ( base[ k ] + rt.edge[ k ].MinStep() ) >= 0.0f;
+				}
+				if ( rejected ) {
+					continue; // the whole block is outside of this edge
+				}
 
-					vec4 texRef = TexRef( glm::mod( vec2( texCoord.x, 1.0f - texCoord.y ), vec2( 1.0f ) ), texCoord.z );
-					if ( texRef.a == 0.0f ) {
-						continue; // reject zero alpha samples - still need to implement blending
+				base[ 3 ] = rt.depth.BlockBase( blockOffset );
+				const ivec2 hiZBlock = ( ivec2( bx, by ) - target.origin ) / 8;
+				if ( target.hiZ != nullptr && base[ 3 ] + rt.depth.MinStep() >= target.hiZ[ hiZBlock.x + hiZBlock.y * hiZWidth ] ) {
+					counters.blocksOccluded++;
+					occludedAnyBlock = true;
+					continue; // the whole block is behind what's already there
+				}
+				reachedAnyBlock = true;
+				base[ 4 ] = rt.u.BlockBase( blockOffset );
+				base[ 5 ] = rt.v.BlockBase( blockOffset );
+
+				uint32_t blockWritten = 0;
+				for ( int qy = 0; qy < 8; qy += 2 ) {
+					const int y = by + qy;
+					if ( y + 1 < lo.y || y > hi.y ) continue;
+					const int rowMax[ 2 ] = { rowEnd( y ), ( y + 1 <= hi.y ) ? rowEnd( y + 1 ) : lo.x - 1 };
+					const bool rowValid[ 2 ] = { y >= lo.y, true };
+					for ( int qx = 0; qx < 8; qx += 2 ) {
+						const int x = bx + qx;
+						int valid = 0;
+						for ( int lane = 0; lane < 4; lane++ ) {
+							const int lx = x + ( lane & 1 );
+							if ( rowValid[ lane >> 1 ] && lx >= lo.x && lx <= rowMax[ lane >> 1 ] ) {
+								valid |= 1 << lane;
+							}
+						}
+						if ( !valid ) continue;
+
+						rasterQuad q;
+						EvaluateQuad( rt, base, qx, qy, fullyCovered, q );
+
+						// depth test before any of the texcoord work
+						size_t index[ 4 ];
+						int passed = 0;
+						for ( int lane = 0; lane < 4; lane++ ) {
+							if ( !( valid & q.covered & ( 1 << lane ) ) ) continue;
+							index[ lane ] = size_t( y + ( lane >> 1 ) - target.origin.y ) * target.stride + ( x + ( lane & 1 ) - target.origin.x );
+							if ( target.depth[ index[ lane ] ] > q.depth[ lane ] ) {
+								passed |= 1 << lane;
+							}
+						}
+						if ( !passed ) continue;
+
+						EvaluateQuadTexcoords( rt, base, qx, qy, q );
+						for ( int lane = 0; lane < 4; lane++ ) {
+							if ( !( passed & ( 1 << lane ) ) ) continue;
+							// compute the color to write, texturing, etc, etc
+							counters.pixelsShaded++;
+							vec4 texRef = TexRef( glm::mod( vec2( q.u[ lane ], 1.0f - q.v[ lane ] ), vec2( 1.0f ) ), rt.textureID, rt.dUVdx, rt.dUVdy );
+							if ( texRef.a == 0.0f ) {
+								continue; // reject zero alpha samples - still need to implement blending
+							}
+
+							// vec4 color( texCoord.x, texCoord.y, texCoord.z / texSet.size(), 1.0f );
+							vec4 color( texRef.x, texRef.y, texRef.z, 1.0f );
+
+							const color_4U value = ColorFromVec4( color );
+							std::copy( value.data.begin(), value.data.end(), target.color + index[ lane ] * 4 );
+							target.depth[ index[ lane ] ] = q.depth[ lane ];
+							blockWritten++;
+						}
 					}
+				}
 
-					// vec4 color( texCoord.x, texCoord.y, texCoord.z / texSet.size(), 1.0f );
-					vec4 color( texRef.x, texRef.y, texRef.z, 1.0f );
-
-					Color.SetAtXY( eval.x, eval.y, ColorFromVec4( color ) );
-					Depth.SetAtXY( eval.x, eval.y, color_1F( { depth } ) );
+				// depths only ever get closer, so the block's farthest value can only come down
+				if ( blockWritten != 0 && target.hiZ != nullptr ) {
+					UpdateHiZBlock( target, hiZBlock );
 				}
+				counters.pixelsWritten += blockWritten;
 			}
 		}
+		return reachedAnyBlock || !occludedAnyBlock;
 	}
 
+	// draw triangle
+	void DrawTriangle ( triangle t, const mat3 transform, const vec3 offset ) {
+		rasterTriangle rt;
+		rasterStats_t counters;
+		if ( SetupTriangle( t, transform, offset, rt ) ) {
+			RasterizeTriangle( rt, FullscreenTarget(), counters );
+		}
+	}
 
 // the interface to TinyOBJLoader has changed significantly, and my wrapper is no longer really relevant at all - this will need to be rewritten to handle the new stuff
 	// on the upside - materials become much, much easier to handle - this means that I will be able to more easily handle multi-texture models
 		// for example, the sponza model I found here https://github.com/jimmiebergmann/Sponza
 
+	// binary mesh cache, written beside the OBJ on the first load - the arrays are flat, one entry per triangle, so a
+		// later load maps the file and assembles the triangles straight out of it instead of parsing text again
+	static constexpr uint32_t meshCacheVersion = 2;
+	struct meshCacheHeader {
+		char magic[ 8 ] = { 'S', 'R', 'M', 'E', 'S', 'H', 0, 0 };
+		uint32_t version = meshCacheVersion;
+		uint32_t headerSize = sizeof( meshCacheHeader );
+		uint64_t sourceSize = 0;		// size and timestamp of the OBJ it was built from, a change in either means a rebuild
+		int64_t sourceTime = 0;
+		uint64_t materialStamp = 0;		// same for the MTL files it names, hashed together - see MaterialStamp()
+		uint64_t triangleCount = 0;
+		uint64_t textureCount = 0;		// texture paths, in LoadTex order - empty strings for missing textures
+		uint64_t materialCount = 0;		// MTL file paths, in mtllib order
+		uint64_t stringTableSize = 0;	// mtl search path, the texture paths, then the MTL paths - a uint32 length and the
+										// chars, padded to 4
+	};
+
+	// positions, normals, colors at 9 floats, texcoords at 6, and the material ID
+	static constexpr size_t meshCacheTriangleBytes = ( 9 + 9 + 6 + 9 ) * sizeof( float ) + sizeof( int32_t );
+
+	// flat per triangle arrays, pointing either into the mapped cache or at freshly parsed data
+	struct meshArrays {
+		const float *positions;			// 9 per triangle
+		const float *normals;			// 9
+		const float *texcoords;			// 6
+		const float *colors;			// 9
+		const int32_t *materialIDs;		// 1
+		size_t count;
+	};
+
+	static string MeshCachePath ( const string &modelPath ) {
+		return modelPath + ".srmesh";
+	}
+
+	// returns false if the source is missing, so there's no way to tell if a cache is current
+	static bool SourceStamp ( const string &modelPath, uint64_t &size, int64_t &time ) {
+		std::error_code ec;
+		size = std::filesystem::file_size( modelPath, ec );
+		if ( ec ) {
+			return false;
+		}
+		time = int64_t( std::filesystem::last_write_time( modelPath, ec ).time_since_epoch().count() );
+		return !ec;
+	}
+
+	// the MTL files named by the OBJ's mtllib lines, resolved the way TinyOBJLoader does it - against the search path,
+		// or the OBJ's own directory without one. Only needed when writing the cache, the OBJ stamp covers the list itself
+	static std::vector< string > MaterialLibraries ( const string &modelPath, const string &mtlSearchPath ) {
+		string directory = mtlSearchPath;
+		if ( directory.empty() ) {
+			const size_t slash = modelPath.find_last_of( "/\\" );
+			directory = ( slash != string::npos ) ? modelPath.substr( 0, slash ) : string();
+		}
+		if ( !directory.empty() && directory.back() != '/' ) {
+			directory += '/';
+		}
+
+		std::vector< string > libraries;
+		std::ifstream obj( modelPath );
+		string line;
+		while ( std::getline( obj, line ) ) {
+			std::istringstream tokens( line );
+			string keyword, name;
+			tokens >> keyword;
+			if ( keyword == "mtllib" ) {
+				while ( tokens >> name ) {
+					libraries.push_back( directory + name );
+				}
+			}
+		}
+		return libraries;
+	}
+
+	// FNV-1a over the size and timestamp of each MTL file, zeroes for one that's missing - editing a material changes it
+	static uint64_t MaterialStamp ( const std::vector< string > &libraries ) {
+		uint64_t hash = 0xcbf29ce484222325ull;
+		auto mix = [ &hash ] ( const uint64_t value ) { hash = ( hash ^ value ) * 0x100000001b3ull; };
+		for ( auto &library : libraries ) {
+			uint64_t size = 0;
+			int64_t time = 0;
+			if ( !SourceStamp( library, size, time ) ) {
+				size = 0;
+				time = 0;
+			}
+			mix( size );
+			mix( uint64_t( time ) );
+		}
+		return hash;
+	}
+
+	// textures decode and build their mip chains in parallel, then go into texSet in order. The image operations in
+		// PrepareTex nest their own row bands on the same pool, so nothing they keep alive across a wait can be shared per thread
+	void LoadTextures ( const std::vector< string > &texturePaths ) {
+		std::vector< Image_4U_Tiled > loaded( texturePaths.size() );
+		jbDE::GetThreadPool().ParallelFor( 0, texturePaths.size(), 1, [ & ] ( int64_t iMin, int64_t iMax ) {
+			for ( int64_t i = iMin; i < iMax; i++ ) {
+				loaded[ i ] = PrepareTex( texturePaths[ i ] );
+			}
+		} );
+		for ( auto &texture : loaded ) {
+			texSet.push_back( std::move( texture ) );
+		}
+	}
+
+	// fills out triangles from the flat arrays, computing the tangent frames along the way
+	void AssembleTriangles ( const meshArrays &mesh ) {
+		const size_t base = triangles.size();
+		triangles.resize( base + mesh.count );
+		jbDE::GetThreadPool().ParallelFor( 0, mesh.count, 4096, [ & ] ( int64_t iMin, int64_t iMax ) {
+			for ( int64_t i = iMin; i < iMax; i++ ) {
+				triangle &t = triangles[ base + i ];
+				const float *p = mesh.positions + 9 * i;
+				const float *n = mesh.normals + 9 * i;
+				const float *uv = mesh.texcoords + 6 * i;
+				const float *c = mesh.colors + 9 * i;
+				const float texID = float( mesh.materialIDs[ i ] );
+
+				t.p0 = vec3( p[ 0 ], p[ 1 ], p[ 2 ] );
+				t.p1 = vec3( p[ 3 ], p[ 4 ], p[ 5 ] );
+				t.p2 = vec3( p[ 6 ], p[ 7 ], p[ 8 ] );
+				t.n0 = vec3( n[ 0 ], n[ 1 ], n[ 2 ] );
+				t.n1 = vec3( n[ 3 ], n[ 4 ], n[ 5 ] );
+				t.n2 = vec3( n[ 6 ], n[ 7 ], n[ 8 ] );
+				t.t0 = vec3( uv[ 0 ], uv[ 1 ], texID );
+				t.t1 = vec3( uv[ 2 ], uv[ 3 ], texID );
+				t.t2 = vec3( uv[ 4 ], uv[ 5 ], texID );
+				t.c0 = vec3( c[ 0 ], c[ 1 ], c[ 2 ] );
+				t.c1 = vec3( c[ 3 ], c[ 4 ], c[ 5 ] );
+				t.c2 = vec3( c[ 6 ], c[ 7 ], c[ 8 ] );
+
+				// compute tangent, bitangent
+				vec3 edge1 = t.p1 - t.p0;
+				vec3 edge2 = t.p2 - t.p0;
+				vec2 deltaUV1 = t.t1 - t.t0;
+				vec2 deltaUV2 = t.t2 - t.t0;
+
+				float f = 1.0f / ( deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y );
+				t.t.x = f * ( deltaUV2.y * edge1.x - deltaUV1.y * edge2.x );
+				t.t.y = f * ( deltaUV2.y * edge1.y - deltaUV1.y * edge2.y );
+				t.t.z = f * ( deltaUV2.y * edge1.z - deltaUV1.y * edge2.z );
+				t.b.x = f * ( -deltaUV2.x * edge1.x + deltaUV1.x * edge2.x );
+				t.b.y = f * ( -deltaUV2.x * edge1.y + deltaUV1.x * edge2.y );
+				t.b.z = f * ( -deltaUV2.x * edge1.z + deltaUV1.x * edge2.z );
+			}
+		} );
+	}
+
+	// maps the cache and loads from it, if there is one that's current for this OBJ and search path
+	bool LoadMeshCache ( const string &modelPath, const string &mtlSearchPath ) {
+		meshCacheHeader expected;
+		if ( !SourceStamp( modelPath, expected.sourceSize, expected.sourceTime ) ) {
+			return false;
+		}
+
+		mappedFile cache( MeshCachePath( modelPath ) );
+		const meshCacheHeader *header = cache.At< meshCacheHeader >( 0 );
+		if ( header == nullptr || std::memcmp( header->magic, expected.magic, sizeof( expected.magic ) ) != 0 ||
+			header->version != expected.version || header->headerSize != expected.headerSize ||
+			header->sourceSize != expected.sourceSize || header->sourceTime != expected.sourceTime ) {
+			return false;
+		}
+
+		// the counts get bounded by the file size before any arithmetic on them - every string takes at least 4 bytes of
+			// the table, and every triangle meshCacheTriangleBytes of the file - so nothing below can wrap around
+		size_t offset = sizeof( meshCacheHeader );
+		if ( header->stringTableSize > cache.Size() - offset || header->triangleCount > cache.Size() / meshCacheTriangleBytes ||
+			header->textureCount > header->stringTableSize / 4 || header->materialCount > header->stringTableSize / 4 ) {
+			return false;
+		}
+
+		// string table
+		const size_t stringTableEnd = offset + header->stringTableSize;
+		auto readString = [ & ] ( string &out ) {
+			const uint32_t *length = cache.At< uint32_t >( offset );
+			const char *chars = ( length != nullptr ) ? cache.At< char >( offset + sizeof( uint32_t ), *length ) : nullptr;
+			if ( chars == nullptr || offset + sizeof( uint32_t ) + *length > stringTableEnd ) {
+				return false;
+			}
+			out.assign( chars, *length );
+			offset += ( sizeof( uint32_t ) + *length + 3 ) & ~size_t( 3 );
+			return true;
+		};
+		string cachedSearchPath;
+		if ( !readString( cachedSearchPath ) || cachedSearchPath != mtlSearchPath ) {
+			return false;
+		}
+		std::vector< string > texturePaths( header->textureCount );
+		for ( auto &path : texturePaths ) {
+			if ( !readString( path ) ) {
+				return false;
+			}
+		}
+		std::vector< string > materialLibraries( header->materialCount );
+		for ( auto &path : materialLibraries ) {
+			if ( !readString( path ) ) {
+				return false;
+			}
+		}
+		if ( MaterialStamp( materialLibraries ) != header->materialStamp ) {
+			return false; // a material changed, the texture paths may be stale
+		}
+
+		// per triangle arrays
+		const size_t count = header->triangleCount;
+		meshArrays mesh;
+		mesh.count = count;
+		offset = stringTableEnd;
+		mesh.positions = cache.At< float >( offset, 9 * count );		offset += 9 * count * sizeof( float );
+		mesh.normals = cache.At< float >( offset, 9 * count );			offset += 9 * count * sizeof( float );
+		mesh.texcoords = cache.At< float >( offset, 6 * count );		offset += 6 * count * sizeof( float );
+		mesh.colors = cache.At< float >( offset, 9 * count );			offset += 9 * count * sizeof( float );
+		mesh.materialIDs = cache.At< int32_t >( offset, count );
+		if ( !mesh.positions || !mesh.normals || !mesh.texcoords || !mesh.colors || !mesh.materialIDs ) {
+			return false; // truncated
+		}
+
+		LoadTextures( texturePaths );
+		AssembleTriangles( mesh );
+		if ( verboseLoad ) {
+			cout << "loaded " << count << " triangles from " << MeshCachePath( modelPath ) << newline;
+		}
+		return true;
+	}
+
+	// written to a temp file and renamed into place, so a partial write never gets picked up as a cache
+	void WriteMeshCache ( const string &modelPath, const string &mtlSearchPath, const std::vector< string > &texturePaths, const meshArrays &mesh ) {
+		meshCacheHeader header;
+		if ( !SourceStamp( modelPath, header.sourceSize, header.sourceTime ) ) {
+			return;
+		}
+		const std::vector< string > materialLibraries = MaterialLibraries( modelPath, mtlSearchPath );
+		header.materialStamp = MaterialStamp( materialLibraries );
+		header.triangleCount = mesh.count;
+		header.textureCount = texturePaths.size();
+		header.materialCount = materialLibraries.size();
+
+		std::vector< char > stringTable;
+		auto writeString = [ & ] ( const string &value ) {
+			const uint32_t length = uint32_t( value.size() );
+			const char *lengthBytes = reinterpret_cast< const char * >( &length );
+			stringTable.insert( stringTable.end(), lengthBytes, lengthBytes + sizeof( length ) );
+			stringTable.insert( stringTable.end(), value.begin(), value.end() );
+			stringTable.resize( ( stringTable.size() + 3 ) & ~size_t( 3 ), 0 );
+		};
+		writeString( mtlSearchPath );
+		for ( auto &path : texturePaths ) {
+			writeString( path );
+		}
+		for ( auto &path : materialLibraries ) {
+			writeString( path );
+		}
+		header.stringTableSize = stringTable.size();
+
+		const string cachePath = MeshCachePath( modelPath );
+		const string tempPath = cachePath + ".tmp";
+		{
+			std::ofstream file( tempPath, std::ios::binary | std::ios::trunc );
+			file.write( reinterpret_cast< const char * >( &header ), sizeof( header ) );
+			file.write( stringTable.data(), stringTable.size() );
+			file.write( reinterpret_cast< const char * >( mesh.positions ), 9 * mesh.count * sizeof( float ) );
+			file.write( reinterpret_cast< const char * >( mesh.normals ), 9 * mesh.count * sizeof( float ) );
+			file.write( reinterpret_cast< const char * >( mesh.texcoords ), 6 * mesh.count * sizeof( float ) );
+			file.write( reinterpret_cast< const char * >( mesh.colors ), 9 * mesh.count * sizeof( float ) );
+			file.write( reinterpret_cast< const char * >( mesh.materialIDs ), mesh.count * sizeof( int32_t ) );
+			if ( !file ) {
+				cout << "SoftRast: failed to write mesh cache " << cachePath << newline;
+				return;
+			}
+		}
+		std::error_code ec;
+		std::filesystem::rename( tempPath, cachePath, ec );
+	}
+
 	void LoadModel ( string modelPath, string mtlSearchPath ) {
+		// Tick();
+
+		if ( LoadMeshCache( modelPath, mtlSearchPath ) ) {
+			return;
+		}
+
 		tinyobj::ObjReaderConfig readerConfig;
 		readerConfig.mtl_search_path = mtlSearchPath;
 
 		tinyobj::ObjReader reader;
 
-		// Tick();
-
 		// report any errors or warnings
 		if ( !reader.ParseFromFile( modelPath, readerConfig ) ) {
 			if ( !reader.Error().empty() ) {
 				cout << "TinyOBJLoader: " << reader.Error() << newline;
 			}
+			return;
 		}
 
 		if ( !reader.Warning().empty() ) {
@@ -347,12 +937,13 @@ public:
 		// full complement of pbr textures ( intel sponza is a nice option, given sufficient VRAM )
 
 		// iterating through the materials
+		std::vector< string > texturePaths;
 		for ( size_t materialID = 0; materialID < materials.size(); materialID++ ) {
 
 			string diffuseTexname = materials[ materialID ].diffuse_texname;
 			string normalTexname = materials[ materialID ].displacement_texname;
-			LoadTex( diffuseTexname.empty() ? string() : mtlSearchPath + diffuseTexname );
-			LoadTex( normalTexname.empty() ? string() : mtlSearchPath + normalTexname );
+			texturePaths.push_back( diffuseTexname.empty() ? string() : mtlSearchPath + diffuseTexname );
+			texturePaths.push_back( normalTexname.empty() ? string() : mtlSearchPath + normalTexname );
 
 			if ( verboseLoad ) {
 				cout << "Material " << materialID << " is called " << materials[ materialID ].name << newline;
@@ -361,123 +952,211 @@ public:
 				cout << "  normal texture is: " << normalTexname << newline;
 			}
 		}
-
-
-		// iterating through shapes in the file
+		LoadTextures( texturePaths );
+
+		// where each face starts in its shape's index array - this is the only serial part of the assembly
+		struct faceRef {
+			uint32_t shapeID;
+			uint32_t faceID;
+			size_t indexOffset;
+		};
+		std::vector< faceRef > faces;
 		for ( size_t shapeID = 0; shapeID < shapes.size(); shapeID++ ) {
-
-			// for indexing into the mesh's index array
 			size_t indexOffset = 0;
-
-			// iterating through faces in the mesh
 			for ( size_t faceID = 0; faceID < shapes[ shapeID ].mesh.num_face_vertices.size(); faceID++ ) {
+				faces.push_back( { uint32_t( shapeID ), uint32_t( faceID ), indexOffset } );
+				// increment index array indexing by ( what should always be 3 )
+				indexOffset += shapes[ shapeID ].mesh.num_face_vertices[ faceID ];
+			}
+		}
 
-				triangle t; // current triangle to be drawn
+		// gather the vertex data for every face in parallel, into the same flat layout as the cache
+		const size_t count = faces.size();
+		std::vector< float > positions( 9 * count, 0.0f ), normals( 9 * count, 0.0f ), texcoords( 6 * count, 0.0f ), colors( 9 * count, 1.0f );
+		std::vector< int32_t > materialIDs( count );
+		std::atomic< uint32_t > badFaces = 0;
+		jbDE::GetThreadPool().ParallelFor( 0, count, 4096, [ & ] ( int64_t iMin, int64_t iMax ) {
+			for ( int64_t i = iMin; i < iMax; i++ ) {
+				const tinyobj::mesh_t &mesh = shapes[ faces[ i ].shapeID ].mesh;
 
 				// per-face material ( texture select )
-				size_t texID = shapes[ shapeID ].mesh.material_ids[ faceID ];
+				materialIDs[ i ] = mesh.material_ids[ faces[ i ].faceID ];
 
 				// this should basically always be 3, with the triangulate flag set ( default setting )
-				size_t numFaceVertices = size_t( shapes[ shapeID ].mesh.num_face_vertices[ faceID ] );
+				const size_t numFaceVertices = size_t( mesh.num_face_vertices[ faces[ i ].faceID ] );
+				if ( numFaceVertices != 3 ) {
+					badFaces++;
+				}
 
 				// iterating through vertices in the face
-				for ( size_t vertexID = 0; vertexID < numFaceVertices; vertexID++ ) {
-
-				// we got triangles
-					// access to vertex position data
-					tinyobj::index_t idx = shapes[ shapeID ].mesh.indices[ indexOffset + vertexID ];
-					tinyobj::real_t vx, vy, vz;
-					vx = attributes.vertices[ 3 * size_t( idx.vertex_index ) + 0 ];
-					vy = attributes.vertices[ 3 * size_t( idx.vertex_index ) + 1 ];
-					vz = attributes.vertices[ 3 * size_t( idx.vertex_index ) + 2 ];
+				for ( size_t vertexID = 0; vertexID < std::min< size_t >( numFaceVertices, 3 ); vertexID++ ) {
+					const tinyobj::index_t idx = mesh.indices[ faces[ i ].indexOffset + vertexID ];
+					for ( int c = 0; c < 3; c++ ) {
+						positions[ 9 * i + 3 * vertexID + c ] = attributes.vertices[ 3 * size_t( idx.vertex_index ) + c ];
+					}
 
-					tinyobj::real_t nx, ny, nz;
 					if ( idx.normal_index >= 0 ) { // Check if `normal_index` is zero or positive. negative = no normal data
-						nx = attributes.normals[ 3 * size_t( idx.normal_index ) + 0 ];
-						ny = attributes.normals[ 3 * size_t( idx.normal_index ) + 1 ];
-						nz = attributes.normals[ 3 * size_t( idx.normal_index ) + 2 ];
+						for ( int c = 0; c < 3; c++ ) {
+							normals[ 9 * i + 3 * vertexID + c ] = attributes.normals[ 3 * size_t( idx.normal_index ) + c ];
+						}
 					}
 
-					tinyobj::real_t tx, ty;
 					if ( idx.texcoord_index >= 0 ) { // Check if `texcoord_index` is zero or positive. negative = no texcoord data
-						tx = attributes.texcoords[ 2 * size_t( idx.texcoord_index ) + 0 ];
-						ty = attributes.texcoords[ 2 * size_t( idx.texcoord_index ) + 1 ];
-						// pack the material id in the third element
-					}
-
-					tinyobj::real_t red, green, blue;
-					if ( idx.vertex_index >= 0 ) { // Check if `vertex_index` is zero or positive. negative = no vertex color data
-						red   = attributes.colors[ 3 * size_t( idx.vertex_index ) + 0 ];
-						green = attributes.colors[ 3 * size_t( idx.vertex_index ) + 1 ];
-						blue  = attributes.colors[ 3 * size_t( idx.vertex_index ) + 2 ];
+						for ( int c = 0; c < 2; c++ ) {
+							texcoords[ 6 * i + 2 * vertexID + c ] = attributes.texcoords[ 2 * size_t( idx.texcoord_index ) + c ];
+						}
 					}
 
-
-					switch ( vertexID ) { // there's a better way to do this
-						case 0:
-							t.p0 = vec3( vx, vy, vz );
-							t.n0 = vec3( nx, ny, nz );
-							t.t0 = vec3( tx, ty, texID );
-							t.c0 = vec3( red, green, blue );
-							break;
-
-						case 1:
-							t.p1 = vec3( vx, vy, vz );
-							t.n1 = vec3( nx, ny, nz );
-							t.t1 = vec3( tx, ty, texID );
-							t.c1 = vec3( red, green, blue );
-							break;
-
-						case 2:
-							t.p2 = vec3( vx, vy, vz );
-							t.n2 = vec3( nx, ny, nz );
-							t.t2 = vec3( tx, ty, texID );
-							t.c2 = vec3( red, green, blue );
-							break;
-
-						default: // should not hit this, because of triangulate flag
-							cout << "vertex out of range" << newline;
-							break;
+					if ( idx.vertex_index >= 0 && !attributes.colors.empty() ) { // vertex colors are stored alongside the positions
+						for ( int c = 0; c < 3; c++ ) {
+							colors[ 9 * i + 3 * vertexID + c ] = attributes.colors[ 3 * size_t( idx.vertex_index ) + c ];
+						}
 					}
 				}
-
-				// increment index array indexing by ( what should always be 3 )
-				indexOffset += numFaceVertices;
-
-				// compute tangent, bitangent
-				vec3 edge1 = t.p1 - t.p0;
-				vec3 edge2 = t.p2 - t.p0;
-				vec2 deltaUV1 = t.t1 - t.t0;
-				vec2 deltaUV2 = t.t2 - t.t0;
-
-				float f = 1.0f / ( deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y );
-				t.t.x = f * ( deltaUV2.y * edge1.x - deltaUV1.y * edge2.x );
-				t.t.y = f * ( deltaUV2.y * edge1.y - deltaUV1.y * edge2.y );
-				t.t.z = f * ( deltaUV2.y * edge1.z - deltaUV1.y * edge2.z );
-				t.b.x = f * ( -deltaUV2.x * edge1.x + deltaUV1.x * edge2.x );
-				t.b.y = f * ( -deltaUV2.x * edge1.y + deltaUV1.x * edge2.y );
-				t.b.z = f * ( -deltaUV2.x * edge1.z + deltaUV1.x * edge2.z );
-
-				// do it
-				triangles.push_back( t );
 			}
+		} );
+
+		if ( badFaces != 0 ) { // should not hit this, because of triangulate flag
+			cout << badFaces << " faces without exactly three vertices, only the first three were used" << newline;
 		}
 
+		const meshArrays mesh = { positions.data(), normals.data(), texcoords.data(), colors.data(), materialIDs.data(), count };
+		WriteMeshCache( modelPath, mtlSearchPath, texturePaths, mesh );
+		AssembleTriangles( mesh );
+
 		// if ( verboseLoad ) {
 		// 	cout << "loading took " << Tock() / 1000.0f << "ms" << newline;
 		// }
 	}
 
+	// binned rasterization - triangles are set up in parallel and sorted into screen tiles, then the tiles are drawn in
+		// parallel, each one into a small color/depth cache that is copied back when it's done. Every tile sees its
+		// triangles in submission order and every triangle covers the same pixels it would on its own, so the result
+		// matches DrawModelSerial exactly
+	static constexpr int rasterTileSize = 64;		// 16k color + 16k depth per tile cache
+	static constexpr size_t binChunkSize = 4096;	// triangles per binning task
+
+	// per triangle state, for the culling counters
+	enum triangleState_t : uint8_t { CLIPPED, SETUP, DRAWN };
+
 	void DrawModel( const mat3 transform, const vec3 offset = vec3( 0.0f ) ) {
 		// Tick();
-		for ( auto& t : triangles ) {
-			DrawTriangle( t, transform, offset );
+		threadPool &pool = jbDE::GetThreadPool();
+		const ivec2 numTiles = ( ivec2( width, height ) + ivec2( rasterTileSize - 1 ) ) / rasterTileSize;
+		const size_t tileCount = size_t( numTiles.x ) * numTiles.y;
+		const size_t numChunks = ( triangles.size() + binChunkSize - 1 ) / binChunkSize;
+
+		// bins are [ chunk ][ tile ] lists of triangle indices - walking the chunks in order gives a tile its
+			// triangles in submission order, without any synchronization between the binning tasks
+		rasterTriangles.resize( triangles.size() );
+		triangleStates.resize( triangles.size() );
+		tileBins.resize( std::max( tileBins.size(), numChunks * tileCount ) );
+		pool.ParallelFor( 0, numChunks, 1, [ & ] ( int64_t chunkMin, int64_t chunkMax ) {
+			for ( size_t chunk = chunkMin; chunk < size_t( chunkMax ); chunk++ ) {
+				std::vector< uint32_t > *bins = &tileBins[ chunk * tileCount ];
+				for ( size_t i = 0; i < tileCount; i++ ) {
+					bins[ i ].clear();
+				}
+				const size_t end = std::min( triangles.size(), ( chunk + 1 ) * binChunkSize );
+				for ( size_t i = chunk * binChunkSize; i < end; i++ ) {
+					rasterTriangle &rt = rasterTriangles[ i ];
+					triangleStates[ i ] = CLIPPED;
+					if ( SetupTriangle( triangles[ i ], transform, offset, rt ) ) {
+						triangleStates[ i ] = SETUP;
+						const ivec2 tileMin = rt.bboxMin / rasterTileSize;
+						const ivec2 tileMax = rt.bboxMax / rasterTileSize;
+						for ( int y = tileMin.y; y <= tileMax.y; y++ ) {
+							for ( int x = tileMin.x; x <= tileMax.x; x++ ) {
+								bins[ x + y * numTiles.x ].push_back( uint32_t( i ) );
+							}
+						}
+					}
+				}
+			}
+		} );
+
+		uint8_t *colorBase = Color.GetImageDataBasePtr();
+		float *depthBase = Depth.GetImageDataBasePtr();
+		std::mutex statsLock;
+		rasterStats_t frameStats;
+		pool.ParallelFor( 0, tileCount, 1, [ & ] ( int64_t tileMin, int64_t tileMax ) {
+			uint8_t colorCache[ rasterTileSize * rasterTileSize * 4 ];
+			float depthCache[ rasterTileSize * rasterTileSize ];
+			float hiZCache[ ( rasterTileSize / 8 ) * ( rasterTileSize / 8 ) ];
+			rasterStats_t tileStats;
+			for ( size_t tile = tileMin; tile < size_t( tileMax ); tile++ ) {
+				bool empty = true;
+				for ( size_t chunk = 0; chunk < numChunks && empty; chunk++ ) {
+					empty = tileBins[ chunk * tileCount + tile ].empty();
+				}
+				if ( empty ) {
+					continue; // nothing to draw, leave the buffers alone
+				}
+
+				rasterTarget target { colorCache, depthCache, ivec2( tile % numTiles.x, tile / numTiles.x ) * rasterTileSize, ivec2( 0 ), rasterTileSize, hiZCache };
+				target.extent = glm::min( ivec2( rasterTileSize ), ivec2( width, height ) - target.origin );
+
+				// pull the tile into the cache, build its Hi-Z, draw everything that touches it, write it back
+				for ( int y = 0; y < target.extent.y; y++ ) {
+					const size_t source = size_t( target.origin.y + y ) * width + target.origin.x;
+					std::copy_n( colorBase + source * 4, target.extent.x * 4, colorCache + y * rasterTileSize * 4 );
+					std::copy_n( depthBase + source, target.extent.x, depthCache + y * rasterTileSize );
+				}
+				BuildHiZ( target );
+				for ( size_t chunk = 0; chunk < numChunks; chunk++ ) {
+					for ( const uint32_t i : tileBins[ chunk * tileCount + tile ] ) {
+						if ( RasterizeTriangle( rasterTriangles[ i ], target, tileStats ) ) {
+							std::atomic_ref< triangleState_t >( triangleStates[ i ] ).store( DRAWN, std::memory_order_relaxed );
+						}
+					}
+				}
+				for ( int y = 0; y < target.extent.y; y++ ) {
+					const size_t destination = size_t( target.origin.y + y ) * width + target.origin.x;
+					for ( int x = 0; x < target.extent.x; x++ ) {
+						tileStats.pixelsTouched += ( depthCache[ x + y * rasterTileSize ] != depthBase[ destination + x ] );
+					}
+					std::copy_n( colorCache + y * rasterTileSize * 4, target.extent.x * 4, colorBase + destination * 4 );
+					std::copy_n( depthCache + y * rasterTileSize, target.extent.x, depthBase + destination );
+				}
+			}
+			std::lock_guard< std::mutex > lock( statsLock );
+			frameStats += tileStats;
+		} );
+
+		frameStats.trianglesSubmitted = triangles.size();
+		for ( const triangleState_t state : triangleStates ) {
+			frameStats.trianglesClipped += ( state == CLIPPED );
+			frameStats.trianglesOccluded += ( state == SETUP );
 		}
+		stats = frameStats;
 		// if ( verboseDraw ) {
 			// cout << "drawing took " << Tock() / 1000.0f << "ms" << newline;
 		// }
 	}
 
+	// one triangle at a time, straight into the full buffers - reference for the binned path
+	void DrawModelSerial( const mat3 transform, const vec3 offset = vec3( 0.0f ) ) {
+		rasterTarget target = FullscreenTarget();
+		hiZBuffer.resize( size_t( ( width + 7 ) / 8 ) * ( ( height + 7 ) / 8 ) );
+		target.hiZ = hiZBuffer.data();
+		BuildHiZ( target );
+		const std::vector< float > depthBefore = *Depth.GetData();
+
+		stats = rasterStats_t();
+		stats.trianglesSubmitted = triangles.size();
+		for ( auto& t : triangles ) {
+			rasterTriangle rt;
+			if ( !SetupTriangle( t, transform, offset, rt ) ) {
+				stats.trianglesClipped++;
+			} else if ( !RasterizeTriangle( rt, target, stats ) ) {
+				stats.trianglesOccluded++;
+			}
+		}
+		for ( size_t i = 0; i < depthBefore.size(); i++ ) {
+			stats.pixelsTouched += ( depthBefore[ i ] != ( *Depth.GetData() )[ i ] );
+		}
+	}
+
 	void DrawModelWireframe( const mat3 transform, const vec3 offset = vec3( 0.0f ) ) {
 		// Tick();
 		for ( auto& t : triangles ) {
@@ -501,16 +1180,35 @@ public:
 		mins.z = glm::min( mins.z, p.z );
 		maxs.z = glm::max( maxs.z, p.z );
 	}
+	// chunks reduce in parallel, min/max don't care about order so this matches a serial pass exactly
+	void ModelBounds ( vec3 &mins, vec3 &maxs ) {
+		const size_t chunkSize = 16384;
+		const size_t numChunks = ( triangles.size() + chunkSize - 1 ) / chunkSize;
+		std::vector< vec3 > chunkMins( numChunks, vec3( 1e9f ) );
+		std::vector< vec3 > chunkMaxs( numChunks, vec3( -1e9f ) );
+		jbDE::GetThreadPool().ParallelFor( 0, numChunks, 1, [ & ] ( int64_t chunkMin, int64_t chunkMax ) {
+			for ( int64_t chunk = chunkMin; chunk < chunkMax; chunk++ ) {
+				const size_t end = std::min( triangles.size(), ( chunk + 1 ) * chunkSize );
+				for ( size_t i = chunk * chunkSize; i < end; i++ ) {
+					expandBBox( chunkMins[ chunk ], chunkMaxs[ chunk ], triangles[ i ].p0 );
+					expandBBox( chunkMins[ chunk ], chunkMaxs[ chunk ], triangles[ i ].p1 );
+					expandBBox( chunkMins[ chunk ], chunkMaxs[ chunk ], triangles[ i ].p2 );
+				}
+			}
+		} );
+		mins = vec3(  1e9f );
+		maxs = vec3( -1e9f );
+		for ( size_t chunk = 0; chunk < numChunks; chunk++ ) {
+			expandBBox( mins, maxs, chunkMins[ chunk ] );
+			expandBBox( mins, maxs, chunkMaxs[ chunk ] );
+		}
+	}
+
 	void UnitCubeRefit( bool verbose = false ) {
-		vec3 mins = vec3(  1e9f );
-		vec3 maxs = vec3( -1e9f );
+		vec3 mins, maxs;
 
 		// determine the size of the bounding box
-		for ( size_t i = 0; i < triangles.size(); i++ ) {
-			expandBBox( mins, maxs, triangles[ i ].p0 );
-			expandBBox( mins, maxs, triangles[ i ].p1 );
-			expandBBox( mins, maxs, triangles[ i ].p2 );
-		}
+		ModelBounds( mins, maxs );
 
 		// figure out scaling
 		vec3 spans = maxs - mins;
@@ -518,23 +1216,16 @@ public:
 		float largestDimension = glm::max( glm::max( spans.x, spans.y ), spans.z ) * 0.51f;
 
 		// run through again, butting the bbox min up against the origin + scaling appropriately to just fit inside -1..1
-		for ( size_t i = 0; i < triangles.size(); i++ ) {
-			triangles[ i ].p0 = ( triangles[ i ].p0 - center ) / largestDimension;
-			triangles[ i ].p1 = ( triangles[ i ].p1 - center ) / largestDimension;
-			triangles[ i ].p2 = ( triangles[ i ].p2 - center ) / largestDimension;
-		}
-
-		if ( verbose ) {
-			mins = vec3(  1e9f );
-			maxs = vec3( -1e9f );
-
-			// determine the size of the bounding box
-			for ( size_t i = 0; i < triangles.size(); i++ ) {
-				expandBBox( mins, maxs, triangles[ i ].p0 );
-				expandBBox( mins, maxs, triangles[ i ].p1 );
-				expandBBox( mins, maxs, triangles[ i ].p2 );
+		jbDE::GetThreadPool().ParallelFor( 0, triangles.size(), 16384, [ & ] ( int64_t iMin, int64_t iMax ) {
+			for ( int64_t i = iMin; i < iMax; i++ ) {
+				triangles[ i ].p0 = ( triangles[ i ].p0 - center ) / largestDimension;
+				triangles[ i ].p1 = ( triangles[ i ].p1 - center ) / largestDimension;
+				triangles[ i ].p2 = ( triangles[ i ].p2 - center ) / largestDimension;
 			}
+		} );
 
+		if ( verbose ) {
+			ModelBounds( mins, maxs );
 			cout << "bbox after is:" << endl;
 			cout << "mins: " << mins.x << " " << mins.y << " " << mins.z << endl;
 			cout << "maxs: " << maxs.x << " " << maxs.y << " " << maxs.z << endl;
@@ -543,6 +1234,15 @@ public:
 
 	std::vector<triangle> triangles;
 
+	// DrawModel scratch, kept around so the allocations carry over from frame to frame
+	std::vector< rasterTriangle > rasterTriangles;
+	std::vector< std::vector< uint32_t > > tileBins;
+
+	std::vector< triangleState_t > triangleStates;
+
+	// full screen Hi-Z for DrawModelSerial, the binned path keeps one per tile
+	std::vector< float > hiZBuffer;
+
 	// dimensions
 	uint32_t width = 0;
 	uint32_t height = 0;
@@ -0,0 +1,337 @@
+#pragma once
+#ifndef GRID_EROSION
+#define GRID_EROSION
+
+#include "../../engine/includes.h"
+
+// Eulerian counterpart to particleEroder - the virtual pipe model from Mei, Decaudin, Hu, "Fast Hydraulic Erosion
+	// Simulation and Visualization on GPU" ( 2007 ), plus thermal weathering. Water, sediment, outflow flux and velocity
+	// live in flat SoA grids, and every step is a handful of row sweeps over the whole map, so the cost goes with the
+	// map size and the step count instead of with a droplet count. Each pass only writes the cells of its own rows, and
+	// reads neighbors from arrays that pass doesn't write, so rows are split across the thread pool freely and the result
+	// doesn't depend on the thread count. Memory is twelve floats per cell - the eleven state and scratch grids, plus
+	// the model - so ~805MB at 4096x4096
+
+class gridEroder {
+public:
+	gridEroder () {}
+
+	// same initial terrain as the particle eroder
+	void InitWithPerlin ( const uint32_t dim = 1024 ) {
+		particleEroder p;
+		p.InitWithPerlin( dim );
+		model = std::move( p.model );
+		Reset();
+	}
+
+	void InitWithDiamondSquare ( const uint32_t dim = 1024 ) {
+		particleEroder p;
+		p.InitWithDiamondSquare( dim );
+		model = std::move( p.model );
+		Reset();
+	}
+
+	// clear the water and sediment, e.g. after putting a new heightmap in model
+	void Reset () {
+		const size_t count = size_t( model.Width() ) * model.Height();
+		for ( auto *grid : { &water, &sediment, &fluxL, &fluxR, &fluxT, &fluxB, &velocityX, &velocityY, &scratchA, &scratchB } ) {
+			grid->assign( count, 0.0f );
+		}
+		terrain.resize( count );
+	}
+
+	// each iteration is one timestep of the hydraulic passes, followed by thermal weathering
+	void Erode ( uint32_t numIterations ) {
+		w = model.Width();
+		h = model.Height();
+		if ( w < 2 || h < 2 ) return;
+		if ( water.size() != size_t( w ) * h ) {
+			Reset();
+		}
+
+		// the sim runs in world units where a cell is one unit wide - heightScale matches the scale the particle
+			// eroder uses for its normals, so the slopes come out similar
+		float *heights = model.GetImageDataBasePtr();
+		Rows( [ & ] ( uint32_t, size_t row ) {
+			for ( uint32_t x = 0; x < w; x++ ) {
+				terrain[ row + x ] = heights[ row + x ] * heightScale;
+			}
+		} );
+
+		for ( uint32_t i = 0; i < numIterations; i++ ) {
+			UpdateFlux();
+			TransportSediment();
+			UpdateWaterAndVelocity();
+			ErodeAndDeposit();
+			if ( thermalRate > 0.0f ) {
+				ThermalWeathering();
+			}
+		}
+
+		Rows( [ & ] ( uint32_t, size_t row ) {
+			for ( uint32_t x = 0; x < w; x++ ) {
+				heights[ row + x ] = terrain[ row + x ] / heightScale;
+			}
+		} );
+	}
+
+	// cells per second ( cells times iterations ), run on a copy of the current model, which is left as it was - the water
+		// and sediment start out clear, and are cleared again after
+	struct benchmarkResult_t {
+		float cellsPerSecond = 0.0f;
+		bool repeatable = false; // two runs from the same state came out identical
+	};
+
+	benchmarkResult_t Benchmark ( uint32_t numIterations ) {
+		benchmarkResult_t result;
+		const Image_1F original = model;
+		Reset();
+
+		const auto tStart = std::chrono::steady_clock::now();
+		Erode( numIterations );
+		const float seconds = std::chrono::duration< float >( std::chrono::steady_clock::now() - tStart ).count();
+		result.cellsPerSecond = ( seconds > 0.0f ) ? float( model.Width() ) * model.Height() * numIterations / seconds : 0.0f;
+
+		const Image_1F firstRun = model;
+		model = original;
+		Reset();
+		Erode( numIterations );
+		result.repeatable = std::equal( model.GetImageDataBasePtr(), model.GetImageDataBasePtr() + size_t( model.Width() ) * model.Height(), firstRun.GetImageDataBasePtr() );
+
+		model = original;
+		Reset();
+		return result;
+	}
+
+	void Save ( string filename ) {
+		model.Save( filename, Image_1F::backend::TINYEXR );
+	}
+
+	// simulation field
+	Image_1F model;
+
+	// simulation parameters
+	float heightScale = 60.0f;		// model units to world units
+	float timeStep = 0.05f;
+	float rainRate = 0.012f;		// water depth added per unit time, everywhere
+	float gravity = 9.81f;
+	float maxSpeed = 10.0f;			// cells per unit time, for the sediment capacity
+	float pipeArea = 1.0f;			// cross section of the virtual pipes
+	float capacityRate = 0.3f;		// Kc, sediment capacity per unit of speed and tilt
+	float dissolveRate = 0.5f;		// Ks, per unit time
+	float depositionRate = 1.0f;	// Kd, per unit time
+	float evaporationRate = 0.015f;	// Ke
+	float minTilt = 0.05f;			// so flat ground still carries a little sediment
+	float capacityDepth = 0.05f;	// water shallower than this carries proportionally less
+	float thermalRate = 0.15f;		// how fast material over the talus angle slides, zero to turn it off
+	float talusSlope = 0.5f;		// height difference per cell that loose material holds at
+
+	// state grids, row-major like the model
+	std::vector< float > terrain;		// model * heightScale, while Erode() runs
+	std::vector< float > water;
+	std::vector< float > sediment;
+	std::vector< float > fluxL, fluxR, fluxT, fluxB;	// outflow towards each neighbor
+	std::vector< float > velocityX, velocityY;
+
+private:
+	uint32_t w = 0;
+	uint32_t h = 0;
+
+	// per pass temporaries - sediment capacity, and the output of the transport and thermal passes
+	std::vector< float > scratchA;
+	std::vector< float > scratchB;
+
+	// rowFunc( y, index of the row's first cell ) over every row, split across the thread pool
+	template < typename rowFunc_t >
+	void Rows ( rowFunc_t &&rowFunc ) {
+		const uint32_t width = w;
+		const int64_t grain = std::max< int64_t >( 1, 16384 / width );
+		jbDE::GetThreadPool().ParallelFor( 0, h, grain, [ & ] ( int64_t lo, int64_t hi ) {
+			for ( int64_t y = lo; y < hi; y++ ) {
+				rowFunc( uint32_t( y ), size_t( y ) * width );
+			}
+		} );
+	}
+
+	// cell( x, left, right ) for a row - the interior loop has plain x - 1, x + 1 neighbors so it vectorizes, and the
+		// two ends run with the neighbor off the edge clamped back onto the cell itself. The passes copy everything they
+		// use into locals first, since a float member could alias the float stores as far as the compiler knows
+	template < typename cellFunc_t >
+	static void Sweep ( const uint32_t width, cellFunc_t &&cell ) {
+		cell( 0u, 0u, 1u );
+		for ( uint32_t x = 1; x < width - 1; x++ ) {
+			cell( x, x - 1, x + 1 );
+		}
+		cell( width - 1, width - 2, width - 1 );
+	}
+
+	// pass 1 - accelerate the outflow through each pipe by the difference in water surface height, scaled back so a
+		// cell can't send out more water than it has. Off the edge the neighbor is the cell itself, so nothing flows out
+	void UpdateFlux () {
+		const uint32_t width = w, height = h;
+		const float dt = timeStep;
+		const float k = timeStep * pipeArea * gravity;
+		const float rain = timeStep * rainRate; // uniform, so it only shows up in a cell's own volume
+		const float *b = terrain.data(), *d = water.data();
+		Rows( [ & ] ( uint32_t y, size_t row ) {
+			const size_t up = ( y > 0 ) ? row - width : row;
+			const size_t down = ( y + 1 < height ) ? row + width : row;
+			float *fl = fluxL.data() + row, *fr = fluxR.data() + row, *ft = fluxT.data() + row, *fb = fluxB.data() + row;
+			Sweep( width, [ & ] ( uint32_t x, uint32_t left, uint32_t right ) {
+				const float surface = b[ row + x ] + d[ row + x ];
+				const float l = std::max( 0.0f, fl[ x ] + k * ( surface - b[ row + left ] - d[ row + left ] ) );
+				const float r = std::max( 0.0f, fr[ x ] + k * ( surface - b[ row + right ] - d[ row + right ] ) );
+				const float t = std::max( 0.0f, ft[ x ] + k * ( surface - b[ up + x ] - d[ up + x ] ) );
+				const float bo = std::max( 0.0f, fb[ x ] + k * ( surface - b[ down + x ] - d[ down + x ] ) );
+				const float volume = d[ row + x ] + rain;
+				const float scale = std::min( 1.0f, volume / std::max( ( l + r + t + bo ) * dt, 1e-12f ) );
+				fl[ x ] = l * scale;
+				fr[ x ] = r * scale;
+				ft[ x ] = t * scale;
+				fb[ x ] = bo * scale;
+			} );
+		} );
+	}
+
+	// pass 2 - sediment goes along with the water, each pipe carries the same share of a cell's sediment as it does of
+		// its water. Done as a gather of what the neighbors send, before the water moves, so mass is kept exactly
+	void TransportSediment () {
+		const uint32_t width = w, height = h;
+		const float dt = timeStep;
+		const float rain = timeStep * rainRate;
+		const float *d = water.data(), *s = sediment.data(), *fl = fluxL.data(), *fr = fluxR.data(), *ft = fluxT.data(), *fb = fluxB.data();
+		// what fraction of a cell's contents leaves through a pipe this step
+		auto share = [ & ] ( const size_t i, const float flux ) { return std::min( flux * dt / std::max( d[ i ] + rain, 1e-12f ), 1.0f ); };
+		Rows( [ & ] ( uint32_t y, size_t row ) {
+			const size_t up = ( y > 0 ) ? row - width : row;
+			const size_t down = ( y + 1 < height ) ? row + width : row;
+			const float upWeight = ( y > 0 ) ? 1.0f : 0.0f, downWeight = ( y + 1 < height ) ? 1.0f : 0.0f; // no neighbor off the edge
+			float *out = scratchB.data() + row;
+			Sweep( width, [ & ] ( uint32_t x, uint32_t left, uint32_t right ) {
+				const size_t i = row + x;
+				float carried = s[ i ] * ( 1.0f - share( i, fl[ i ] + fr[ i ] + ft[ i ] + fb[ i ] ) );
+				carried += ( left != x ) ? s[ row + left ] * share( row + left, fr[ row + left ] ) : 0.0f;
+				carried += ( right != x ) ? s[ row + right ] * share( row + right, fl[ row + right ] ) : 0.0f;
+				carried += upWeight * s[ up + x ] * share( up + x, fb[ up + x ] );
+				carried += downWeight * s[ down + x ] * share( down + x, ft[ down + x ] );
+				out[ x ] = carried;
+			} );
+		} );
+		sediment.swap( scratchB );
+	}
+
+	// pass 3 - move the water by the net flux, and get the velocity from the flow through the cell. Capacity goes out
+		// to scratchA here since it needs the terrain gradient, which pass 4 changes
+	void UpdateWaterAndVelocity () {
+		const uint32_t width = w, height = h;
+		const float dt = timeStep;
+		const float rain = timeStep * rainRate;
+		const float kc = capacityRate, tiltFloor = minTilt, depthScale = capacityDepth, speedLimit = maxSpeed;
+		const float *b = terrain.data(), *fl = fluxL.data(), *fr = fluxR.data(), *ft = fluxT.data(), *fb = fluxB.data();
+		Rows( [ & ] ( uint32_t y, size_t row ) {
+			const size_t up = ( y > 0 ) ? row - width : row;
+			const size_t down = ( y + 1 < height ) ? row + width : row;
+			const float upWeight = ( y > 0 ) ? 1.0f : 0.0f, downWeight = ( y + 1 < height ) ? 1.0f : 0.0f;
+			float *d = water.data() + row, *u = velocityX.data() + row, *v = velocityY.data() + row, *capacity = scratchA.data() + row;
+			Sweep( width, [ & ] ( uint32_t x, uint32_t left, uint32_t right ) {
+				const size_t i = row + x;
+				// a neighbor off the edge was clamped to this cell, and its flux towards us doesn't exist
+				const float inL = ( left != x ) ? fr[ row + left ] : 0.0f;
+				const float inR = ( right != x ) ? fl[ row + right ] : 0.0f;
+				const float inT = upWeight * fb[ up + x ];
+				const float inB = downWeight * ft[ down + x ];
+				const float outflow = fl[ i ] + fr[ i ] + ft[ i ] + fb[ i ];
+				const float before = d[ x ] + rain;
+				const float after = std::max( 0.0f, before + dt * ( inL + inR + inT + inB - outflow ) );
+				d[ x ] = after;
+
+				const float meanDepth = std::max( 0.5f * ( before + after ), 1e-4f );
+				const float velocityX = 0.5f * ( inL - fl[ i ] + fr[ i ] - inR ) / meanDepth;
+				const float velocityY = 0.5f * ( inT - ft[ i ] + fb[ i ] - inB ) / meanDepth;
+				u[ x ] = velocityX;
+				v[ x ] = velocityY;
+
+				const float gradX = 0.5f * ( b[ row + right ] - b[ row + left ] );
+				const float gradY = 0.5f * ( b[ down + x ] - b[ up + x ] );
+				const float gradient2 = gradX * gradX + gradY * gradY;
+				const float sinTilt = std::max( std::sqrt( gradient2 / ( 1.0f + gradient2 ) ), tiltFloor );
+				const float depthLimit = std::min( after / depthScale, 1.0f ); // a film of water can't carry much
+				const float speed = std::min( std::sqrt( velocityX * velocityX + velocityY * velocityY ), speedLimit );
+				capacity[ x ] = kc * sinTilt * speed * depthLimit;
+			} );
+		} );
+	}
+
+	// pass 4 - dissolve terrain into the water when it's under capacity, drop sediment when it's over, and evaporate
+	void ErodeAndDeposit () {
+		const uint32_t width = w;
+		const float dissolve = timeStep * dissolveRate, deposit = timeStep * depositionRate;
+		const float evaporation = std::max( 0.0f, 1.0f - timeStep * evaporationRate );
+		Rows( [ & ] ( uint32_t, size_t row ) {
+			float *b = terrain.data() + row, *s = sediment.data() + row, *d = water.data() + row;
+			const float *capacity = scratchA.data() + row;
+			for ( uint32_t x = 0; x < width; x++ ) {
+				const float difference = capacity[ x ] - s[ x ];
+				const float amount = ( ( difference > 0.0f ) ? dissolve : deposit ) * difference;
+				b[ x ] -= amount;
+				s[ x ] += amount;
+				d[ x ] *= evaporation;
+			}
+		} );
+	}
+
+	// pass 5 - material above the talus slope slides to the lower neighbors, a fixed fraction of the excess per step.
+		// Each pair of cells uses the same two heights from either side, so what one loses the other gains
+	void ThermalWeathering () {
+		const uint32_t width = w, height = h;
+		const float rate = std::min( timeStep * thermalRate, 0.2f ); // past a fifth, a peak can overshoot its neighbors
+		const float talus = talusSlope;
+		const float *b = terrain.data();
+		auto exchange = [ talus ] ( const float self, const float neighbor ) {
+			return std::max( 0.0f, neighbor - self - talus ) - std::max( 0.0f, self - neighbor - talus );
+		};
+		Rows( [ & ] ( uint32_t y, size_t row ) {
+			const size_t up = ( y > 0 ) ? row - width : row;
+			const size_t down = ( y + 1 < height ) ? row + width : row;
+			float *out = scratchB.data() + row;
+			Sweep( width, [ & ] ( uint32_t x, uint32_t left, uint32_t right ) {
+				const float self = b[ row + x ];
+				const float change = exchange( self, b[ row + left ] ) + exchange( self, b[ row + right ] ) + exchange( self, b[ up + x ] ) + exchange( self, b[ down + x ] );
+				out[ x ] = self + rate * change;
+			} );
+		} );
+		terrain.swap( scratchB );
+	}
+};
+
+// how two erosion results from the same starting map compare - the mean absolute height change of each, and the
+	// correlation of their height change maps, 1.0 when they carve and fill in the same places in the same proportions
+struct erosionComparison_t {
+	float meanChangeA = 0.0f;
+	float meanChangeB = 0.0f;
+	float correlation = 0.0f;
+};
+
+inline erosionComparison_t CompareErosion ( const Image_1F &before, const Image_1F &a, const Image_1F &b ) {
+	erosionComparison_t result;
+	const size_t count = size_t( before.Width() ) * before.Height();
+	if ( count == 0 ) return result;
+	const float *h0 = before.GetImageDataBasePtr(), *ha = a.GetImageDataBasePtr(), *hb = b.GetImageDataBasePtr();
+	double sumA = 0.0, sumB = 0.0, sumAA = 0.0, sumBB = 0.0, sumAB = 0.0, absA = 0.0, absB = 0.0;
+	for ( size_t i = 0; i < count; i++ ) {
+		const double da = double( ha[ i ] ) - h0[ i ];
+		const double db = double( hb[ i ] ) - h0[ i ];
+		sumA += da; sumB += db;
+		sumAA += da * da; sumBB += db * db; sumAB += da * db;
+		absA += std::abs( da ); absB += std::abs( db );
+	}
+	const double covariance = sumAB - sumA * sumB / count;
+	const double varianceA = sumAA - sumA * sumA / count;
+	const double varianceB = sumBB - sumB * sumB / count;
+	result.meanChangeA = float( absA / count );
+	result.meanChangeB = float( absB / count );
+	result.correlation = ( varianceA > 0.0 && varianceB > 0.0 ) ? float( covariance / std::sqrt( varianceA * varianceB ) ) : 0.0f;
+	return result;
+}
+
+#endif // GRID_EROSION
@@ -22,83 +22,45 @@ public:
 		}
 	}
 
+	// dim + 1 samples square, same as the old no-wrap version - one lattice cell of the generator covers the whole map,
+		// like the four random corners did, but any size works now, not just powers of two
 	void InitWithDiamondSquare ( const uint32_t dim = 1024 ) {
-		long unsigned int seed = std::chrono::system_clock::now().time_since_epoch().count();
-
-		std::default_random_engine engine{ seed };
-		std::uniform_real_distribution< float > distribution{ 0.0f, 1.0f };
-
-		// todo: make this variable ( data array cannot be variable size in c++ )
-		// const uint32_t dim = 1024;
-		// const uint32_t dim = 4096;
-
-	// #define TILE
-	#ifdef TILE
-		const auto size = dim;
-	#else
-		const auto size = dim + 1; // for no_wrap
-	#endif
-
-		const auto edge = size - 1;
-		// float data[ size ][ size ] = { { 0.0f } };
-		std::vector< std::vector< float > > data;
-		data.resize( size );
-		for ( uint32_t i = 0; i < size; i++ ) {
-			data[ i ].resize( size );
-		}
-
-		// data[ 0 ][ 0 ] = data[ edge ][ 0 ] = data[ 0 ][ edge ] = data[ edge ][ edge ] = 0.25f;
-
-		rng pos = rng( 0.0f, 1.5f );
-		data[ 0 ][ 0 ] = pos();
-		data[ edge ][ 0 ] = pos();
-		data[ 0 ][ edge ] = pos();
-		data[ edge ][ edge ] = pos();
-
-	#ifdef TILE
-		heightfield::diamond_square_wrap
-	#else
-		heightfield::diamond_square_no_wrap
-	#endif
-		(size,
-			// random
-			[ &engine, &distribution ]( float range ) {
-				return distribution( engine ) * range;
-			},
-			// variance
-			[]( int level ) -> float {
-				return std::pow( 0.5f, level );
-				// return static_cast<float>( std::numeric_limits<float>::max() / 2 ) * std::pow(0.5f, level);
-				// return static_cast<float>(std::numeric_limits<float>::max()/1.6) * std::pow(0.5f, level);
-			},
-			// at
-			[ &data ]( int x, int y ) -> float& {
-				return data[ x ][ y ];
-			}
-		);
-
-		model = Image_1F( size, size );
-		for ( uint32_t y = 0; y < size; y++ ) {
-			for ( uint32_t x = 0; x < size; x++ ) {
-				model.SetAtXY( x, y, color_1F( { data[ x ][ y ] } ) );
-			}
-		}
+		diamondSquareSettings_t settings;
+		settings.seed = std::chrono::system_clock::now().time_since_epoch().count();
+		settings.featureSize = dim;
+		diamondSquareGenerator( settings ).Generate( model, 0, 0, dim + 1, dim + 1 );
 
 		// model.Save( "test.exr", Image_1F::backend::TINYEXR );
 	}
 
+	// same as model.GetAtXY( x, y )[ red ], zero off the edge, without building the color
+	float Height ( uint32_t x, uint32_t y ) const {
+		return ( x < model.Width() && y < model.Height() ) ? model.GetImageDataBasePtr()[ x + size_t( y ) * model.Width() ] : 0.0f;
+	}
+
 	vec3 GetSurfaceNormal ( uint32_t x, uint32_t y ) {
 		const float scale = 60.0f;
 
-		const float cache00 = model.GetAtXY( x, y )[ red ];
-		const float cachep0 = model.GetAtXY( x + 1, y )[ red ];
-		const float cachen0 = model.GetAtXY( x - 1, y )[ red ];
-		const float cache0p = model.GetAtXY( x, y + 1 )[ red ];
-		const float cache0n = model.GetAtXY( x, y - 1 )[ red ];
-		const float cachepp = model.GetAtXY( x + 1, y + 1 )[ red ];
-		const float cachepn = model.GetAtXY( x + 1, y - 1 )[ red ];
-		const float cachenp = model.GetAtXY( x - 1, y + 1 )[ red ];
-		const float cachenn = model.GetAtXY( x - 1, y - 1 )[ red ];
+		// away from the edges the neighborhood is three runs of three in the row-major data, no bounds checks needed
+		float cache00, cachep0, cachen0, cache0p, cache0n, cachepp, cachepn, cachenp, cachenn;
+		if ( x > 0 && y > 0 && x + 1 < model.Width() && y + 1 < model.Height() ) {
+			const float *center = model.GetImageDataBasePtr() + x + size_t( y ) * model.Width();
+			const float *below = center - model.Width();
+			const float *above = center + model.Width();
+			cache00 = center[ 0 ];	cachep0 = center[ 1 ];	cachen0 = center[ -1 ];
+			cache0p = above[ 0 ];	cachepp = above[ 1 ];	cachenp = above[ -1 ];
+			cache0n = below[ 0 ];	cachepn = below[ 1 ];	cachenn = below[ -1 ];
+		} else {
+			cache00 = Height( x, y );
+			cachep0 = Height( x + 1, y );
+			cachen0 = Height( x - 1, y );
+			cache0p = Height( x, y + 1 );
+			cache0n = Height( x, y - 1 );
+			cachepp = Height( x + 1, y + 1 );
+			cachepn = Height( x + 1, y - 1 );
+			cachenp = Height( x - 1, y + 1 );
+			cachenn = Height( x - 1, y - 1 );
+		}
 
 		const float sqrt2 = sqrt( 2.0f );
 
@@ -123,6 +85,45 @@ public:
 		float sedimentFraction = 0.0f;
 	};
 
+	// runs one droplet until it evaporates or leaves the box [ boxMin, boxMax ) - the whole map for the serial path
+	void SimulateDroplet ( particle &p, const glm::uvec2 boxMin, const glm::uvec2 boxMax ) {
+		const uint32_t w = model.Width();
+		const uint32_t h = model.Height();
+		float *heights = model.GetImageDataBasePtr();
+
+		while ( p.volume > minVolume ) { // while the droplet exists (drop volume > 0)
+			const glm::uvec2 initialPosition = p.position; // cache the initial position
+			const vec3 normal = GetSurfaceNormal( initialPosition.x, initialPosition.y );
+
+			// newton's second law to calculate acceleration
+			p.speed += timeStep * glm::vec2( normal.x, normal.z ) / ( p.volume * density ); // F = MA, A = F/M
+			p.position += timeStep * p.speed; // update position based on new speed
+			p.speed *= ( 1.0f - timeStep * friction ); // friction factor to attenuate speed
+
+			// // wrap if out of bounds (mod logic)
+			// particle_wrap(p);
+			// if(glm::any(glm::isnan(p.position)))
+			//     break;
+
+			// thought I was clever, just discard if out of bounds
+			if ( !glm::all( glm::greaterThanEqual( p.position, glm::vec2( boxMin ) ) ) ||
+				!glm::all( glm::lessThan( p.position, glm::vec2( boxMax ) ) ) ) break;
+
+			// sediment capacity
+			glm::ivec2 refPoint = glm::ivec2( p.position.x, p.position.y );
+			float maxSediment = p.volume * glm::length( p.speed ) * ( Height( initialPosition.x, initialPosition.y ) - Height( refPoint.x, refPoint.y ) );
+			maxSediment = std::max( maxSediment, 0.0f ); // don't want negative values here
+			float sedimentDifference = maxSediment - p.sedimentFraction;
+
+			// update sediment content, deposit on the heightmap
+			p.sedimentFraction += timeStep * depositionRate * sedimentDifference;
+			heights[ std::clamp( initialPosition.x, 0u, w - 1 ) + size_t( std::clamp( initialPosition.y, 0u, h - 1 ) ) * w ] -= ( timeStep * p.volume * depositionRate * sedimentDifference );
+
+			// evaporate the droplet
+			p.volume *= ( 1.0f - timeStep * evaporationRate );
+		}
+	}
+
 	void Erode ( uint32_t numIterations ) {
 		std::default_random_engine gen;
 
@@ -139,42 +140,136 @@ public:
 			//spawn a new particle at a random position
 			particle p;
 			p.position = glm::vec2( distX( gen ), distY( gen ) );
+			SimulateDroplet( p, glm::uvec2( 0 ), glm::uvec2( w, h ) );
+		}
+	}
 
-			while ( p.volume > minVolume ) { // while the droplet exists (drop volume > 0)
-				const glm::uvec2 initialPosition = p.position; // cache the initial position
-				const vec3 normal = GetSurfaceNormal( initialPosition.x, initialPosition.y );
-
-				// newton's second law to calculate acceleration
-				p.speed += timeStep * glm::vec2( normal.x, normal.z ) / ( p.volume * density ); // F = MA, A = F/M
-				p.position += timeStep * p.speed; // update position based on new speed
-				p.speed *= ( 1.0f - timeStep * friction ); // friction factor to attenuate speed
-
-				// // wrap if out of bounds (mod logic)
-				// particle_wrap(p);
-				// if(glm::any(glm::isnan(p.position)))
-				//     break;
-
-				// thought I was clever, just discard if out of bounds
-				if ( !glm::all( glm::greaterThanEqual( p.position, glm::vec2( 0.0f ) ) ) ||
-					!glm::all( glm::lessThan( p.position, glm::vec2( w, h ) ) ) ) break;
-
-				// sediment capacity
-				glm::ivec2 refPoint = glm::ivec2( p.position.x, p.position.y );
-				float maxSediment = p.volume * glm::length( p.speed ) * ( model.GetAtXY( initialPosition.x, initialPosition.y )[ red ] - model.GetAtXY( refPoint.x, refPoint.y )[ red ] );
-				maxSediment = std::max( maxSediment, 0.0f ); // don't want negative values here
-				float sedimentDifference = maxSediment - p.sedimentFraction;
-
-				// update sediment content, deposit on the heightmap
-				p.sedimentFraction += timeStep * depositionRate * sedimentDifference;
-				float oldValue = model.GetAtXY( std::clamp( initialPosition.x, 0u, w - 1 ), std::clamp( initialPosition.y, 0u, h - 1 ) )[ red ];
-				model.SetAtXY( std::clamp( initialPosition.x, 0u, w - 1 ), std::clamp( initialPosition.y, 0u, h - 1 ), color_1F( { oldValue - ( timeStep * p.volume * depositionRate * sedimentDifference ) } ) );
-
-				// evaporate the droplet
-				p.volume *= ( 1.0f - timeStep * evaporationRate );
+	// parallel version - the map is cut into tiles, every droplet belongs to the tile it spawns in, and the tiles run in
+		// four checkerboard phases. Tiles in the same phase have a whole tile between them, and a droplet is held to its
+		// own tile plus half of that gap on each side, less a pixel for the normal's neighborhood, so no two droplets that
+		// run at the same time can touch the same pixel. Spawn positions are hashed from the seed and a running droplet
+		// count, and each tile runs its droplets in spawn order, so the result is the same for any number of threads
+	uint32_t seed = 0;
+	uint32_t tileSize = 64;
+	uint64_t dropletsSpawned = 0; // so later calls get new droplets
+
+	// splitmix64 finalizer, as a counter based generator
+	static uint64_t Hash ( uint64_t x ) {
+		x += 0x9e3779b97f4a7c15ull;
+		x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+		x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebull;
+		return x ^ ( x >> 31 );
+	}
+
+	void ErodeParallel ( uint32_t numDroplets ) {
+		// droplets get cut off at the edges of their boxes, so the work goes in rounds of a few droplets per tile, with
+			// the tile grid moved each round - otherwise the seams pile up along the same lines
+		const uint32_t size = std::max( tileSize, 8u );
+		const uint32_t roundSize = std::max( 1024u, 16u * ( ( model.Width() / size ) + 1 ) * ( ( model.Height() / size ) + 1 ) );
+		while ( numDroplets > 0 ) {
+			const uint32_t count = std::min( numDroplets, roundSize );
+			ErodeRound( count );
+			numDroplets -= count;
+		}
+	}
+
+	void ErodeRound ( uint32_t numDroplets ) {
+		const uint32_t w = model.Width();
+		const uint32_t h = model.Height();
+		const uint32_t size = std::max( tileSize, 8u );
+		const uint64_t streamBase = Hash( seed );
+		const uint64_t offsetBits = Hash( streamBase ^ ~dropletsSpawned );
+		const glm::uvec2 offset = glm::uvec2( ( offsetBits & 0xFFFFFFFFull ) % size, ( offsetBits >> 32 ) % size );
+		const uint32_t tilesX = ( w + offset.x + size - 1 ) / size;
+		const uint32_t tilesY = ( h + offset.y + size - 1 ) / size;
+
+		// spawn positions, bucketed by tile with a counting sort - buckets keep the spawn order
+		std::vector< glm::vec2 > spawns( numDroplets );
+		std::vector< uint32_t > tileOf( numDroplets );
+		std::vector< uint32_t > bucketStart( tilesX * tilesY + 1, 0 );
+		for ( uint32_t i = 0; i < numDroplets; i++ ) {
+			const uint64_t bits = Hash( streamBase + dropletsSpawned + i );
+			const uint32_t x = uint32_t( ( ( bits & 0xFFFFFFFFull ) * w ) >> 32 );
+			const uint32_t y = uint32_t( ( ( bits >> 32 ) * h ) >> 32 );
+			spawns[ i ] = glm::vec2( x, y );
+			tileOf[ i ] = ( ( x + offset.x ) / size ) + ( ( y + offset.y ) / size ) * tilesX;
+			bucketStart[ tileOf[ i ] + 1 ]++;
+		}
+		dropletsSpawned += numDroplets;
+		for ( uint32_t t = 0; t < tilesX * tilesY; t++ ) {
+			bucketStart[ t + 1 ] += bucketStart[ t ];
+		}
+		std::vector< uint32_t > order( numDroplets );
+		std::vector< uint32_t > fill( bucketStart.begin(), bucketStart.end() - 1 );
+		for ( uint32_t i = 0; i < numDroplets; i++ ) {
+			order[ fill[ tileOf[ i ] ]++ ] = i;
+		}
+
+		// the four phases, one after another - inside a phase the tiles are independent
+		const uint32_t margin = size / 2 - 1;
+		for ( uint32_t phase = 0; phase < 4; phase++ ) {
+			std::vector< uint32_t > phaseTiles;
+			for ( uint32_t ty = ( phase >> 1 ); ty < tilesY; ty += 2 ) {
+				for ( uint32_t tx = ( phase & 1 ); tx < tilesX; tx += 2 ) {
+					const uint32_t t = tx + ty * tilesX;
+					if ( bucketStart[ t + 1 ] > bucketStart[ t ] ) {
+						phaseTiles.push_back( t );
+					}
+				}
 			}
+
+			jbDE::GetThreadPool().ParallelFor( 0, phaseTiles.size(), 1, [ & ] ( int64_t lo, int64_t hi ) {
+				for ( int64_t j = lo; j < hi; j++ ) {
+					const uint32_t t = phaseTiles[ j ];
+					const glm::ivec2 tileMin = glm::ivec2( glm::uvec2( t % tilesX, t / tilesX ) * size ) - glm::ivec2( offset );
+					const glm::uvec2 boxMin = glm::uvec2( glm::max( tileMin - int( margin ), glm::ivec2( 0 ) ) );
+					const glm::uvec2 boxMax = glm::uvec2( glm::min( tileMin + int( size + margin ), glm::ivec2( w, h ) ) );
+					for ( uint32_t k = bucketStart[ t ]; k < bucketStart[ t + 1 ]; k++ ) {
+						particle p;
+						p.position = spawns[ order[ k ] ];
+						SimulateDroplet( p, boxMin, boxMax );
+					}
+				}
+			} );
 		}
 	}
 
+	// droplets per second for both paths, run on copies of the current model, which is left as it was
+	struct benchmarkResult_t {
+		float serialDropletsPerSecond = 0.0f;
+		float parallelDropletsPerSecond = 0.0f;
+		bool repeatable = false; // two parallel runs from the same state and seed came out identical
+	};
+
+	benchmarkResult_t Benchmark ( uint32_t numDroplets ) {
+		benchmarkResult_t result;
+		const Image_1F original = model;
+		const uint64_t spawnedBefore = dropletsSpawned;
+		auto dropletsPerSecond = [ numDroplets ] ( auto tStart ) {
+			const float seconds = std::chrono::duration< float >( std::chrono::steady_clock::now() - tStart ).count();
+			return ( seconds > 0.0f ) ? float( numDroplets ) / seconds : 0.0f;
+		};
+
+		auto tStart = std::chrono::steady_clock::now();
+		Erode( numDroplets );
+		result.serialDropletsPerSecond = dropletsPerSecond( tStart );
+
+		model = original;
+		tStart = std::chrono::steady_clock::now();
+		ErodeParallel( numDroplets );
+		result.parallelDropletsPerSecond = dropletsPerSecond( tStart );
+
+		const Image_1F firstRun = model;
+		model = original;
+		dropletsSpawned = spawnedBefore;
+		ErodeParallel( numDroplets );
+		result.repeatable = std::equal( model.GetImageDataBasePtr(), model.GetImageDataBasePtr() + size_t( model.Width() ) * model.Height(), firstRun.GetImageDataBasePtr() );
+
+		model = original;
+		dropletsSpawned = spawnedBefore;
+		return result;
+	}
+
 	void Save ( string filename ) {
 		model.Save( filename, Image_1F::backend::TINYEXR );
 	}
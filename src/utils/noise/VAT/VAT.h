@@ -1,3 +1,6 @@
+#include <concepts>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <vector>
 #include <random>
@@ -16,7 +19,8 @@ using std::endl;
 
 class voxelAutomataTerrain {
 public:
-	voxelAutomataTerrain( int levels_deep, float flip_p, std::string rule, int initmode, float lamb, float bet, float mg, glm::bvec3 minimums, glm::bvec3 maximums )
+	// seed zero picks a random one, anything else gives the same volume every time, however many threads evaluate it
+	voxelAutomataTerrain( int levels_deep, float flip_p, std::string rule, int initmode, float lamb, float bet, float mg, glm::bvec3 minimums, glm::bvec3 maximums, uint64_t seed_in = 0 )
     :L( levels_deep ),
     K( ( 1 << levels_deep ) + 1 ),
     flipP( flip_p ),
@@ -24,7 +28,8 @@ public:
     maxs( maximums ),
     lambda( lamb ),
     beta( bet ),
-    mag( mg ) {
+    mag( mg ),
+    seed( seed_in != 0 ? seed_in : ( uint64_t( std::random_device()(  ) ) << 32 | std::random_device()(  ) ) ) {
 			// resize the cubeRule
 			cubeRule.resize( 9 );
 			for( auto & x : cubeRule )
@@ -55,35 +60,9 @@ public:
 					y = 0;
 
 
-			// resize the state
-			state.resize( K );
-			for( auto & x : state )
-			{
-				x.resize( K );
-				for( auto & y : x )
-					y.resize( K );
-			}
-
-			// initialize with zeroes, or fill for the faces
-			for( auto & x : state )
-				for( auto & y : x )
-					for( auto & z : y )
-					{
-						if( minimums.x && &x == std::addressof( *state.begin(  ) ) )
-							z = fill( initmode );
-						else if( maximums.x && &x == std::addressof( *state.end(  ) ) - 1 )
-							z = fill( initmode );
-						else if( minimums.y && &y == std::addressof( *x.begin(  ) ) )
-							z = fill( initmode );
-						else if( maximums.y && &y == std::addressof( *x.end(  ) ) - 1 )
-							z = fill( initmode );
-						else if( minimums.z && &z == std::addressof( *y.begin(  ) ) )
-							z = fill( initmode );
-						else if( maximums.z && &z == std::addressof( *y.end(  ) ) - 1 )
-							z = fill( initmode );
-						else
-							z = 0;
-					}
+			// one flat allocation, initialized with zeroes, then fill for the faces
+			state.assign( size_t( K ) * K * K, 0 );
+			initState( initmode );
 
 			// interpreting rule input
 			if( rule == std::string( "r" ) )
@@ -100,7 +79,6 @@ public:
 				readShortRule( rule );
 			}
 
-			// initState( initmode ); // now handled above
 			evalState(  );
 
 
@@ -119,7 +97,50 @@ public:
 		}
 
 		// I need to be able to access this externally, to create the OpenGL texture
-		std::vector<std::vector<std::vector<int>>> state;
+			// K^3 values of 0, 1 or 2, z fastest - so x, y, z is at ( x * K + y ) * K + z
+		std::vector< uint8_t > state;
+
+		int Size(  ) const { return K; }
+		uint64_t Seed(  ) const { return seed; }
+		size_t Index( int x, int y, int z ) const { return ( size_t( x ) * K + y ) * K + z; }
+		uint8_t At( int x, int y, int z ) const { return state[ Index( x, y, z ) ]; }
+
+		// write straight into a GPU ready RGBA8 buffer of dims.x * dims.y * dims.z texels, in the same order as the state
+			// ( z fastest ), cropped to dims - e.g. a 512^3 texture takes the first 512 of the 513 samples on each axis.
+			// colorFunc maps a state to a vec4 in 0..1, and is called from one thread, in order
+		template < typename colorFunc_t > requires std::invocable< colorFunc_t, uint8_t >
+		void ExportRGBA( uint8_t * rgba, const glm::ivec3 dims, colorFunc_t && colorFunc ) const
+		{
+			for ( int x = 0; x < dims.x; x++ )
+				for ( int y = 0; y < dims.y; y++ )
+					for ( int z = 0; z < dims.z; z++ )
+					{
+						const glm::vec4 color = colorFunc( At( x, y, z ) );
+						*rgba++ = static_cast< uint8_t >( color.x * 255.0 );
+						*rgba++ = static_cast< uint8_t >( color.y * 255.0 );
+						*rgba++ = static_cast< uint8_t >( color.z * 255.0 );
+						*rgba++ = static_cast< uint8_t >( color.w * 255.0 );
+					}
+		}
+
+		// same, with one fixed color per state, spread over the thread pool
+		void ExportRGBA( uint8_t * rgba, const glm::ivec3 dims, const glm::vec4 colors[ 3 ] ) const
+		{
+			uint8_t texels[ 3 ][ 4 ];
+			for ( int i = 0; i < 3; i++ )
+				for ( int c = 0; c < 4; c++ )
+					texels[ i ][ c ] = static_cast< uint8_t >( colors[ i ][ c ] * 255.0 );
+
+			jbDE::GetThreadPool(  ).ParallelFor( 0, int64_t( dims.x ) * dims.y, 64, [ & ] ( int64_t lo, int64_t hi ) {
+				for ( int64_t row = lo; row < hi; row++ )
+				{
+					const uint8_t * source = &state[ Index( int( row / dims.y ), int( row % dims.y ), 0 ) ];
+					uint8_t * dest = rgba + size_t( row ) * dims.z * 4;
+					for ( int z = 0; z < dims.z; z++ )
+						std::memcpy( dest + 4 * z, texels[ source[ z ] ], 4 );
+				}
+			} );
+		}
 
 	private:
 		int L; // levels of depth, from the original code, used to compute the edge length
@@ -135,13 +156,13 @@ public:
 
 		void dumpState(  )
 		{
-			for( auto & x : state )
+			for ( int x = 0; x < K; x++ )
 			{
-				for( auto & y : x )
+				for ( int y = 0; y < K; y++ )
 				{
-					for( auto & z : y )
+					for ( int z = 0; z < K; z++ )
 					{
-						std::cout << z << " ";
+						std::cout << int( At( x, y, z ) ) << " ";
 					}
 					std::cout << std::endl;
 				}
@@ -149,193 +170,66 @@ public:
 			}
 		}
 
-		int fill( int fill )
+		// value for a face voxel, index picks the random draw so it doesn't matter which face gets there first
+		uint8_t fill( int fill, size_t index )
 		{
 			switch ( fill )
 			{
 				case 0: return 0;                break; // fill with zeroes
 				case 1: return 1;                break; // fill with ones
 				case 2: return 2;                break; // fill with twos
-				case 3: return int( random( 2 ) ) + 1; break; // fill with random numbers [ 0-2 inclusive ]
+				case 3: return uint8_t( std::min( int( uniform( fillStream, index ) * 2.0f ), 1 ) + 1 ); break; // fill with random numbers [ 1-2 inclusive ]
 				default: return 0;
 			}
 		}
 
-		// fill the center of a cube
-		void evalCube( int i, int j, int k, int w )
-		{
-			if ( ( i < 0 ) || ( j < 0 ) || ( k < 0 ) || ( i+w >= K ) || ( j+w >= K ) || ( k+w >= K ) ) return;
-
-			int idx1 = ( state[ i ][ j ][ k ]==1?1:0 ) + ( state[ i+w ][ j ][ k ]==1?1:0 ) + ( state[ i ][ j+w ][ k ]==1?1:0 ) + ( state[ i+w ][ j+w ][ k ]==1?1:0 ) +
-						( state[ i ][ j ][ k+w ]==1?1:0 ) + ( state[ i+w ][ j ][ k+w ]==1?1:0 ) + ( state[ i ][ j+w ][ k+w ]==1?1:0 ) + ( state[ i+w ][ j+w ][ k+w ]==1?1:0 );
-			int idx2 = ( state[ i ][ j ][ k ]==2?1:0 ) + ( state[ i+w ][ j ][ k ]==2?1:0 ) + ( state[ i ][ j+w ][ k ]==2?1:0 ) + ( state[ i+w ][ j+w ][ k ]==2?1:0 ) +
-						( state[ i ][ j ][ k+w ]==2?1:0 ) + ( state[ i+w ][ j ][ k+w ]==2?1:0 ) + ( state[ i ][ j+w ][ k+w ]==2?1:0 ) + ( state[ i+w ][ j+w ][ k+w ]==2?1:0 );
-
-			state[ i+w/2 ][ j+w/2 ][ k+w/2 ] = cubeRule[ idx1 ][ idx2 ];
-
-			if ( ( random( 1.0 ) < flipP ) && ( state[ i+w/2 ][ j+w/2 ][ k+w/2 ] != 0 ) )
-			{
-				state[ i+w/2 ][ j+w/2 ][ k+w/2 ] = 3 - state[ i+w/2 ][ j+w/2 ][ k+w/2 ];
-			}
-		}
-
-		// fill a face
-		void f1( int i, int j, int k, int w )
-		{
-			if ( ( i < 0 ) || ( j < 0 ) || ( k-w/2 < 0 ) || ( i+w >= K ) || ( j+w >= K ) || ( k+w/2 >= K ) ) return;
-
-			int idx1 = ( state[ i ][ j ][ k ]==1?1:0 ) + ( state[ i+w ][ j ][ k ]==1?1:0 ) + ( state[ i ][ j+w ][ k ]==1?1:0 ) + ( state[ i+w ][ j+w ][ k ]==1?1:0 ) +
-						( state[ i+w/2 ][ j+w/2 ][ k-w/2 ]==1?1:0 ) + ( state[ i+w/2 ][ j+w/2 ][ k+w/2 ]==1?1:0 );
-			int idx2 = ( state[ i ][ j ][ k ]==2?1:0 ) + ( state[ i+w ][ j ][ k ]==2?1:0 ) + ( state[ i ][ j+w ][ k ]==2?1:0 ) + ( state[ i+w ][ j+w ][ k ]==2?1:0 ) +
-						( state[ i+w/2 ][ j+w/2 ][ k-w/2 ]==2?1:0 ) + ( state[ i+w/2 ][ j+w/2 ][ k+w/2 ]==2?1:0 );
-
-			state[ i+w/2 ][ j+w/2 ][ k ] = faceRule[ idx1 ][ idx2 ];
-
-			if ( ( random( 1.0 ) < flipP ) && ( state[ i+w/2 ][ j+w/2 ][ k ] != 0 ) )
-			{
-				state[ i+w/2 ][ j+w/2 ][ k ] = 3 - state[ i+w/2 ][ j+w/2 ][ k ];
-			}
-		}
-
-		// fill a face
-		void f2( int i, int j, int k, int w )
-		{
-			if ( ( i < 0 ) || ( j-w/2 < 0 ) || ( k < 0 ) || ( i+w >= K ) || ( j+w/2 >= K ) || ( k+w >= K ) ) return;
-
-			int idx1 = ( state[ i ][ j ][ k ]==1?1:0 ) + ( state[ i+w ][ j ][ k ]==1?1:0 ) + ( state[ i ][ j ][ k+w ]==1?1:0 ) + ( state[ i+w ][ j ][ k+w ]==1?1:0 ) +
-						( state[ i+w/2 ][ j-w/2 ][ k+w/2 ]==1?1:0 ) + ( state[ i+w/2 ][ j+w/2 ][ k+w/2 ]==1?1:0 );
-			int idx2 = ( state[ i ][ j ][ k ]==2?1:0 ) + ( state[ i+w ][ j ][ k ]==2?1:0 ) + ( state[ i ][ j ][ k+w ]==2?1:0 ) + ( state[ i+w ][ j ][ k+w ]==2?1:0 ) +
-						( state[ i+w/2 ][ j-w/2 ][ k+w/2 ]==2?1:0 ) + ( state[ i+w/2 ][ j+w/2 ][ k+w/2 ]==2?1:0 );
-
-			state[ i+w/2 ][ j ][ k+w/2 ] = faceRule[ idx1 ][ idx2 ];
-
-			if ( ( random( 1.0 ) < flipP ) && ( state[ i+w/2 ][ j ][ k+w/2 ] != 0 ) )
-			{
-				state[ i+w/2 ][ j ][ k+w/2 ] = 3 - state[ i+w/2 ][ j ][ k+w/2 ];
-			}
-		}
-
-		// fill a face
-		void f3( int i, int j, int k, int w )
-		{
-			if ( ( i-w/2 < 0 ) || ( j < 0 ) || ( k < 0 ) || ( i+w/2 >= K ) || ( j+w >= K ) || ( k+w >= K ) ) return;
-
-			int idx1 = ( state[ i ][ j ][ k ]==1?1:0 ) + ( state[ i ][ j ][ k+w ]==1?1:0 ) + ( state[ i ][ j+w ][ k ]==1?1:0 ) + ( state[ i ][ j+w ][ k+w ]==1?1:0 ) +
-						( state[ i-w/2 ][ j+w/2 ][ k+w/2 ]==1?1:0 ) + ( state[ i+w/2 ][ j+w/2 ][ k+w/2 ]==1?1:0 );
-			int idx2 = ( state[ i ][ j ][ k ]==2?1:0 ) + ( state[ i ][ j ][ k+w ]==2?1:0 ) + ( state[ i ][ j+w ][ k ]==2?1:0 ) + ( state[ i ][ j+w ][ k+w ]==2?1:0 ) +
-						( state[ i-w/2 ][ j+w/2 ][ k+w/2 ]==2?1:0 ) + ( state[ i+w/2 ][ j+w/2 ][ k+w/2 ]==2?1:0 );
-
-			state[ i ][ j+w/2 ][ k+w/2 ] = faceRule[ idx1 ][ idx2 ];
-
-			if ( ( random( 1.0 ) < flipP ) && ( state[ i ][ j+w/2 ][ k+w/2 ] != 0 ) )
-			{
-				state[ i ][ j+w/2 ][ k+w/2 ] = 3 - state[ i ][ j+w/2 ][ k+w/2 ];
-			}
-		}
-
-		// fill a face
-		void f4( int i, int j, int k, int w )
-		{
-			f1( i,j,k+w,w );
-		}
-
-		// fill a face
-		void f5( int i, int j, int k, int w )
-		{
-			f1( i,j+w,k,w );
-		}
-
-		// fill a face
-		void f6( int i, int j, int k, int w )
+		// evaluate one set of cells - every cell in the set is written exactly once, and only reads cells from earlier sets,
+			// so the order doesn't matter and they can be spread over the thread pool. Cells are at origin + step * ( a, b, c )
+			// for a, b, c in [ 0, counts ), and taps are the flat offsets of the neighbors the rule counts
+		template < int numTaps >
+		void evalCells( const glm::ivec3 origin, const int step, const glm::ivec3 counts, const glm::ivec3 ( &taps )[ numTaps ], const std::vector< std::vector< int > > & rule, const uint64_t stream )
 		{
-			f1( i+w,j,k,w );
-		}
-
-		// fill every face
-		void evalFaces( int i, int j, int k, int w )
-		{
-			f1( i,j,k,w );
-			f2( i,j,k,w );
-			f3( i,j,k,w );
-			f4( i,j,k,w );
-			f5( i,j,k,w );
-			f6( i,j,k,w );
-		}
-
-		// fill an edge
-		void e1( int i, int j, int k, int w )
-		{
-			if ( ( i < 0 ) || ( j-w/2 < 0 ) || ( k-w/2 < 0 ) || ( i+w >= K ) || ( j+w/2 >= K ) || ( k+w/2 >= K ) ) return;
-
-			int idx1 = ( state[ i ][ j ][ k ]==1?1:0 ) + ( state[ i+w ][ j ][ k ]==1?1:0 ) + ( state[ i+w/2 ][ j-w/2 ][ k ]==1?1:0 ) + ( state[ i+w/2 ][ j+w/2 ][ k ]==1?1:0 ) +
-						( state[ i+w/2 ][ j ][ k+w/2 ]==1?1:0 ) + ( state[ i+w/2 ][ j ][ k-w/2 ]==1?1:0 );
-			int idx2 = ( state[ i ][ j ][ k ]==2?1:0 ) + ( state[ i+w ][ j ][ k ]==2?1:0 ) + ( state[ i+w/2 ][ j-w/2 ][ k ]==2?1:0 ) + ( state[ i+w/2 ][ j+w/2 ][ k ]==2?1:0 ) +
-						( state[ i+w/2 ][ j ][ k+w/2 ]==2?1:0 ) + ( state[ i+w/2 ][ j ][ k-w/2 ]==2?1:0 );
-
-			state[ i+w/2 ][ j ][ k ] = edgeRule[ idx1 ][ idx2 ];
-
-			if ( ( random( 1.0 ) < flipP ) && ( state[ i+w/2 ][ j ][ k ] != 0 ) )
-			{
-				state[ i+w/2 ][ j ][ k ] = 3 - state[ i+w/2 ][ j ][ k ];
-			}
-		}
-
-		// fill an edge
-		void e2( int i, int j, int k, int w )
-		{
-			e1( i,j+w,k,w );
-		}
-
-		// fill an edge
-		void e3( int i, int j, int k, int w )
-		{
-			e1( i,j,k+w,w );
-		}
-
-		// fill an edge
-		void e4( int i, int j, int k, int w )
-		{
-			e1( i,j+w,k+w,w );
-		}
-
-		// fill an edge
-		void e5( int i, int j, int k, int w )
-		{
-			e1( i-w/2,j+w/2,k,w );
-		}
-
-		// fill an edge
-		void e6( int i, int j, int k, int w )
-		{
-			e1( i+w/2,j+w/2,k,w );
-		}
-
-		// fill an edge
-		void e7( int i, int j, int k, int w )
-		{
-			e1( i-w/2,j+w/2,k+w,w );
-		}
-
-		// fill an edge
-		void e8( int i, int j, int k, int w )
-		{
-			e1( i+w/2,j+w/2,k+w,w );
-		}
-
-		// fill all edges
-		void evalEdges( int i, int j, int k, int w )
-		{
-			e1( i,j,k,w );
-			e2( i,j,k,w );
-			e3( i,j,k,w );
-			e4( i,j,k,w );
-			e5( i,j,k,w );
-			e6( i,j,k,w );
-			e7( i,j,k,w );
-			e8( i,j,k,w );
+			if ( counts.x <= 0 || counts.y <= 0 || counts.z <= 0 ) return;
+
+			// flat copies, for the inner loop
+			ptrdiff_t offsets[ numTaps ];
+			for ( int t = 0; t < numTaps; t++ )
+				offsets[ t ] = ( ptrdiff_t( taps[ t ].x ) * K + taps[ t ].y ) * K + taps[ t ].z;
+			uint8_t table[ 9 ][ 9 ] = {};
+			for ( size_t i = 0; i < rule.size(  ); i++ )
+				for ( size_t j = 0; j < rule[ i ].size(  ); j++ )
+					table[ i ][ j ] = uint8_t( rule[ i ][ j ] );
+
+			// rows along z, so the threads get a decent amount of work even at the coarse levels
+			const int64_t numRows = int64_t( counts.x ) * counts.y;
+			const int64_t grain = std::max< int64_t >( 1, 16384 / counts.z );
+			jbDE::GetThreadPool(  ).ParallelFor( 0, numRows, grain, [ & ] ( int64_t lo, int64_t hi ) {
+				for ( int64_t row = lo; row < hi; row++ )
+				{
+					const int x = origin.x + step * int( row / counts.y );
+					const int y = origin.y + step * int( row % counts.y );
+					for ( int c = 0; c < counts.z; c++ )
+					{
+						const size_t index = Index( x, y, origin.z + step * c );
+						const uint8_t * center = &state[ index ];
+						int idx1 = 0, idx2 = 0;
+						for ( int t = 0; t < numTaps; t++ )
+						{
+							const uint8_t v = center[ offsets[ t ] ];
+							idx1 += ( v == 1 );
+							idx2 += ( v == 2 );
+						}
+						uint8_t result = table[ idx1 ][ idx2 ];
+						if ( ( uniform( stream, index ) < flipP ) && ( result != 0 ) )
+						{
+							result = 3 - result;
+						}
+						state[ index ] = result;
+					}
+				}
+			} );
 		}
 
-
 		// parameters for the random rules
 		float lambda; //  = 0.35;
 		float beta; //  = 0.5;
@@ -458,22 +352,19 @@ public:
 		}
 
 
-		// fill the bottom with random bits ( the other sides are all empty )
+		// fill the faces picked by mins and maxs, the rest stays zero
 		void initState( int initmode )
 		{
-		// fill just the bottom so we can see
-			// print( "Randomizing IC..." );
-			for ( int i = 0; i < K; i++ )
+			for ( int a = 0; a < K; a++ )
 			{
-				for ( int j = 0; j < K; j++ )
+				for ( int b = 0; b < K; b++ )
 				{
-					switch ( initmode ) {
-						case 0: state[ j ][ 0 ][ i ] = 0;                break; // fill with zeroes
-						case 1: state[ j ][ 0 ][ i ] = 1;                break; // fill with ones
-						case 2: state[ j ][ 0 ][ i ] = 2;                break; // fill with twos
-						case 3: state[ j ][ 0 ][ i ] = int( random( 2 ) )+1; break; // fill with random numbers [ 0-2 inclusive ]
-					}
-
+					if ( mins.x ) state[ Index( 0, a, b ) ]		= fill( initmode, Index( 0, a, b ) );
+					if ( maxs.x ) state[ Index( K-1, a, b ) ]	= fill( initmode, Index( K-1, a, b ) );
+					if ( mins.y ) state[ Index( a, 0, b ) ]		= fill( initmode, Index( a, 0, b ) );
+					if ( maxs.y ) state[ Index( a, K-1, b ) ]	= fill( initmode, Index( a, K-1, b ) );
+					if ( mins.z ) state[ Index( a, b, 0 ) ]		= fill( initmode, Index( a, b, 0 ) );
+					if ( maxs.z ) state[ Index( a, b, K-1 ) ]	= fill( initmode, Index( a, b, K-1 ) );
 				}
 			}
 		}
@@ -481,39 +372,34 @@ public:
 		void evalState(  )
 		{
 			// print( "Computing..." );
-			// do everything on all scales in order
+			// do everything on all scales in order - each scale is cube centers, then faces, then edges, and the cells
+				// within each of those passes are independent. Faces and edges shared between neighboring cubes are done
+				// once each, and the ones on the outside of the volume are left alone, as they always were. Edges along z
+				// aren't evaluated at any scale, matching the original e1..e8 ( two of the four directions x, two y )
+			uint64_t stream = firstEvalStream;
 			for ( int w = K-1; w >= 2; w /= 2 )
 			{
-				for ( int i = 0; i < K-1; i+=w )
-				{
-					for ( int j = 0; j < K-1; j+=w )
-					{
-						for ( int k = 0; k < K-1; k+=w )
-						{
-							evalCube( i,j,k,w );
-						}
-					}
-				}
-				for ( int i = 0; i < K-1; i+=w )
-				{
-					for ( int j = 0; j < K-1; j+=w )
-					{
-						for ( int k = 0; k < K-1; k+=w )
-						{
-							evalFaces( i,j,k,w );
-						}
-					}
-				}
-				for ( int i = 0; i < K-1; i+=w )
-				{
-					for ( int j = 0; j < K-1; j+=w )
-					{
-						for ( int k = 0; k < K-1; k+=w )
-						{
-							evalEdges( i,j,k,w );
-						}
-					}
-				}
+				const int h = w / 2;
+				const int n = ( K - 1 ) / w; // cubes per side, at this scale
+
+				// cube centers, from the 8 corners
+				const glm::ivec3 cubeTaps[ 8 ] = {
+					{ -h, -h, -h }, { h, -h, -h }, { -h, h, -h }, { h, h, -h },
+					{ -h, -h, h }, { h, -h, h }, { -h, h, h }, { h, h, h } };
+				evalCells( glm::ivec3( h, h, h ), w, glm::ivec3( n, n, n ), cubeTaps, cubeRule, stream++ );
+
+				// interior faces, from the 4 corners of the face and the 2 cube centers on either side
+				const glm::ivec3 faceTapsZ[ 6 ] = { { -h, -h, 0 }, { h, -h, 0 }, { -h, h, 0 }, { h, h, 0 }, { 0, 0, -h }, { 0, 0, h } };
+				const glm::ivec3 faceTapsY[ 6 ] = { { -h, 0, -h }, { h, 0, -h }, { -h, 0, h }, { h, 0, h }, { 0, -h, 0 }, { 0, h, 0 } };
+				const glm::ivec3 faceTapsX[ 6 ] = { { 0, -h, -h }, { 0, -h, h }, { 0, h, -h }, { 0, h, h }, { -h, 0, 0 }, { h, 0, 0 } };
+				evalCells( glm::ivec3( h, h, w ), w, glm::ivec3( n, n, n - 1 ), faceTapsZ, faceRule, stream++ );
+				evalCells( glm::ivec3( h, w, h ), w, glm::ivec3( n, n - 1, n ), faceTapsY, faceRule, stream++ );
+				evalCells( glm::ivec3( w, h, h ), w, glm::ivec3( n - 1, n, n ), faceTapsX, faceRule, stream++ );
+
+				// interior edges, from the 2 corners at the ends and the 4 faces around it
+				const glm::ivec3 edgeTaps[ 6 ] = { { -h, 0, 0 }, { h, 0, 0 }, { 0, -h, 0 }, { 0, h, 0 }, { 0, 0, -h }, { 0, 0, h } };
+				evalCells( glm::ivec3( h, w, w ), w, glm::ivec3( n, n - 1, n - 1 ), edgeTaps, edgeRule, stream++ );
+				evalCells( glm::ivec3( w, h, w ), w, glm::ivec3( n - 1, n, n - 1 ), edgeTaps, edgeRule, stream++ );
 			}
 			// draw the dots to the PShape for efficiency
 			// print( "Lighting..." );
@@ -626,31 +512,39 @@ public:
 			return int( in ) - int( 'a' ) + 10;
 		}
 
-		float random( float max )
+		// counter based rng - a draw is a hash of the seed, a stream and a counter, so each voxel gets the same number no
+			// matter which thread evaluates it. Stream 0 is the serial one used for the rules, 1 is the face fill, and each
+			// pass of evalState gets its own after that
+		uint64_t seed;
+		uint64_t ruleCounter = 0;
+		static constexpr uint64_t ruleStream = 0;
+		static constexpr uint64_t fillStream = 1;
+		static constexpr uint64_t firstEvalStream = 2;
+
+		float uniform( const uint64_t stream, const uint64_t counter ) const
 		{
-			static std::random_device rd;  //Will be used to obtain a seed for the random number engine
-			static std::mt19937 gen( rd(  ) ); //Standard mersenne_twister_engine seeded with rd(  )
-			std::uniform_real_distribution<float> dis( 0.0, max );
+			// splitmix64 finalizer
+			uint64_t z = seed + stream * 0x9E3779B97F4A7C15ull + ( counter + 1 ) * 0xD1B54A32D192ED03ull;
+			z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+			z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBull;
+			z ^= ( z >> 31 );
+			return float( z >> 40 ) * ( 1.0f / 16777216.0f ); // [ 0, 1 )
+		}
 
-			return dis( gen );
+		float random( float max )
+		{
+			return uniform( ruleStream, ruleCounter++ ) * max;
 		}
 
 		double random( double max )
 		{
-			static std::random_device rd;
-			static std::mt19937 gen( rd(  ) );
-			std::uniform_real_distribution<double> dis( 0.0, max );
-
-			return dis( gen );
+			return uniform( ruleStream, ruleCounter++ ) * max;
 		}
 
 		int random( int max )
 		{
-			static std::random_device rd;
-			static std::mt19937 gen( rd(  ) ); // this is done to match the way processing does integer rng
-			std::uniform_int_distribution<int> dis( 0, max-1 ); // https://processing.org/reference/random_.html
-
-			return dis( gen );
+			// this is done to match the way processing does integer rng - https://processing.org/reference/random_.html
+			return std::min( int( uniform( ruleStream, ruleCounter++ ) * max ), max - 1 );
 		}
 
 };
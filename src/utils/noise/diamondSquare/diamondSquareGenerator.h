@@ -0,0 +1,176 @@
+#pragma once
+#ifndef DIAMONDSQUAREGENERATOR_H
+#define DIAMONDSQUAREGENERATOR_H
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+//=============================================================================
+//==== Tiled Diamond Square ===================================================
+//=============================================================================
+
+// diamond square over an infinite lattice - the coarsest points are random values spaced featureSize apart, and each
+	// level after that fills in the diamond centers and then the square midpoints, at half the spacing, with the average
+	// of their four neighbors plus a random displacement. Every random number is a hash of the seed, the level and the
+	// global position, so the value of a sample doesn't depend on what else was generated alongside it - any window can
+	// be generated on its own, at any size, and neighboring chunks line up exactly
+
+// a level only reads the level above it, so each level is one pass that's split over the thread pool by rows. Square
+	// midpoints need the diamond centers next to them, which get recomputed from the level above rather than stored, so
+	// there's no second pass. The coarse levels only cover the window plus the margin the finer levels read from, and
+	// the finest level writes straight into the output image
+
+struct diamondSquareSettings_t {
+	uint64_t seed = 0;
+	uint32_t featureSize = 1024;	// power of two, spacing of the coarsest points - the biggest hills
+	float baseRange = 1.5f;			// the coarsest points are uniform in [ 0, baseRange )
+	float amplitude = 1.0f;			// displacement is uniform in [ -range, range ), starting at amplitude
+	float persistence = 0.5f;		// ... and scaled by this at each level after that
+	uint32_t period = 0;			// nonzero makes the terrain repeat with this period, should be a multiple of featureSize
+};
+
+class diamondSquareGenerator {
+public:
+	diamondSquareGenerator ( const diamondSquareSettings_t &settingsIn = diamondSquareSettings_t() ) : settings( settingsIn ) {
+		settings.featureSize = std::bit_ceil( std::max( settings.featureSize, 2u ) );
+	}
+
+	// width x height samples starting at x0, y0 - the image is resized to fit if it isn't already that size
+	void Generate ( Image_1F &image, const int64_t x0, const int64_t y0, const uint32_t width, const uint32_t height ) const {
+		if ( image.Width() != width || image.Height() != height ) {
+			image = Image_1F( width, height );
+		}
+		if ( width == 0 || height == 0 ) {
+			return;
+		}
+
+		const int64_t x1 = x0 + width - 1;
+		const int64_t y1 = y0 + height - 1;
+
+		// coarsest level, the random base lattice, over the window plus its margin
+		grid_t coarse = Window( x0, y0, x1, y1, settings.featureSize );
+		coarse.values.resize( size_t( coarse.width ) * coarse.height );
+		jbDE::GetThreadPool().ParallelFor( 0, coarse.height, std::max< int64_t >( 1, 16384 / coarse.width ), [ & ] ( int64_t lo, int64_t hi ) {
+			for ( int64_t j = lo; j < hi; j++ ) {
+				for ( int64_t i = 0; i < coarse.width; i++ ) {
+					coarse.values[ j * coarse.width + i ] = settings.baseRange * Uniform( 0, coarse.x0 + i * coarse.step, coarse.y0 + j * coarse.step );
+				}
+			}
+		} );
+
+		// then each level at half the spacing of the one before, the last one is the image
+		grid_t fine;
+		float range = settings.amplitude;
+		uint32_t level = 1;
+		for ( int64_t h = settings.featureSize / 2; h >= 1; h /= 2, level++, range *= settings.persistence ) {
+			fine = Window( x0, y0, x1, y1, h );
+			float *values;
+			if ( h == 1 ) {
+				values = image.GetImageDataBasePtr();
+			} else {
+				fine.values.resize( size_t( fine.width ) * fine.height );
+				values = fine.values.data();
+			}
+			FillLevel( coarse, fine, values, level, range );
+			std::swap( coarse, fine );
+		}
+	}
+
+	// chunkSize + 1 samples square, so neighboring chunks share the samples along their common edge
+	Image_1F GenerateChunk ( const int64_t chunkX, const int64_t chunkY, const uint32_t chunkSize ) const {
+		Image_1F chunk;
+		Generate( chunk, chunkX * chunkSize, chunkY * chunkSize, chunkSize + 1, chunkSize + 1 );
+		return chunk;
+	}
+
+	const diamondSquareSettings_t & Settings () const { return settings; }
+
+private:
+	diamondSquareSettings_t settings;
+
+	// the samples at multiples of step inside an axis aligned window
+	struct grid_t {
+		int64_t x0, y0;			// first sample, multiples of step
+		int64_t width, height;	// in samples
+		int64_t step;
+		int shift;				// log2( step ), the positions inside the window are never negative so this divides
+		std::vector< float > values;
+
+		float At ( const int64_t x, const int64_t y ) const {
+			return values[ ( ( y - y0 ) >> shift ) * width + ( ( x - x0 ) >> shift ) ];
+		}
+	};
+
+	// a level at spacing h reads the level above out to 2h past its own window, so going up a level the margin grows
+		// by 3h - zero at the finest level, which is exactly the requested window, then 3, 9, 21... after that
+	static grid_t Window ( const int64_t x0, const int64_t y0, const int64_t x1, const int64_t y1, const int64_t step ) {
+		const int64_t margin = 3 * step - 3;
+		grid_t grid;
+		grid.step = step;
+		grid.shift = std::countr_zero( uint64_t( step ) );
+		grid.x0 = FloorMultiple( x0 - margin, step );
+		grid.y0 = FloorMultiple( y0 - margin, step );
+		grid.width = ( FloorMultiple( x1 + margin + step - 1, step ) - grid.x0 ) / step + 1;
+		grid.height = ( FloorMultiple( y1 + margin + step - 1, step ) - grid.y0 ) / step + 1;
+		return grid;
+	}
+
+	static int64_t FloorMultiple ( const int64_t value, const int64_t step ) {
+		const int64_t q = value / step;
+		return ( q - ( ( value % step ) < 0 ) ) * step;
+	}
+
+	// fine is at half the spacing of coarse - points on the coarse lattice carry over, diamond centers ( odd, odd ) average
+		// their four coarse corners, and square midpoints average the two coarse points and the two diamond centers around them
+	void FillLevel ( const grid_t &coarse, const grid_t &fine, float *values, const uint32_t level, const float range ) const {
+		const int64_t h = fine.step;
+		auto Displace = [ & ] ( const int64_t x, const int64_t y ) {
+			return ( Uniform( level, x, y ) * 2.0f - 1.0f ) * range;
+		};
+		auto Diamond = [ & ] ( const int64_t x, const int64_t y ) {
+			const float average = ( coarse.At( x - h, y - h ) + coarse.At( x + h, y - h ) + coarse.At( x - h, y + h ) + coarse.At( x + h, y + h ) ) / 4.0f;
+			return average + Displace( x, y );
+		};
+
+		jbDE::GetThreadPool().ParallelFor( 0, fine.height, std::max< int64_t >( 1, 16384 / fine.width ), [ & ] ( int64_t lo, int64_t hi ) {
+			for ( int64_t j = lo; j < hi; j++ ) {
+				const int64_t y = fine.y0 + j * h;
+				const bool oddY = ( y & h ) != 0;
+				float *row = values + j * fine.width;
+				for ( int64_t i = 0; i < fine.width; i++ ) {
+					const int64_t x = fine.x0 + i * h;
+					const bool oddX = ( x & h ) != 0;
+					if ( !oddX && !oddY ) {
+						row[ i ] = coarse.At( x, y );
+					} else if ( oddX && oddY ) {
+						row[ i ] = Diamond( x, y );
+					} else if ( oddX ) {
+						const float average = ( coarse.At( x - h, y ) + coarse.At( x + h, y ) + Diamond( x, y - h ) + Diamond( x, y + h ) ) / 4.0f;
+						row[ i ] = average + Displace( x, y );
+					} else {
+						const float average = ( coarse.At( x, y - h ) + coarse.At( x, y + h ) + Diamond( x - h, y ) + Diamond( x + h, y ) ) / 4.0f;
+						row[ i ] = average + Displace( x, y );
+					}
+				}
+			}
+		} );
+	}
+
+	// counter based, [ 0, 1 ) - a splitmix64 finalizer over the seed, the level and the ( wrapped ) position
+	float Uniform ( const uint32_t level, int64_t x, int64_t y ) const {
+		if ( settings.period != 0 ) {
+			const int64_t p = settings.period;
+			x = ( ( x % p ) + p ) % p;
+			y = ( ( y % p ) + p ) % p;
+		}
+		uint64_t z = settings.seed + level * 0x9E3779B97F4A7C15ull + uint64_t( x ) * 0xD1B54A32D192ED03ull + uint64_t( y ) * 0x8CB92BA72F3D8DD7ull;
+		z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+		z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBull;
+		z ^= ( z >> 31 );
+		return float( z >> 40 ) * ( 1.0f / 16777216.0f );
+	}
+};
+
+#endif // DIAMONDSQUAREGENERATOR_H
@@ -0,0 +1,257 @@
+#pragma once
+#ifndef STFT_H
+#define STFT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//=============================================================================
+//==== Lock Free Sample Ring ==================================================
+//=============================================================================
+
+// single producer, single consumer - e.g. the audio callback pushes and the main thread pops. The capacity rounds up to
+	// a power of two, and the read and write positions are free running counters, so full and empty are told apart
+	// without keeping a spare slot. Each side only ever stores its own counter, so no locks are needed
+class sampleRing {
+public:
+	sampleRing ( uint32_t minCapacity = 1 << 16 ) {
+		uint32_t capacity = 1;
+		while ( capacity < minCapacity ) {
+			capacity *= 2;
+		}
+		buffer.resize( capacity, 0.0f );
+		mask = capacity - 1;
+	}
+
+	uint32_t Capacity () const { return mask + 1; }
+
+	// samples ready to be popped - from the consumer side this only ever grows until it pops
+	uint32_t Available () const {
+		return uint32_t( writePos.load( std::memory_order_acquire ) - readPos.load( std::memory_order_acquire ) );
+	}
+
+	// producer side, returns how many went in - the rest is dropped when the consumer falls behind
+	uint32_t Push ( const float *samples, uint32_t count ) {
+		const uint64_t w = writePos.load( std::memory_order_relaxed );
+		const uint64_t r = readPos.load( std::memory_order_acquire );
+		count = std::min( count, Capacity() - uint32_t( w - r ) );
+		const uint32_t start = uint32_t( w & mask );
+		const uint32_t first = std::min( count, Capacity() - start );
+		std::memcpy( &buffer[ start ], samples, first * sizeof( float ) );
+		std::memcpy( &buffer[ 0 ], samples + first, ( count - first ) * sizeof( float ) );
+		writePos.store( w + count, std::memory_order_release );
+		return count;
+	}
+
+	// consumer side, returns how many came out
+	uint32_t Pop ( float *samples, uint32_t count ) {
+		const uint64_t r = readPos.load( std::memory_order_relaxed );
+		const uint64_t w = writePos.load( std::memory_order_acquire );
+		count = std::min( count, uint32_t( w - r ) );
+		const uint32_t start = uint32_t( r & mask );
+		const uint32_t first = std::min( count, Capacity() - start );
+		std::memcpy( samples, &buffer[ start ], first * sizeof( float ) );
+		std::memcpy( samples + first, &buffer[ 0 ], ( count - first ) * sizeof( float ) );
+		readPos.store( r + count, std::memory_order_release );
+		return count;
+	}
+
+private:
+	std::vector< float > buffer;
+	uint32_t mask;
+
+	// on separate cache lines, so the two threads aren't bouncing one line back and forth
+	alignas( 64 ) std::atomic< uint64_t > writePos { 0 };
+	alignas( 64 ) std::atomic< uint64_t > readPos { 0 };
+};
+
+//=============================================================================
+//==== Short Time Fourier Transform ===========================================
+//=============================================================================
+
+// real to complex single precision FFTW plans, one frame of fftSize samples every hopSize samples, giving fftSize / 2 + 1
+	// magnitude bins per frame. Works either streaming, pulling hops out of a sampleRing as they arrive, or offline over
+	// a whole buffer, where the frames are independent and get spread over the shared thread pool
+
+// plans are made with FFTW_MEASURE, which takes a while - so the wisdom is kept in a file, and only sizes that haven't
+	// been seen before get measured. Planning is not thread safe in FFTW, so it's all done under one lock. Executing is,
+	// with the new-array interface, as long as the arrays come from fftwf_malloc and so share the plan's alignment
+
+enum class stftWindow_t {
+	RECTANGULAR,
+	HANN,
+	HAMMING,
+	BLACKMAN
+};
+
+struct stftSettings_t {
+	uint32_t fftSize = 1024;
+	uint32_t hopSize = 256;
+	stftWindow_t window = stftWindow_t::HANN;
+	bool decibels = false;				// 20 log10 of the magnitude instead of the magnitude
+	std::string wisdomPath = "fftwf.wisdom";	// empty skips the wisdom file
+};
+
+class stft {
+public:
+	stft ( const stftSettings_t &settings = stftSettings_t() ) { Configure( settings ); }
+	~stft () { Release(); }
+
+	stft ( const stft & ) = delete;
+	stft& operator = ( const stft & ) = delete;
+
+	// makes the plan and window table, and clears the streaming history
+	void Configure ( const stftSettings_t &settingsIn ) {
+		Release();
+		settings = settingsIn;
+		settings.fftSize = std::max( settings.fftSize, 2u );
+		settings.hopSize = std::clamp( settings.hopSize, 1u, settings.fftSize );
+
+		const uint32_t N = settings.fftSize;
+		in = fftwf_alloc_real( N );
+		out = fftwf_alloc_complex( NumBins() );
+		plan = MakePlan( N, in, out, settings.wisdomPath );
+
+		// scaled so a sinusoid comes out at the same magnitude under every window
+		windowTable.resize( N );
+		double windowSum = 0.0;
+		for ( uint32_t i = 0; i < N; i++ ) {
+			windowTable[ i ] = WindowValue( settings.window, i, N );
+			windowSum += windowTable[ i ];
+		}
+		magnitudeScale = float( N / windowSum );
+
+		history.assign( N, 0.0f );
+	}
+
+	const stftSettings_t & Settings () const { return settings; }
+	uint32_t NumBins () const { return settings.fftSize / 2 + 1; }
+
+	// the fftSize most recent samples seen by Next(), oldest first, before windowing
+	const float * History () const { return history.data(); }
+
+	// streaming - takes one hop out of the ring and writes NumBins() values, false if there isn't a full hop there yet
+	bool Next ( sampleRing &ring, float *result ) {
+		const uint32_t N = settings.fftSize;
+		const uint32_t hop = settings.hopSize;
+		if ( ring.Available() < hop ) {
+			return false;
+		}
+		std::memmove( &history[ 0 ], &history[ hop ], ( N - hop ) * sizeof( float ) );
+		ring.Pop( &history[ N - hop ], hop );
+		Transform( history.data(), in, out, result );
+		return true;
+	}
+
+	// number of frames Analyze() gives for a buffer - frames are centered on multiples of the hop, zero padded off the ends
+	size_t NumFrames ( const size_t sampleCount ) const {
+		return sampleCount / settings.hopSize + 1;
+	}
+
+	// offline - the whole buffer at once, one row of NumBins() per frame, so it lines up with the streaming waterfall
+	Image_1F Analyze ( const float *samples, const size_t sampleCount ) const {
+		const uint32_t N = settings.fftSize;
+		const uint32_t numBins = NumBins();
+		const size_t numFrames = NumFrames( sampleCount );
+		Image_1F result( numBins, uint32_t( numFrames ) );
+		float *rows = result.GetImageDataBasePtr();
+
+		jbDE::GetThreadPool().ParallelFor( 0, int64_t( numFrames ), 64, [ & ] ( int64_t lo, int64_t hi ) {
+			// per chunk buffers, the plan only gets read
+			std::vector< float > frame( N );
+			float *chunkIn = fftwf_alloc_real( N );
+			fftwf_complex *chunkOut = fftwf_alloc_complex( numBins );
+			for ( int64_t f = lo; f < hi; f++ ) {
+				const int64_t start = f * int64_t( settings.hopSize ) - N / 2;
+				for ( uint32_t i = 0; i < N; i++ ) {
+					const int64_t s = start + i;
+					frame[ i ] = ( s >= 0 && s < int64_t( sampleCount ) ) ? samples[ s ] : 0.0f;
+				}
+				Transform( frame.data(), chunkIn, chunkOut, rows + size_t( f ) * numBins );
+			}
+			fftwf_free( chunkIn );
+			fftwf_free( chunkOut );
+		} );
+		return result;
+	}
+
+	static float WindowValue ( const stftWindow_t window, const uint32_t i, const uint32_t N ) {
+		// periodic form, so overlapping hann windows at N / 2 or N / 4 hops sum to a constant
+		const double x = jbDE::tau * double( i ) / double( N );
+		switch ( window ) {
+			case stftWindow_t::RECTANGULAR: return 1.0f;
+			case stftWindow_t::HANN: return float( 0.5 - 0.5 * cos( x ) );
+			case stftWindow_t::HAMMING: return float( 0.54 - 0.46 * cos( x ) );
+			case stftWindow_t::BLACKMAN: return float( 0.42 - 0.5 * cos( x ) + 0.08 * cos( 2.0 * x ) );
+		}
+		return 1.0f;
+	}
+
+private:
+	stftSettings_t settings;
+	float *in = nullptr;
+	fftwf_complex *out = nullptr;
+	fftwf_plan plan = nullptr;
+	std::vector< float > windowTable;
+	std::vector< float > history;
+	float magnitudeScale = 1.0f;
+
+	// window, transform, magnitudes - the plan is only read, so this is safe to run from several threads on their own arrays
+	void Transform ( const float *frame, float *frameIn, fftwf_complex *frameOut, float *result ) const {
+		const uint32_t N = settings.fftSize;
+		for ( uint32_t i = 0; i < N; i++ ) {
+			frameIn[ i ] = frame[ i ] * windowTable[ i ];
+		}
+		fftwf_execute_dft_r2c( plan, frameIn, frameOut );
+		for ( uint32_t k = 0; k < NumBins(); k++ ) {
+			const float magnitude = magnitudeScale * std::sqrt( frameOut[ k ][ 0 ] * frameOut[ k ][ 0 ] + frameOut[ k ][ 1 ] * frameOut[ k ][ 1 ] );
+			result[ k ] = settings.decibels ? 20.0f * std::log10( std::max( magnitude, 1e-10f ) ) : magnitude;
+		}
+	}
+
+	void Release () {
+		if ( plan != nullptr ) {
+			std::lock_guard< std::mutex > lock( PlannerLock() );
+			fftwf_destroy_plan( plan );
+			plan = nullptr;
+		}
+		fftwf_free( in );
+		fftwf_free( out );
+		in = nullptr;
+		out = nullptr;
+	}
+
+	static std::mutex & PlannerLock () {
+		static std::mutex lock;
+		return lock;
+	}
+
+	static fftwf_plan MakePlan ( const uint32_t N, float *planIn, fftwf_complex *planOut, const std::string &wisdomPath ) {
+		std::lock_guard< std::mutex > lock( PlannerLock() );
+
+		// pick up anything measured by earlier runs, the first time through
+		static bool wisdomLoaded = false;
+		if ( !wisdomLoaded && !wisdomPath.empty() ) {
+			fftwf_import_wisdom_from_filename( wisdomPath.c_str() );
+			wisdomLoaded = true;
+		}
+
+		// only measure if the wisdom doesn't already cover this size, and save it when we did
+		fftwf_plan p = fftwf_plan_dft_r2c_1d( int( N ), planIn, planOut, FFTW_MEASURE | FFTW_WISDOM_ONLY );
+		if ( p == nullptr ) {
+			p = fftwf_plan_dft_r2c_1d( int( N ), planIn, planOut, FFTW_MEASURE );
+			if ( !wisdomPath.empty() ) {
+				fftwf_export_wisdom_to_filename( wisdomPath.c_str() );
+			}
+		}
+		return p;
+	}
+};
+
+#endif // STFT_H